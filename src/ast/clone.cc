@@ -0,0 +1,214 @@
+#include "./clone.hpp"
+
+namespace ast {
+
+Uptr<TextType> Cloner::Copy(const Uptr<TextType> &text) {
+  return text == nullptr ? nullptr : std::make_unique<TextType>(*text);
+}
+
+Uptr<builtin::BasicType> Cloner::Copy(const Uptr<builtin::BasicType> &type) {
+  auto name = std::string(type->GetName());
+  if (name == "Int") return std::make_unique<builtin::Int>();
+  if (name == "Float") return std::make_unique<builtin::Float>();
+  return std::make_unique<builtin::String>();
+}
+
+void Cloner::Visit(Module *module) {
+  auto res = std::make_unique<Module>(module->filename);
+  for (const auto &obj : module->objs) res->AddObj(Copy(obj));
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(Block *block) {
+  auto res = std::make_unique<Block>();
+  for (const auto &stmt : block->statements) res->AddStatement(Copy(stmt));
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(ExprStatement *stmt) {
+  _visit_result = std::make_unique<ExprStatement>(Copy(stmt->expr));
+}
+
+void Cloner::Visit(Break *) { _visit_result = std::make_unique<Break>(); }
+
+void Cloner::Visit(Continue *) {
+  _visit_result = std::make_unique<Continue>();
+}
+
+void Cloner::Visit(Return *ret) {
+  _visit_result = std::make_unique<Return>(Copy(ret->expr));
+}
+
+void Cloner::Visit(If *if_stmt) {
+  _visit_result = std::make_unique<If>(
+      Copy(if_stmt->test), Copy(if_stmt->body), Copy(if_stmt->orelse));
+}
+
+void Cloner::Visit(While *while_stmt) {
+  _visit_result = std::make_unique<While>(
+      Copy(while_stmt->test), Copy(while_stmt->body), Copy(while_stmt->orelse));
+}
+
+void Cloner::Visit(ObjCreate *create) {
+  auto res =
+      std::make_unique<ObjCreate>(Copy(create->id), Copy(create->call_expr));
+  res->binding = create->binding;
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(Function *func) {
+  auto res = std::make_unique<Function>(Copy(func->id), Copy(func->args),
+                                        Copy(func->body));
+  res->binding = func->binding;
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(Assemble *assemble) {
+  auto res = std::make_unique<Assemble>(
+      Copy(assemble->id), Copy(assemble->args), Copy(assemble->body));
+  res->binding = assemble->binding;
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(Struct *struct_create) {
+  auto res = std::make_unique<Struct>(Copy(struct_create->id),
+                                      Copy(struct_create->body));
+  res->binding = struct_create->binding;
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(Class *class_create) {
+  auto res = std::make_unique<Class>(Copy(class_create->id),
+                                     Copy(class_create->parents),
+                                     Copy(class_create->body));
+  res->binding = class_create->binding;
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(Import *import) {
+  auto res = std::make_unique<Import>(
+      Copy(import->id), Copy(import->module_root), Copy(import->files));
+  res->binding = import->binding;
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(Raise *raise) {
+  _visit_result = std::make_unique<Raise>(Copy(raise->error));
+}
+
+void Cloner::Visit(Try *try_stmt) {
+  auto res =
+      std::make_unique<Try>(Copy(try_stmt->body), Copy(try_stmt->orelse));
+  for (const auto &x : try_stmt->excepts) {
+    res->AddExcept(std::make_tuple(Copy(std::get<0>(x)), Copy(std::get<1>(x)),
+                                   Copy(std::get<2>(x))));
+  }
+  res->alias_slots = try_stmt->alias_slots;
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(Literal *literal) {
+  _visit_result =
+      std::make_unique<Literal>(Copy(literal->val), Copy(literal->type));
+}
+
+void Cloner::Visit(Name *name) {
+  auto res =
+      std::make_unique<Name>(Copy(name->id), name->deref, Copy(name->parent));
+  res->binding = name->binding;
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(UnaryOpExpr *expr) {
+  _visit_result =
+      std::make_unique<UnaryOpExpr>(Copy(expr->op), Copy(expr->right));
+}
+
+void Cloner::Visit(BinaryOpExpr *expr) {
+  _visit_result = std::make_unique<BinaryOpExpr>(
+      Copy(expr->left), Copy(expr->op), Copy(expr->right));
+}
+
+void Cloner::Visit(LogicExpr *expr) {
+  _visit_result = std::make_unique<LogicExpr>(
+      Copy(expr->left), Copy(expr->op), Copy(expr->right));
+}
+
+void Cloner::Visit(IfElseExpr *expr) {
+  _visit_result = std::make_unique<IfElseExpr>(
+      Copy(expr->left), Copy(expr->test), Copy(expr->right));
+}
+
+void Cloner::Visit(CallExpr *expr) {
+  auto res = std::make_unique<CallExpr>(Copy(expr->obj), Copy(expr->op));
+  res->escape = expr->escape;
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(SubscriptExpr *expr) {
+  _visit_result =
+      std::make_unique<SubscriptExpr>(Copy(expr->obj), Copy(expr->op));
+}
+
+void Cloner::Visit(CallOperator *cop) {
+  auto res = std::make_unique<CallOperator>();
+  for (const auto &x : cop->unameds) res->AddUnamed(Copy(x));
+  for (const auto &x : cop->keywords) {
+    res->AddKeyword(Copy(std::get<0>(x)), Copy(std::get<1>(x)));
+  }
+  _visit_result = std::move(res);
+}
+
+void Cloner::Visit(SubscriptOperator *sop) {
+  auto res = std::make_unique<SubscriptOperator>();
+  for (const auto &x : sop->dims) {
+    res->AddDim(std::make_unique<SubscriptOperator::SubscriptArg>(
+        Copy(std::get<0>(*x)), Copy(std::get<1>(*x)), Copy(std::get<2>(*x))));
+  }
+  res->in_bounds = sop->in_bounds;
+  _visit_result = std::move(res);
+}
+
+#define _OP_CLONE(OpLeafT) \
+  void Cloner::Visit(OpLeafT *) { _visit_result = std::make_unique<OpLeafT>(); }
+
+_OP_CLONE(OpPlus)
+_OP_CLONE(OpMinus)
+_OP_CLONE(OpMul)
+_OP_CLONE(OpDiv)
+_OP_CLONE(OpMod)
+_OP_CLONE(OpBitXor)
+_OP_CLONE(OpBitOr)
+_OP_CLONE(OpBitAnd)
+_OP_CLONE(OpShiftL)
+_OP_CLONE(OpShiftR)
+
+_OP_CLONE(OpAssign)
+_OP_CLONE(OpSelfPlus)
+_OP_CLONE(OpSelfMinus)
+_OP_CLONE(OpSelfMul)
+_OP_CLONE(OpSelfDiv)
+_OP_CLONE(OpSelfMod)
+_OP_CLONE(OpSelfBitXor)
+_OP_CLONE(OpSelfBitOr)
+_OP_CLONE(OpSelfBitAnd)
+_OP_CLONE(OpSelfShiftL)
+_OP_CLONE(OpSelfShiftR)
+
+_OP_CLONE(OpOr)
+_OP_CLONE(OpAnd)
+_OP_CLONE(OpEq)
+_OP_CLONE(OpNe)
+_OP_CLONE(OpLe)
+_OP_CLONE(OpGe)
+_OP_CLONE(OpLt)
+_OP_CLONE(OpGt)
+
+_OP_CLONE(OpBitNot)
+_OP_CLONE(OpNot)
+_OP_CLONE(OpPositive)
+_OP_CLONE(OpNegative)
+_OP_CLONE(OpDeref)
+_OP_CLONE(OpRef)
+
+}  // namespace ast
@@ -0,0 +1,102 @@
+#ifndef _XULANG_SRC_AST_CLONE_HPP
+#define _XULANG_SRC_AST_CLONE_HPP
+
+#include "./statement.hpp"
+
+namespace ast {
+
+// Deep copy of a node and all its children, bindings and slots included
+class Cloner final : private VisitorInterface {
+ private:
+  Uptr<Node> _visit_result;
+
+  template <class T>
+  Uptr<T> Copy(const Uptr<T> &node) {
+    if (node == nullptr) return nullptr;
+    node->Accept(this);
+    return Uptr<T>(static_cast<T *>(_visit_result.release()));
+  }
+  Uptr<TextType> Copy(const Uptr<TextType> &text);
+  Uptr<builtin::BasicType> Copy(const Uptr<builtin::BasicType> &type);
+
+ public:
+  template <class T>
+  Uptr<T> operator()(const T *node) {
+    if (node == nullptr) return nullptr;
+    const_cast<T *>(node)->Accept(this);
+    return Uptr<T>(static_cast<T *>(_visit_result.release()));
+  }
+
+ private:
+  virtual void Visit(Module *) override;
+  virtual void Visit(Block *) override;
+  virtual void Visit(ExprStatement *) override;
+  virtual void Visit(Break *) override;
+  virtual void Visit(Continue *) override;
+  virtual void Visit(Return *) override;
+  virtual void Visit(If *) override;
+  virtual void Visit(While *) override;
+  virtual void Visit(ObjCreate *) override;
+  virtual void Visit(Function *) override;
+  virtual void Visit(Assemble *) override;
+  virtual void Visit(Struct *) override;
+  virtual void Visit(Class *) override;
+  virtual void Visit(Import *) override;
+  virtual void Visit(Raise *) override;
+  virtual void Visit(Try *) override;
+
+  virtual void Visit(Literal *) override;
+  virtual void Visit(Name *) override;
+  virtual void Visit(UnaryOpExpr *) override;
+  virtual void Visit(BinaryOpExpr *) override;
+  virtual void Visit(LogicExpr *) override;
+  virtual void Visit(IfElseExpr *) override;
+  virtual void Visit(CallExpr *) override;
+  virtual void Visit(SubscriptExpr *) override;
+
+  virtual void Visit(CallOperator *) override;
+  virtual void Visit(SubscriptOperator *) override;
+
+  virtual void Visit(OpPlus *) override;
+  virtual void Visit(OpMinus *) override;
+  virtual void Visit(OpMul *) override;
+  virtual void Visit(OpDiv *) override;
+  virtual void Visit(OpMod *) override;
+  virtual void Visit(OpBitXor *) override;
+  virtual void Visit(OpBitOr *) override;
+  virtual void Visit(OpBitAnd *) override;
+  virtual void Visit(OpShiftL *) override;
+  virtual void Visit(OpShiftR *) override;
+
+  virtual void Visit(OpAssign *) override;
+  virtual void Visit(OpSelfPlus *) override;
+  virtual void Visit(OpSelfMinus *) override;
+  virtual void Visit(OpSelfMul *) override;
+  virtual void Visit(OpSelfDiv *) override;
+  virtual void Visit(OpSelfMod *) override;
+  virtual void Visit(OpSelfBitXor *) override;
+  virtual void Visit(OpSelfBitOr *) override;
+  virtual void Visit(OpSelfBitAnd *) override;
+  virtual void Visit(OpSelfShiftL *) override;
+  virtual void Visit(OpSelfShiftR *) override;
+
+  virtual void Visit(OpOr *) override;
+  virtual void Visit(OpAnd *) override;
+  virtual void Visit(OpEq *) override;
+  virtual void Visit(OpNe *) override;
+  virtual void Visit(OpLe *) override;
+  virtual void Visit(OpGe *) override;
+  virtual void Visit(OpLt *) override;
+  virtual void Visit(OpGt *) override;
+
+  virtual void Visit(OpBitNot *) override;
+  virtual void Visit(OpNot *) override;
+  virtual void Visit(OpPositive *) override;
+  virtual void Visit(OpNegative *) override;
+  virtual void Visit(OpDeref *) override;
+  virtual void Visit(OpRef *) override;
+};
+
+}  // namespace ast
+
+#endif  // _XULANG_SRC_AST_CLONE_HPP
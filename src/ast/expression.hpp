@@ -23,6 +23,7 @@ class Name final : public Expression {
   Uptr<TextType> id;
   bool deref;
   Uptr<Expression> parent;
+  Binding binding;
   Name(Uptr<TextType> &&id, bool deref = false,
        Uptr<Expression> &&parent = nullptr)
       : id(std::move(id)), deref(deref), parent(std::move(parent)) {}
@@ -74,8 +75,17 @@ class IfElseExpr final : public Expression {
 
 class CallExpr final : public Expression {
  public:
+  // Where the object the call makes may still be used after the function
+  // making it returns, filled by pass::EscapeAnalyzer
+  enum Escape {
+    kUnknown,   // not analyzed, or outside any function
+    kNoEscape,  // only by the function, may live in its frame
+    kReturned,  // by the caller, the object is returned or raised
+    kStored,    // by anyone, e.g. stored in a member, a global or by &
+  };
   Uptr<Expression> obj;
   Uptr<CallOperator> op;
+  Escape escape = kUnknown;
   CallExpr(Uptr<Expression> &&obj, Uptr<CallOperator> &&op)
       : obj(std::move(obj)), op(std::move(op)) {}
   virtual void Accept(VisitorInterface *) override;
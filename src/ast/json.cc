@@ -0,0 +1,37 @@
+#include "./json.hpp"
+
+namespace ast {
+
+void PrintJson(const std::string &str, std::ostream &out) {
+  auto depth = 0;
+  bool one_line = false, in_string = false;
+  for (int i = 0; i < static_cast<int>(str.length());) {
+    if (str[i] == '{' || str[i] == '[') {
+      int right = str.find(str[i] == '{' ? '}' : ']', i);
+      one_line = str.find(str[i], i + 1) > static_cast<size_t>(right) &&
+                 str.find(',', i) > static_cast<size_t>(right);
+
+      out << str[i++];
+      if (!one_line) out << "\n" << std::string(++depth * 2, ' ');
+    } else if (str[i] == '}' || str[i] == ']') {
+      if (!one_line) out << "\n" << std::string(--depth * 2, ' ');
+      out << str[i++];
+
+      if (str[i] == ',') {
+        out << str[i++] << '\n' << std::string(depth * 2, ' ');
+        i += str[i] == ' ';
+      } else if (str[i] == '}') {
+        one_line = false;
+      }
+    } else {
+      out << str[i];
+      in_string ^= str[i] == '"';
+      if (str[i++] == ',' && !in_string) {
+        out << '\n' << std::string(depth * 2, ' ');
+        i += str[i] == ' ';
+      }
+    }
+  }
+}
+
+}  // namespace ast
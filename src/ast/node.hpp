@@ -22,6 +22,16 @@ struct SourceCodeLocator {
   }
 };
 
+// Where an id lives, filled by pass::Resolver so that later passes index
+// frames instead of looking names up by string
+struct Binding {
+  enum Kind { kUnresolved, kLocal, kGlobal, kBuiltin, kMember };
+  Kind kind = kUnresolved;
+  int depth = 0;  // kLocal, how many frames outwards from the use
+  int slot = -1;  // kLocal frame slot, kGlobal Module objs index,
+                  // kBuiltin builtin::kBuiltins index
+};
+
 // The base of all AST node classes
 class Node {
  public:
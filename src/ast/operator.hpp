@@ -2,6 +2,7 @@
 #define _XULANG_SRC_AST_OPERATOR_HPP
 
 #include <iostream>
+#include <vector>
 
 #include "./node.hpp"
 
@@ -43,6 +44,9 @@ class SubscriptOperator final : public Operator {
   using SubscriptArg =
       std::tuple<Uptr<Expression>, Uptr<Expression>, Uptr<Expression>>;
   std::list<Uptr<SubscriptArg>> dims;
+  // By dim, true if its index is known to be in bounds, set by
+  // pass::RangeAnalyzer. Empty or false means it must be checked.
+  std::vector<bool> in_bounds;
   SubscriptOperator() = default;
   virtual const char *GetName() const override;
   virtual void Accept(VisitorInterface *) override;
@@ -50,6 +54,11 @@ class SubscriptOperator final : public Operator {
   inline void AddDim(Uptr<SubscriptArg> &&dim) {
     dims.push_back(std::move(dim));
   }
+  // Not [beg] alone, which [beg:] and [beg::] parse the same as
+  static inline bool IsSlice(const SubscriptArg &dim) {
+    return std::get<0>(dim) == nullptr || std::get<1>(dim) != nullptr ||
+           std::get<2>(dim) != nullptr;
+  }
 };
 
 #define _OP_CHILD_CLASS(class_name, parent)                  \
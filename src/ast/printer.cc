@@ -0,0 +1,234 @@
+#include "./printer.hpp"
+
+namespace ast {
+
+std::string Printer::Print(const Node *node) {
+  if (node == nullptr) return "";
+  const_cast<Node *>(node)->Accept(this);
+  return _visit_result;
+}
+
+std::string Printer::PrintOperand(const Expression *expr) {
+  auto res = Print(expr);
+  if (dynamic_cast<const UnaryOpExpr *>(expr) != nullptr ||
+      dynamic_cast<const BinaryOpExpr *>(expr) != nullptr ||
+      dynamic_cast<const LogicExpr *>(expr) != nullptr ||
+      dynamic_cast<const IfElseExpr *>(expr) != nullptr) {
+    return "(" + res + ")";
+  }
+  return res;
+}
+
+void Printer::Visit(Module *module) {
+  auto res = std::string();
+  for (const auto &obj : module->objs) res += Print(obj.get()) + "\n";
+  _visit_result = res;
+}
+
+void Printer::Visit(Block *block) {
+  if (block->statements.empty()) {
+    _visit_result = "{}";
+    return;
+  }
+  auto res = std::string("{\n");
+  ++_depth;
+  for (const auto &stmt : block->statements) {
+    res += Indent() + Print(stmt.get()) + "\n";
+  }
+  --_depth;
+  _visit_result = res + Indent() + "}";
+}
+
+void Printer::Visit(ExprStatement *stmt) {
+  _visit_result = Print(stmt->expr.get());
+}
+void Printer::Visit(Break *) { _visit_result = "break"; }
+void Printer::Visit(Continue *) { _visit_result = "continue"; }
+
+void Printer::Visit(Return *ret) {
+  _visit_result = ret->expr ? "return " + Print(ret->expr.get()) : "return";
+}
+
+void Printer::Visit(If *if_stmt) {
+  auto res = "if (" + Print(if_stmt->test.get()) + ") " +
+             Print(if_stmt->body.get());
+  if (if_stmt->orelse != nullptr) {
+    // The parser nests "else if" as a Block holding a single If
+    const auto &stmts = if_stmt->orelse->statements;
+    if (stmts.size() == 1 && dynamic_cast<If *>(stmts.front().get())) {
+      res += " else " + Print(stmts.front().get());
+    } else {
+      res += " else " + Print(if_stmt->orelse.get());
+    }
+  }
+  _visit_result = res;
+}
+
+void Printer::Visit(While *while_stmt) {
+  auto res = "while (" + Print(while_stmt->test.get()) + ") " +
+             Print(while_stmt->body.get());
+  if (while_stmt->orelse) res += " else " + Print(while_stmt->orelse.get());
+  _visit_result = res;
+}
+
+void Printer::Visit(ObjCreate *create) {
+  _visit_result = *create->id + " := " + Print(create->call_expr.get());
+}
+
+void Printer::Visit(Function *func) {
+  auto args = Print(func->args.get());
+  _visit_result = *func->id + " := Function" + args + " " +
+                  Print(func->body.get());
+}
+
+void Printer::Visit(Assemble *assemble) {
+  auto args = Print(assemble->args.get());
+  _visit_result = *assemble->id + " := Assemble" + args + " " +
+                  Print(assemble->body.get());
+}
+
+void Printer::Visit(Struct *struct_create) {
+  _visit_result = *struct_create->id + " := Struct() " +
+                  Print(struct_create->body.get());
+}
+
+void Printer::Visit(Class *class_create) {
+  auto parents = Print(class_create->parents.get());
+  _visit_result = *class_create->id + " := Class" + parents + " " +
+                  Print(class_create->body.get());
+}
+
+void Printer::Visit(Import *import) {
+  auto root = Print(import->module_root.get());
+  _visit_result = *import->id + " := Import" + root + " " +
+                  Print(import->files.get());
+}
+
+void Printer::Visit(Raise *raise) {
+  _visit_result = "raise " + Print(raise->error.get());
+}
+
+void Printer::Visit(Try *try_stmt) {
+  auto res = "try " + Print(try_stmt->body.get());
+  for (const auto &x : try_stmt->excepts) {
+    auto error = Print(std::get<1>(x).get());
+    res += " except (" + *std::get<0>(x) + " := " + error + ") " +
+           Print(std::get<2>(x).get());
+  }
+  if (try_stmt->orelse) res += " else " + Print(try_stmt->orelse.get());
+  _visit_result = res;
+}
+
+void Printer::Visit(Literal *literal) { _visit_result = *literal->val; }
+
+void Printer::Visit(Name *name) {
+  if (name->parent == nullptr) {
+    _visit_result = *name->id;
+    return;
+  }
+  auto parent = PrintOperand(name->parent.get());
+  _visit_result = parent + (name->deref ? "->" : ".") + *name->id;
+}
+
+void Printer::Visit(UnaryOpExpr *expr) {
+  auto op = Print(expr->op.get());
+  _visit_result = op + PrintOperand(expr->right.get());
+}
+
+void Printer::Visit(BinaryOpExpr *expr) {
+  auto left = PrintOperand(expr->left.get());
+  auto op = Print(expr->op.get());
+  _visit_result = left + " " + op + " " + PrintOperand(expr->right.get());
+}
+
+void Printer::Visit(LogicExpr *expr) {
+  auto left = PrintOperand(expr->left.get());
+  auto op = Print(expr->op.get());
+  _visit_result = left + " " + op + " " + PrintOperand(expr->right.get());
+}
+
+void Printer::Visit(IfElseExpr *expr) {
+  auto left = PrintOperand(expr->left.get());
+  auto test = PrintOperand(expr->test.get());
+  _visit_result =
+      left + " if " + test + " else " + PrintOperand(expr->right.get());
+}
+
+void Printer::Visit(CallExpr *expr) {
+  auto obj = PrintOperand(expr->obj.get());
+  _visit_result = obj + Print(expr->op.get());
+}
+
+void Printer::Visit(SubscriptExpr *expr) {
+  auto obj = PrintOperand(expr->obj.get());
+  _visit_result = obj + Print(expr->op.get());
+}
+
+void Printer::Visit(CallOperator *cop) {
+  auto res = std::string();
+  for (const auto &x : cop->unameds) {
+    res += (res.empty() ? "" : ", ") + Print(x.get());
+  }
+  for (const auto &x : cop->keywords) {
+    res += (res.empty() ? "" : ", ") + *std::get<0>(x) +
+           ":=" + Print(std::get<1>(x).get());
+  }
+  _visit_result = "(" + res + ")";
+}
+
+void Printer::Visit(SubscriptOperator *sop) {
+  auto res = std::string();
+  for (const auto &x : sop->dims) {
+    auto dim = Print(std::get<0>(*x).get());
+    if (std::get<1>(*x) || std::get<2>(*x)) {
+      dim += ":" + Print(std::get<1>(*x).get());
+    }
+    if (std::get<2>(*x)) dim += ":" + Print(std::get<2>(*x).get());
+    res += (res.empty() ? "" : ", ") + dim;
+  }
+  _visit_result = "[" + res + "]";
+}
+
+#define _OP_TO_SOURCE(OpLeafT, symbol) \
+  void Printer::Visit(OpLeafT *) { _visit_result = symbol; }
+
+_OP_TO_SOURCE(OpPlus, "+")
+_OP_TO_SOURCE(OpMinus, "-")
+_OP_TO_SOURCE(OpMul, "*")
+_OP_TO_SOURCE(OpDiv, "/")
+_OP_TO_SOURCE(OpMod, "%")
+_OP_TO_SOURCE(OpBitXor, "^")
+_OP_TO_SOURCE(OpBitOr, "|")
+_OP_TO_SOURCE(OpBitAnd, "&")
+_OP_TO_SOURCE(OpShiftL, "<<")
+_OP_TO_SOURCE(OpShiftR, ">>")
+
+_OP_TO_SOURCE(OpAssign, "=")
+_OP_TO_SOURCE(OpSelfPlus, "+=")
+_OP_TO_SOURCE(OpSelfMinus, "-=")
+_OP_TO_SOURCE(OpSelfMul, "*=")
+_OP_TO_SOURCE(OpSelfDiv, "/=")
+_OP_TO_SOURCE(OpSelfMod, "%=")
+_OP_TO_SOURCE(OpSelfBitXor, "^=")
+_OP_TO_SOURCE(OpSelfBitOr, "|=")
+_OP_TO_SOURCE(OpSelfBitAnd, "&=")
+_OP_TO_SOURCE(OpSelfShiftL, "<<=")
+_OP_TO_SOURCE(OpSelfShiftR, ">>=")
+
+_OP_TO_SOURCE(OpOr, "||")
+_OP_TO_SOURCE(OpAnd, "&&")
+_OP_TO_SOURCE(OpEq, "==")
+_OP_TO_SOURCE(OpNe, "!=")
+_OP_TO_SOURCE(OpLe, "<=")
+_OP_TO_SOURCE(OpGe, ">=")
+_OP_TO_SOURCE(OpLt, "<")
+_OP_TO_SOURCE(OpGt, ">")
+
+_OP_TO_SOURCE(OpBitNot, "~")
+_OP_TO_SOURCE(OpNot, "!")
+_OP_TO_SOURCE(OpPositive, "+")
+_OP_TO_SOURCE(OpNegative, "-")
+_OP_TO_SOURCE(OpDeref, "*")
+_OP_TO_SOURCE(OpRef, "&")
+
+}  // namespace ast
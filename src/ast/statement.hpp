@@ -1,6 +1,8 @@
 #ifndef _XULANG_SRC_AST_STATEMENT_HPP
 #define _XULANG_SRC_AST_STATEMENT_HPP
 
+#include <vector>
+
 #include "./expression.hpp"
 
 namespace ast {
@@ -8,6 +10,7 @@ namespace ast {
 class Statement : public Node {};
 class Create : public Statement {
  public:
+  Binding binding;  // where the created id is stored
   virtual const TextType *GetId() const = 0;
 };
 
@@ -102,6 +105,8 @@ class ObjCreate final : public Create {
 };
 
 // e.g. func_name := Function(Void, Arg0:=T0(), Arg1:=T1()) { }
+// The first unamed arg is the return type, the other unameds are parameter
+// names, then come the keyword parameters with their defaults
 class Function final : public Create {
  public:
   Uptr<TextType> id;
@@ -176,6 +181,7 @@ class Try final : public Statement {
   Uptr<Block> body;
   std::list<std::tuple<Uptr<TextType>, Uptr<Name>, Uptr<Block>>> excepts;
   Uptr<Block> orelse;
+  std::vector<int> alias_slots;  // frame slot of each except alias
   Try(Uptr<Block> &&body, Uptr<Block> &&orelse = nullptr)
       : body(std::move(body)), orelse(std::move(orelse)) {}
   virtual void Accept(VisitorInterface *) override;
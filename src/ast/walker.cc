@@ -0,0 +1,196 @@
+#include "./walker.hpp"
+
+namespace ast {
+
+void Walker::Visit(Module *module) {
+  for (const auto &obj : module->objs) Walk(obj.get());
+}
+
+void Walker::Visit(Block *block) {
+  for (const auto &stmt : block->statements) Walk(stmt.get());
+}
+
+void Walker::Visit(ExprStatement *stmt) { Walk(stmt->expr.get()); }
+void Walker::Visit(Return *ret) { Walk(ret->expr.get()); }
+
+void Walker::Visit(If *if_stmt) {
+  Walk(if_stmt->test.get());
+  Walk(if_stmt->body.get());
+  Walk(if_stmt->orelse.get());
+}
+
+void Walker::Visit(While *while_stmt) {
+  Walk(while_stmt->test.get());
+  Walk(while_stmt->body.get());
+  Walk(while_stmt->orelse.get());
+}
+
+void Walker::Visit(ObjCreate *create) { Walk(create->call_expr.get()); }
+
+void Walker::Visit(Function *func) {
+  Walk(func->args.get());
+  Walk(func->body.get());
+}
+
+void Walker::Visit(Assemble *assemble) {
+  Walk(assemble->args.get());
+  Walk(assemble->body.get());
+}
+
+void Walker::Visit(Struct *struct_create) { Walk(struct_create->body.get()); }
+
+void Walker::Visit(Class *class_create) {
+  Walk(class_create->parents.get());
+  Walk(class_create->body.get());
+}
+
+void Walker::Visit(Import *import) {
+  Walk(import->module_root.get());
+  Walk(import->files.get());
+}
+
+void Walker::Visit(Raise *raise) { Walk(raise->error.get()); }
+
+void Walker::Visit(Try *try_stmt) {
+  Walk(try_stmt->body.get());
+  for (const auto &x : try_stmt->excepts) {
+    Walk(std::get<1>(x).get());
+    Walk(std::get<2>(x).get());
+  }
+  Walk(try_stmt->orelse.get());
+}
+
+void Walker::Visit(Name *name) { Walk(name->parent.get()); }
+
+void Walker::Visit(UnaryOpExpr *expr) {
+  Walk(expr->op.get());
+  Walk(expr->right.get());
+}
+
+void Walker::Visit(BinaryOpExpr *expr) {
+  Walk(expr->left.get());
+  Walk(expr->op.get());
+  Walk(expr->right.get());
+}
+
+void Walker::Visit(LogicExpr *expr) {
+  Walk(expr->left.get());
+  Walk(expr->op.get());
+  Walk(expr->right.get());
+}
+
+void Walker::Visit(IfElseExpr *expr) {
+  Walk(expr->left.get());
+  Walk(expr->test.get());
+  Walk(expr->right.get());
+}
+
+void Walker::Visit(CallExpr *expr) {
+  Walk(expr->obj.get());
+  Walk(expr->op.get());
+}
+
+void Walker::Visit(SubscriptExpr *expr) {
+  Walk(expr->obj.get());
+  Walk(expr->op.get());
+}
+
+void Walker::Visit(CallOperator *cop) {
+  for (const auto &x : cop->unameds) Walk(x.get());
+  for (const auto &x : cop->keywords) Walk(std::get<1>(x).get());
+}
+
+void Walker::Visit(SubscriptOperator *sop) {
+  for (const auto &x : sop->dims) {
+    Walk(std::get<0>(*x).get());
+    Walk(std::get<1>(*x).get());
+    Walk(std::get<2>(*x).get());
+  }
+}
+
+namespace {
+
+#define _COUNT_AND_WALK(NodeClass)              \
+  virtual void Visit(NodeClass *node) override { \
+    ++count;                                     \
+    Walker::Visit(node);                         \
+  }
+
+class Counter final : public Walker {
+ public:
+  size_t count = 0;
+
+  _COUNT_AND_WALK(Module)
+  _COUNT_AND_WALK(Block)
+  _COUNT_AND_WALK(ExprStatement)
+  _COUNT_AND_WALK(Break)
+  _COUNT_AND_WALK(Continue)
+  _COUNT_AND_WALK(Return)
+  _COUNT_AND_WALK(If)
+  _COUNT_AND_WALK(While)
+  _COUNT_AND_WALK(ObjCreate)
+  _COUNT_AND_WALK(Function)
+  _COUNT_AND_WALK(Assemble)
+  _COUNT_AND_WALK(Struct)
+  _COUNT_AND_WALK(Class)
+  _COUNT_AND_WALK(Import)
+  _COUNT_AND_WALK(Raise)
+  _COUNT_AND_WALK(Try)
+  _COUNT_AND_WALK(Literal)
+  _COUNT_AND_WALK(Name)
+  _COUNT_AND_WALK(UnaryOpExpr)
+  _COUNT_AND_WALK(BinaryOpExpr)
+  _COUNT_AND_WALK(LogicExpr)
+  _COUNT_AND_WALK(IfElseExpr)
+  _COUNT_AND_WALK(CallExpr)
+  _COUNT_AND_WALK(SubscriptExpr)
+  _COUNT_AND_WALK(CallOperator)
+  _COUNT_AND_WALK(SubscriptOperator)
+  _COUNT_AND_WALK(OpPlus)
+  _COUNT_AND_WALK(OpMinus)
+  _COUNT_AND_WALK(OpMul)
+  _COUNT_AND_WALK(OpDiv)
+  _COUNT_AND_WALK(OpMod)
+  _COUNT_AND_WALK(OpBitXor)
+  _COUNT_AND_WALK(OpBitOr)
+  _COUNT_AND_WALK(OpBitAnd)
+  _COUNT_AND_WALK(OpShiftL)
+  _COUNT_AND_WALK(OpShiftR)
+  _COUNT_AND_WALK(OpAssign)
+  _COUNT_AND_WALK(OpSelfPlus)
+  _COUNT_AND_WALK(OpSelfMinus)
+  _COUNT_AND_WALK(OpSelfMul)
+  _COUNT_AND_WALK(OpSelfDiv)
+  _COUNT_AND_WALK(OpSelfMod)
+  _COUNT_AND_WALK(OpSelfBitXor)
+  _COUNT_AND_WALK(OpSelfBitOr)
+  _COUNT_AND_WALK(OpSelfBitAnd)
+  _COUNT_AND_WALK(OpSelfShiftL)
+  _COUNT_AND_WALK(OpSelfShiftR)
+  _COUNT_AND_WALK(OpOr)
+  _COUNT_AND_WALK(OpAnd)
+  _COUNT_AND_WALK(OpEq)
+  _COUNT_AND_WALK(OpNe)
+  _COUNT_AND_WALK(OpLe)
+  _COUNT_AND_WALK(OpGe)
+  _COUNT_AND_WALK(OpLt)
+  _COUNT_AND_WALK(OpGt)
+  _COUNT_AND_WALK(OpBitNot)
+  _COUNT_AND_WALK(OpNot)
+  _COUNT_AND_WALK(OpPositive)
+  _COUNT_AND_WALK(OpNegative)
+  _COUNT_AND_WALK(OpDeref)
+  _COUNT_AND_WALK(OpRef)
+};
+
+#undef _COUNT_AND_WALK
+
+}  // namespace
+
+size_t CountNodes(Node *node) {
+  auto counter = Counter();
+  counter.Walk(node);
+  return counter.count;
+}
+
+}  // namespace ast
@@ -0,0 +1,51 @@
+#ifndef _XULANG_SRC_BUILTIN_NAMES_HPP
+#define _XULANG_SRC_BUILTIN_NAMES_HPP
+
+#include <iterator>
+#include <string>
+
+namespace builtin {
+
+// Ids every module can use without creating them
+struct Builtin {
+  const char *name;
+  bool is_type;
+  bool is_pure;      // no side effect at all, so it may be removed or moved
+  bool is_readonly;  // never changes its arguments, but may do IO
+  bool is_alloc;     // a new object every call, never the same as another
+};
+
+inline constexpr Builtin kBuiltins[] = {
+    {"Int", true, true, true, false},     {"Int8", true, true, true, false},
+    {"Float", true, true, true, false},   {"String", true, true, true, false},
+    {"Array", true, true, true, true},    {"Memory", true, true, true, true},
+    {"Ptr", true, true, true, false},     {"Error", true, true, true, true},
+    {"Auto", true, true, true, false},    {"Void", true, true, true, false},
+    {"VOID", false, true, true, false},   {"Print", false, false, true, false},
+    {"Input", false, false, true, false},
+    // Bulk operations on the elements [lo, hi) of a Memory or Array:
+    // Fill(a, v, lo, hi), Copy(a, b, lo, hi), Sum(a, lo, hi), Count(a, v, lo, hi)
+    {"Fill", false, false, false, false}, {"Copy", false, false, false, false},
+    {"Sum", false, false, true, false},   {"Count", false, false, true, false},
+};
+
+// Methods of builtin types which only read their object
+inline constexpr const char *kPureMethods[] = {"length"};
+
+inline int FindBuiltin(const std::string &name) {
+  for (int i = 0; i < static_cast<int>(std::size(kBuiltins)); ++i) {
+    if (name == kBuiltins[i].name) return i;
+  }
+  return -1;
+}
+
+inline bool IsPureMethod(const std::string &name) {
+  for (const auto &method : kPureMethods) {
+    if (name == method) return true;
+  }
+  return false;
+}
+
+}  // namespace builtin
+
+#endif  // _XULANG_SRC_BUILTIN_NAMES_HPP
@@ -0,0 +1,685 @@
+#include "./build.hpp"
+
+#include "../builtin/names.hpp"
+
+namespace ir {
+
+// Both the operator and its self assigning form, e.g. + and +=
+static const std::unordered_map<std::string, Op> kOps = {
+    {"__plus__", Op::kAdd},          {"__self_plus__", Op::kAdd},
+    {"__minus__", Op::kSub},         {"__self_minus__", Op::kSub},
+    {"__mul__", Op::kMul},           {"__self_mul__", Op::kMul},
+    {"__div__", Op::kDiv},           {"__self_div__", Op::kDiv},
+    {"__mod__", Op::kMod},           {"__self_mod__", Op::kMod},
+    {"__bit_xor__", Op::kXor},       {"__self_bit_xor__", Op::kXor},
+    {"__bit_or__", Op::kOr},         {"__self_bit_or__", Op::kOr},
+    {"__bit_and__", Op::kAnd},       {"__self_bit_and__", Op::kAnd},
+    {"__shift_left__", Op::kShl},    {"__self_shift_left__", Op::kShl},
+    {"__shift_right__", Op::kShr},   {"__self_shift_right__", Op::kShr},
+    {"__eq__", Op::kEq},             {"__ne__", Op::kNe},
+    {"__le__", Op::kLe},             {"__ge__", Op::kGe},
+    {"__lt__", Op::kLt},             {"__gt__", Op::kGt},
+    {"__positive__", Op::kPos},      {"__negative__", Op::kNeg},
+    {"__not__", Op::kNot},           {"__bit_not__", Op::kBitNot},
+    {"__deref__", Op::kDeref},       {"__ref__", Op::kRef},
+};
+
+// Bit d is set if dim d needs no bounds check, see pass::RangeAnalyzer
+static int InBounds(const ast::SubscriptOperator *sop) {
+  auto res = 0;
+  for (size_t i = 0; i < sop->in_bounds.size() && i < 31; ++i) {
+    if (sop->in_bounds[i]) res |= 1 << i;
+  }
+  return res;
+}
+
+// Every Function and Assemble with the path of Creates leading to it
+class Callables final : public ast::Walker {
+ public:
+  struct Callable {
+    std::string name;  // e.g. Name.__Create__
+    ast::CallOperator *args;
+    ast::Block *body;
+  };
+  std::vector<Callable> found;
+
+ private:
+  std::vector<std::string> _path;
+
+  void Enter(ast::Create *create, ast::CallOperator *args, ast::Block *body) {
+    _path.push_back(*create->GetId());
+    if (args != nullptr) {
+      auto name = std::string();
+      for (const auto &id : _path) name += (name.empty() ? "" : ".") + id;
+      found.push_back({name, args, body});
+    }
+  }
+
+ public:
+  virtual void Visit(ast::Function *func) override {
+    Enter(func, func->args.get(), func->body.get());
+    ast::Walker::Visit(func);
+    _path.pop_back();
+  }
+  virtual void Visit(ast::Assemble *assemble) override {
+    Enter(assemble, assemble->args.get(), assemble->body.get());
+    ast::Walker::Visit(assemble);
+    _path.pop_back();
+  }
+  virtual void Visit(ast::Struct *struct_create) override {
+    Enter(struct_create, nullptr, nullptr);
+    ast::Walker::Visit(struct_create);
+    _path.pop_back();
+  }
+  virtual void Visit(ast::Class *class_create) override {
+    Enter(class_create, nullptr, nullptr);
+    ast::Walker::Visit(class_create);
+    _path.pop_back();
+  }
+  virtual void Visit(ast::Import *) override {}
+};
+
+Lowering Builder::operator()(ast::Module *module) {
+  auto res = Lowering();
+  _remarks = &res.remarks;
+  auto callables = Callables();
+  callables.Walk(module);
+  for (const auto &callable : callables.found) {
+    _where = module->filename + ": " + callable.name;
+    res.funcs.push_back(Lower(callable.name, callable.args, callable.body));
+  }
+  return res;
+}
+
+Uptr<Function> Builder::Lower(const std::string &name, ast::CallOperator *args,
+                              ast::Block *body) {
+  auto func = std::make_unique<Function>(name);
+  _func = func.get();
+  _undef = nullptr;
+  _loops.clear();
+  _unwinds.clear();
+  _defs.clear();
+  _incomplete.clear();
+  _sealed.clear();
+  _removed_phis.clear();
+
+  _block = NewBlock();
+  Seal(_block);
+  WriteVariable(kMemory, _block, Emit(Make(Op::kEntry)));
+
+  // The parameters take the first slots, see pass::Resolver. The first
+  // unamed arg is the return type.
+  auto unamed = args->unameds.begin();
+  if (unamed != args->unameds.end()) ++unamed;
+  for (; unamed != args->unameds.end(); ++unamed) {
+    auto param = dynamic_cast<ast::Name *>(unamed->get());
+    if (param != nullptr && param->parent == nullptr) ++_func->params;
+  }
+  _func->params += static_cast<int>(args->keywords.size());
+  for (auto i = 0; i < _func->params; ++i) {
+    auto param = Make(Op::kParam);
+    param->num = i;
+    WriteVariable(i, _block, Emit(std::move(param)));
+  }
+
+  Walk(body);
+  Emit(Make(Op::kReturn));
+
+  for (const auto &[phi, _] : _removed_phis) _func->Erase(phi);
+  _func->RemoveUnreachable();
+  if (_undef != nullptr && _undef->users.empty()) _func->Erase(_undef);
+  return func;
+}
+
+void Builder::WriteVariable(int var, Block *block, Instr *value) {
+  _defs[block][var] = value;
+}
+
+Instr *Builder::ReadVariable(int var, Block *block) {
+  auto &defs = _defs[block];
+  auto it = defs.find(var);
+  if (it != defs.end()) return it->second;
+  return ReadVariableRecursive(var, block);
+}
+
+Instr *Builder::ReadVariableRecursive(int var, Block *block) {
+  Instr *val = nullptr;
+  if (!_sealed.count(block)) {
+    // Not all preds are known yet, e.g. the header of a loop
+    val = Phi(block, {});
+    _incomplete[block][var] = val;
+  } else if (block->preds.empty()) {
+    val = Undef();
+  } else if (block->preds.size() == 1) {
+    val = ReadVariable(var, block->preds[0]);
+  } else {
+    // Break cycles with an operandless phi
+    val = Phi(block, {});
+    WriteVariable(var, block, val);
+    val = AddPhiOperands(var, val);
+  }
+  WriteVariable(var, block, val);
+  return val;
+}
+
+Instr *Builder::AddPhiOperands(int var, Instr *phi) {
+  for (auto pred : phi->block->preds) phi->AddArg(ReadVariable(var, pred));
+  return TryRemoveTrivialPhi(phi);
+}
+
+Instr *Builder::TryRemoveTrivialPhi(Instr *phi) {
+  Instr *same = nullptr;
+  for (auto arg : phi->args) {
+    if (arg == same || arg == phi) continue;
+    if (same != nullptr) return phi;  // merges at least two values
+    same = arg;
+  }
+  if (same == nullptr) same = Undef();  // unreachable or in the entry
+
+  auto users = phi->users;
+  _func->ReplaceAllUses(phi, same);
+  for (auto &[_, defs] : _defs) {
+    for (auto &[_, def] : defs) {
+      if (def == phi) def = same;
+    }
+  }
+  phi->DropArgs();
+  _removed_phis[phi] = same;
+
+  // Removing it may have made the phis using it trivial. Skip the ones still
+  // getting their operands, they are checked once they have all of them.
+  for (auto user : users) {
+    if (user == phi || user->op != Op::kPhi || _removed_phis.count(user) ||
+        user->args.size() != user->block->preds.size()) {
+      continue;
+    }
+    TryRemoveTrivialPhi(user);
+  }
+  while (_removed_phis.count(same)) same = _removed_phis[same];
+  return same;
+}
+
+void Builder::Seal(Block *block) {
+  auto incomplete = std::move(_incomplete[block]);
+  _incomplete.erase(block);
+  _sealed.insert(block);
+  for (const auto &[var, phi] : incomplete) AddPhiOperands(var, phi);
+}
+
+Block *Builder::NewBlock() { return _func->NewBlock(); }
+
+Uptr<Instr> Builder::Make(Op op, const std::vector<Instr *> &args) {
+  auto instr = _func->NewInstr(op, EffectOf(op));
+  for (auto arg : args) instr->AddArg(arg);
+  return instr;
+}
+
+// Operators raise on operands of the wrong types, e.g. 1 + 'a', and so do
+// division by zero, shifts out of range, members and indices. Calls are
+// invokes instead.
+static bool MayRaise(const Instr *instr) {
+  switch (instr->op) {
+    case Op::kNot:
+      return false;
+    case Op::kGetMember:
+    case Op::kGetIndex:
+    case Op::kDeref:
+    case Op::kSetMember:
+    case Op::kSetIndex:
+    case Op::kStore:
+    case Op::kMatch:
+      return true;
+    default:
+      return instr->op >= Op::kAdd && instr->op <= Op::kBitNot;
+  }
+}
+
+Instr *Builder::Emit(Uptr<Instr> &&instr) {
+  auto effect = instr->effect;
+  if ((effect == Effect::kRead || effect == Effect::kWrite) &&
+      instr->op != Op::kCatch) {
+    instr->AddArg(ReadVariable(kMemory, _block));
+  }
+  auto block = _block;
+  auto res = _func->Append(block, std::move(instr));
+  if (effect == Effect::kWrite) WriteVariable(kMemory, block, res);
+
+  // A raise goes to the except dispatch
+  if (!_unwinds.empty() && MayRaise(res)) {
+    auto normal = NewBlock();
+    auto unwind = Make(Op::kUnwind);
+    unwind->succs = {normal, _unwinds.back()};
+    _func->Append(block, std::move(unwind));
+    Seal(normal);
+    _block = normal;
+  }
+  return res;
+}
+
+Instr *Builder::Undef() {
+  if (_undef == nullptr) {
+    _undef = _func->Prepend(_func->blocks.front().get(), Make(Op::kUndef));
+  }
+  return _undef;
+}
+
+Instr *Builder::Phi(Block *block, const std::vector<Instr *> &args) {
+  return _func->Prepend(block, Make(Op::kPhi, args));
+}
+
+void Builder::Jump(Block *target) {
+  auto jump = Make(Op::kJump);
+  jump->succs = {target};
+  Emit(std::move(jump));
+}
+
+void Builder::Branch(Instr *test, Block *taken, Block *not_taken) {
+  auto branch = Make(Op::kBranch, {test});
+  branch->succs = {taken, not_taken};
+  Emit(std::move(branch));
+}
+
+// After return, raise, break and continue the code is unreachable, keep
+// lowering it into a block without preds which is removed at the end
+void Builder::Kill() {
+  _block = NewBlock();
+  Seal(_block);
+}
+
+void Builder::Remark(const std::string &message) {
+  _remarks->push_back({"ir", _where, message});
+}
+
+Instr *Builder::Value(ast::Node *expr) {
+  _value = nullptr;
+  Walk(expr);
+  return _value == nullptr ? Undef() : _value;
+}
+
+Instr *Builder::Load(const ast::Binding &binding, const std::string &id) {
+  if (binding.kind == ast::Binding::kLocal && binding.depth == 0) {
+    return ReadVariable(binding.slot, _block);
+  }
+  auto op = Op::kGlobal;  // also for unresolved names, slot -1
+  if (binding.kind == ast::Binding::kLocal) {
+    op = Op::kLoadOuter;
+  } else if (binding.kind == ast::Binding::kBuiltin) {
+    op = Op::kBuiltin;
+  }
+  auto instr = Make(op);
+  instr->text = id;
+  instr->depth = binding.depth;
+  instr->num = binding.slot;
+  return Emit(std::move(instr));
+}
+
+void Builder::Store(const ast::Binding &binding, const std::string &id,
+                    Instr *val) {
+  if (binding.kind == ast::Binding::kLocal && binding.depth == 0) {
+    return WriteVariable(binding.slot, _block, val);
+  }
+  if (binding.kind == ast::Binding::kBuiltin) {
+    return Remark("cannot assign to builtin \"" + id + "\"");
+  }
+  auto instr = Make(binding.kind == ast::Binding::kLocal ? Op::kStoreOuter
+                                                         : Op::kStoreGlobal,
+                    {val});
+  instr->text = id;
+  instr->depth = binding.depth;
+  instr->num = binding.slot;
+  Emit(std::move(instr));
+}
+
+// Evaluate the target before the value, e.g. a[i] += f() reads a[i] first
+Instr *Builder::Assign(ast::Expression *target, const Op *op,
+                       ast::Expression *val) {
+  auto compute = [&](Instr *old) {
+    auto res = Value(val);
+    return op == nullptr ? res : Emit(Make(*op, {old, res}));
+  };
+
+  if (auto name = dynamic_cast<ast::Name *>(target); name != nullptr) {
+    if (name->parent == nullptr) {
+      auto res = compute(op ? Load(name->binding, *name->id) : nullptr);
+      Store(name->binding, *name->id, res);
+      return res;
+    }
+    auto obj = Value(name->parent.get());
+    auto get = [&] {
+      auto instr = Make(Op::kGetMember, {obj});
+      instr->text = *name->id;
+      instr->deref = name->deref;
+      return Emit(std::move(instr));
+    };
+    auto res = compute(op ? get() : nullptr);
+    auto set = Make(Op::kSetMember, {obj, res});
+    set->text = *name->id;
+    set->deref = name->deref;
+    Emit(std::move(set));
+    return res;
+  }
+
+  if (auto sub = dynamic_cast<ast::SubscriptExpr *>(target); sub != nullptr) {
+    auto obj = Value(sub->obj.get());
+    auto indices = Indices(sub->op.get());
+    auto args = std::vector<Instr *>{obj};
+    args.insert(args.end(), indices.begin(), indices.end());
+    auto get = op ? Make(Op::kGetIndex, args) : nullptr;
+    if (get != nullptr) get->num = InBounds(sub->op.get());
+    auto res = compute(op ? Emit(std::move(get)) : nullptr);
+    args.insert(args.begin() + 1, res);
+    auto set = Make(Op::kSetIndex, args);
+    set->num = InBounds(sub->op.get());
+    Emit(std::move(set));
+    return res;
+  }
+
+  auto unary = dynamic_cast<ast::UnaryOpExpr *>(target);
+  if (unary != nullptr && std::string(unary->op->GetName()) == "__deref__") {
+    auto ptr = Value(unary->right.get());
+    auto res = compute(op ? Emit(Make(Op::kDeref, {ptr})) : nullptr);
+    Emit(Make(Op::kStore, {ptr, res}));
+    return res;
+  }
+
+  Remark("cannot assign to this expression");
+  Value(target);
+  return Value(val);
+}
+
+std::vector<Instr *> Builder::Indices(ast::SubscriptOperator *sop) {
+  auto res = std::vector<Instr *>();
+  for (const auto &dim : sop->dims) {
+    auto &[beg, end, step] = *dim;
+    if (end == nullptr && step == nullptr) {
+      res.push_back(Value(beg.get()));
+      continue;
+    }
+    auto b = beg == nullptr ? Undef() : Value(beg.get());
+    auto e = end == nullptr ? Undef() : Value(end.get());
+    auto s = step == nullptr ? Undef() : Value(step.get());
+    res.push_back(Emit(Make(Op::kSlice, {b, e, s})));
+  }
+  return res;
+}
+
+Instr *Builder::Call(Instr *callee, ast::CallOperator *cop, Effect effect) {
+  auto call = Make(Op::kCall, {callee});
+  call->effect = effect;
+  for (const auto &x : cop->unameds) call->AddArg(Value(x.get()));
+  for (const auto &[id, val] : cop->keywords) {
+    call->AddArg(Value(val.get()));
+    call->names.push_back(*id);
+  }
+  if (_unwinds.empty()) return Emit(std::move(call));
+
+  // A raise in the callee goes to the except dispatch
+  auto normal = NewBlock();
+  call->op = Op::kInvoke;
+  call->succs = {normal, _unwinds.back()};
+  auto res = Emit(std::move(call));
+  Seal(normal);
+  _block = normal;
+  return res;
+}
+
+// A Create inside a function makes a new object every time it is run
+void Builder::Nested(ast::Create *create) {
+  auto closure = Make(Op::kClosure);
+  closure->text = *create->GetId();
+  Store(create->binding, closure->text, Emit(std::move(closure)));
+}
+
+void Builder::Visit(ast::ExprStatement *stmt) { Value(stmt->expr.get()); }
+
+void Builder::Visit(ast::Break *) {
+  if (_loops.empty()) return Remark("break outside a loop");
+  Jump(_loops.back().exit);
+  Kill();
+}
+
+void Builder::Visit(ast::Continue *) {
+  if (_loops.empty()) return Remark("continue outside a loop");
+  Jump(_loops.back().next);
+  Kill();
+}
+
+void Builder::Visit(ast::Return *ret) {
+  auto instr = Make(Op::kReturn);
+  if (ret->expr != nullptr) instr->AddArg(Value(ret->expr.get()));
+  Emit(std::move(instr));
+  Kill();
+}
+
+void Builder::Visit(ast::If *if_stmt) {
+  auto test = Value(if_stmt->test.get());
+  auto body = NewBlock();
+  auto orelse = if_stmt->orelse == nullptr ? nullptr : NewBlock();
+  auto join = NewBlock();
+  Branch(test, body, orelse == nullptr ? join : orelse);
+
+  Seal(body);
+  _block = body;
+  Walk(if_stmt->body.get());
+  Jump(join);
+  if (orelse != nullptr) {
+    Seal(orelse);
+    _block = orelse;
+    Walk(if_stmt->orelse.get());
+    Jump(join);
+  }
+  Seal(join);
+  _block = join;
+}
+
+void Builder::Visit(ast::While *while_stmt) {
+  auto header = NewBlock();
+  Jump(header);
+  _block = header;
+  auto test = Value(while_stmt->test.get());
+  auto body = NewBlock();
+  auto exit = NewBlock();
+  auto orelse = while_stmt->orelse == nullptr ? exit : NewBlock();
+  Branch(test, body, orelse);
+
+  Seal(body);
+  _block = body;
+  _loops.push_back({header, exit});
+  Walk(while_stmt->body.get());
+  _loops.pop_back();
+  Jump(header);
+  Seal(header);
+
+  // Break skips the else
+  if (orelse != exit) {
+    Seal(orelse);
+    _block = orelse;
+    Walk(while_stmt->orelse.get());
+    Jump(exit);
+  }
+  Seal(exit);
+  _block = exit;
+}
+
+void Builder::Visit(ast::ObjCreate *create) {
+  Store(create->binding, *create->id, Value(create->call_expr.get()));
+}
+
+void Builder::Visit(ast::Function *func) { Nested(func); }
+void Builder::Visit(ast::Assemble *assemble) { Nested(assemble); }
+void Builder::Visit(ast::Struct *struct_create) { Nested(struct_create); }
+void Builder::Visit(ast::Class *class_create) { Nested(class_create); }
+void Builder::Visit(ast::Import *import) { Nested(import); }
+
+void Builder::Visit(ast::Raise *raise) {
+  auto instr = Make(Op::kRaise, {Value(raise->error.get())});
+  if (!_unwinds.empty()) instr->succs = {_unwinds.back()};
+  Emit(std::move(instr));
+  Kill();
+}
+
+// try { body } except (e := T) { handler } else { orelse } becomes
+//   body; orelse; jump after
+// dispatch:
+//   %e = catch; branch match %e, T -> handler, next
+// next:
+//   raise %e, to the dispatch of the enclosing try if any
+void Builder::Visit(ast::Try *try_stmt) {
+  auto dispatch = NewBlock();
+  _unwinds.push_back(dispatch);
+  Walk(try_stmt->body.get());
+  _unwinds.pop_back();
+  Walk(try_stmt->orelse.get());
+  auto after = NewBlock();
+  Jump(after);
+
+  Seal(dispatch);
+  _block = dispatch;
+  auto error = Emit(Make(Op::kCatch));
+  size_t idx = 0;
+  for (const auto &[alias, type, handler_body] : try_stmt->excepts) {
+    auto match = Emit(Make(Op::kMatch, {error, Value(type.get())}));
+    auto handler = NewBlock();
+    auto next = NewBlock();
+    Branch(match, handler, next);
+    Seal(handler);
+    Seal(next);
+
+    _block = handler;
+    if (idx < try_stmt->alias_slots.size()) {
+      WriteVariable(try_stmt->alias_slots[idx], handler, error);
+    }
+    ++idx;
+    Walk(handler_body.get());
+    Jump(after);
+    _block = next;
+  }
+  auto reraise = Make(Op::kRaise, {error});
+  if (!_unwinds.empty()) reraise->succs = {_unwinds.back()};
+  Emit(std::move(reraise));
+
+  Seal(after);
+  _block = after;
+}
+
+void Builder::Visit(ast::Literal *literal) {
+  auto instr = Make(Op::kConst);
+  instr->type = literal->type->GetName();
+  instr->text = *literal->val;
+  _value = Emit(std::move(instr));
+}
+
+void Builder::Visit(ast::Name *name) {
+  if (name->parent == nullptr) {
+    _value = Load(name->binding, *name->id);
+    return;
+  }
+  auto instr = Make(Op::kGetMember, {Value(name->parent.get())});
+  instr->text = *name->id;
+  instr->deref = name->deref;
+  _value = Emit(std::move(instr));
+}
+
+void Builder::Visit(ast::UnaryOpExpr *expr) {
+  auto right = Value(expr->right.get());
+  _value = Emit(Make(kOps.at(expr->op->GetName()), {right}));
+}
+
+void Builder::Visit(ast::BinaryOpExpr *expr) {
+  auto name = std::string(expr->op->GetName());
+  if (name == "__assign__") {
+    _value = Assign(expr->left.get(), nullptr, expr->right.get());
+    return;
+  }
+  auto op = kOps.at(name);
+  if (name.rfind("__self_", 0) == 0) {
+    _value = Assign(expr->left.get(), &op, expr->right.get());
+    return;
+  }
+  auto left = Value(expr->left.get());
+  auto right = Value(expr->right.get());
+  _value = Emit(Make(op, {left, right}));
+}
+
+void Builder::Visit(ast::LogicExpr *expr) {
+  auto name = std::string(expr->op->GetName());
+  auto left = Value(expr->left.get());
+  if (name != "__and__" && name != "__or__") {
+    auto right = Value(expr->right.get());
+    _value = Emit(Make(kOps.at(name), {left, right}));
+    return;
+  }
+
+  // The right side only runs if the left one does not decide, e.g. the
+  // result of 0 && f() is 0 and f is never called
+  auto is_and = name == "__and__";
+  auto decided = Make(Op::kConst);
+  decided->type = "Int";
+  decided->text = is_and ? "0" : "1";
+  auto decided_val = Emit(std::move(decided));
+  auto rhs = NewBlock();
+  auto join = NewBlock();
+  if (is_and) {
+    Branch(left, rhs, join);
+  } else {
+    Branch(left, join, rhs);
+  }
+  Seal(rhs);
+  _block = rhs;
+  auto right = Emit(Make(Op::kBool, {Value(expr->right.get())}));
+  Jump(join);
+  Seal(join);
+  _block = join;
+  _value = Phi(join, {decided_val, right});
+}
+
+void Builder::Visit(ast::IfElseExpr *expr) {
+  auto test = Value(expr->test.get());
+  auto taken = NewBlock();
+  auto not_taken = NewBlock();
+  auto join = NewBlock();
+  Branch(test, taken, not_taken);
+
+  Seal(taken);
+  _block = taken;
+  auto left = Value(expr->left.get());
+  Jump(join);
+  Seal(not_taken);
+  _block = not_taken;
+  auto right = Value(expr->right.get());
+  Jump(join);
+  Seal(join);
+  _block = join;
+  _value = Phi(join, {left, right});
+}
+
+void Builder::Visit(ast::CallExpr *expr) {
+  auto callee = Value(expr->obj.get());
+
+  // Calls to builtins without side effects and to methods which only read
+  // their object need not order with the memory
+  auto effect = Effect::kWrite;
+  auto name = dynamic_cast<ast::Name *>(expr->obj.get());
+  if (name != nullptr && name->binding.kind == ast::Binding::kBuiltin) {
+    const auto &builtin = builtin::kBuiltins[name->binding.slot];
+    if (builtin.is_pure) {
+      effect = builtin.is_alloc ? Effect::kAlloc : Effect::kNone;
+    }
+  } else if (name != nullptr && name->parent != nullptr &&
+             builtin::IsPureMethod(*name->id)) {
+    effect = Effect::kRead;
+  }
+  _value = Call(callee, expr->op.get(), effect);
+  _value->num = expr->escape == ast::CallExpr::kNoEscape;
+}
+
+void Builder::Visit(ast::SubscriptExpr *expr) {
+  auto args = std::vector<Instr *>{Value(expr->obj.get())};
+  auto indices = Indices(expr->op.get());
+  args.insert(args.end(), indices.begin(), indices.end());
+  auto get = Make(Op::kGetIndex, args);
+  get->num = InBounds(expr->op.get());
+  _value = Emit(std::move(get));
+}
+
+}  // namespace ir
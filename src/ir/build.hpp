@@ -0,0 +1,108 @@
+#ifndef _XULANG_SRC_IR_BUILD_HPP
+#define _XULANG_SRC_IR_BUILD_HPP
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../ast/walker.hpp"
+#include "../pass/pass.hpp"
+#include "./ir.hpp"
+
+namespace ir {
+
+struct Lowering {
+  std::list<Uptr<Function>> funcs;  // in source order, nested ones too
+  pass::Remarks remarks;
+};
+
+// Lower the body of every Function and Assemble of a module, after
+// pass::Resolver has bound its names. The locals of the function become SSA
+// values, and so does the memory: its value is the last instr which may
+// have changed it. Locals of outer frames and Module objs are loaded and
+// stored through the memory. Inside try, calls become invokes, raise gets
+// an edge to the except dispatch and so does every other instr which may
+// raise, by an unwind after it.
+class Builder final : private ast::Walker {
+ private:
+  static constexpr int kMemory = -1;  // the variable of the memory
+
+  struct Loop {
+    Block *next;  // where continue goes
+    Block *exit;  // where break goes
+  };
+
+  std::string _where;
+  pass::Remarks *_remarks;
+  Function *_func;
+  Block *_block;  // where instrs are appended
+  Instr *_value;  // of the expression just visited
+  Instr *_undef;
+  std::vector<Loop> _loops;
+  std::vector<Block *> _unwinds;  // except dispatch of the enclosing trys
+
+  // Simple and Efficient Construction of Static Single Assignment Form,
+  // Braun et al. 2013
+  std::unordered_map<Block *, std::unordered_map<int, Instr *>> _defs;
+  std::unordered_map<Block *, std::unordered_map<int, Instr *>> _incomplete;
+  std::unordered_set<Block *> _sealed;
+  std::unordered_map<Instr *, Instr *> _removed_phis;  // to what replaced them
+
+  void WriteVariable(int var, Block *block, Instr *value);
+  Instr *ReadVariable(int var, Block *block);
+  Instr *ReadVariableRecursive(int var, Block *block);
+  Instr *AddPhiOperands(int var, Instr *phi);
+  Instr *TryRemoveTrivialPhi(Instr *phi);
+  void Seal(Block *block);
+
+  Uptr<Function> Lower(const std::string &name, ast::CallOperator *args,
+                       ast::Block *body);
+  Block *NewBlock();
+  Uptr<Instr> Make(Op op, const std::vector<Instr *> &args = {});
+  Instr *Emit(Uptr<Instr> &&instr);
+  Instr *Undef();
+  Instr *Phi(Block *block, const std::vector<Instr *> &args);
+  void Jump(Block *target);
+  void Branch(Instr *test, Block *taken, Block *not_taken);
+  void Kill();
+  void Remark(const std::string &message);
+
+  Instr *Value(ast::Node *expr);
+  Instr *Load(const ast::Binding &binding, const std::string &id);
+  void Store(const ast::Binding &binding, const std::string &id, Instr *val);
+  Instr *Assign(ast::Expression *target, const Op *op, ast::Expression *val);
+  std::vector<Instr *> Indices(ast::SubscriptOperator *sop);
+  Instr *Call(Instr *callee, ast::CallOperator *cop, Effect effect);
+  void Nested(ast::Create *create);
+
+ public:
+  Lowering operator()(ast::Module *module);
+
+ private:
+  virtual void Visit(ast::ExprStatement *) override;
+  virtual void Visit(ast::Break *) override;
+  virtual void Visit(ast::Continue *) override;
+  virtual void Visit(ast::Return *) override;
+  virtual void Visit(ast::If *) override;
+  virtual void Visit(ast::While *) override;
+  virtual void Visit(ast::ObjCreate *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override;
+  virtual void Visit(ast::Raise *) override;
+  virtual void Visit(ast::Try *) override;
+
+  virtual void Visit(ast::Literal *) override;
+  virtual void Visit(ast::Name *) override;
+  virtual void Visit(ast::UnaryOpExpr *) override;
+  virtual void Visit(ast::BinaryOpExpr *) override;
+  virtual void Visit(ast::LogicExpr *) override;
+  virtual void Visit(ast::IfElseExpr *) override;
+  virtual void Visit(ast::CallExpr *) override;
+  virtual void Visit(ast::SubscriptExpr *) override;
+};
+
+}  // namespace ir
+
+#endif  // _XULANG_SRC_IR_BUILD_HPP
@@ -0,0 +1,76 @@
+#include "./dom.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace ir {
+
+DomTree::DomTree(const Function &func) {
+  auto entry = func.blocks.front().get();
+
+  // Post order without recursion, loops can nest deeply
+  auto post = std::vector<Block *>();
+  auto seen = std::unordered_set<const Block *>{entry};
+  auto stack = std::vector<std::pair<Block *, size_t>>{{entry, 0}};
+  while (!stack.empty()) {
+    auto &[block, next] = stack.back();
+    const auto &succs = block->Succs();
+    if (next == succs.size()) {
+      post.push_back(block);
+      stack.pop_back();
+      continue;
+    }
+    auto succ = succs[next++];
+    if (seen.insert(succ).second) stack.push_back({succ, 0});
+  }
+  _rpo.assign(post.rbegin(), post.rend());
+  for (size_t i = 0; i < _rpo.size(); ++i) _order[_rpo[i]] = i;
+
+  auto intersect = [this](Block *a, Block *b) {
+    while (a != b) {
+      while (_order[a] > _order[b]) a = _idom[a];
+      while (_order[b] > _order[a]) b = _idom[b];
+    }
+    return a;
+  };
+  _idom[entry] = entry;
+  for (auto changed = true; changed;) {
+    changed = false;
+    for (size_t i = 1; i < _rpo.size(); ++i) {
+      auto block = _rpo[i];
+      Block *idom = nullptr;
+      for (auto pred : block->preds) {
+        if (!_idom.count(pred)) continue;
+        idom = idom == nullptr ? pred : intersect(pred, idom);
+      }
+      if (_idom[block] != idom) {
+        _idom[block] = idom;
+        changed = true;
+      }
+    }
+  }
+  _idom[entry] = nullptr;
+  for (size_t i = 1; i < _rpo.size(); ++i) {
+    _children[_idom[_rpo[i]]].push_back(_rpo[i]);
+  }
+}
+
+Block *DomTree::IDom(const Block *block) const {
+  auto it = _idom.find(block);
+  return it == _idom.end() ? nullptr : it->second;
+}
+
+const std::vector<Block *> &DomTree::Children(const Block *block) const {
+  static const auto kNone = std::vector<Block *>();
+  auto it = _children.find(block);
+  return it == _children.end() ? kNone : it->second;
+}
+
+bool DomTree::Dominates(const Block *a, const Block *b) const {
+  if (!IsReachable(a) || !IsReachable(b)) return false;
+  // The idom of a block always comes before it in reverse post order
+  while (b != nullptr && _order.at(b) > _order.at(a)) b = IDom(b);
+  return a == b;
+}
+
+}  // namespace ir
@@ -0,0 +1,35 @@
+#ifndef _XULANG_SRC_IR_DOM_HPP
+#define _XULANG_SRC_IR_DOM_HPP
+
+#include <unordered_map>
+
+#include "./ir.hpp"
+
+namespace ir {
+
+// Dominators of the blocks the entry reaches, by the iterative algorithm of
+// Cooper, Harvey and Kennedy. Rebuild it after changing the edges.
+class DomTree {
+ private:
+  std::vector<Block *> _rpo;
+  std::unordered_map<const Block *, int> _order;
+  std::unordered_map<const Block *, Block *> _idom;
+  std::unordered_map<const Block *, std::vector<Block *>> _children;
+
+ public:
+  DomTree(const Function &func);
+
+  // The blocks in reverse post order, the entry first
+  inline const std::vector<Block *> &Rpo() const { return _rpo; }
+  inline bool IsReachable(const Block *block) const {
+    return _order.count(block) != 0;
+  }
+  // nullptr for the entry
+  Block *IDom(const Block *block) const;
+  const std::vector<Block *> &Children(const Block *block) const;
+  bool Dominates(const Block *a, const Block *b) const;
+};
+
+}  // namespace ir
+
+#endif  // _XULANG_SRC_IR_DOM_HPP
@@ -0,0 +1,129 @@
+#include "./gvn.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "./dom.hpp"
+
+namespace ir {
+
+static bool IsNumbered(const Instr *instr) {
+  if (instr->op == Op::kEntry || instr->op == Op::kPhi) return false;
+  if (instr->IsTerminator()) return false;
+  return instr->effect == Effect::kNone || instr->effect == Effect::kRead;
+}
+
+// Only + takes other operands than numbers without raising, a + b of
+// Strings is not b + a
+static bool IsNumber(const Instr *instr, int depth = 0) {
+  if (instr->op == Op::kConst) {
+    return instr->type == "Int" || instr->type == "Float";
+  }
+  if (instr->op == Op::kAdd) {
+    return depth < 8 && IsNumber(instr->args[0], depth + 1) &&
+           IsNumber(instr->args[1], depth + 1);
+  }
+  return instr->op > Op::kAdd && instr->op <= Op::kBool;
+}
+
+static bool IsCommutative(const Instr *instr) {
+  switch (instr->op) {
+    case Op::kAdd:
+      return IsNumber(instr->args[0]) && IsNumber(instr->args[1]);
+    case Op::kMul:
+    case Op::kXor:
+    case Op::kOr:
+    case Op::kAnd:
+    case Op::kEq:
+    case Op::kNe:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Equal for instrs computing the same value
+static std::string Key(const Instr *instr) {
+  auto key = std::string(OpName(instr->op)) + " " + instr->type + " " +
+             instr->text + " " + std::to_string(instr->depth) + ":" +
+             std::to_string(instr->num) + (instr->deref ? "->" : ".");
+  for (const auto &name : instr->names) key += name + "=";
+  // Phis of different blocks merge values on different edges
+  if (instr->op == Op::kPhi) key += "b" + std::to_string(instr->block->id);
+
+  auto ids = std::vector<int>();
+  for (auto arg : instr->args) ids.push_back(arg->id);
+  if (IsCommutative(instr)) std::sort(ids.begin(), ids.end());
+  for (auto id : ids) key += " %" + std::to_string(id);
+  return key;
+}
+
+// All operands but itself are the same value, e.g. a loop which never
+// assigns the variable
+static Instr *TrivialValue(const Instr *phi) {
+  Instr *same = nullptr;
+  for (auto arg : phi->args) {
+    if (arg == phi || arg == same) continue;
+    if (same != nullptr) return nullptr;
+    same = arg;
+  }
+  return same;
+}
+
+int NumberValues(Function *func) {
+  auto dom = DomTree(*func);
+  auto table = std::unordered_map<std::string, Instr *>();
+  auto removed = 0;
+
+  // Preorder over the dominator tree, every block sees the values of the
+  // blocks dominating it and no other
+  struct Frame {
+    Block *block;
+    std::vector<std::string> keys;  // to forget once its subtree is done
+    size_t next_child;
+  };
+  auto stack = std::vector<Frame>{{func->blocks.front().get(), {}, 0}};
+  auto enter = [&](Frame *frame) {
+    auto &instrs = frame->block->instrs;
+    for (auto it = instrs.begin(); it != instrs.end();) {
+      auto instr = it++->get();
+      if (instr->op == Op::kPhi) {
+        auto same = TrivialValue(instr);
+        if (same != nullptr) {
+          func->ReplaceAllUses(instr, same);
+          func->Erase(instr);
+          ++removed;
+          continue;
+        }
+      } else if (!IsNumbered(instr)) {
+        continue;
+      }
+
+      auto key = Key(instr);
+      auto [found, inserted] = table.emplace(key, instr);
+      if (inserted) {
+        frame->keys.push_back(std::move(key));
+        continue;
+      }
+      func->ReplaceAllUses(instr, found->second);
+      func->Erase(instr);
+      ++removed;
+    }
+  };
+
+  enter(&stack.back());
+  while (!stack.empty()) {
+    auto &frame = stack.back();
+    const auto &children = dom.Children(frame.block);
+    if (frame.next_child == children.size()) {
+      for (const auto &key : frame.keys) table.erase(key);
+      stack.pop_back();
+      continue;
+    }
+    stack.push_back({children[frame.next_child++], {}, 0});
+    enter(&stack.back());
+  }
+  return removed;
+}
+
+}  // namespace ir
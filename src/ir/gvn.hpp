@@ -0,0 +1,17 @@
+#ifndef _XULANG_SRC_IR_GVN_HPP
+#define _XULANG_SRC_IR_GVN_HPP
+
+#include "./ir.hpp"
+
+namespace ir {
+
+// Global value numbering over the dominator tree: an instr computing what a
+// dominating one already has is replaced by it, e.g. the second i * i, and
+// so is a phi merging the same values. Instrs reading the memory are only
+// the same if they read the same version of it, e.g. two array.length()
+// without a call in between. Returns how many instrs it removed.
+int NumberValues(Function *func);
+
+}  // namespace ir
+
+#endif  // _XULANG_SRC_IR_GVN_HPP
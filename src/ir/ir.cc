@@ -0,0 +1,289 @@
+#include "./ir.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace ir {
+
+const char *OpName(Op op) {
+  switch (op) {
+    case Op::kEntry: return "entry";
+    case Op::kParam: return "param";
+    case Op::kConst: return "const";
+    case Op::kBuiltin: return "builtin";
+    case Op::kClosure: return "closure";
+    case Op::kUndef: return "undef";
+    case Op::kPhi: return "phi";
+    case Op::kAdd: return "add";
+    case Op::kSub: return "sub";
+    case Op::kMul: return "mul";
+    case Op::kDiv: return "div";
+    case Op::kMod: return "mod";
+    case Op::kXor: return "xor";
+    case Op::kOr: return "or";
+    case Op::kAnd: return "and";
+    case Op::kShl: return "shl";
+    case Op::kShr: return "shr";
+    case Op::kEq: return "eq";
+    case Op::kNe: return "ne";
+    case Op::kLe: return "le";
+    case Op::kGe: return "ge";
+    case Op::kLt: return "lt";
+    case Op::kGt: return "gt";
+    case Op::kPos: return "pos";
+    case Op::kNeg: return "neg";
+    case Op::kNot: return "not";
+    case Op::kBitNot: return "bitnot";
+    case Op::kBool: return "bool";
+    case Op::kRef: return "ref";
+    case Op::kSlice: return "slice";
+    case Op::kMatch: return "match";
+    case Op::kGlobal: return "global";
+    case Op::kLoadOuter: return "loadouter";
+    case Op::kGetMember: return "getmember";
+    case Op::kGetIndex: return "getindex";
+    case Op::kDeref: return "deref";
+    case Op::kStoreOuter: return "storeouter";
+    case Op::kStoreGlobal: return "storeglobal";
+    case Op::kSetMember: return "setmember";
+    case Op::kSetIndex: return "setindex";
+    case Op::kStore: return "store";
+    case Op::kCall: return "call";
+    case Op::kCatch: return "catch";
+    case Op::kJump: return "jump";
+    case Op::kBranch: return "branch";
+    case Op::kReturn: return "return";
+    case Op::kRaise: return "raise";
+    case Op::kInvoke: return "invoke";
+    case Op::kUnwind: return "unwind";
+  }
+  return "?";
+}
+
+Effect EffectOf(Op op) {
+  if (op == Op::kClosure) return Effect::kAlloc;
+  if (op >= Op::kGlobal && op <= Op::kDeref) return Effect::kRead;
+  if (op >= Op::kStoreOuter && op <= Op::kCatch) return Effect::kWrite;
+  if (op == Op::kInvoke) return Effect::kWrite;
+  return Effect::kNone;
+}
+
+void Instr::AddArg(Instr *arg) {
+  args.push_back(arg);
+  arg->users.push_back(this);
+}
+
+void Instr::SetArg(size_t idx, Instr *arg) {
+  auto &users = args[idx]->users;
+  users.erase(std::find(users.begin(), users.end(), this));
+  args[idx] = arg;
+  arg->users.push_back(this);
+}
+
+void Instr::RemoveArg(size_t idx) {
+  auto &users = args[idx]->users;
+  users.erase(std::find(users.begin(), users.end(), this));
+  args.erase(args.begin() + idx);
+}
+
+void Instr::DropArgs() {
+  while (!args.empty()) RemoveArg(args.size() - 1);
+}
+
+Instr *Block::Terminator() const {
+  if (instrs.empty() || !instrs.back()->IsTerminator()) return nullptr;
+  return instrs.back().get();
+}
+
+const std::vector<Block *> &Block::Succs() const {
+  static const auto kNone = std::vector<Block *>();
+  auto term = Terminator();
+  return term == nullptr ? kNone : term->succs;
+}
+
+Block *Function::NewBlock() {
+  blocks.push_back(std::make_unique<Block>(_block_count++));
+  return blocks.back().get();
+}
+
+Uptr<Instr> Function::NewInstr(Op op, Effect effect) {
+  return std::make_unique<Instr>(op, effect);
+}
+
+Instr *Function::Append(Block *block, Uptr<Instr> &&instr) {
+  instr->id = _instr_count++;
+  instr->block = block;
+  for (auto succ : instr->succs) succ->preds.push_back(block);
+  block->instrs.push_back(std::move(instr));
+  return block->instrs.back().get();
+}
+
+Instr *Function::Prepend(Block *block, Uptr<Instr> &&instr) {
+  instr->id = _instr_count++;
+  instr->block = block;
+  block->instrs.push_front(std::move(instr));
+  return block->instrs.front().get();
+}
+
+void Function::ReplaceAllUses(Instr *from, Instr *to) {
+  auto users = std::move(from->users);
+  from->users.clear();
+  for (auto user : users) {
+    for (auto &arg : user->args) {
+      if (arg != from) continue;
+      arg = to;
+      to->users.push_back(user);
+      break;
+    }
+  }
+}
+
+void Function::Erase(Instr *instr) {
+  instr->DropArgs();
+  auto &instrs = instr->block->instrs;
+  auto it = std::find_if(instrs.begin(), instrs.end(),
+                         [instr](const auto &x) { return x.get() == instr; });
+  instrs.erase(it);
+}
+
+int Function::RemoveUnreachable() {
+  auto reached = std::unordered_set<Block *>();
+  auto stack = std::vector<Block *>{blocks.front().get()};
+  while (!stack.empty()) {
+    auto block = stack.back();
+    stack.pop_back();
+    if (!reached.insert(block).second) continue;
+    for (auto succ : block->Succs()) stack.push_back(succ);
+  }
+
+  // Cut the edges out of the dead blocks first, their instrs may still be
+  // phi operands of the live ones
+  for (const auto &block : blocks) {
+    if (reached.count(block.get())) continue;
+    for (auto succ : block->Succs()) {
+      for (auto idx = succ->preds.size(); idx-- > 0;) {
+        if (succ->preds[idx] != block.get()) continue;
+        succ->preds.erase(succ->preds.begin() + idx);
+        for (const auto &instr : succ->instrs) {
+          if (instr->op == Op::kPhi) instr->RemoveArg(idx);
+        }
+      }
+    }
+  }
+  for (const auto &block : blocks) {
+    if (reached.count(block.get())) continue;
+    for (const auto &instr : block->instrs) instr->DropArgs();
+  }
+  auto removed = static_cast<int>(blocks.size());
+  blocks.remove_if([&](const auto &x) { return !reached.count(x.get()); });
+  removed -= static_cast<int>(blocks.size());
+
+  // e.g. the phi of a variable in the join of if (1) { } else { }
+  for (auto changed = true; changed;) {
+    changed = false;
+    for (const auto &block : blocks) {
+      for (auto it = block->instrs.begin(); it != block->instrs.end();) {
+        auto phi = it++->get();
+        if (phi->op != Op::kPhi) continue;
+        Instr *same = nullptr;
+        auto trivial = true;
+        for (auto arg : phi->args) {
+          if (arg == phi || arg == same) continue;
+          if (same != nullptr) trivial = false;
+          same = arg;
+        }
+        if (!trivial || same == nullptr) continue;
+        ReplaceAllUses(phi, same);
+        Erase(phi);
+        changed = true;
+      }
+    }
+  }
+  return removed;
+}
+
+size_t Function::Size() const {
+  size_t size = 0;
+  for (const auto &block : blocks) size += block->instrs.size();
+  return size;
+}
+
+static std::string Name(const Instr *instr) {
+  return "%" + std::to_string(instr->id);
+}
+
+static std::string Name(const Block *block) {
+  return "b" + std::to_string(block->id);
+}
+
+static std::string DumpInstr(const Instr *instr) {
+  auto res = std::string();
+  if (instr->op != Op::kJump && instr->op != Op::kBranch &&
+      instr->op != Op::kReturn && instr->op != Op::kRaise &&
+      instr->op != Op::kUnwind) {
+    res += Name(instr) + " = ";
+  }
+  res += OpName(instr->op);
+
+  switch (instr->op) {
+    case Op::kParam: res += " " + std::to_string(instr->num); break;
+    case Op::kConst: res += " " + instr->type + " " + instr->text; break;
+    case Op::kBuiltin:
+    case Op::kClosure:
+    case Op::kGlobal:
+    case Op::kStoreGlobal: res += " \"" + instr->text + "\""; break;
+    case Op::kLoadOuter:
+    case Op::kStoreOuter:
+      res += " " + std::to_string(instr->depth) + ":" +
+             std::to_string(instr->num);
+      break;
+    case Op::kGetMember:
+    case Op::kSetMember:
+      res += std::string(instr->deref ? " ->" : " .") + instr->text;
+      break;
+    case Op::kGetIndex:
+    case Op::kSetIndex:
+      if (instr->num != 0) res += " inbounds:" + std::to_string(instr->num);
+      break;
+    case Op::kCall:
+    case Op::kInvoke:
+      if (instr->num != 0) res += " noescape";
+      break;
+    default: break;
+  }
+
+  // Keyword args are the last ones, e.g. call %1, %2, x=%3, %4
+  auto first_keyword = instr->args.size() - instr->names.size();
+  if (instr->effect == Effect::kRead || instr->effect == Effect::kWrite) {
+    if (instr->op != Op::kCatch) --first_keyword;
+  }
+  for (size_t i = 0; i < instr->args.size(); ++i) {
+    res += i == 0 ? " " : ", ";
+    if (i >= first_keyword && i - first_keyword < instr->names.size()) {
+      res += instr->names[i - first_keyword] + "=";
+    }
+    res += Name(instr->args[i]);
+  }
+  for (size_t i = 0; i < instr->succs.size(); ++i) {
+    res += (i == 0 ? " -> " : ", ") + Name(instr->succs[i]);
+  }
+  return res;
+}
+
+std::string Dump(const Function &func) {
+  auto res = "function " + func.name + "(" + std::to_string(func.params) +
+             " params) {\n";
+  for (const auto &block : func.blocks) {
+    res += Name(block.get()) + ":";
+    for (size_t i = 0; i < block->preds.size(); ++i) {
+      res += (i == 0 ? "  <- " : ", ") + Name(block->preds[i]);
+    }
+    res += "\n";
+    for (const auto &instr : block->instrs) {
+      res += "  " + DumpInstr(instr.get()) + "\n";
+    }
+  }
+  return res + "}\n";
+}
+
+}  // namespace ir
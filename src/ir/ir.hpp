@@ -0,0 +1,141 @@
+#ifndef _XULANG_SRC_IR_IR_HPP
+#define _XULANG_SRC_IR_IR_HPP
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "../utils/utils.hpp"
+
+namespace ir {
+
+using utils::Uptr;
+
+enum class Op {
+  // No operands
+  kEntry,    // the memory when the function is entered
+  kParam,    // num: the index of the parameter
+  kConst,    // type: Int, Float or String, text: the literal
+  kBuiltin,  // num: builtin::kBuiltins index, text: the id
+  kClosure,  // text: the id of a Create nested in the function
+  kUndef,
+  kPhi,      // one operand per predecessor, in the same order
+
+  // Pure
+  kAdd, kSub, kMul, kDiv, kMod, kXor, kOr, kAnd, kShl, kShr,
+  kEq, kNe, kLe, kGe, kLt, kGt,
+  kPos, kNeg, kNot, kBitNot,
+  kBool,   // 1 if the operand is true else 0
+  kRef,
+  kSlice,  // beg, end, step, e.g. a[1:n], any of them may be kUndef
+  kMatch,  // error, type, 1 if the error is of the type else 0
+
+  // Read the memory, their last operand
+  kGlobal,     // num: Module objs index or -1, text: the id
+  kLoadOuter,  // depth: frames outwards, num: slot
+  kGetMember,  // obj, text: the member id, deref: obj->id
+  kGetIndex,   // obj, indices..., num: bit d set if index d is in bounds
+  kDeref,      // ptr
+
+  // Also define the memory after them
+  kStoreOuter,   // val, depth: frames outwards, num: slot
+  kStoreGlobal,  // val, num: Module objs index or -1, text: the id
+  kSetMember,    // obj, val, text: the member id, deref: obj->id
+  kSetIndex,     // obj, val, indices..., num: as kGetIndex
+  kStore,        // ptr, val
+  kCall,         // callee, args..., names: the ids of the last args,
+                 // num: 1 if the object made never escapes the function
+  kCatch,        // the raised Error, first where an unwind edge goes
+
+  // Terminators, last in every block
+  kJump,    // -> target
+  kBranch,  // test -> taken, not taken
+  kReturn,  // [val]
+  kRaise,   // error [-> unwind]
+  kInvoke,  // kCall -> normal, unwind, the result is only on normal
+  kUnwind,  // -> normal, unwind, where a raise of the instr before it goes
+};
+
+enum class Effect {
+  kNone,   // may be numbered and removed
+  kAlloc,  // a new object each time, may be removed but not numbered
+  kRead,   // reads the memory, its last operand
+  kWrite,  // reads the memory, its last operand, and is the new memory
+};
+
+const char *OpName(Op op);
+Effect EffectOf(Op op);  // kCall and kInvoke depend on the callee
+
+class Block;
+
+class Instr {
+ public:
+  Op op;
+  Effect effect;
+  int id = -1;  // given when it is put in a block
+  Block *block = nullptr;
+  std::vector<Instr *> args;
+  std::vector<Block *> succs;  // terminators only
+  std::vector<Instr *> users;  // one entry per use
+
+  std::string type;
+  std::string text;
+  std::vector<std::string> names;
+  int depth = 0;
+  int num = 0;
+  bool deref = false;
+
+  Instr(Op op, Effect effect) : op(op), effect(effect) {}
+
+  inline bool IsTerminator() const { return op >= Op::kJump; }
+  void AddArg(Instr *arg);
+  void SetArg(size_t idx, Instr *arg);
+  void RemoveArg(size_t idx);
+  void DropArgs();
+};
+
+class Block {
+ public:
+  int id;
+  std::list<Uptr<Instr>> instrs;
+  std::vector<Block *> preds;
+
+  Block(int id) : id(id) {}
+
+  Instr *Terminator() const;
+  const std::vector<Block *> &Succs() const;
+};
+
+class Function {
+ private:
+  int _instr_count = 0;
+  int _block_count = 0;
+
+ public:
+  std::string name;  // e.g. Name.__Create__
+  int params = 0;
+  std::list<Uptr<Block>> blocks;  // the entry first
+
+  Function(const std::string &name) : name(name) {}
+
+  Block *NewBlock();
+  Uptr<Instr> NewInstr(Op op, Effect effect);
+  // Appends to the block and adds it to the preds of the successors
+  Instr *Append(Block *block, Uptr<Instr> &&instr);
+  // Phis and kUndef go before the rest of the block
+  Instr *Prepend(Block *block, Uptr<Instr> &&instr);
+
+  void ReplaceAllUses(Instr *from, Instr *to);
+  // The instr must have no users left
+  void Erase(Instr *instr);
+  // Remove the blocks the entry cannot reach and the phi operands of their
+  // edges, then the phis left with a single value. Returns the blocks removed.
+  int RemoveUnreachable();
+  size_t Size() const;
+};
+
+std::string Dump(const Function &func);
+
+}  // namespace ir
+
+#endif  // _XULANG_SRC_IR_IR_HPP
@@ -0,0 +1,137 @@
+#include "./verify.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "./dom.hpp"
+
+namespace ir {
+
+static std::string Where(const Block *block, const Instr *instr = nullptr) {
+  auto res = "b" + std::to_string(block->id);
+  if (instr != nullptr) {
+    res += " %" + std::to_string(instr->id) + " " + OpName(instr->op);
+  }
+  return res + ": ";
+}
+
+static bool HasMemory(const Instr *instr) {
+  return instr->op != Op::kCatch && (instr->effect == Effect::kRead ||
+                                     instr->effect == Effect::kWrite);
+}
+
+static bool IsMemory(const Instr *instr) {
+  return instr->op == Op::kEntry || instr->op == Op::kPhi ||
+         instr->op == Op::kUndef || instr->effect == Effect::kWrite;
+}
+
+std::vector<std::string> Verify(const Function &func) {
+  auto errors = std::vector<std::string>();
+  if (func.blocks.empty()) return {"no entry block"};
+  if (!func.blocks.front()->preds.empty()) {
+    errors.push_back(Where(func.blocks.front().get()) + "entry has preds");
+  }
+
+  // Where every instr is, to check the defs dominate the uses
+  auto pos = std::unordered_map<const Instr *, std::pair<const Block *, int>>();
+  for (const auto &block : func.blocks) {
+    auto idx = 0;
+    for (const auto &instr : block->instrs) {
+      pos[instr.get()] = {block.get(), idx++};
+      if (instr->block != block.get()) {
+        errors.push_back(Where(block.get(), instr.get()) + "wrong block");
+      }
+    }
+  }
+
+  auto dom = DomTree(func);
+  auto dominates = [&](const Instr *def, const Block *block, int idx) {
+    auto [def_block, def_idx] = pos.at(def);
+    // The result of an invoke only exists on its normal edge
+    if (def->op == Op::kInvoke) return dom.Dominates(def->succs[0], block);
+    if (def_block == block) return def_idx < idx;
+    return dom.Dominates(def_block, block);
+  };
+
+  for (const auto &block : func.blocks) {
+    if (!dom.IsReachable(block.get())) {
+      errors.push_back(Where(block.get()) + "unreachable");
+    }
+    if (block->Terminator() == nullptr) {
+      errors.push_back(Where(block.get()) + "no terminator");
+    }
+    for (auto succ : block->Succs()) {
+      if (std::count(succ->preds.begin(), succ->preds.end(), block.get()) !=
+          std::count(block->Succs().begin(), block->Succs().end(), succ)) {
+        errors.push_back(Where(block.get()) + "not a pred of b" +
+                         std::to_string(succ->id));
+      }
+    }
+    for (auto pred : block->preds) {
+      const auto &succs = pred->Succs();
+      if (std::find(succs.begin(), succs.end(), block.get()) == succs.end()) {
+        errors.push_back(Where(block.get()) + "not a succ of b" +
+                         std::to_string(pred->id));
+      }
+    }
+
+    auto idx = 0;
+    auto first_non_phi = -1;
+    auto in_phis = true;
+    for (const auto &instr : block->instrs) {
+      auto where = Where(block.get(), instr.get());
+      if (in_phis && instr->op != Op::kPhi && instr->op != Op::kUndef) {
+        in_phis = false;
+        first_non_phi = idx;
+      }
+      if (instr->op == Op::kPhi && !in_phis) {
+        errors.push_back(where + "phi after other instrs");
+      }
+      if (instr->IsTerminator() && instr.get() != block->instrs.back().get()) {
+        errors.push_back(where + "terminator in the middle of the block");
+      }
+      if (instr->op == Op::kCatch && idx != first_non_phi) {
+        errors.push_back(where + "catch after other instrs");
+      }
+      if (HasMemory(instr.get()) &&
+          (instr->args.empty() || !IsMemory(instr->args.back()))) {
+        errors.push_back(where + "last operand is not the memory");
+      }
+      if (instr->op == Op::kPhi && instr->args.size() != block->preds.size()) {
+        errors.push_back(where + "operands do not match the preds");
+      }
+
+      for (size_t i = 0; i < instr->args.size(); ++i) {
+        auto arg = instr->args[i];
+        auto name = "%" + std::to_string(arg->id);
+        if (!pos.count(arg)) {
+          errors.push_back(where + name + " is not in the function");
+          continue;
+        }
+        if (std::count(arg->users.begin(), arg->users.end(), instr.get()) !=
+            std::count(instr->args.begin(), instr->args.end(), arg)) {
+          errors.push_back(where + name + " does not list it as a user");
+        }
+        // A phi operand is used at the end of its pred
+        auto ok = false;
+        if (instr->op != Op::kPhi || i >= block->preds.size()) {
+          ok = dominates(arg, block.get(), idx);
+        } else if (arg->op == Op::kInvoke && arg->block == block->preds[i]) {
+          ok = arg->succs[0] == block.get();
+        } else {
+          ok = dominates(arg, block->preds[i], INT32_MAX);
+        }
+        if (!ok) errors.push_back(where + name + " does not dominate it");
+      }
+      for (auto user : instr->users) {
+        if (!pos.count(user)) {
+          errors.push_back(where + "used by an instr not in the function");
+        }
+      }
+      ++idx;
+    }
+  }
+  return errors;
+}
+
+}  // namespace ir
@@ -0,0 +1,14 @@
+#ifndef _XULANG_SRC_IR_VERIFY_HPP
+#define _XULANG_SRC_IR_VERIFY_HPP
+
+#include "./ir.hpp"
+
+namespace ir {
+
+// Check the structure and the SSA form of the function, one message for
+// each problem found, none if it is well formed
+std::vector<std::string> Verify(const Function &func);
+
+}  // namespace ir
+
+#endif  // _XULANG_SRC_IR_VERIFY_HPP
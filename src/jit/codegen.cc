@@ -0,0 +1,718 @@
+#include "./codegen.hpp"
+
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Verifier.h>
+
+#include "../pass/fold.hpp"
+#include "../vm/runtime.hpp"
+
+namespace jit {
+
+static const char *NameOf(vm::Tag tag) {
+  return tag == vm::Tag::kInt ? "Int" : "Float";
+}
+
+static bool IsBuiltin(const ast::Expression *expr, const std::string &id) {
+  auto name = dynamic_cast<const ast::Name *>(expr);
+  return name != nullptr && name->parent == nullptr &&
+         name->binding.kind == ast::Binding::kBuiltin && *name->id == id;
+}
+
+// Int or Float, Void if it is neither: the return type is a Name and a
+// param is typed by its default, e.g. n:=Int() or x:=0.5
+static vm::Tag TagOf(const ast::Expression *expr) {
+  if (auto call = dynamic_cast<const ast::CallExpr *>(expr); call != nullptr) {
+    expr = call->obj.get();
+  }
+  if (IsBuiltin(expr, "Int")) return vm::Tag::kInt;
+  if (IsBuiltin(expr, "Float")) return vm::Tag::kFloat;
+  auto constant = pass::Constant();
+  if (dynamic_cast<const ast::Literal *>(expr) != nullptr &&
+      pass::ToConstant(expr, &constant)) {
+    return constant.is_float ? vm::Tag::kFloat : vm::Tag::kInt;
+  }
+  return vm::Tag::kVoid;
+}
+
+Lowering CodeGen::operator()(ast::Module *module, const vm::Program &program) {
+  auto res = Lowering();
+  _program = &program;
+  _signatures.clear();
+  auto where = [&](int func) {
+    return program.filename + ": " + program.funcs[func].name;
+  };
+
+  auto asts = std::unordered_map<const ast::Create *, ast::Function *>();
+  for (const auto &obj : module->objs) {
+    if (auto func = dynamic_cast<ast::Function *>(obj.get()); func != nullptr) {
+      asts[func] = func;
+    }
+  }
+  auto bodies = std::unordered_map<int, ast::Function *>();
+  for (int idx = 0; idx < static_cast<int>(program.funcs.size()); ++idx) {
+    auto found = asts.find(program.funcs[idx].ast);
+    if (found == asts.end()) continue;
+    const auto &args = found->second->args;
+    auto signature = Signature();
+    signature.res = args->unameds.empty()
+                        ? vm::Tag::kVoid
+                        : TagOf(args->unameds.front().get());
+    auto why = std::string();
+    if (signature.res == vm::Tag::kVoid) {
+      why = "returns neither Int nor Float";
+    } else if (args->unameds.size() > 1) {
+      why = "has params without a type";
+    } else if (args->keywords.size() > vm::Native::kMaxParams) {
+      why = "has more than " + std::to_string(vm::Native::kMaxParams) +
+            " params";
+    }
+    for (const auto &[id, val] : args->keywords) {
+      auto tag = TagOf(val.get());
+      if (tag == vm::Tag::kVoid && why.empty()) {
+        why = "has the param \"" + *id + "\" of neither Int nor Float";
+      }
+      signature.params.push_back(tag);
+    }
+    if (!why.empty()) {
+      res.remarks.push_back({"jit", where(idx), "not compiled, " + why});
+      continue;
+    }
+    _signatures[idx] = std::move(signature);
+    bodies[idx] = found->second;
+  }
+
+  // A Function which cannot be lowered takes the ones calling it with it,
+  // so all are lowered again until none fails
+  for (auto failed = true; failed;) {
+    failed = false;
+    res.module.reset();  // before its context
+    res.context = std::make_unique<llvm::LLVMContext>();
+    res.module = std::make_unique<llvm::Module>(program.filename, *res.context);
+    _context = res.context.get();
+    _module = res.module.get();
+    _builder = std::make_unique<llvm::IRBuilder<>>(*_context);
+    for (auto &[idx, signature] : _signatures) {
+      auto params = std::vector<llvm::Type *>();
+      for (auto tag : signature.params) params.push_back(TypeOf(tag));
+      params.push_back(_builder->getInt32Ty());
+      params.push_back(TypeOf(signature.res)->getPointerTo());
+      auto type =
+          llvm::FunctionType::get(_builder->getInt1Ty(), params, false);
+      signature.impl =
+          llvm::Function::Create(type, llvm::Function::InternalLinkage,
+                                 "xl." + program.funcs[idx].name, _module);
+    }
+    for (auto it = _signatures.begin(); it != _signatures.end();) {
+      const auto &func = program.funcs[it->first];
+      if (Lower(func, bodies[it->first], it->second)) {
+        ++it;
+        continue;
+      }
+      res.remarks.push_back(
+          {"jit", where(it->first), "not compiled, " + _failure});
+      it = _signatures.erase(it);
+      failed = true;
+    }
+  }
+
+  for (const auto &[idx, signature] : _signatures) {
+    auto symbol = "xl_" + program.funcs[idx].name;
+    Entry(program.funcs[idx], signature, symbol);
+    res.entries.push_back({idx, symbol, signature.params, signature.res});
+  }
+  _builder.reset();
+  return res;
+}
+
+void CodeGen::Fail(const std::string &why) {
+  if (_failure.empty()) _failure = why;
+  _val = Typed();
+}
+
+llvm::Type *CodeGen::TypeOf(vm::Tag tag) {
+  return tag == vm::Tag::kInt ? _builder->getInt64Ty()
+                              : _builder->getDoubleTy();
+}
+
+// The params are the first slots, then come the depth and where the result
+// goes
+bool CodeGen::Lower(const vm::Func &func, ast::Function *ast,
+                    const Signature &signature) {
+  _signature = &signature;
+  _impl = signature.impl;
+  _fail = nullptr;
+  _slots.assign(func.nslots, nullptr);
+  _tags.assign(func.nslots, vm::Tag::kVoid);
+  _created.assign(func.nslots, false);
+  _loops.clear();
+  _failure.clear();
+
+  _builder->SetInsertPoint(llvm::BasicBlock::Create(*_context, "", _impl));
+  for (size_t i = 0; i < signature.params.size(); ++i) {
+    Define(i, func.params[i], signature.params[i]);
+    _builder->CreateStore(_impl->getArg(i), _slots[i]);
+    _created[i] = true;
+  }
+  auto depth = _impl->getArg(signature.params.size());
+  FailIf(_builder->CreateICmpSGE(
+      depth, _builder->getInt32(vm::Runtime::kMaxDepth)));
+
+  Walk(ast->body.get());
+  if (!_failure.empty()) return false;
+  // Falls off the end, which returns Void
+  if (_builder->GetInsertBlock()->getTerminator() == nullptr) {
+    _builder->CreateRet(_builder->getFalse());
+  }
+  if (llvm::verifyFunction(*_impl)) {
+    Fail("is lowered to invalid IR");
+    return false;
+  }
+  return true;
+}
+
+// Unpack the args for the Function and pack its result
+void CodeGen::Entry(const vm::Func &func, const Signature &signature,
+                    const std::string &symbol) {
+  auto i64_ptr = _builder->getInt64Ty()->getPointerTo();
+  auto type = llvm::FunctionType::get(
+      _builder->getInt1Ty(), {i64_ptr, i64_ptr, _builder->getInt32Ty()},
+      false);
+  auto entry = llvm::Function::Create(type, llvm::Function::ExternalLinkage,
+                                      symbol, _module);
+  entry->addRetAttr(llvm::Attribute::ZExt);
+  _builder->SetInsertPoint(llvm::BasicBlock::Create(*_context, "", entry));
+
+  auto args = std::vector<llvm::Value *>();
+  for (size_t i = 0; i < signature.params.size(); ++i) {
+    auto ptr = _builder->CreateConstInBoundsGEP1_64(_builder->getInt64Ty(),
+                                                    entry->getArg(0), i);
+    auto bits =
+        _builder->CreateLoad(_builder->getInt64Ty(), ptr, func.params[i]);
+    args.push_back(_builder->CreateBitCast(bits, TypeOf(signature.params[i])));
+  }
+  args.push_back(entry->getArg(2));
+  auto res = _builder->CreateAlloca(TypeOf(signature.res));
+  args.push_back(res);
+  auto ok = _builder->CreateCall(signature.impl, args);
+  auto bits = _builder->CreateBitCast(
+      _builder->CreateLoad(TypeOf(signature.res), res), _builder->getInt64Ty());
+  _builder->CreateStore(bits, entry->getArg(1));
+  _builder->CreateRet(ok);
+}
+
+// Give up if cond, which should never be
+void CodeGen::FailIf(llvm::Value *cond) {
+  if (_fail == nullptr) {
+    _fail = llvm::BasicBlock::Create(*_context, "fail", _impl);
+    llvm::IRBuilder<>(_fail).CreateRet(_builder->getFalse());
+  }
+  auto next = llvm::BasicBlock::Create(*_context, "", _impl);
+  auto weights = llvm::MDBuilder(*_context).createBranchWeights(1, 1 << 20);
+  _builder->CreateCondBr(cond, _fail, next, weights);
+  _builder->SetInsertPoint(next);
+}
+
+void CodeGen::Close(llvm::BasicBlock *next) {
+  if (_builder->GetInsertBlock()->getTerminator() == nullptr) {
+    _builder->CreateBr(next);
+  }
+}
+
+// For what follows a break, continue or return
+void CodeGen::Unreachable() {
+  _builder->SetInsertPoint(llvm::BasicBlock::Create(*_context, "", _impl));
+}
+
+// A slot keeps the type it is first created with
+void CodeGen::Define(int slot, const std::string &id, vm::Tag tag) {
+  if (_tags[slot] == vm::Tag::kVoid) {
+    auto &entry = _impl->getEntryBlock();
+    llvm::IRBuilder<> builder(&entry, entry.begin());
+    _slots[slot] = builder.CreateAlloca(TypeOf(tag), nullptr, id);
+    _tags[slot] = tag;
+  } else if (_tags[slot] != tag) {
+    Fail("\"" + id + "\" is both Int and Float");
+  }
+}
+
+CodeGen::Typed CodeGen::Eval(ast::Expression *expr) {
+  _val = Typed();
+  if (!_failure.empty()) return _val;
+  Walk(expr);
+  return _failure.empty() ? _val : Typed();
+}
+
+// An i1, && and || never evaluate more than they need
+llvm::Value *CodeGen::Cond(ast::Expression *expr) {
+  auto logic = dynamic_cast<ast::LogicExpr *>(expr);
+  auto name = logic == nullptr ? "" : std::string(logic->op->GetName());
+  if (name == "__and__" || name == "__or__") {
+    auto is_and = name == "__and__";
+    auto left = Cond(logic->left.get());
+    if (left == nullptr) return nullptr;
+    auto from = _builder->GetInsertBlock();
+    auto rhs = llvm::BasicBlock::Create(*_context, "", _impl);
+    auto end = llvm::BasicBlock::Create(*_context, "", _impl);
+    _builder->CreateCondBr(left, is_and ? rhs : end, is_and ? end : rhs);
+    _builder->SetInsertPoint(rhs);
+    auto right = Cond(logic->right.get());
+    if (right == nullptr) return nullptr;
+    auto to = _builder->GetInsertBlock();
+    _builder->CreateBr(end);
+    _builder->SetInsertPoint(end);
+    auto phi = _builder->CreatePHI(_builder->getInt1Ty(), 2);
+    phi->addIncoming(_builder->getInt1(!is_and), from);
+    phi->addIncoming(right, to);
+    return phi;
+  }
+
+  auto unary = dynamic_cast<ast::UnaryOpExpr *>(expr);
+  if (unary != nullptr && std::string(unary->op->GetName()) == "__not__") {
+    auto right = Cond(unary->right.get());
+    return right == nullptr ? nullptr : _builder->CreateNot(right);
+  }
+  return Truth(Eval(expr));
+}
+
+// As vm::IsTrue, NaN is true
+llvm::Value *CodeGen::Truth(Typed val) {
+  if (val.val == nullptr) return nullptr;
+  if (val.tag == vm::Tag::kInt) {
+    return _builder->CreateICmpNE(val.val, _builder->getInt64(0));
+  }
+  return _builder->CreateFCmpUNE(val.val,
+                                 llvm::ConstantFP::get(val.val->getType(), 0));
+}
+
+// Of a local created on every path to name
+llvm::Value *CodeGen::Slot(ast::Name *name) {
+  const auto &binding = name->binding;
+  if (name->parent != nullptr) {
+    Fail("uses the member \"" + *name->id + "\"");
+  } else if (binding.kind != ast::Binding::kLocal || binding.depth != 0) {
+    Fail("uses \"" + *name->id + "\", which is not a local");
+  } else if (!_created[binding.slot]) {
+    Fail("may use \"" + *name->id + "\" before creating it");
+  } else {
+    return _slots[binding.slot];
+  }
+  return nullptr;
+}
+
+// As vm::Runtime::Binary
+CodeGen::Typed CodeGen::Arith(vm::Op op, Typed left, Typed right) {
+  using vm::Op;
+  if (left.val == nullptr || right.val == nullptr) return Typed();
+  auto &b = *_builder;
+  auto l = left.val, r = right.val;
+  auto to_int = [&](llvm::Value *cond) {
+    return Typed{b.CreateZExt(cond, b.getInt64Ty()), vm::Tag::kInt};
+  };
+
+  if (left.tag == vm::Tag::kInt && right.tag == vm::Tag::kInt) {
+    switch (op) {
+      case Op::kAdd: return {b.CreateAdd(l, r), vm::Tag::kInt};
+      case Op::kSub: return {b.CreateSub(l, r), vm::Tag::kInt};
+      case Op::kMul: return {b.CreateMul(l, r), vm::Tag::kInt};
+      case Op::kDiv:
+      case Op::kMod: {
+        FailIf(b.CreateICmpEQ(r, b.getInt64(0)));
+        // The least Int / -1 overflows, -1 is kept apart
+        auto minus_one = b.CreateICmpEQ(r, b.getInt64(-1));
+        auto safe = b.CreateSelect(minus_one, b.getInt64(1), r);
+        if (op == Op::kDiv) {
+          return {b.CreateSelect(minus_one, b.CreateSub(b.getInt64(0), l),
+                                 b.CreateSDiv(l, safe)),
+                  vm::Tag::kInt};
+        }
+        return {b.CreateSelect(minus_one, b.getInt64(0), b.CreateSRem(l, safe)),
+                vm::Tag::kInt};
+      }
+      case Op::kXor: return {b.CreateXor(l, r), vm::Tag::kInt};
+      case Op::kOr: return {b.CreateOr(l, r), vm::Tag::kInt};
+      case Op::kAnd: return {b.CreateAnd(l, r), vm::Tag::kInt};
+      case Op::kShl:
+      case Op::kShr:
+        FailIf(b.CreateICmpUGT(r, b.getInt64(63)));
+        return {op == Op::kShl ? b.CreateShl(l, r) : b.CreateAShr(l, r),
+                vm::Tag::kInt};
+      case Op::kEq: return to_int(b.CreateICmpEQ(l, r));
+      case Op::kNe: return to_int(b.CreateICmpNE(l, r));
+      case Op::kLt: return to_int(b.CreateICmpSLT(l, r));
+      case Op::kLe: return to_int(b.CreateICmpSLE(l, r));
+      case Op::kGt: return to_int(b.CreateICmpSGT(l, r));
+      case Op::kGe: return to_int(b.CreateICmpSGE(l, r));
+      default: break;
+    }
+  } else {
+    l = Convert(vm::Tag::kFloat, left).val;
+    r = Convert(vm::Tag::kFloat, right).val;
+    switch (op) {
+      case Op::kAdd: return {b.CreateFAdd(l, r), vm::Tag::kFloat};
+      case Op::kSub: return {b.CreateFSub(l, r), vm::Tag::kFloat};
+      case Op::kMul: return {b.CreateFMul(l, r), vm::Tag::kFloat};
+      case Op::kDiv: return {b.CreateFDiv(l, r), vm::Tag::kFloat};
+      case Op::kMod: return {b.CreateFRem(l, r), vm::Tag::kFloat};
+      case Op::kEq: return to_int(b.CreateFCmpOEQ(l, r));
+      case Op::kNe: return to_int(b.CreateFCmpUNE(l, r));
+      case Op::kLt: return to_int(b.CreateFCmpOLT(l, r));
+      case Op::kLe: return to_int(b.CreateFCmpOLE(l, r));
+      case Op::kGt: return to_int(b.CreateFCmpOGT(l, r));
+      case Op::kGe: return to_int(b.CreateFCmpOGE(l, r));
+      default: break;
+    }
+  }
+  Fail(std::string("computes ") + NameOf(left.tag) + " " + vm::OpName(op) +
+       " " + NameOf(right.tag));
+  return Typed();
+}
+
+// The local keeps its type, e.g. i += 0.5 on an Int i cannot be lowered
+CodeGen::Typed CodeGen::Assign(ast::Expression *target, const std::string &op,
+                               ast::Expression *val) {
+  auto name = dynamic_cast<ast::Name *>(target);
+  if (name == nullptr) {
+    Fail("assigns to something else than a local");
+    return Typed();
+  }
+  auto slot = Slot(name);
+  if (slot == nullptr) return Typed();
+  auto tag = _tags[name->binding.slot];
+  auto res = Typed();
+  if (op == "__assign__") {
+    res = Eval(val);
+  } else {
+    auto old = Typed{_builder->CreateLoad(TypeOf(tag), slot), tag};
+    res = Arith(vm::OpOf(op), old, Eval(val));
+  }
+  if (res.val == nullptr) return Typed();
+  if (res.tag != tag) {
+    Fail(std::string("assigns a ") + NameOf(res.tag) + " to the " +
+         NameOf(tag) + " \"" + *name->id + "\"");
+    return Typed();
+  }
+  _builder->CreateStore(res.val, slot);
+  return res;
+}
+
+// As Int(x) and Float(x)
+CodeGen::Typed CodeGen::Convert(vm::Tag to, Typed from) {
+  if (from.val == nullptr || from.tag == to) return from;
+  if (to == vm::Tag::kFloat) {
+    return {_builder->CreateSIToFP(from.val, TypeOf(to)), to};
+  }
+  // Out of range and NaN raise
+  auto abs = _builder->CreateUnaryIntrinsic(llvm::Intrinsic::fabs, from.val);
+  FailIf(_builder->CreateFCmpUGE(
+      abs, llvm::ConstantFP::get(from.val->getType(), 9.2e18)));
+  return {_builder->CreateFPToSI(from.val, TypeOf(to)), to};
+}
+
+// Every param is given, of its type, as the callee takes it as is
+CodeGen::Typed CodeGen::Call(int func, ast::CallOperator *cop) {
+  const auto &callee = _program->funcs[func];
+  const auto &signature = _signatures.at(func);
+  auto nparams = signature.params.size();
+  auto args = std::vector<llvm::Value *>(nparams, nullptr);
+  auto give = [&](size_t param, ast::Expression *expr) {
+    auto arg = Eval(expr);
+    if (arg.val == nullptr) return false;
+    if (arg.tag != signature.params[param]) {
+      Fail(std::string("gives a ") + NameOf(arg.tag) + " as the " +
+           NameOf(signature.params[param]) + " \"" + callee.params[param] +
+           "\" of " + callee.name);
+      return false;
+    }
+    args[param] = arg.val;
+    return true;
+  };
+
+  size_t param = 0;
+  for (const auto &unamed : cop->unameds) {
+    if (param >= nparams) {
+      Fail("gives " + callee.name + " too many args");
+      return Typed();
+    }
+    if (!give(param++, unamed.get())) return Typed();
+  }
+  for (const auto &[id, val] : cop->keywords) {
+    auto found =
+        std::find(callee.params.begin(), callee.params.end(), *id);
+    if (found == callee.params.end()) {
+      Fail(callee.name + " has no param \"" + *id + "\"");
+      return Typed();
+    }
+    if (!give(found - callee.params.begin(), val.get())) return Typed();
+  }
+  for (size_t i = 0; i < nparams; ++i) {
+    if (args[i] == nullptr) {
+      Fail("leaves \"" + callee.params[i] + "\" of " + callee.name +
+           " to its default");
+      return Typed();
+    }
+  }
+
+  auto depth = _impl->getArg(_signature->params.size());
+  args.push_back(_builder->CreateAdd(depth, _builder->getInt32(1)));
+  auto &entry = _impl->getEntryBlock();
+  auto res = llvm::IRBuilder<>(&entry, entry.begin())
+                 .CreateAlloca(TypeOf(signature.res));
+  args.push_back(res);
+  FailIf(_builder->CreateNot(_builder->CreateCall(signature.impl, args)));
+  return {_builder->CreateLoad(TypeOf(signature.res), res), signature.res};
+}
+
+void CodeGen::Visit(ast::Block *block) {
+  for (const auto &stmt : block->statements) {
+    if (!_failure.empty()) return;
+    if (_builder->GetInsertBlock()->getTerminator() != nullptr) Unreachable();
+    Walk(stmt.get());
+  }
+}
+
+void CodeGen::Visit(ast::ExprStatement *stmt) { Eval(stmt->expr.get()); }
+
+void CodeGen::Visit(ast::Break *) {
+  if (_loops.empty()) return Fail("breaks outside a loop");
+  _builder->CreateBr(_loops.back().exit);
+  Unreachable();
+}
+
+void CodeGen::Visit(ast::Continue *) {
+  if (_loops.empty()) return Fail("continues outside a loop");
+  _builder->CreateBr(_loops.back().next);
+  Unreachable();
+}
+
+void CodeGen::Visit(ast::Return *ret) {
+  if (ret->expr == nullptr) return Fail("returns Void");
+  auto val = Eval(ret->expr.get());
+  if (val.val == nullptr) return;
+  if (val.tag != _signature->res) {
+    return Fail(std::string("returns a ") + NameOf(val.tag) + " for an " +
+                NameOf(_signature->res));
+  }
+  _builder->CreateStore(val.val, _impl->getArg(_impl->arg_size() - 1));
+  _builder->CreateRet(_builder->getTrue());
+  Unreachable();
+}
+
+// Only what both branches create is created after
+void CodeGen::Visit(ast::If *if_stmt) {
+  auto test = Cond(if_stmt->test.get());
+  if (test == nullptr) return;
+  auto body = llvm::BasicBlock::Create(*_context, "", _impl);
+  auto end = llvm::BasicBlock::Create(*_context, "", _impl);
+  auto orelse = if_stmt->orelse == nullptr
+                    ? end
+                    : llvm::BasicBlock::Create(*_context, "", _impl);
+  _builder->CreateCondBr(test, body, orelse);
+
+  auto created = _created;
+  _builder->SetInsertPoint(body);
+  Walk(if_stmt->body.get());
+  if (!_failure.empty()) return;
+  Close(end);
+  std::swap(created, _created);
+  if (if_stmt->orelse != nullptr) {
+    _builder->SetInsertPoint(orelse);
+    Walk(if_stmt->orelse.get());
+    if (!_failure.empty()) return;
+    Close(end);
+    for (size_t i = 0; i < _created.size(); ++i) {
+      _created[i] = _created[i] && created[i];
+    }
+  }
+  _builder->SetInsertPoint(end);
+}
+
+// Break skips the else, neither the body nor the else may have run after
+void CodeGen::Visit(ast::While *while_stmt) {
+  auto test = llvm::BasicBlock::Create(*_context, "", _impl);
+  Close(test);
+  _builder->SetInsertPoint(test);
+  auto cond = Cond(while_stmt->test.get());
+  if (cond == nullptr) return;
+  auto body = llvm::BasicBlock::Create(*_context, "", _impl);
+  auto exit = llvm::BasicBlock::Create(*_context, "", _impl);
+  auto orelse = while_stmt->orelse == nullptr
+                    ? exit
+                    : llvm::BasicBlock::Create(*_context, "", _impl);
+  _builder->CreateCondBr(cond, body, orelse);
+
+  auto created = _created;
+  _loops.push_back({test, exit});
+  _builder->SetInsertPoint(body);
+  Walk(while_stmt->body.get());
+  _loops.pop_back();
+  if (!_failure.empty()) return;
+  Close(test);
+  _created = created;
+  if (while_stmt->orelse != nullptr) {
+    _builder->SetInsertPoint(orelse);
+    Walk(while_stmt->orelse.get());
+    if (!_failure.empty()) return;
+    Close(exit);
+    _created = created;
+  }
+  _builder->SetInsertPoint(exit);
+}
+
+void CodeGen::Visit(ast::ObjCreate *create) {
+  const auto &binding = create->binding;
+  if (binding.kind != ast::Binding::kLocal || binding.depth != 0) {
+    return Fail("creates \"" + *create->id + "\" outside its frame");
+  }
+  auto val = Eval(create->call_expr.get());
+  if (val.val == nullptr) return;
+  Define(binding.slot, *create->id, val.tag);
+  if (!_failure.empty()) return;
+  _builder->CreateStore(val.val, _slots[binding.slot]);
+  _created[binding.slot] = true;
+}
+
+void CodeGen::Visit(ast::Function *) { Fail("creates a Function"); }
+void CodeGen::Visit(ast::Assemble *) { Fail("creates an Assemble"); }
+void CodeGen::Visit(ast::Struct *) { Fail("creates a Struct"); }
+void CodeGen::Visit(ast::Class *) { Fail("creates a Class"); }
+void CodeGen::Visit(ast::Import *) { Fail("imports"); }
+void CodeGen::Visit(ast::Raise *) { Fail("raises"); }
+void CodeGen::Visit(ast::Try *) { Fail("catches errors"); }
+
+void CodeGen::Visit(ast::Literal *literal) {
+  auto constant = pass::Constant();
+  if (!pass::ToConstant(literal, &constant)) {
+    return Fail("uses a " + std::string(literal->type->GetName()));
+  }
+  if (constant.is_float) {
+    _val = {llvm::ConstantFP::get(_builder->getDoubleTy(), constant.f),
+            vm::Tag::kFloat};
+  } else {
+    _val = {_builder->getInt64(constant.i), vm::Tag::kInt};
+  }
+}
+
+void CodeGen::Visit(ast::Name *name) {
+  auto slot = Slot(name);
+  if (slot == nullptr) return;
+  auto tag = _tags[name->binding.slot];
+  _val = {_builder->CreateLoad(TypeOf(tag), slot, *name->id), tag};
+}
+
+void CodeGen::Visit(ast::UnaryOpExpr *expr) {
+  auto name = std::string(expr->op->GetName());
+  if (name == "__not__") {
+    auto cond = Cond(expr);
+    if (cond == nullptr) return;
+    _val = {_builder->CreateZExt(cond, _builder->getInt64Ty()),
+            vm::Tag::kInt};
+    return;
+  }
+  auto right = Eval(expr->right.get());
+  if (right.val == nullptr) return;
+  auto is_int = right.tag == vm::Tag::kInt;
+  switch (vm::OpOf(name)) {
+    case vm::Op::kPos: _val = right; return;
+    case vm::Op::kNeg:
+      _val = {is_int ? _builder->CreateSub(_builder->getInt64(0), right.val)
+                     : _builder->CreateFNeg(right.val),
+              right.tag};
+      return;
+    case vm::Op::kBitNot:
+      if (!is_int) break;
+      _val = {_builder->CreateNot(right.val), right.tag};
+      return;
+    default: break;
+  }
+  Fail("computes " + name + " of a " + NameOf(right.tag));
+}
+
+void CodeGen::Visit(ast::BinaryOpExpr *expr) {
+  auto name = std::string(expr->op->GetName());
+  if (name == "__assign__" || name.rfind("__self_", 0) == 0) {
+    _val = Assign(expr->left.get(), name, expr->right.get());
+    return;
+  }
+  auto left = Eval(expr->left.get());
+  _val = Arith(vm::OpOf(name), left, Eval(expr->right.get()));
+}
+
+void CodeGen::Visit(ast::LogicExpr *expr) {
+  auto name = std::string(expr->op->GetName());
+  if (name == "__and__" || name == "__or__") {
+    auto cond = Cond(expr);
+    if (cond == nullptr) return;
+    _val = {_builder->CreateZExt(cond, _builder->getInt64Ty()),
+            vm::Tag::kInt};
+    return;
+  }
+  auto left = Eval(expr->left.get());
+  _val = Arith(vm::OpOf(name), left, Eval(expr->right.get()));
+}
+
+void CodeGen::Visit(ast::IfElseExpr *expr) {
+  auto test = Cond(expr->test.get());
+  if (test == nullptr) return;
+  auto left_block = llvm::BasicBlock::Create(*_context, "", _impl);
+  auto right_block = llvm::BasicBlock::Create(*_context, "", _impl);
+  auto end = llvm::BasicBlock::Create(*_context, "", _impl);
+  _builder->CreateCondBr(test, left_block, right_block);
+  _builder->SetInsertPoint(left_block);
+  auto left = Eval(expr->left.get());
+  if (left.val == nullptr) return;
+  left_block = _builder->GetInsertBlock();
+  _builder->CreateBr(end);
+  _builder->SetInsertPoint(right_block);
+  auto right = Eval(expr->right.get());
+  if (right.val == nullptr) return;
+  right_block = _builder->GetInsertBlock();
+  _builder->CreateBr(end);
+  if (left.tag != right.tag) {
+    return Fail(std::string("chooses between an ") + NameOf(left.tag) +
+                " and a " + NameOf(right.tag));
+  }
+  _builder->SetInsertPoint(end);
+  auto phi = _builder->CreatePHI(TypeOf(left.tag), 2);
+  phi->addIncoming(left.val, left_block);
+  phi->addIncoming(right.val, right_block);
+  _val = {phi, left.tag};
+}
+
+// Int(x), Float(x), Auto(x) and the Functions lowered
+void CodeGen::Visit(ast::CallExpr *expr) {
+  auto cop = expr->op.get();
+  auto name = dynamic_cast<ast::Name *>(expr->obj.get());
+  if (name == nullptr || name->parent != nullptr) {
+    return Fail("calls a method or an expression");
+  }
+  const auto &id = *name->id;
+  const auto &binding = name->binding;
+  if (binding.kind == ast::Binding::kBuiltin) {
+    if ((id != "Int" && id != "Float" && id != "Auto") ||
+        !cop->keywords.empty() || cop->unameds.size() > 1) {
+      return Fail("calls " + id);
+    }
+    auto tag = id == "Int" ? vm::Tag::kInt : vm::Tag::kFloat;
+    if (cop->unameds.empty()) {
+      if (id == "Auto") return Fail("creates an Auto of nothing");
+      _val = {llvm::Constant::getNullValue(TypeOf(tag)), tag};
+      return;
+    }
+    auto arg = Eval(cop->unameds.front().get());
+    _val = id == "Auto" ? arg : Convert(tag, arg);
+    return;
+  }
+
+  if (binding.kind == ast::Binding::kGlobal && binding.slot >= 0) {
+    const auto &callee = _program->statics[binding.slot];
+    if (callee.tag == vm::Tag::kFunction && _signatures.count(callee.i)) {
+      _val = Call(callee.i, cop);
+      return;
+    }
+  }
+  Fail("calls \"" + id + "\", which is not compiled");
+}
+
+void CodeGen::Visit(ast::SubscriptExpr *) { Fail("uses subscripts"); }
+
+}  // namespace jit
@@ -0,0 +1,125 @@
+#ifndef _XULANG_SRC_JIT_CODEGEN_HPP
+#define _XULANG_SRC_JIT_CODEGEN_HPP
+
+#include <map>
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+#include "../ast/walker.hpp"
+#include "../pass/pass.hpp"
+#include "../vm/bytecode.hpp"
+
+namespace jit {
+
+struct Lowering {
+  // The entry of a Function, xl_ and its name, e.g. xl_fib
+  struct Entry {
+    int func;  // Program::funcs index
+    std::string symbol;
+    std::vector<vm::Tag> params;
+    vm::Tag res;
+  };
+
+  std::unique_ptr<llvm::LLVMContext> context;
+  std::unique_ptr<llvm::Module> module;
+  std::vector<Entry> entries;
+  pass::Remarks remarks;  // why the other Functions are not lowered
+};
+
+// Lower the Module Functions of a compiled Program which only compute on
+// Int and Float to LLVM IR: their params are all keyword params of Int or
+// Float, they return one of them, and their bodies only create, assign and
+// compute on locals of those, branch, loop and call such Functions. Having
+// no side effects, whatever the IR cannot do as the bytecode does, e.g.
+// divide by zero, shift out of [0, 63], call too deep or fall off the end,
+// gives up with false and the bytecode runs the call again.
+//
+// The entry of each is extern "C" bool xl_f(const int64_t *args,
+// int64_t *res, int depth), see vm::Native.
+class CodeGen final : private ast::Walker {
+ public:
+  Lowering operator()(ast::Module *module, const vm::Program &program);
+
+ private:
+  struct Typed {
+    llvm::Value *val = nullptr;  // nullptr once it fails
+    vm::Tag tag = vm::Tag::kVoid;
+  };
+  struct Loop {
+    llvm::BasicBlock *next;
+    llvm::BasicBlock *exit;
+  };
+  struct Signature {
+    std::vector<vm::Tag> params;
+    vm::Tag res;
+    llvm::Function *impl = nullptr;
+  };
+
+  const vm::Program *_program;
+  llvm::LLVMContext *_context;
+  llvm::Module *_module;
+  utils::Uptr<llvm::IRBuilder<>> _builder;
+  std::map<int, Signature> _signatures;  // by Program::funcs index
+
+  // Of the Function being lowered
+  const Signature *_signature;
+  llvm::Function *_impl;
+  llvm::BasicBlock *_fail = nullptr;  // returns false
+  std::vector<llvm::AllocaInst *> _slots;
+  std::vector<vm::Tag> _tags;
+  std::vector<bool> _created;  // on every path to here
+  std::vector<Loop> _loops;
+  std::string _failure;  // why it cannot be lowered
+  Typed _val;            // of the expression just walked
+
+  void Fail(const std::string &why);
+  llvm::Type *TypeOf(vm::Tag tag);
+  bool Lower(const vm::Func &func, ast::Function *ast,
+             const Signature &signature);
+  void Entry(const vm::Func &func, const Signature &signature,
+             const std::string &symbol);
+  void FailIf(llvm::Value *cond);
+  void Close(llvm::BasicBlock *next);
+  void Unreachable();
+  void Define(int slot, const std::string &id, vm::Tag tag);
+  Typed Eval(ast::Expression *expr);
+  llvm::Value *Cond(ast::Expression *expr);
+  llvm::Value *Truth(Typed val);
+  llvm::Value *Slot(ast::Name *name);
+  Typed Arith(vm::Op op, Typed left, Typed right);
+  Typed Assign(ast::Expression *target, const std::string &op,
+               ast::Expression *val);
+  Typed Convert(vm::Tag to, Typed from);
+  Typed Call(int func, ast::CallOperator *cop);
+
+  virtual void Visit(ast::Block *) override;
+  virtual void Visit(ast::ExprStatement *) override;
+  virtual void Visit(ast::Break *) override;
+  virtual void Visit(ast::Continue *) override;
+  virtual void Visit(ast::Return *) override;
+  virtual void Visit(ast::If *) override;
+  virtual void Visit(ast::While *) override;
+  virtual void Visit(ast::ObjCreate *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override;
+  virtual void Visit(ast::Raise *) override;
+  virtual void Visit(ast::Try *) override;
+
+  virtual void Visit(ast::Literal *) override;
+  virtual void Visit(ast::Name *) override;
+  virtual void Visit(ast::UnaryOpExpr *) override;
+  virtual void Visit(ast::BinaryOpExpr *) override;
+  virtual void Visit(ast::LogicExpr *) override;
+  virtual void Visit(ast::IfElseExpr *) override;
+  virtual void Visit(ast::CallExpr *) override;
+  virtual void Visit(ast::SubscriptExpr *) override;
+};
+
+}  // namespace jit
+
+#endif  // _XULANG_SRC_JIT_CODEGEN_HPP
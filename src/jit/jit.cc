@@ -0,0 +1,107 @@
+#include "./jit.hpp"
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+namespace jit {
+
+Jit::Jit() {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+}
+
+bool Jit::Optimize(llvm::Module *module) {
+  if (!Host()) return false;
+  module->setDataLayout(_machine->createDataLayout());
+  module->setTargetTriple(_machine->getTargetTriple().str());
+
+  auto loops = llvm::LoopAnalysisManager();
+  auto funcs = llvm::FunctionAnalysisManager();
+  auto sccs = llvm::CGSCCAnalysisManager();
+  auto modules = llvm::ModuleAnalysisManager();
+  auto builder = llvm::PassBuilder(_machine.get());
+  builder.registerModuleAnalyses(modules);
+  builder.registerCGSCCAnalyses(sccs);
+  builder.registerFunctionAnalyses(funcs);
+  builder.registerLoopAnalyses(loops);
+  builder.crossRegisterProxies(loops, funcs, sccs, modules);
+  builder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2)
+      .run(*module, modules);
+  return true;
+}
+
+// Code generation changes the IR, a copy of it is compiled
+bool Jit::EmitObject(llvm::Module *module, const std::string &filename) {
+  if (!Host()) return false;
+  auto code = std::error_code();
+  auto out = llvm::raw_fd_ostream(filename, code, llvm::sys::fs::OF_None);
+  if (code) {
+    _error = filename + ": " + code.message();
+    return false;
+  }
+  auto copy = llvm::CloneModule(*module);
+  auto passes = llvm::legacy::PassManager();
+  if (_machine->addPassesToEmitFile(passes, out, nullptr,
+                                    llvm::CGFT_ObjectFile)) {
+    _error = "the host cannot emit object files";
+    return false;
+  }
+  passes.run(*copy);
+  out.flush();
+  return true;
+}
+
+bool Jit::Load(Lowering &&lowering, vm::Program *program) {
+  if (_jit == nullptr) {
+    auto jit = llvm::orc::LLJITBuilder().create();
+    if (!jit) return Check(jit.takeError());
+    _jit = std::move(*jit);
+    // e.g. fmod, which % of Floats may call
+    auto process =
+        llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+            _jit->getDataLayout().getGlobalPrefix());
+    if (!process) return Check(process.takeError());
+    _jit->getMainJITDylib().addGenerator(std::move(*process));
+  }
+
+  auto module = llvm::orc::ThreadSafeModule(std::move(lowering.module),
+                                            std::move(lowering.context));
+  if (!Check(_jit->addIRModule(std::move(module)))) return false;
+  for (const auto &entry : lowering.entries) {
+    auto symbol = _jit->lookup(entry.symbol);
+    if (!symbol) return Check(symbol.takeError());
+    auto &native = program->funcs[entry.func].native;
+    native.entry = reinterpret_cast<decltype(native.entry)>(
+        static_cast<uintptr_t>(symbol->getAddress()));
+    native.params = entry.params;
+    native.res = entry.res;
+  }
+  return true;
+}
+
+// The host with the code generation of -O2, and position independent code
+// for object files to link anywhere
+bool Jit::Host() {
+  if (_machine != nullptr) return true;
+  auto builder = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!builder) return Check(builder.takeError());
+  builder->setCodeGenOptLevel(llvm::CodeGenOpt::Default);
+  builder->setRelocationModel(llvm::Reloc::PIC_);
+  auto machine = builder->createTargetMachine();
+  if (!machine) return Check(machine.takeError());
+  _machine = std::move(*machine);
+  return true;
+}
+
+bool Jit::Check(llvm::Error error) {
+  if (!error) return true;
+  _error = llvm::toString(std::move(error));
+  return false;
+}
+
+}  // namespace jit
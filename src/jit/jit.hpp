@@ -0,0 +1,38 @@
+#ifndef _XULANG_SRC_JIT_JIT_HPP
+#define _XULANG_SRC_JIT_JIT_HPP
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include "./codegen.hpp"
+
+namespace jit {
+
+// Compile what CodeGen lowers to machine code for the host: optimize it with
+// the -O2 pipeline of LLVM, then load it through ORC for the VM to call or
+// write it to an object file ahead of time. A step which fails returns false
+// with the reason in error().
+class Jit final {
+ public:
+  Jit();
+
+  bool Optimize(llvm::Module *module);
+  bool EmitObject(llvm::Module *module, const std::string &filename);
+  // Set the vm::Native of every Function lowered, the machine code lives as
+  // long as the Jit
+  bool Load(Lowering &&lowering, vm::Program *program);
+
+  inline const std::string &error() const { return _error; }
+
+ private:
+  utils::Uptr<llvm::TargetMachine> _machine;
+  utils::Uptr<llvm::orc::LLJIT> _jit;
+  std::string _error;
+
+  bool Host();
+  bool Check(llvm::Error error);
+};
+
+}  // namespace jit
+
+#endif  // _XULANG_SRC_JIT_JIT_HPP
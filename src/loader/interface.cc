@@ -0,0 +1,124 @@
+#include "./interface.hpp"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "../ast/printer.hpp"
+#include "../utils/log.hpp"
+
+namespace loader {
+
+static auto kLog = utils::Logger::NewLogger("loader.interface");
+
+static bool ReadFile(const std::string &path, std::string *res) {
+  auto in = std::ifstream(path, std::ios::binary);
+  if (!in) return false;
+  auto buf = std::stringstream();
+  buf << in.rdbuf();
+  *res = buf.str();
+  return true;
+}
+
+// Write to a temporary file first, so that readers never see half a file
+static bool WriteFile(const std::string &path, const std::string &data) {
+  auto tmp = path + ".tmp" + std::to_string(getpid());
+  {
+    auto out = std::ofstream(tmp, std::ios::binary | std::ios::trunc);
+    if (!(out << data)) return false;
+  }
+  std::error_code err;
+  std::filesystem::rename(tmp, path, err);
+  return !err;
+}
+
+static std::string ToHex(uint64_t val) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(val));
+  return buf;
+}
+
+static std::string Declare(ast::Create *obj, const std::string &indent);
+
+// Only the Creates of a Class or Struct body are part of its interface
+static std::string DeclareBody(ast::Block *body, const std::string &indent) {
+  auto res = std::string();
+  for (const auto &stmt : body->statements) {
+    auto obj = dynamic_cast<ast::Create *>(stmt.get());
+    if (obj != nullptr) res += Declare(obj, indent + "    ") + "\n";
+  }
+  return res.empty() ? "{}" : "{\n" + res + indent + "}";
+}
+
+static std::string Declare(ast::Create *obj, const std::string &indent) {
+  auto print = ast::Printer();
+  if (auto func = dynamic_cast<ast::Function *>(obj)) {
+    return indent + *func->id + " := Function" + print(func->args.get()) +
+           " {}";
+  }
+  if (auto assemble = dynamic_cast<ast::Assemble *>(obj)) {
+    return indent + *assemble->id + " := Assemble" +
+           print(assemble->args.get()) + " {}";
+  }
+  if (auto class_create = dynamic_cast<ast::Class *>(obj)) {
+    return indent + *class_create->id + " := Class" +
+           print(class_create->parents.get()) + " " +
+           DeclareBody(class_create->body.get(), indent);
+  }
+  if (auto struct_create = dynamic_cast<ast::Struct *>(obj)) {
+    return indent + *struct_create->id + " := Struct() " +
+           DeclareBody(struct_create->body.get(), indent);
+  }
+  // ObjCreate and Import are declarations already
+  return indent + print(obj);
+}
+
+bool Interface::HashFile(const std::string &path, uint64_t *hash) {
+  auto data = std::string();
+  if (!ReadFile(path, &data)) return false;
+  *hash = utils::Fnv1a(data);
+  return true;
+}
+
+Uptr<Interface> Interface::Summarize(const ast::Module *module,
+                                     uint64_t source_hash) {
+  auto name = std::filesystem::path(module->filename).filename().string();
+  auto text = "# Interface of " + name + ", generated, do not edit\n";
+  for (const auto &obj : module->objs) text += Declare(obj.get(), "") + "\n";
+  return std::make_unique<Interface>(module->filename, text, source_hash);
+}
+
+Uptr<Interface> Interface::Find(const std::string &source,
+                                uint64_t source_hash) {
+  auto stamp = std::string(), text = std::string();
+  if (!ReadFile(StampPath(source), &stamp) ||
+      !ReadFile(SummaryPath(source), &text)) {
+    return nullptr;
+  }
+  auto res = std::make_unique<Interface>(source, text, source_hash);
+  if (stamp != ToHex(source_hash) + " " + ToHex(res->Hash()) + "\n") {
+    return nullptr;
+  }
+  return res;
+}
+
+bool Interface::Save() const {
+  auto old = std::string();
+  auto changed = !ReadFile(SummaryPath(source), &old) || old != text;
+  if (changed && !WriteFile(SummaryPath(source), text)) {
+    kLog->Warning({"cannot write", SummaryPath(source)});
+    return false;
+  }
+
+  auto stamp = ToHex(source_hash) + " " + ToHex(Hash()) + "\n";
+  if ((!ReadFile(StampPath(source), &old) || old != stamp) &&
+      !WriteFile(StampPath(source), stamp)) {
+    kLog->Warning({"cannot write", StampPath(source)});
+  }
+  return changed;
+}
+
+}  // namespace loader
@@ -0,0 +1,49 @@
+#ifndef _XULANG_SRC_LOADER_INTERFACE_HPP
+#define _XULANG_SRC_LOADER_INTERFACE_HPP
+
+#include "../ast/statement.hpp"
+
+namespace loader {
+
+using utils::Uptr;
+
+// What the users of a module need from it, like a precompiled header: every
+// top level Create with the Function and Assemble bodies dropped. It is kept
+// as XuLang source in "file.xl.xli" beside "file.xl", so loading it is just
+// parsing a much smaller file.
+//
+// "file.xl.xli.stamp" records the source hash the summary was made from. The
+// summary itself is only rewritten when the interface text changes, so
+// editing function bodies never invalidates the users of a module.
+class Interface final {
+ public:
+  std::string source;
+  std::string text;
+  uint64_t source_hash;
+
+  Interface(const std::string &source, const std::string &text,
+            uint64_t source_hash)
+      : source(source), text(text), source_hash(source_hash) {}
+
+  inline uint64_t Hash() const { return utils::Fnv1a(text); }
+
+  static Uptr<Interface> Summarize(const ast::Module *module,
+                                   uint64_t source_hash);
+  // Return nullptr if there is no summary made from this very source
+  static Uptr<Interface> Find(const std::string &source, uint64_t source_hash);
+  // Return true if the summary file was written, false if it was up to date
+  // or could not be written
+  bool Save() const;
+
+  static bool HashFile(const std::string &path, uint64_t *hash);
+  static inline std::string SummaryPath(const std::string &source) {
+    return source + ".xli";
+  }
+  static inline std::string StampPath(const std::string &source) {
+    return source + ".xli.stamp";
+  }
+};
+
+}  // namespace loader
+
+#endif  // _XULANG_SRC_LOADER_INTERFACE_HPP
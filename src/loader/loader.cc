@@ -0,0 +1,224 @@
+#include "./loader.hpp"
+
+#include <algorithm>
+#include <filesystem>
+
+#include "../parser/parse.hpp"
+#include "../utils/log.hpp"
+
+namespace loader {
+
+static auto kLog = utils::Logger::NewLogger("loader");
+
+// The text of a String literal keeps its quotes, e.g. 'ast.xl'
+static bool GetStringLiteral(const ast::Expression *expr, std::string *res) {
+  auto literal = dynamic_cast<const ast::Literal *>(expr);
+  if (literal == nullptr ||
+      dynamic_cast<const builtin::String *>(literal->type.get()) == nullptr) {
+    return false;
+  }
+  const auto &text = *literal->val;
+  if (text.length() < 2 || text.front() != '\'' || text.back() != '\'') {
+    return false;
+  }
+  *res = text.substr(1, text.length() - 2);
+  return true;
+}
+
+ModuleNode *ModuleGraph::Find(const std::string &path) const {
+  auto normalized = Loader::NormalizePath(path);
+  for (const auto &node : nodes) {
+    if (node->path == normalized) return node.get();
+  }
+  return nullptr;
+}
+
+std::vector<int> ModuleGraph::TopoOrder() const {
+  std::vector<int> res;
+  for (const auto &wave : waves) {
+    res.insert(res.end(), wave.begin(), wave.end());
+  }
+  return res;
+}
+
+std::string Loader::NormalizePath(const std::string &path) {
+  std::error_code err;
+  auto res = std::filesystem::weakly_canonical(path, err);
+  if (err) return std::filesystem::path(path).lexically_normal().string();
+  return res.string();
+}
+
+bool Loader::ImportedFiles(const ast::Module *module,
+                           std::vector<std::string> *files) {
+  auto dir = std::filesystem::path(module->filename).parent_path();
+  auto ok = true;
+  for (const auto &obj : module->objs) {
+    auto import = dynamic_cast<const ast::Import *>(obj.get());
+    if (import == nullptr) continue;
+
+    auto root = std::string();
+    if (import->module_root->unameds.size() != 1 ||
+        !GetStringLiteral(import->module_root->unameds.front().get(), &root)) {
+      kLog->Error({"file \"" + module->filename + "\"", "Import",
+                   *import->id, "needs exactly one String literal root"});
+      ok = false;
+      continue;
+    }
+
+    for (const auto &stmt : import->files->statements) {
+      auto file = dynamic_cast<const ast::ObjCreate *>(stmt.get());
+      auto name = std::string();
+      if (file == nullptr || file->call_expr->op->unameds.size() != 1 ||
+          !GetStringLiteral(file->call_expr->op->unameds.front().get(),
+                            &name)) {
+        kLog->Error({"file \"" + module->filename + "\"", "Import",
+                     *import->id, "files must be like a := String('a.xl')"});
+        ok = false;
+        continue;
+      }
+      files->push_back((dir / root / name).string());
+    }
+  }
+  return ok;
+}
+
+ModuleNode *Loader::AddNode(const std::string &path) {
+  auto normalized = NormalizePath(path);
+  auto it = _index.find(normalized);
+  if (it != _index.end()) return _graph->nodes[it->second].get();
+
+  auto idx = static_cast<int>(_graph->nodes.size());
+  _graph->nodes.push_back(std::make_unique<ModuleNode>(idx, normalized));
+  _index[normalized] = idx;
+
+  auto node = _graph->nodes.back().get();
+  _pool.Submit([this, node] { ParseNode(node); });
+  return node;
+}
+
+void Loader::ParseNode(ModuleNode *node) {
+  auto module = Uptr<ast::Module>(nullptr);
+  auto interface = Uptr<Interface>(nullptr);
+  auto from_interface = false;
+  uint64_t source_hash = 0;
+  if (_use_interfaces && Interface::HashFile(node->path, &source_hash)) {
+    // Users of an imported module only need its interface
+    if (_roots.count(node->path) == 0) {
+      interface = Interface::Find(node->path, source_hash);
+    }
+    if (interface != nullptr) {
+      module = parser::Parse(Interface::SummaryPath(node->path), node->idx);
+      from_interface = module != nullptr;
+    }
+  }
+  if (from_interface) {
+    module->filename = node->path;
+  } else {
+    module = parser::Parse(node->path, node->idx);
+    interface = nullptr;
+    if (module != nullptr && _use_interfaces) {
+      interface = Interface::Summarize(module.get(), source_hash);
+      interface->Save();
+    }
+  }
+
+  auto files = std::vector<std::string>();
+  auto ok = module != nullptr && ImportedFiles(module.get(), &files);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  node->module = std::move(module);
+  node->interface = std::move(interface);
+  node->from_interface = from_interface;
+  if (!ok) {
+    _failed = true;
+    return;
+  }
+  for (const auto &file : files) {
+    auto dep = AddNode(file);
+    if (std::find(node->deps.begin(), node->deps.end(), dep->idx) !=
+        node->deps.end()) {
+      continue;
+    }
+    node->deps.push_back(dep->idx);
+    dep->users.push_back(node->idx);
+  }
+}
+
+// Kahn's algorithm, a module joins the wave after its last dependency
+bool Loader::ComputeWaves() {
+  auto &nodes = _graph->nodes;
+  // Discovery order depends on thread timing, paths do not
+  auto by_path = [&nodes](int a, int b) {
+    return nodes[a]->path < nodes[b]->path;
+  };
+  auto pending = std::vector<int>(nodes.size());
+  auto wave = std::vector<int>();
+  for (const auto &node : nodes) {
+    pending[node->idx] = static_cast<int>(node->deps.size());
+    if (pending[node->idx] == 0) wave.push_back(node->idx);
+  }
+
+  auto done = size_t(0);
+  while (!wave.empty()) {
+    auto next = std::vector<int>();
+    for (auto idx : wave) {
+      nodes[idx]->wave = static_cast<int>(_graph->waves.size());
+      for (auto user : nodes[idx]->users) {
+        if (--pending[user] == 0) next.push_back(user);
+      }
+    }
+    done += wave.size();
+    std::sort(wave.begin(), wave.end(), by_path);
+    _graph->waves.push_back(std::move(wave));
+    wave = std::move(next);
+  }
+  if (done == nodes.size()) return true;
+
+  // Every module left is on a cycle or behind one, walk deps until repeating
+  auto start = 0;
+  while (pending[start] == 0) ++start;
+  auto seen = std::vector<int>(nodes.size(), -1);
+  auto path = std::vector<int>();
+  auto idx = start;
+  while (seen[idx] < 0) {
+    seen[idx] = static_cast<int>(path.size());
+    path.push_back(idx);
+    for (auto dep : nodes[idx]->deps) {
+      if (pending[dep] == 0) continue;
+      idx = dep;
+      break;
+    }
+  }
+
+  auto cycle = std::string();
+  for (auto i = seen[idx]; i < static_cast<int>(path.size()); ++i) {
+    cycle += "\"" + nodes[path[i]]->path + "\" -> ";
+  }
+  kLog->Error({"import cycle:", cycle + "\"" + nodes[idx]->path + "\""});
+  return false;
+}
+
+Uptr<ModuleGraph> Loader::Load(const std::vector<std::string> &files) {
+  _graph = std::make_unique<ModuleGraph>();
+  _index.clear();
+  _roots.clear();
+  _failed = false;
+  for (const auto &file : files) _roots.insert(NormalizePath(file));
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &file : files) {
+      auto idx = AddNode(file)->idx;
+      if (std::find(_graph->roots.begin(), _graph->roots.end(), idx) ==
+          _graph->roots.end()) {
+        _graph->roots.push_back(idx);
+      }
+    }
+  }
+  _pool.Wait();
+
+  if (_failed || !ComputeWaves()) return nullptr;
+  return std::move(_graph);
+}
+
+}  // namespace loader
@@ -0,0 +1,78 @@
+#ifndef _XULANG_SRC_LOADER_LOADER_HPP
+#define _XULANG_SRC_LOADER_LOADER_HPP
+
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../utils/thread_pool.hpp"
+#include "./interface.hpp"
+
+namespace loader {
+
+// One source file of the program, imports are resolved to other nodes
+struct ModuleNode {
+  int idx;
+  std::string path;
+  Uptr<ast::Module> module = nullptr;
+  // Set when interface summaries are enabled, an imported module whose
+  // summary is up to date is loaded from it and has no function bodies
+  Uptr<Interface> interface = nullptr;
+  bool from_interface = false;
+  std::vector<int> deps;   // modules imported by this one
+  std::vector<int> users;  // modules importing this one
+  int wave = -1;           // all deps are in smaller waves
+
+  ModuleNode(int idx, const std::string &path) : idx(idx), path(path) {}
+};
+
+// The import DAG, every file appears exactly once
+class ModuleGraph final {
+ public:
+  std::vector<Uptr<ModuleNode>> nodes;
+  std::vector<int> roots;
+  // Modules of the same wave do not depend on each other
+  std::vector<std::vector<int>> waves;
+
+  ModuleNode *Find(const std::string &path) const;
+  // Dependencies always come before their users
+  std::vector<int> TopoOrder() const;
+};
+
+// Parse the given files and everything they Import, each unique file is
+// parsed once on a worker thread as soon as it is discovered.
+class Loader final {
+ private:
+  utils::ThreadPool _pool;
+  std::mutex _mutex;
+  std::unordered_map<std::string, int> _index;
+  std::unordered_set<std::string> _roots;
+  Uptr<ModuleGraph> _graph;
+  bool _failed;
+  bool _use_interfaces = false;
+
+  ModuleNode *AddNode(const std::string &path);
+  void ParseNode(ModuleNode *node);
+  bool ComputeWaves();
+
+ public:
+  Loader(size_t threads = 0) : _pool(threads) {}
+
+  // Load imported modules from their interface summaries when up to date,
+  // and write the summaries of every parsed module
+  inline void SetUseInterfaces(bool use) { _use_interfaces = use; }
+
+  // Return nullptr if any file fails to parse or the imports form a cycle
+  Uptr<ModuleGraph> Load(const std::vector<std::string> &files);
+
+  // e.g. Import('./') { a := String('a.xl') } in "dir/m.xl" gives "dir/a.xl",
+  // return false if some Import does not name its files with literals
+  static bool ImportedFiles(const ast::Module *module,
+                            std::vector<std::string> *files);
+  static std::string NormalizePath(const std::string &path);
+};
+
+}  // namespace loader
+
+#endif  // _XULANG_SRC_LOADER_LOADER_HPP
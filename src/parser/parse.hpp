@@ -0,0 +1,30 @@
+#ifndef _XULANG_SRC_PARSER_PARSE_HPP
+#define _XULANG_SRC_PARSER_PARSE_HPP
+
+#include "../ast/statement.hpp"
+
+namespace parser {
+
+// The per-file state shared by the scanner and the parser, so that several
+// files can be parsed at the same time from different threads
+struct Context {
+  std::string filename;
+  int file_idx;
+  int line_end = 0;
+  int column = 1;
+  utils::Uptr<ast::Module> module = nullptr;
+
+  Context(const std::string &filename, int file_idx)
+      : filename(filename), file_idx(file_idx) {}
+};
+
+// Parse a whole file, return nullptr on IO or syntax errors
+utils::Uptr<ast::Module> Parse(const std::string &filename, int file_idx = 0);
+// Parse source already in memory, filename is only used for the Module
+utils::Uptr<ast::Module> ParseString(const std::string &source,
+                                     const std::string &filename,
+                                     int file_idx = 0);
+
+}  // namespace parser
+
+#endif  // _XULANG_SRC_PARSER_PARSE_HPP
@@ -2,7 +2,12 @@
 // tokens.l lex file. We also define the node type they represent.
 
 %code requires {
-    #include "ast/statement.hpp"
+    #include "parser/parse.hpp"
+
+    #ifndef YY_TYPEDEF_YY_SCANNER_T
+    #define YY_TYPEDEF_YY_SCANNER_T
+    typedef void *yyscan_t;
+    #endif
 
     #define MVU(p)      (std::unique_ptr<std::remove_reference<decltype(*p)>::type>(p))
     #define UNEW(exp)   (utils::Uptr<decltype(exp)>(new exp))
@@ -16,25 +21,39 @@
             (cur).col_beg = YYRHSLOC(x, 1).col_beg;                    \
             (cur).line_end = YYRHSLOC(x, n).line_end;                  \
             (cur).col_end = YYRHSLOC(x, n).col_end;                    \
-            (cur).file_idx = kFilenames.size() - 1;                    \
+            (cur).file_idx = ctx->file_idx;                            \
         } else {                                                       \
             (cur).line_beg = (cur).line_end = YYRHSLOC(x, 0).line_end; \
             (cur).col_beg = (cur).col_end = YYRHSLOC(x, 0).col_end;    \
-            (cur).file_idx = kFilenames.size() - 1;                    \
+            (cur).file_idx = ctx->file_idx;                            \
         }
 
 }
 
-%{
-    #include "../src/ast/statement.hpp"
-    #include <stack>
-    
-    int yylex();
-    void yyerror(char const *s);
+%code {
+    #include "../src/utils/log.hpp"
+
+    int yylex(YYSTYPE *lval, YYLTYPE *lloc, yyscan_t scanner);
+    void yyerror(YYLTYPE *lloc, yyscan_t scanner, parser::Context *ctx, char const *s);
+
+    // Provided by the reentrant scanner generated from token.l
+    int yylex_init_extra(parser::Context *ctx, yyscan_t *scanner);
+    void yyset_in(FILE *in, yyscan_t scanner);
+    int yylex_destroy(yyscan_t scanner);
+
+    // The If an else (if) of a chain belongs to, e.g. the second one in
+    // if (a) { } else if (b) { } else { }
+    static ast::If *LastIf(ast::If *if_stmt) {
+        while (if_stmt->orelse != nullptr) {
+            if_stmt = static_cast<ast::If *>(if_stmt->orelse->statements.front().get());
+        }
+        return if_stmt;
+    }
+}
 
-    std::stack<std::string> kFilenames;
-    utils::Uptr<ast::Module> kModule = nullptr; // the top level root node of our final AST
-%}
+%define api.pure full
+%lex-param      {yyscan_t scanner}
+%parse-param    {yyscan_t scanner} {parser::Context *ctx}
 
 
 %union {
@@ -110,12 +129,12 @@
 %locations
 
 %%
-start   : module { kModule = MVU($1); }
+start   : module { ctx->module = MVU($1); }
         ;
 module  : module TK_LF create { $1->AddObj(MVU($3)); }
         | module TK_LF { $$ = $1; }
-        | create { $$ = new ast::Module(kFilenames.top(), MVU($1)); }
-        | %empty { $$ = new ast::Module(kFilenames.top()); }
+        | create { $$ = new ast::Module(ctx->filename, MVU($1)); }
+        | %empty { $$ = new ast::Module(ctx->filename); }
         ;
 create  : obj_create | function | assemble | struct | class | import
         ;
@@ -148,12 +167,12 @@ return      : TK_RETURN expr { $$ = new ast::Return(MVU($2)); }
             ;
 raise       : TK_RAISE expr { $$ = new ast::Raise(MVU($2)); }
             ;
-if          : _beg_if TK_ELSE block { $$ = $1; $1->SetOrelse(MVU($3)); }
+if          : _beg_if TK_ELSE block { $$ = $1; LastIf($1)->SetOrelse(MVU($3)); }
             | _beg_if { $$ = $1; }
             ;
 _beg_if     : TK_IF TK_PAREN_L expr TK_PAREN_R block { $$ = new ast::If(MVU($3), MVU($5)); }
             | _beg_if TK_ELSE TK_IF TK_PAREN_L expr TK_PAREN_R block
-                { $$ = $1; $1->SetOrelse(UNEW(ast::Block( UNEW(ast::If(MVU($5), MVU($7))) ))); }
+                { $$ = $1; LastIf($1)->SetOrelse(UNEW(ast::Block( UNEW(ast::If(MVU($5), MVU($7))) ))); }
             ;
 while       : TK_WHILE TK_PAREN_L expr TK_PAREN_R block TK_ELSE block
                 { $$ = new ast::While(MVU($3), MVU($5), MVU($7)); }
@@ -266,8 +285,8 @@ uop_expr    : TK_BNOT expr %prec PR_UOP { $$ = new ast::UnaryOpExpr(UNEW(ast::Op
 bop_expr    : expr TK_PLUS expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpPlus()), MVU($3)); }
             | expr TK_MINUS expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpMinus()), MVU($3)); }
             | expr TK_MUL expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpMul()), MVU($3)); }
-            | expr TK_DIV expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpMod()), MVU($3)); }
-            | expr TK_MOD expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpDiv()), MVU($3)); }
+            | expr TK_DIV expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpDiv()), MVU($3)); }
+            | expr TK_MOD expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpMod()), MVU($3)); }
             | expr TK_BXOR expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpBitXor()), MVU($3)); }
             | expr TK_BOR expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpBitOr()), MVU($3)); }
             | expr TK_BAND expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpBitAnd()), MVU($3)); }
@@ -278,8 +297,8 @@ bop_expr    : expr TK_PLUS expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::
             | expr TK_SELF_PLUS expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpSelfPlus()), MVU($3)); }
             | expr TK_SELF_MINUS expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpSelfMinus()), MVU($3)); }
             | expr TK_SELF_MUL expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpSelfMul()), MVU($3)); }
-            | expr TK_SELF_DIV expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpSelfMod()), MVU($3)); }
-            | expr TK_SELF_MOD expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpSelfDiv()), MVU($3)); }
+            | expr TK_SELF_DIV expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpSelfDiv()), MVU($3)); }
+            | expr TK_SELF_MOD expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpSelfMod()), MVU($3)); }
             | expr TK_SELF_BXOR expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpSelfBitXor()), MVU($3)); }
             | expr TK_SELF_BOR expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpSelfBitOr()), MVU($3)); }
             | expr TK_SELF_BAND expr { $$ = new ast::BinaryOpExpr(MVU($1), UNEW(ast::OpSelfBitAnd()), MVU($3)); }
@@ -297,3 +316,43 @@ logic_expr  : expr TK_OR expr { $$ = new ast::LogicExpr(MVU($1), UNEW(ast::OpOr(
             | expr TK_GT expr { $$ = new ast::LogicExpr(MVU($1), UNEW(ast::OpGt()), MVU($3)); }
             ;
 %%
+
+namespace parser {
+
+static utils::Uptr<ast::Module> ParseFile(FILE *in, const std::string &filename,
+                                          int file_idx) {
+    auto ctx = Context(filename, file_idx);
+    yyscan_t scanner;
+    yylex_init_extra(&ctx, &scanner);
+    yyset_in(in, scanner);
+    auto ret = yyparse(scanner, &ctx);
+    yylex_destroy(scanner);
+
+    return ret == 0 ? std::move(ctx.module) : nullptr;
+}
+
+utils::Uptr<ast::Module> Parse(const std::string &filename, int file_idx) {
+    auto in = fopen(filename.c_str(), "r");
+    if (in == nullptr) {
+        utils::Logger::GetLogger("parser")->Error(
+            {"file \"" + filename + "\"", "cannot be opened"});
+        return nullptr;
+    }
+    auto res = ParseFile(in, filename, file_idx);
+    fclose(in);
+    return res;
+}
+
+utils::Uptr<ast::Module> ParseString(const std::string &source,
+                                     const std::string &filename,
+                                     int file_idx) {
+    // fmemopen() refuses empty buffers
+    if (source.empty()) return std::make_unique<ast::Module>(filename);
+    auto in = fmemopen(const_cast<char *>(source.data()), source.size(), "r");
+    if (in == nullptr) return nullptr;
+    auto res = ParseFile(in, filename, file_idx);
+    fclose(in);
+    return res;
+}
+
+}  // namespace parser
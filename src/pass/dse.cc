@@ -0,0 +1,657 @@
+#include "./dse.hpp"
+
+#include <cmath>
+#include <cstdint>
+
+#include "./fold.hpp"
+
+namespace pass {
+
+static bool IsAssign(const std::string &op) {
+  return op == "__assign__" || op.rfind("__self_", 0) == 0;
+}
+
+static bool IsNumber(const std::string &type) {
+  return type == "Int" || type == "Float";
+}
+
+// An Int literal from lo to hi
+static bool IsIntIn(const ast::Expression *expr, int64_t lo, int64_t hi) {
+  auto constant = Constant();
+  if (!ToConstant(expr, &constant) || constant.is_float) return false;
+  auto i = static_cast<int64_t>(constant.i);
+  return i >= lo && i <= hi;
+}
+
+// The builtin id expr names, or ""
+static std::string BuiltinOf(const ast::Expression *expr) {
+  auto name = dynamic_cast<const ast::Name *>(expr);
+  return name != nullptr && name->parent == nullptr &&
+                 name->binding.kind == ast::Binding::kBuiltin
+             ? *name->id
+             : "";
+}
+
+// The locals of a frame and the types of their ObjCreates, see FindTypes
+class KnownTypes final : public ast::Walker {
+ public:
+  SlotTypes types;
+  std::set<int> untyped;
+  std::vector<std::pair<int, const ast::Expression *>> self_sets;
+
+ private:
+  static int SlotOf(const ast::Expression *expr) {
+    auto name = dynamic_cast<const ast::Name *>(expr);
+    return name != nullptr && name->parent == nullptr &&
+                   name->binding.kind == ast::Binding::kLocal &&
+                   name->binding.depth == 0
+               ? name->binding.slot
+               : -1;
+  }
+
+ public:
+  virtual void Visit(ast::ObjCreate *create) override {
+    auto slot = create->binding.slot;
+    auto id = BuiltinOf(create->call_expr->obj.get());
+    auto type = id == "Int8" ? "Int" : id;
+    if (type != "Int" && type != "Float" && type != "String" &&
+        type != "Array" && type != "Memory") {
+      untyped.insert(slot);
+    } else if (!types.emplace(slot, type).second && types[slot] != type) {
+      untyped.insert(slot);
+    }
+    ast::Walker::Visit(create);
+  }
+  virtual void Visit(ast::BinaryOpExpr *expr) override {
+    auto slot = SlotOf(expr->left.get());
+    auto op = std::string(expr->op->GetName());
+    if (slot >= 0 && op == "__assign__") untyped.insert(slot);
+    if (slot >= 0 && op != "__assign__" && IsAssign(op)) {
+      self_sets.push_back({slot, expr->right.get()});
+    }
+    ast::Walker::Visit(expr);
+  }
+  // Other frames
+  virtual void Visit(ast::Function *) override {}
+  virtual void Visit(ast::Assemble *) override {}
+  virtual void Visit(ast::Struct *) override {}
+  virtual void Visit(ast::Class *) override {}
+  virtual void Visit(ast::Import *) override {}
+};
+
+SlotTypes FindTypes(ast::Block *body, const std::set<int> &captured) {
+  auto known = KnownTypes();
+  known.Walk(body);
+  auto &types = known.types;
+  for (auto it = types.begin(); it != types.end();) {
+    if (known.untyped.count(it->first) || captured.count(it->first)) {
+      it = types.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // x op= y gives a Float or raises for a Float x, a String or raises for a
+  // String x, and raises for an Array or Memory x. An Int x stays one if y
+  // is an Int, which may depend on another such x.
+  for (auto changed = true; changed;) {
+    changed = false;
+    for (const auto &[slot, value] : known.self_sets) {
+      auto type = types.find(slot);
+      if (type != types.end() && type->second == "Int" &&
+          SafeType(value, types) != "Int") {
+        types.erase(type);
+        changed = true;
+      }
+    }
+  }
+  return std::move(types);
+}
+
+std::string SafeType(const ast::Expression *expr, const SlotTypes &types) {
+  if (expr == nullptr) return "?";
+  if (auto literal = dynamic_cast<const ast::Literal *>(expr)) {
+    return literal->type->GetName();
+  }
+  if (auto name = dynamic_cast<const ast::Name *>(expr)) {
+    // e.g. o.x, which o may not have
+    if (name->parent != nullptr) return "";
+    const auto &binding = name->binding;
+    auto type = types.end();
+    if (binding.kind == ast::Binding::kLocal && binding.depth == 0) {
+      type = types.find(binding.slot);
+    }
+    return type == types.end() ? "?" : type->second;
+  }
+  if (auto unary = dynamic_cast<const ast::UnaryOpExpr *>(expr)) {
+    // Neither *p nor &x, which raise on numbers
+    auto op = std::string(unary->op->GetName());
+    auto right = SafeType(unary->right.get(), types);
+    if (right.empty()) return "";
+    if (op == "__not__") return "Int";
+    if (op == "__negative__" || op == "__positive__") {
+      return IsNumber(right) ? right : "";
+    }
+    return op == "__bit_not__" && right == "Int" ? "Int" : "";
+  }
+  if (auto binary = dynamic_cast<const ast::BinaryOpExpr *>(expr)) {
+    auto op = std::string(binary->op->GetName());
+    auto left = SafeType(binary->left.get(), types);
+    auto right = SafeType(binary->right.get(), types);
+    if (IsAssign(op)) return "";
+    if (op == "__plus__" && left == "String" && right == "String") {
+      return "String";
+    }
+    if (!IsNumber(left) || !IsNumber(right)) return "";
+    auto is_float = left == "Float" || right == "Float";
+    if (op == "__plus__" || op == "__minus__" || op == "__mul__") {
+      return is_float ? "Float" : "Int";
+    }
+    // Only Ints divide by 0, and only Ints are bitwise
+    auto by = binary->right.get();
+    if (op == "__div__" || op == "__mod__") {
+      auto nonzero = IsIntIn(by, INT64_MIN, -1) || IsIntIn(by, 1, INT64_MAX);
+      return is_float ? "Float" : nonzero ? "Int" : "";
+    }
+    if (is_float) return "";
+    if (op == "__bit_and__" || op == "__bit_or__" || op == "__bit_xor__") {
+      return "Int";
+    }
+    if (op == "__shift_left__" || op == "__shift_right__") {
+      return IsIntIn(by, 0, 63) ? "Int" : "";
+    }
+    return "";
+  }
+  if (auto logic = dynamic_cast<const ast::LogicExpr *>(expr)) {
+    // Anything is equal or not, only numbers and Strings are ordered
+    auto op = std::string(logic->op->GetName());
+    auto left = SafeType(logic->left.get(), types);
+    auto right = SafeType(logic->right.get(), types);
+    if (left.empty() || right.empty()) return "";
+    if (op == "__and__" || op == "__or__" || op == "__eq__" ||
+        op == "__ne__") {
+      return "Int";
+    }
+    auto ordered = (IsNumber(left) && IsNumber(right)) ||
+                   (left == "String" && right == "String");
+    return ordered ? "Int" : "";
+  }
+  if (auto if_else = dynamic_cast<const ast::IfElseExpr *>(expr)) {
+    auto left = SafeType(if_else->left.get(), types);
+    auto right = SafeType(if_else->right.get(), types);
+    if (SafeType(if_else->test.get(), types).empty() || left.empty() ||
+        right.empty()) {
+      return "";
+    }
+    return left == right ? left : "?";
+  }
+  if (auto call = dynamic_cast<const ast::CallExpr *>(expr)) {
+    auto callee = dynamic_cast<const ast::Name *>(call->obj.get());
+    if (callee == nullptr || !call->op->keywords.empty()) return "";
+    auto args = std::vector<const ast::Expression *>();
+    auto arg_types = std::vector<std::string>();
+    for (const auto &x : call->op->unameds) {
+      args.push_back(x.get());
+      arg_types.push_back(SafeType(x.get(), types));
+      if (arg_types.back().empty()) return "";
+    }
+    // e.g. s.length() of a String, Array or Memory
+    if (callee->parent != nullptr) {
+      auto type = SafeType(callee->parent.get(), types);
+      return *callee->id == "length" && args.empty() &&
+                     (type == "String" || type == "Array" || type == "Memory")
+                 ? "Int"
+                 : "";
+    }
+
+    // The pure builtins, with the args they take. Int of a Float out of its
+    // range raises, and Array(T, n) calls T() for its elements.
+    auto id = BuiltinOf(callee);
+    auto argc = args.size();
+    auto constant = Constant();
+    if (id == "Int" || id == "Int8") {
+      auto fits = argc == 0 || arg_types[0] == "Int" ||
+                  (ToConstant(args[0], &constant) &&
+                   constant.is_float && std::fabs(constant.f) < 9.2e18);
+      return argc <= 1 && fits ? "Int" : "";
+    }
+    if (id == "Float") {
+      return argc == 0 || (argc == 1 && IsNumber(arg_types[0])) ? "Float" : "";
+    }
+    if (id == "String") return argc <= 1 ? "String" : "";
+    if (id == "Auto") return argc == 0 ? "?" : argc == 1 ? arg_types[0] : "";
+    if (id == "Void" || id == "VOID" || id == "Ptr") return "?";
+    if (id == "Array") {
+      if (argc < 2) return "Array";
+      auto elem = BuiltinOf(args[0]);
+      auto safe = elem == "Int" || elem == "Int8" || elem == "Float" ||
+                  elem == "String" || elem == "Array" || elem == "Auto";
+      return argc == 2 && safe && IsIntIn(args[1], 0, INT64_MAX)
+                 ? "Array"
+                 : "";
+    }
+    if (id == "Memory") {
+      auto elem = argc == 2 ? BuiltinOf(args[0]) : "";
+      return (elem == "Int8" || elem == "Int" || elem == "Float") &&
+                     IsIntIn(args[1], 0, INT64_MAX)
+                 ? "Memory"
+                 : "";
+    }
+    return "";
+  }
+  // e.g. a[i] may raise
+  return "";
+}
+
+bool IsPure(const ast::Expression *expr, const SlotTypes &types) {
+  return !SafeType(expr, types).empty();
+}
+
+// The locals of the frame used by an expression, one entry per Name
+class Uses final : public ast::Walker {
+ public:
+  std::vector<int> slots;
+
+  virtual void Visit(ast::Name *name) override {
+    if (name->parent != nullptr) return Walk(name->parent.get());
+    if (name->binding.kind == ast::Binding::kLocal &&
+        name->binding.depth == 0) {
+      slots.push_back(name->binding.slot);
+    }
+  }
+};
+
+// Every Function and Assemble, how many Names use each local of a frame, and
+// the locals used by the Creates nested in it or taken by &. The frames are
+// the same as the ones of pass::Resolver.
+class Frames final : public ast::Walker {
+ public:
+  struct Callable {
+    ast::Create *create;
+    std::string name;  // e.g. Name.__Create__
+    ast::Block *body;
+  };
+  std::vector<Callable> callables;
+  std::unordered_map<const ast::Create *, std::set<int>> captured;
+  std::unordered_map<const ast::Create *, std::unordered_map<int, int>> uses;
+
+ private:
+  std::vector<ast::Create *> _frames;
+  std::vector<std::string> _path;
+
+  void Enter(ast::Create *create) {
+    _frames.push_back(create);
+    _path.push_back(*create->GetId());
+  }
+
+  void Leave() {
+    _frames.pop_back();
+    _path.pop_back();
+  }
+
+  void VisitCallable(ast::Create *callable, ast::CallOperator *args,
+                     ast::Block *body) {
+    // Types and defaults belong to the outer frame
+    if (!args->unameds.empty()) Walk(args->unameds.front().get());
+    for (const auto &x : args->keywords) Walk(std::get<1>(x).get());
+    Enter(callable);
+    auto name = std::string();
+    for (const auto &id : _path) name += (name.empty() ? "" : ".") + id;
+    callables.push_back({callable, name, body});
+    Walk(body);
+    Leave();
+  }
+
+ public:
+  virtual void Visit(ast::Function *func) override {
+    VisitCallable(func, func->args.get(), func->body.get());
+  }
+  virtual void Visit(ast::Assemble *assemble) override {
+    VisitCallable(assemble, assemble->args.get(), assemble->body.get());
+  }
+  virtual void Visit(ast::Struct *struct_create) override {
+    Enter(struct_create);
+    Walk(struct_create->body.get());
+    Leave();
+  }
+  virtual void Visit(ast::Class *class_create) override {
+    Walk(class_create->parents.get());
+    Enter(class_create);
+    Walk(class_create->body.get());
+    Leave();
+  }
+  virtual void Visit(ast::Import *) override {}
+
+  virtual void Visit(ast::Name *name) override {
+    if (name->parent != nullptr) return Walk(name->parent.get());
+    const auto &binding = name->binding;
+    if (binding.kind != ast::Binding::kLocal || _frames.empty()) return;
+    if (binding.depth == 0) {
+      ++uses[_frames.back()][binding.slot];
+      return;
+    }
+    auto idx = static_cast<int>(_frames.size()) - 1 - binding.depth;
+    if (idx >= 0) captured[_frames[idx]].insert(binding.slot);
+  }
+
+  // e.g. &x, its value may change or be read through the pointer
+  virtual void Visit(ast::UnaryOpExpr *expr) override {
+    auto name = dynamic_cast<ast::Name *>(expr->right.get());
+    if (std::string(expr->op->GetName()) == "__ref__" && name != nullptr &&
+        name->parent == nullptr && !_frames.empty() &&
+        name->binding.kind == ast::Binding::kLocal) {
+      auto idx = static_cast<int>(_frames.size()) - 1 - name->binding.depth;
+      if (idx >= 0) captured[_frames[idx]].insert(name->binding.slot);
+    }
+    ast::Walker::Visit(expr);
+  }
+};
+
+std::unordered_map<const ast::Create *, std::set<int>> FindCaptured(
+    ast::Module *module) {
+  auto frames = Frames();
+  frames.Walk(module);
+  return std::move(frames.captured);
+}
+
+Elimination DeadStoreEliminator::operator()(ast::Module *module) {
+  auto res = Elimination();
+  _res = &res;
+  auto frames = Frames();
+  frames.Walk(module);
+  _captured = std::move(frames.captured);
+  _uses = std::move(frames.uses);
+
+  for (const auto &callable : frames.callables) {
+    _where = module->filename + ": " + callable.name;
+    _frame_captured = &_captured[callable.create];
+    _frame_types = FindTypes(callable.body, *_frame_captured);
+    _frame_uses = &_uses[callable.create];
+    _live.clear();
+    _rewrite = true;
+    _loops.clear();
+    _dispatches.clear();
+    Walk(callable.body);
+  }
+  return res;
+}
+
+bool DeadStoreEliminator::IsDead(const ast::Binding &binding) const {
+  return _rewrite && binding.kind == ast::Binding::kLocal &&
+         binding.depth == 0 && !_live.count(binding.slot) &&
+         !_frame_captured->count(binding.slot);
+}
+
+void DeadStoreEliminator::Define(const ast::Binding &binding) {
+  if (binding.kind == ast::Binding::kLocal && binding.depth == 0) {
+    _live.erase(binding.slot);
+  }
+}
+
+void DeadStoreEliminator::Unuse(ast::Node *node) {
+  auto uses = Uses();
+  uses.Walk(node);
+  for (auto slot : uses.slots) --(*_frame_uses)[slot];
+}
+
+void DeadStoreEliminator::Remark(const std::string &message) {
+  _res->remarks.push_back({"dse", _where, message});
+}
+
+// The statements are visited backwards, each one turns the live after it into
+// the live before it
+void DeadStoreEliminator::Visit(ast::Block *block) {
+  auto &stmts = block->statements;
+  for (auto it = stmts.end(); it != stmts.begin();) {
+    --it;
+    Walk(it->get());
+    if (_replace != nullptr) *it = std::move(_replace);
+    if (_drop) it = stmts.erase(it);
+    _drop = false;
+    // Any statement in a try may raise to its excepts
+    if (!_dispatches.empty()) {
+      _live.insert(_dispatches.back().begin(), _dispatches.back().end());
+    }
+  }
+}
+
+// e.g. x = f() where x is not read before it is set again. x += 1 may call a
+// method of x and is kept.
+void DeadStoreEliminator::Visit(ast::ExprStatement *stmt) {
+  auto expr = dynamic_cast<ast::BinaryOpExpr *>(stmt->expr.get());
+  auto target = expr == nullptr
+                    ? nullptr
+                    : dynamic_cast<ast::Name *>(expr->left.get());
+  if (target == nullptr || target->parent != nullptr ||
+      std::string(expr->op->GetName()) != "__assign__" ||
+      !IsDead(target->binding)) {
+    return Walk(stmt->expr.get());
+  }
+
+  ++_res->stores;
+  if (IsPure(expr->right.get(), _frame_types)) {
+    Remark("dead store to " + *target->id + " removed");
+    Unuse(stmt);
+    _drop = true;
+    return;
+  }
+  Remark("dead store to " + *target->id + " removed, its value is kept");
+  Unuse(target);
+  stmt->expr = std::move(expr->right);
+  Walk(stmt->expr.get());
+}
+
+void DeadStoreEliminator::Visit(ast::Break *) {
+  if (!_loops.empty()) _live = *_loops.back().exit;
+}
+
+void DeadStoreEliminator::Visit(ast::Continue *) {
+  if (!_loops.empty()) _live = *_loops.back().next;
+}
+
+void DeadStoreEliminator::Visit(ast::Return *ret) {
+  _live.clear();
+  Walk(ret->expr.get());
+}
+
+void DeadStoreEliminator::Visit(ast::Raise *raise) {
+  _live.clear();
+  Walk(raise->error.get());
+}
+
+void DeadStoreEliminator::Visit(ast::If *if_stmt) {
+  auto out = _live;
+  Walk(if_stmt->body.get());
+  auto body = std::move(_live);
+  _live = std::move(out);
+  Walk(if_stmt->orelse.get());
+  _live.insert(body.begin(), body.end());
+  Walk(if_stmt->test.get());
+}
+
+// The live at the test is the least fixed point of
+//   test <- body(next: test, exit: out) | orelse(out)
+// found before anything in the body is removed
+void DeadStoreEliminator::Visit(ast::While *while_stmt) {
+  auto out = _live;
+  Walk(while_stmt->orelse.get());
+  auto orelse = std::move(_live);
+
+  auto rewrite = _rewrite;
+  auto head = Live();
+  auto pass = [&]() {
+    _loops.push_back({&head, &out});
+    _live = head;
+    Walk(while_stmt->body.get());
+    _loops.pop_back();
+    _live.insert(orelse.begin(), orelse.end());
+    Walk(while_stmt->test.get());
+  };
+
+  _rewrite = false;
+  for (;;) {
+    pass();
+    _live.insert(head.begin(), head.end());
+    if (_live == head) break;
+    head = std::move(_live);
+  }
+  _rewrite = rewrite;
+  if (_rewrite) pass();
+  _live = std::move(head);
+}
+
+// The id must not be used anywhere else in the frame, e.g. x := Int(0) is
+// still needed by a later x = 1
+void DeadStoreEliminator::Visit(ast::ObjCreate *create) {
+  if (!IsDead(create->binding) || (*_frame_uses)[create->binding.slot] > 0) {
+    Define(create->binding);
+    return Walk(create->call_expr.get());
+  }
+
+  auto call = create->call_expr.get();
+  if (IsPure(call, _frame_types)) {
+    ++_res->objects;
+    Remark("unused object " + *create->id + " removed");
+    Unuse(call);
+    _drop = true;
+    return;
+  }
+  // e.g. res := f(), f is still called
+  ++_res->calls;
+  Remark("unused object " + *create->id + " removed, its call is kept");
+  _replace = std::make_unique<ast::ExprStatement>(std::move(create->call_expr));
+  Walk(call);
+}
+
+// The body is another frame, only its type and defaults are evaluated here
+void DeadStoreEliminator::VisitCreate(ast::Create *create) {
+  Define(create->binding);
+}
+
+void DeadStoreEliminator::Visit(ast::Function *func) {
+  VisitCreate(func);
+  for (const auto &x : func->args->keywords) Walk(std::get<1>(x).get());
+  if (!func->args->unameds.empty()) Walk(func->args->unameds.front().get());
+}
+
+void DeadStoreEliminator::Visit(ast::Assemble *assemble) {
+  VisitCreate(assemble);
+  for (const auto &x : assemble->args->keywords) Walk(std::get<1>(x).get());
+  if (!assemble->args->unameds.empty()) {
+    Walk(assemble->args->unameds.front().get());
+  }
+}
+
+void DeadStoreEliminator::Visit(ast::Struct *struct_create) {
+  VisitCreate(struct_create);
+}
+
+void DeadStoreEliminator::Visit(ast::Class *class_create) {
+  VisitCreate(class_create);
+  Walk(class_create->parents.get());
+}
+
+void DeadStoreEliminator::Visit(ast::Import *import) { VisitCreate(import); }
+
+// The excepts run with what was live at the statement which raised, and an
+// error no except matches goes on to the excepts of the outer try
+void DeadStoreEliminator::Visit(ast::Try *try_stmt) {
+  auto out = _live;
+  auto dispatch = _dispatches.empty() ? Live() : _dispatches.back();
+  auto alias = try_stmt->alias_slots.begin();
+  for (const auto &x : try_stmt->excepts) {
+    _live = out;
+    Walk(std::get<2>(x).get());
+    if (alias != try_stmt->alias_slots.end()) _live.erase(*alias++);
+    dispatch.insert(_live.begin(), _live.end());
+  }
+  _live = std::move(dispatch);
+  for (auto it = try_stmt->excepts.rbegin(); it != try_stmt->excepts.rend();
+       ++it) {
+    Walk(std::get<1>(*it).get());
+  }
+  dispatch = std::move(_live);
+
+  _live = std::move(out);
+  Walk(try_stmt->orelse.get());
+  _dispatches.push_back(dispatch);
+  Walk(try_stmt->body.get());
+  _dispatches.pop_back();
+  _live.insert(dispatch.begin(), dispatch.end());
+}
+
+void DeadStoreEliminator::Visit(ast::Name *name) {
+  if (name->parent != nullptr) return Walk(name->parent.get());
+  const auto &binding = name->binding;
+  if (binding.kind == ast::Binding::kLocal && binding.depth == 0) {
+    _live.insert(binding.slot);
+  }
+}
+
+void DeadStoreEliminator::Visit(ast::UnaryOpExpr *expr) {
+  Walk(expr->right.get());
+}
+
+// Backwards: the store, then the value, then the target
+void DeadStoreEliminator::Visit(ast::BinaryOpExpr *expr) {
+  auto op = std::string(expr->op->GetName());
+  auto target = dynamic_cast<ast::Name *>(expr->left.get());
+  if (op == "__assign__" && target != nullptr && target->parent == nullptr) {
+    Define(target->binding);
+    return Walk(expr->right.get());
+  }
+  Walk(expr->right.get());
+  Walk(expr->left.get());
+}
+
+// The right side may not run, e.g. a && (x = 1)
+void DeadStoreEliminator::Visit(ast::LogicExpr *expr) {
+  auto op = std::string(expr->op->GetName());
+  if (op != "__and__" && op != "__or__") {
+    Walk(expr->right.get());
+    return Walk(expr->left.get());
+  }
+  auto out = _live;
+  Walk(expr->right.get());
+  _live.insert(out.begin(), out.end());
+  Walk(expr->left.get());
+}
+
+void DeadStoreEliminator::Visit(ast::IfElseExpr *expr) {
+  auto out = _live;
+  Walk(expr->left.get());
+  auto left = std::move(_live);
+  _live = std::move(out);
+  Walk(expr->right.get());
+  _live.insert(left.begin(), left.end());
+  Walk(expr->test.get());
+}
+
+void DeadStoreEliminator::Visit(ast::CallExpr *expr) {
+  Walk(expr->op.get());
+  Walk(expr->obj.get());
+}
+
+void DeadStoreEliminator::Visit(ast::SubscriptExpr *expr) {
+  Walk(expr->op.get());
+  Walk(expr->obj.get());
+}
+
+void DeadStoreEliminator::Visit(ast::CallOperator *cop) {
+  for (auto it = cop->keywords.rbegin(); it != cop->keywords.rend(); ++it) {
+    Walk(std::get<1>(*it).get());
+  }
+  for (auto it = cop->unameds.rbegin(); it != cop->unameds.rend(); ++it) {
+    Walk(it->get());
+  }
+}
+
+void DeadStoreEliminator::Visit(ast::SubscriptOperator *sop) {
+  for (auto it = sop->dims.rbegin(); it != sop->dims.rend(); ++it) {
+    Walk(std::get<2>(**it).get());
+    Walk(std::get<1>(**it).get());
+    Walk(std::get<0>(**it).get());
+  }
+}
+
+}  // namespace pass
@@ -0,0 +1,111 @@
+#ifndef _XULANG_SRC_PASS_DSE_HPP
+#define _XULANG_SRC_PASS_DSE_HPP
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/walker.hpp"
+#include "./pass.hpp"
+
+namespace pass {
+
+// The builtin type a local of a frame holds once it is created, e.g. Int for
+// x := Int8(n). None for a param, as the args of a call are bound as they
+// are, nor for a local set by =, one a self assignment may give another type,
+// or one in captured, see FindCaptured.
+using SlotTypes = std::unordered_map<int, std::string>;
+SlotTypes FindTypes(ast::Block *body, const std::set<int> &captured);
+
+// The type of what expr gives, "" if it may raise or has a side effect and
+// "?" if neither but its type is not known. Operators only raise on operands
+// of the wrong types, and /, %, << and >> on some values too.
+std::string SafeType(const ast::Expression *expr, const SlotTypes &types);
+
+// No side effect and it cannot raise, so it may be removed or moved if its
+// value is not needed, see SafeType
+bool IsPure(const ast::Expression *expr, const SlotTypes &types);
+
+// The locals of each frame which are used by the Creates nested in it or
+// taken by &, any call may read or change them
+std::unordered_map<const ast::Create *, std::set<int>> FindCaptured(
+    ast::Module *module);
+
+struct Elimination {
+  int stores = 0;   // assignments removed
+  int objects = 0;  // ObjCreates removed
+  int calls = 0;    // ObjCreates whose call is kept as a statement
+  Remarks remarks;
+};
+
+// Backward liveness of the locals of every Function and Assemble, after
+// pass::Resolver. An assignment statement whose value is never read is
+// removed, and so is an ObjCreate whose id is not used at all, keeping the
+// calls with side effects. Locals used by nested Creates or taken by & are
+// always live.
+class DeadStoreEliminator final : private ast::Walker {
+ private:
+  using Live = std::set<int>;  // slots of the frame
+
+  struct Loop {
+    const Live *next;  // live at continue
+    const Live *exit;  // live at break
+  };
+
+  std::string _where;
+  Elimination *_res;
+  std::unordered_map<const ast::Create *, Live> _captured;
+  std::unordered_map<const ast::Create *, std::unordered_map<int, int>> _uses;
+  const Live *_frame_captured;
+  SlotTypes _frame_types;
+  std::unordered_map<int, int> *_frame_uses;  // Names using each slot
+  Live _live;
+  bool _rewrite;
+  std::vector<Loop> _loops;
+  std::vector<Live> _dispatches;  // live where the enclosing trys catch
+
+  // Set by the Visit() of a statement, consumed by its Block
+  bool _drop = false;
+  utils::Uptr<ast::Statement> _replace;
+
+  bool IsDead(const ast::Binding &binding) const;
+  void Define(const ast::Binding &binding);
+  void Unuse(ast::Node *node);  // before removing it
+  void Remark(const std::string &message);
+  void VisitCreate(ast::Create *create);
+
+ public:
+  Elimination operator()(ast::Module *module);
+
+ private:
+  virtual void Visit(ast::Block *) override;
+  virtual void Visit(ast::ExprStatement *) override;
+  virtual void Visit(ast::Break *) override;
+  virtual void Visit(ast::Continue *) override;
+  virtual void Visit(ast::Return *) override;
+  virtual void Visit(ast::If *) override;
+  virtual void Visit(ast::While *) override;
+  virtual void Visit(ast::ObjCreate *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override;
+  virtual void Visit(ast::Raise *) override;
+  virtual void Visit(ast::Try *) override;
+
+  virtual void Visit(ast::Name *) override;
+  virtual void Visit(ast::UnaryOpExpr *) override;
+  virtual void Visit(ast::BinaryOpExpr *) override;
+  virtual void Visit(ast::LogicExpr *) override;
+  virtual void Visit(ast::IfElseExpr *) override;
+  virtual void Visit(ast::CallExpr *) override;
+  virtual void Visit(ast::SubscriptExpr *) override;
+  virtual void Visit(ast::CallOperator *) override;
+  virtual void Visit(ast::SubscriptOperator *) override;
+};
+
+}  // namespace pass
+
+#endif  // _XULANG_SRC_PASS_DSE_HPP
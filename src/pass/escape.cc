@@ -0,0 +1,494 @@
+#include "./escape.hpp"
+
+#include <algorithm>
+
+#include "../builtin/names.hpp"
+#include "./dse.hpp"
+
+namespace pass {
+
+using Escape = ast::CallExpr::Escape;
+
+// The slot of a local of the frame, or -1
+static int SlotOf(const ast::Expression *expr) {
+  auto name = dynamic_cast<const ast::Name *>(expr);
+  if (name == nullptr || name->parent != nullptr ||
+      name->binding.kind != ast::Binding::kLocal || name->binding.depth != 0) {
+    return -1;
+  }
+  return name->binding.slot;
+}
+
+static bool IsAssign(const std::string &op) {
+  return op == "__assign__" || op.rfind("__self_", 0) == 0;
+}
+
+// The builtin type a call makes, e.g. Array of Array(Int, 8), or nullptr.
+// Auto is not one, it may make anything.
+static const ast::Name *BuiltinType(const ast::Expression *expr) {
+  auto call = dynamic_cast<const ast::CallExpr *>(expr);
+  auto type = call ? dynamic_cast<const ast::Name *>(call->obj.get()) : nullptr;
+  if (type == nullptr || type->parent != nullptr ||
+      type->binding.kind != ast::Binding::kBuiltin ||
+      !builtin::kBuiltins[type->binding.slot].is_type || *type->id == "Auto") {
+    return nullptr;
+  }
+  return type;
+}
+
+// The object a member or an element is part of, e.g. a of a.b[i], or
+// nullptr when it is only pointed to, as p of p->b
+static ast::Expression *Base(ast::Expression *expr) {
+  while (true) {
+    if (auto name = dynamic_cast<ast::Name *>(expr)) {
+      if (name->parent == nullptr) return expr;
+      if (name->deref) return nullptr;
+      expr = name->parent.get();
+    } else if (auto sub = dynamic_cast<ast::SubscriptExpr *>(expr)) {
+      expr = sub->obj.get();
+    } else {
+      return expr;
+    }
+  }
+}
+
+// The locals of a frame only ever created by builtin types, whose methods
+// never keep their object
+class Typed final : public ast::Walker {
+ public:
+  std::set<int> slots;
+  std::set<int> others;
+
+  virtual void Visit(ast::ObjCreate *create) override {
+    if (create->binding.kind == ast::Binding::kLocal) {
+      (BuiltinType(create->call_expr.get()) ? slots : others)
+          .insert(create->binding.slot);
+    }
+    ast::Walker::Visit(create);
+  }
+  virtual void Visit(ast::Function *func) override { Nested(func); }
+  virtual void Visit(ast::Assemble *assemble) override { Nested(assemble); }
+  virtual void Visit(ast::Struct *struct_create) override {
+    Nested(struct_create);
+  }
+  virtual void Visit(ast::Class *class_create) override {
+    Nested(class_create);
+  }
+  virtual void Visit(ast::Import *import) override { Nested(import); }
+  virtual void Visit(ast::Try *try_stmt) override {
+    others.insert(try_stmt->alias_slots.begin(), try_stmt->alias_slots.end());
+    ast::Walker::Visit(try_stmt);
+  }
+
+ private:
+  void Nested(ast::Create *create) {
+    if (create->binding.kind == ast::Binding::kLocal) {
+      others.insert(create->binding.slot);
+    }
+  }
+};
+
+Escapes EscapeAnalyzer::operator()(ast::Module *module) {
+  auto res = Escapes();
+  _res = &res;
+  _where = module->filename;
+  _path.clear();
+  _captured = FindCaptured(module);
+
+  // Every param is assumed not to escape until a use says otherwise
+  _summaries.clear();
+  auto idx = 0;
+  for (const auto &obj : module->objs) {
+    auto func = dynamic_cast<ast::Function *>(obj.get());
+    if (func != nullptr) {
+      auto &summary = _summaries[idx];
+      const auto &unameds = func->args->unameds;
+      for (auto it = std::next(unameds.begin(), !unameds.empty());
+           it != unameds.end(); ++it) {
+        auto param = dynamic_cast<ast::Name *>(it->get());
+        summary.params.push_back(param ? *param->id : "");
+      }
+      for (const auto &x : func->args->keywords) {
+        summary.params.push_back(*std::get<0>(x));
+      }
+      summary.escapes.assign(summary.params.size(), Escape::kNoEscape);
+    }
+    ++idx;
+  }
+
+  // The escapes only grow, so this ends
+  auto walk = [&] {
+    _changed = false;
+    _frames.clear();
+    _frames.push_back({nullptr, true});
+    for (const auto &obj : module->objs) Walk(obj.get());
+    for (auto call : _frames.back().calls) call->escape = Escape::kStored;
+  };
+  _final = false;
+  do {
+    walk();
+  } while (_changed);
+  _final = true;
+  walk();
+  return res;
+}
+
+EscapeAnalyzer::Sources EscapeAnalyzer::Eval(ast::Expression *expr) {
+  _sources.clear();
+  if (expr != nullptr) Walk(expr);
+  return std::move(_sources);
+}
+
+int EscapeAnalyzer::Node(ast::CallExpr *call) {
+  auto &frame = _frames.back();
+  auto found = frame.nodes.find(call);
+  if (found != frame.nodes.end()) return found->second;
+  auto node = -1 - static_cast<int>(frame.calls.size());
+  frame.calls.push_back(call);
+  frame.nodes[call] = node;
+  return node;
+}
+
+void EscapeAnalyzer::Flow(const Sources &from, int slot) {
+  auto &frame = _frames.back();
+  for (auto node : from) {
+    if (node != slot) frame.flows[node].insert(slot);
+  }
+}
+
+// The objects are set as a member or an element of the target, or of
+// whatever it is
+void EscapeAnalyzer::Keep(ast::Expression *target, const Sources &from) {
+  auto base = Base(target);
+  auto slot = SlotOf(base);
+  if (slot >= 0 && !_frames.back().members) return Flow(from, slot);
+  Sink(from, Escape::kStored);
+}
+
+void EscapeAnalyzer::Sink(const Sources &from, Escape escape) {
+  auto &sinks = _frames.back().sinks;
+  for (auto node : from) {
+    auto &sink = sinks.try_emplace(node, Escape::kNoEscape).first->second;
+    sink = std::max(sink, escape);
+  }
+}
+
+// The args of a call escape the way the callee uses them, the ones a
+// Function of the module may return are added to res
+void EscapeAnalyzer::Pass(ast::CallExpr *call, Sources *res) {
+  const auto &frame = _frames.back();
+  auto callee = dynamic_cast<ast::Name *>(call->obj.get());
+  auto escapes = std::vector<Escape>();  // by arg, unameds first
+  auto nargs = call->op->unameds.size() + call->op->keywords.size();
+  auto kept = Escape::kStored;
+  ast::Expression *into = nullptr;  // where the args of stores are set
+  auto stores = std::vector<bool>();
+
+  if (callee != nullptr && callee->parent == nullptr &&
+      callee->binding.kind == ast::Binding::kBuiltin) {
+    // Auto(x) is x, Fill(a, v, lo, hi) and Copy(a, b, lo, hi) set v or the
+    // elements of b in a
+    kept = Escape::kNoEscape;
+    const auto &args = call->op->unameds;
+    if (*callee->id == "Auto") {
+      escapes.push_back(Escape::kReturned);
+    } else if ((*callee->id == "Fill" || *callee->id == "Copy") &&
+               args.size() >= 2) {
+      into = args.front().get();
+      stores = {false, true};
+    }
+  } else if (callee != nullptr && callee->parent != nullptr) {
+    // The object of a method of a builtin type stays where it is
+    auto receiver = Eval(callee->parent.get());
+    auto slot = SlotOf(callee->parent.get());
+    if (builtin::IsPureMethod(*callee->id)) {
+      kept = Escape::kNoEscape;
+    } else if (slot < 0 || !frame.typed.count(slot)) {
+      Sink(receiver, Escape::kStored);
+    } else {
+      // e.g. a.push_back(x) sets x in a
+      kept = Escape::kNoEscape;
+      res->insert(receiver.begin(), receiver.end());  // may be a part of it
+      into = callee->parent.get();
+      stores.assign(nargs, true);
+    }
+  } else if (callee != nullptr && callee->parent == nullptr &&
+             callee->binding.kind == ast::Binding::kGlobal &&
+             _summaries.count(callee->binding.slot)) {
+    // Positional args first, then the keywords by id
+    const auto &summary = _summaries.at(callee->binding.slot);
+    if (call->op->unameds.size() <= summary.params.size()) {
+      escapes.assign(summary.escapes.begin(),
+                     summary.escapes.begin() + call->op->unameds.size());
+      for (const auto &x : call->op->keywords) {
+        auto param = std::find(summary.params.begin(), summary.params.end(),
+                               *std::get<0>(x));
+        escapes.push_back(param == summary.params.end()
+                              ? Escape::kStored
+                              : summary.escapes[param - summary.params.begin()]);
+      }
+    }
+  } else {
+    Eval(call->obj.get());
+  }
+  escapes.resize(nargs, kept);
+  stores.resize(nargs, false);
+
+  size_t idx = 0;
+  auto pass = [&](ast::Expression *arg) {
+    auto from = Eval(arg);
+    if (stores[idx]) Keep(into, from);
+    auto escape = escapes[idx++];
+    if (escape == Escape::kReturned) {
+      res->insert(from.begin(), from.end());
+    } else if (escape == Escape::kStored) {
+      Sink(from, escape);
+    }
+  };
+  for (const auto &x : call->op->unameds) pass(x.get());
+  for (const auto &x : call->op->keywords) pass(std::get<1>(x).get());
+}
+
+void EscapeAnalyzer::VisitFrame(ast::Create *owner, ast::CallOperator *args,
+                                ast::Block *body, bool members) {
+  auto frame = Frame{owner, members};
+  auto typed = Typed();
+  typed.Walk(body);
+  auto nparams = 0;
+  if (args != nullptr) {
+    // The params come first, e.g. n:=Int() of Function(Int, a, n:=Int())
+    nparams = args->unameds.empty() ? 0 : args->unameds.size() - 1;
+    for (const auto &x : args->keywords) {
+      (BuiltinType(std::get<1>(x).get()) ? typed.slots : typed.others)
+          .insert(nparams++);
+    }
+  }
+  for (auto slot : typed.slots) {
+    if (!typed.others.count(slot)) frame.typed.insert(slot);
+  }
+  for (auto slot : _captured[owner]) frame.sinks[slot] = Escape::kStored;
+
+  _frames.push_back(std::move(frame));
+  _path.push_back(*owner->GetId());
+  Walk(body);
+
+  // Each node escapes as far as the nodes its objects go to
+  auto &done = _frames.back();
+  auto escapes = done.sinks;
+  auto raised = done.raised;
+  for (auto changed = true; changed;) {
+    changed = false;
+    for (const auto &[node, targets] : done.flows) {
+      auto &escape = escapes.try_emplace(node, Escape::kNoEscape).first->second;
+      for (auto target : targets) {
+        auto found = escapes.find(target);
+        if (found != escapes.end() && found->second > escape) {
+          escape = found->second;
+          changed = true;
+        }
+        if (raised.count(target) && raised.insert(node).second) changed = true;
+      }
+    }
+  }
+  auto escape_of = [&](int node) {
+    auto found = escapes.find(node);
+    return found == escapes.end() ? Escape::kNoEscape : found->second;
+  };
+
+  // A param raised may be caught and kept by the caller
+  auto summary = _summaries.end();
+  if (_frames.size() == 2 && owner->binding.kind == ast::Binding::kGlobal) {
+    summary = _summaries.find(owner->binding.slot);
+  }
+  if (summary != _summaries.end()) {
+    auto &params = summary->second.escapes;
+    for (int k = 0; k < static_cast<int>(params.size()); ++k) {
+      auto escape = raised.count(k) ? Escape::kStored : escape_of(k);
+      if (escape > params[k]) {
+        params[k] = escape;
+        _changed = true;
+      }
+    }
+  }
+
+  // A default is the object of its param
+  if (args != nullptr) {
+    int k = args->unameds.empty() ? 0 : args->unameds.size() - 1;
+    for (const auto &x : args->keywords) {
+      auto call = dynamic_cast<ast::CallExpr *>(std::get<1>(x).get());
+      if (call != nullptr) call->escape = escape_of(k);
+      ++k;
+    }
+  }
+
+  auto objects = 0, no_escape = 0;
+  for (auto call : done.calls) {
+    call->escape = members ? Escape::kStored : escape_of(done.nodes[call]);
+    if (!_final || members) continue;
+    ++objects;
+    if (call->escape == Escape::kNoEscape) {
+      ++no_escape;
+      auto type = BuiltinType(call);
+      if (type != nullptr &&
+          (*type->id == "Int" || *type->id == "Int8" || *type->id == "Float")) {
+        ++_res->scalars;
+      }
+    } else if (call->escape == Escape::kReturned) {
+      ++_res->returned;
+    } else {
+      ++_res->stored;
+    }
+  }
+  if (_final && !members && objects > 0) {
+    Remark(std::to_string(no_escape) + " of " + std::to_string(objects) +
+           " objects do not escape (" +
+           std::to_string(no_escape * 100 / objects) + "%)");
+  }
+  _res->objects += objects;
+  _res->no_escape += no_escape;
+  _path.pop_back();
+  _frames.pop_back();
+}
+
+void EscapeAnalyzer::Remark(const std::string &message) {
+  auto where = _where;
+  for (size_t i = 0; i < _path.size(); ++i) {
+    where += (i == 0 ? ": " : ".") + _path[i];
+  }
+  _res->remarks.push_back({"escape", where, message});
+}
+
+void EscapeAnalyzer::Visit(ast::Return *ret) {
+  Sink(Eval(ret->expr.get()), Escape::kReturned);
+}
+
+void EscapeAnalyzer::Visit(ast::ObjCreate *create) {
+  auto from = Eval(create->call_expr.get());
+  auto &frame = _frames.back();
+  if (frame.members || create->binding.kind != ast::Binding::kLocal) {
+    return Sink(from, Escape::kStored);
+  }
+  Flow(from, create->binding.slot);
+
+  // Set when the frame is done, the last round found the same
+  if (!_final) return;
+  auto escape = create->call_expr->escape;
+  if (escape == Escape::kReturned) {
+    Remark(*create->id + " escapes, it is returned or raised");
+  } else if (escape == Escape::kStored) {
+    Remark(*create->id + " escapes, it may be kept after the call");
+  }
+}
+
+void EscapeAnalyzer::Visit(ast::Function *func) {
+  VisitFrame(func, func->args.get(), func->body.get(), false);
+}
+
+void EscapeAnalyzer::Visit(ast::Assemble *assemble) {
+  VisitFrame(assemble, assemble->args.get(), assemble->body.get(), false);
+}
+
+void EscapeAnalyzer::Visit(ast::Struct *struct_create) {
+  VisitFrame(struct_create, nullptr, struct_create->body.get(), true);
+}
+
+void EscapeAnalyzer::Visit(ast::Class *class_create) {
+  VisitFrame(class_create, nullptr, class_create->body.get(), true);
+}
+
+void EscapeAnalyzer::Visit(ast::Import *) {}
+
+void EscapeAnalyzer::Visit(ast::Raise *raise) {
+  auto from = Eval(raise->error.get());
+  auto &frame = _frames.back();
+  Sink(from, frame.tries > 0 ? Escape::kStored : Escape::kReturned);
+  frame.raised.insert(from.begin(), from.end());
+}
+
+void EscapeAnalyzer::Visit(ast::Try *try_stmt) {
+  ++_frames.back().tries;
+  Walk(try_stmt->body.get());
+  --_frames.back().tries;
+  for (const auto &x : try_stmt->excepts) {
+    Walk(std::get<1>(x).get());
+    Walk(std::get<2>(x).get());
+  }
+  Walk(try_stmt->orelse.get());
+}
+
+void EscapeAnalyzer::Visit(ast::Literal *) { _sources.clear(); }
+
+// A member is a part of its object
+void EscapeAnalyzer::Visit(ast::Name *name) {
+  if (name->parent != nullptr) {
+    auto from = Eval(name->parent.get());
+    if (name->deref) from.clear();
+    _sources = std::move(from);
+    return;
+  }
+  auto slot = SlotOf(name);
+  _sources.clear();
+  if (slot >= 0) _sources.insert(slot);
+}
+
+void EscapeAnalyzer::Visit(ast::UnaryOpExpr *expr) {
+  Eval(expr->right.get());
+  if (std::string(expr->op->GetName()) == "__ref__") {
+    auto base = Base(expr->right.get());
+    if (base != nullptr) Sink(Eval(base), Escape::kStored);
+  }
+  _sources.clear();
+}
+
+void EscapeAnalyzer::Visit(ast::BinaryOpExpr *expr) {
+  auto op = std::string(expr->op->GetName());
+  if (op != "__assign__") {
+    Eval(expr->left.get());
+    Eval(expr->right.get());
+    auto slot = IsAssign(op) ? SlotOf(expr->left.get()) : -1;
+    _sources.clear();
+    if (slot >= 0) _sources.insert(slot);
+    return;
+  }
+
+  // x = y, or x.a = y or x[i] = y which keep y in x
+  auto from = Eval(expr->right.get());
+  auto slot = SlotOf(expr->left.get());
+  if (slot >= 0) {
+    Flow(from, slot);
+    _sources = {slot};
+    return;
+  }
+  Eval(expr->left.get());
+  Keep(expr->left.get(), from);
+  _sources = std::move(from);
+}
+
+void EscapeAnalyzer::Visit(ast::LogicExpr *expr) {
+  Eval(expr->left.get());
+  Eval(expr->right.get());
+  _sources.clear();
+}
+
+void EscapeAnalyzer::Visit(ast::IfElseExpr *expr) {
+  Eval(expr->test.get());
+  auto res = Eval(expr->left.get());
+  auto right = Eval(expr->right.get());
+  res.insert(right.begin(), right.end());
+  _sources = std::move(res);
+}
+
+void EscapeAnalyzer::Visit(ast::CallExpr *expr) {
+  auto res = Sources{Node(expr)};
+  Pass(expr, &res);
+  _sources = std::move(res);
+}
+
+// An element is a part of its object
+void EscapeAnalyzer::Visit(ast::SubscriptExpr *expr) {
+  auto from = Eval(expr->obj.get());
+  Walk(expr->op.get());
+  _sources = std::move(from);
+}
+
+}  // namespace pass
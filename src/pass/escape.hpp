@@ -0,0 +1,107 @@
+#ifndef _XULANG_SRC_PASS_ESCAPE_HPP
+#define _XULANG_SRC_PASS_ESCAPE_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/walker.hpp"
+#include "./pass.hpp"
+
+namespace pass {
+
+struct Escapes {
+  int objects = 0;    // calls in functions, each makes an object
+  int no_escape = 0;  // of them, only used by the function making them
+  int scalars = 0;    // of those, Int, Int8 or Float which need no object
+  int returned = 0;
+  int stored = 0;
+  Remarks remarks;
+};
+
+// Find where the object made by each call may still be used once the
+// function making it returns, after pass::Resolver, and set it in
+// ast::CallExpr::escape. Objects flow between the locals of a frame by
+// ObjCreates and assignments, and into the object a member or an element of
+// it is set. One escapes when it is returned or raised, kept anywhere else
+// than a local of the frame, taken by &, used by a nested Create or passed
+// to a call which may keep it. Builtins and the methods of builtin types
+// keep none of their args, but Auto(x) is x, and Fill(a, v, lo, hi),
+// Copy(a, b, lo, hi) and a.push_back(v) set v or the elements of b in a.
+// A call of a Function of the module passes its args the way the Function
+// uses its params, found by iterating over the module until no param
+// changes, e.g. neither Array() escapes in
+//   f := Function(Int, a:=Array()) { return a.length() }
+//   main := Function(Int) { b := Array(); return f(b) }
+class EscapeAnalyzer final : private ast::Walker {
+ private:
+  using Escape = ast::CallExpr::Escape;
+  using Sources = std::set<int>;  // slots of the frame, and -1 - call index
+
+  // How a Function of the module uses its params
+  struct Summary {
+    std::vector<std::string> params;
+    std::vector<Escape> escapes;  // kReturned only by Return
+  };
+
+  struct Frame {
+    ast::Create *owner;
+    bool members;                     // Module, Struct or Class, all kept
+    std::vector<ast::CallExpr *> calls;
+    std::unordered_map<const ast::CallExpr *, int> nodes;
+    std::map<int, Sources> flows;     // where the objects of a node go
+    std::map<int, Escape> sinks;
+    Sources raised;
+    std::set<int> typed;  // locals only created by builtin types
+    int tries = 0;        // try bodies around, a raise may be caught
+  };
+
+  std::string _where;
+  std::vector<std::string> _path;
+  Escapes *_res;
+  bool _final;  // the summaries are settled, count and remark
+  bool _changed;
+  std::unordered_map<const ast::Create *, std::set<int>> _captured;
+  std::unordered_map<int, Summary> _summaries;  // by Module objs index
+  std::vector<Frame> _frames;
+  Sources _sources;  // of the expression just visited
+
+  Sources Eval(ast::Expression *expr);
+  int Node(ast::CallExpr *call);
+  void Flow(const Sources &from, int slot);
+  void Keep(ast::Expression *target, const Sources &from);
+  void Sink(const Sources &from, Escape escape);
+  void Pass(ast::CallExpr *call, Sources *res);
+  void VisitFrame(ast::Create *owner, ast::CallOperator *args,
+                  ast::Block *body, bool members);
+  void Remark(const std::string &message);
+
+ public:
+  Escapes operator()(ast::Module *module);
+
+ private:
+  virtual void Visit(ast::Return *) override;
+  virtual void Visit(ast::ObjCreate *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override;
+  virtual void Visit(ast::Raise *) override;
+  virtual void Visit(ast::Try *) override;
+
+  virtual void Visit(ast::Literal *) override;
+  virtual void Visit(ast::Name *) override;
+  virtual void Visit(ast::UnaryOpExpr *) override;
+  virtual void Visit(ast::BinaryOpExpr *) override;
+  virtual void Visit(ast::LogicExpr *) override;
+  virtual void Visit(ast::IfElseExpr *) override;
+  virtual void Visit(ast::CallExpr *) override;
+  virtual void Visit(ast::SubscriptExpr *) override;
+};
+
+}  // namespace pass
+
+#endif  // _XULANG_SRC_PASS_ESCAPE_HPP
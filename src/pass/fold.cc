@@ -0,0 +1,376 @@
+#include "./fold.hpp"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+
+namespace pass {
+
+bool ToConstant(const ast::Expression *expr, Constant *constant) {
+  auto literal = dynamic_cast<const ast::Literal *>(expr);
+  if (literal == nullptr) return false;
+  auto type = std::string(literal->type->GetName());
+  const auto &text = *literal->val;
+  auto negative = !text.empty() && text[0] == '-';
+  auto beg = text.c_str() + (negative ? 1 : 0);
+  char *end = nullptr;
+  errno = 0;
+
+  // As the VM computes, in double. Out of range it is inf or 0, as the
+  // text would give at run time.
+  if (type == "Float") {
+    auto f = std::strtod(beg, &end);
+    if (end == beg || *end != '\0') return false;
+    *constant = {true, 0, negative ? -f : f};
+    return true;
+  }
+  if (type != "Int") return false;
+
+  // e.g. 10, 0b1010, 0o12, 0xa
+  auto base = 10;
+  if (beg[0] == '0' && beg[1] != '\0') {
+    base = beg[1] == 'b' ? 2 : beg[1] == 'o' ? 8 : beg[1] == 'x' ? 16 : 10;
+    if (base != 10) beg += 2;
+  }
+  auto i = static_cast<uint64_t>(std::strtoull(beg, &end, base));
+  if (errno != 0 || end == beg || *end != '\0') return false;
+  *constant = {false, negative ? 0 - i : i, 0};
+  return true;
+}
+
+utils::Uptr<ast::Literal> ToLiteral(const Constant &constant) {
+  if (!constant.is_float) {
+    return std::make_unique<ast::Literal>(
+        std::make_unique<ast::TextType>(
+            std::to_string(static_cast<int64_t>(constant.i))),
+        std::make_unique<builtin::Int>());
+  }
+  if (!std::isfinite(constant.f)) return nullptr;
+
+  // The shortest text which reads back to the same double
+  auto text = std::string();
+  for (auto digits = std::numeric_limits<double>::digits10;
+       digits <= std::numeric_limits<double>::max_digits10; ++digits) {
+    auto out = std::ostringstream();
+    out.precision(digits);
+    out << constant.f;
+    text = out.str();
+    if (std::strtod(text.c_str(), nullptr) == constant.f) break;
+  }
+  // A Float literal needs a dot or an exponent, e.g. 2.0 but not 2
+  if (text.find_first_of(".e") == std::string::npos) text += ".0";
+  return std::make_unique<ast::Literal>(
+      std::make_unique<ast::TextType>(text), std::make_unique<builtin::Float>());
+}
+
+static bool FoldInt(const std::string &op, uint64_t a, uint64_t b,
+                    uint64_t *res) {
+  auto sa = static_cast<int64_t>(a);
+  auto sb = static_cast<int64_t>(b);
+  if (op == "__plus__") {
+    *res = a + b;
+  } else if (op == "__minus__") {
+    *res = a - b;
+  } else if (op == "__mul__") {
+    *res = a * b;
+  } else if (op == "__div__" || op == "__mod__") {
+    if (b == 0) return false;
+    // INT64_MIN / -1 overflows in C++ but wraps around in XuLang
+    if (sb == -1) {
+      *res = op == "__div__" ? 0 - a : 0;
+    } else {
+      *res = static_cast<uint64_t>(op == "__div__" ? sa / sb : sa % sb);
+    }
+  } else if (op == "__bit_xor__") {
+    *res = a ^ b;
+  } else if (op == "__bit_or__") {
+    *res = a | b;
+  } else if (op == "__bit_and__") {
+    *res = a & b;
+  } else if (op == "__shift_left__" || op == "__shift_right__") {
+    if (sb < 0 || sb > 63) return false;
+    *res = op == "__shift_left__" ? a << b : static_cast<uint64_t>(sa >> sb);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool FoldFloat(const std::string &op, double a, double b,
+                      double *res) {
+  if (op == "__plus__") {
+    *res = a + b;
+  } else if (op == "__minus__") {
+    *res = a - b;
+  } else if (op == "__mul__") {
+    *res = a * b;
+  } else if (op == "__div__" && b != 0) {
+    *res = a / b;
+  } else {
+    return false;
+  }
+  return std::isfinite(*res);
+}
+
+template <class T>
+static bool Compare(const std::string &op, T a, T b, bool *res) {
+  if (op == "__eq__") {
+    *res = a == b;
+  } else if (op == "__ne__") {
+    *res = a != b;
+  } else if (op == "__le__") {
+    *res = a <= b;
+  } else if (op == "__ge__") {
+    *res = a >= b;
+  } else if (op == "__lt__") {
+    *res = a < b;
+  } else if (op == "__gt__") {
+    *res = a > b;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool HasCreate(const ast::Block *block) {
+  for (const auto &stmt : block->statements) {
+    if (dynamic_cast<const ast::Create *>(stmt.get()) != nullptr) return true;
+  }
+  return false;
+}
+
+static utils::Uptr<ast::Literal> MakeBool(bool value) {
+  return ToLiteral({false, value ? 1u : 0u, 0});
+}
+
+std::string Folder::Where() const {
+  auto res = _where;
+  for (size_t i = 0; i < _path.size(); ++i) {
+    res += (i == 0 ? ": " : ".") + _path[i];
+  }
+  return res;
+}
+
+Folding Folder::operator()(ast::Module *module) {
+  auto res = Folding();
+  _res = &res;
+  _where = module->filename;
+  _path.clear();
+  auto before = ast::CountNodes(module);
+  module->Accept(this);
+  res.removed = before - ast::CountNodes(module);
+  return res;
+}
+
+void Folder::Fold(utils::Uptr<ast::Expression> &expr) {
+  Walk(expr.get());
+  if (_expr != nullptr) expr = std::move(_expr);
+}
+
+void Folder::Replace(utils::Uptr<ast::Expression> &&expr) {
+  if (expr == nullptr) return;
+  ++_res->folded;
+  _expr = std::move(expr);
+}
+
+void Folder::TakeBranch(utils::Uptr<ast::Block> &&block, const char *what) {
+  ++_res->branches;
+  _res->remarks.push_back({"fold", Where(), what});
+  _drop = true;
+  if (block == nullptr || block->statements.empty()) return;
+  if (HasCreate(block.get())) {
+    // Keep the scope of the ids, e.g. if (1) { x := Int(0) }
+    _splice = std::make_unique<ast::Block>(
+        std::make_unique<ast::If>(MakeBool(true), std::move(block)));
+    return;
+  }
+  _splice = std::move(block);
+}
+
+void Folder::Visit(ast::Block *block) {
+  auto &stmts = block->statements;
+  for (auto it = stmts.begin(); it != stmts.end();) {
+    Walk(it->get());
+    if (!_drop) {
+      ++it;
+      continue;
+    }
+    _drop = false;
+    if (_splice != nullptr) stmts.splice(it, _splice->statements);
+    _splice = nullptr;
+    it = stmts.erase(it);
+  }
+}
+
+// A literal alone does nothing, e.g. 3 + 4 after folding
+void Folder::Visit(ast::ExprStatement *stmt) {
+  Fold(stmt->expr);
+  _drop = dynamic_cast<ast::Literal *>(stmt->expr.get()) != nullptr;
+}
+
+void Folder::Visit(ast::Return *ret) { Fold(ret->expr); }
+void Folder::Visit(ast::Raise *raise) { Fold(raise->error); }
+
+void Folder::Visit(ast::If *if_stmt) {
+  Fold(if_stmt->test);
+  Walk(if_stmt->body.get());
+  Walk(if_stmt->orelse.get());
+
+  auto test = Constant();
+  if (!ToConstant(if_stmt->test.get(), &test)) return;
+  if (!test.IsTrue()) {
+    return TakeBranch(std::move(if_stmt->orelse), "if test is always false");
+  }
+  // Already as small as it gets, e.g. if (1) { x := Int(0) }
+  if (if_stmt->orelse == nullptr && HasCreate(if_stmt->body.get())) return;
+  TakeBranch(std::move(if_stmt->body), "if test is always true");
+}
+
+void Folder::Visit(ast::While *while_stmt) {
+  Fold(while_stmt->test);
+  Walk(while_stmt->body.get());
+  Walk(while_stmt->orelse.get());
+
+  auto test = Constant();
+  if (!ToConstant(while_stmt->test.get(), &test)) return;
+  if (!test.IsTrue()) {
+    // The loop never runs, but its else does
+    return TakeBranch(std::move(while_stmt->orelse),
+                      "while test is always false");
+  }
+  // Only break, return or raise leave the loop, and none of them runs else
+  if (while_stmt->orelse == nullptr) return;
+  while_stmt->orelse = nullptr;
+  ++_res->branches;
+  _res->remarks.push_back(
+      {"fold", Where(), "while test is always true, else removed"});
+}
+
+void Folder::Visit(ast::Function *func) {
+  _path.push_back(*func->id);
+  ast::Walker::Visit(func);
+  _path.pop_back();
+}
+
+void Folder::Visit(ast::Assemble *assemble) {
+  _path.push_back(*assemble->id);
+  ast::Walker::Visit(assemble);
+  _path.pop_back();
+}
+
+void Folder::Visit(ast::Struct *struct_create) {
+  _path.push_back(*struct_create->id);
+  ast::Walker::Visit(struct_create);
+  _path.pop_back();
+}
+
+void Folder::Visit(ast::Class *class_create) {
+  _path.push_back(*class_create->id);
+  ast::Walker::Visit(class_create);
+  _path.pop_back();
+}
+
+void Folder::Visit(ast::Name *name) {
+  if (name->parent != nullptr) Fold(name->parent);
+}
+
+void Folder::Visit(ast::UnaryOpExpr *expr) {
+  Fold(expr->right);
+  auto val = Constant();
+  if (!ToConstant(expr->right.get(), &val)) return;
+
+  auto op = std::string(expr->op->GetName());
+  if (op == "__positive__") {
+  } else if (op == "__negative__" && val.is_float) {
+    val.f = -val.f;
+  } else if (op == "__negative__") {
+    val.i = 0 - val.i;
+  } else if (op == "__bit_not__" && !val.is_float) {
+    val.i = ~val.i;
+  } else if (op == "__not__") {
+    return Replace(MakeBool(!val.IsTrue()));
+  } else {
+    return;
+  }
+  Replace(ToLiteral(val));
+}
+
+void Folder::Visit(ast::BinaryOpExpr *expr) {
+  Fold(expr->left);
+  Fold(expr->right);
+  auto left = Constant(), right = Constant();
+  if (!ToConstant(expr->left.get(), &left) ||
+      !ToConstant(expr->right.get(), &right) ||
+      left.is_float != right.is_float) {
+    return;
+  }
+
+  auto op = std::string(expr->op->GetName());
+  auto res = Constant{left.is_float};
+  if (left.is_float ? FoldFloat(op, left.f, right.f, &res.f)
+                    : FoldInt(op, left.i, right.i, &res.i)) {
+    Replace(ToLiteral(res));
+  }
+}
+
+void Folder::Visit(ast::LogicExpr *expr) {
+  Fold(expr->left);
+  Fold(expr->right);
+  auto left = Constant(), right = Constant();
+  auto has_left = ToConstant(expr->left.get(), &left);
+  auto has_right = ToConstant(expr->right.get(), &right);
+
+  auto op = std::string(expr->op->GetName());
+  if (op == "__and__" || op == "__or__") {
+    // The right side is never run once the left one decides, e.g. 0 && f()
+    auto is_and = op == "__and__";
+    if (has_left && left.IsTrue() != is_and) return Replace(MakeBool(!is_and));
+    if (has_left && has_right) Replace(MakeBool(right.IsTrue()));
+    return;
+  }
+
+  auto res = false;
+  if (!has_left || !has_right || left.is_float != right.is_float) return;
+  if (left.is_float ? Compare(op, left.f, right.f, &res)
+                    : Compare(op, static_cast<int64_t>(left.i),
+                              static_cast<int64_t>(right.i), &res)) {
+    Replace(MakeBool(res));
+  }
+}
+
+void Folder::Visit(ast::IfElseExpr *expr) {
+  Fold(expr->left);
+  Fold(expr->test);
+  Fold(expr->right);
+  auto test = Constant();
+  if (!ToConstant(expr->test.get(), &test)) return;
+  ++_res->branches;
+  _expr = std::move(test.IsTrue() ? expr->left : expr->right);
+}
+
+void Folder::Visit(ast::CallExpr *expr) {
+  Fold(expr->obj);
+  Walk(expr->op.get());
+}
+
+void Folder::Visit(ast::SubscriptExpr *expr) {
+  Fold(expr->obj);
+  Walk(expr->op.get());
+}
+
+void Folder::Visit(ast::CallOperator *cop) {
+  for (auto &x : cop->unameds) Fold(x);
+  for (auto &x : cop->keywords) Fold(std::get<1>(x));
+}
+
+void Folder::Visit(ast::SubscriptOperator *sop) {
+  for (auto &x : sop->dims) {
+    Fold(std::get<0>(*x));
+    Fold(std::get<1>(*x));
+    Fold(std::get<2>(*x));
+  }
+}
+
+}  // namespace pass
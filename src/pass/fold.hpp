@@ -0,0 +1,83 @@
+#ifndef _XULANG_SRC_PASS_FOLD_HPP
+#define _XULANG_SRC_PASS_FOLD_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "../ast/walker.hpp"
+#include "./pass.hpp"
+
+namespace pass {
+
+// The value of an Int or Float Literal
+struct Constant {
+  bool is_float = false;
+  uint64_t i = 0;
+  double f = 0;  // as the VM computes it
+
+  inline bool IsTrue() const { return is_float ? f != 0 : i != 0; }
+};
+
+// False if expr is not an Int or Float Literal, or its text does not fit
+bool ToConstant(const ast::Expression *expr, Constant *constant);
+// nullptr if the value cannot be written as a literal, e.g. inf
+utils::Uptr<ast::Literal> ToLiteral(const Constant &constant);
+
+struct Folding {
+  int folded = 0;      // expressions replaced by a Literal or an operand
+  int branches = 0;    // If, While and IfElseExpr with a constant test
+  size_t removed = 0;  // nodes in the module before minus after
+  Remarks remarks;
+};
+
+// Fold operators on Int and Float literals and remove the branches constant
+// tests never take. Int is 64 bit two's complement and wraps around, shifts
+// are only folded for counts in [0, 63] and >> keeps the sign. Division by
+// zero, overflowing Floats and assignments are left for run time. Folded
+// literals may be negative, e.g. Literal("-3") for 1 - 4.
+class Folder final : private ast::Walker {
+ private:
+  std::string _where;
+  std::vector<std::string> _path;
+  Folding *_res;
+
+  // Set by the Visit() of the node just walked, consumed by its parent
+  utils::Uptr<ast::Expression> _expr;  // the replacement of an expression
+  bool _drop = false;                  // remove the statement...
+  utils::Uptr<ast::Block> _splice;     // ...and put these in its place
+
+  void Fold(utils::Uptr<ast::Expression> &expr);
+  void Replace(utils::Uptr<ast::Expression> &&expr);
+  void TakeBranch(utils::Uptr<ast::Block> &&block, const char *what);
+  std::string Where() const;
+
+ public:
+  Folding operator()(ast::Module *module);
+
+ private:
+  virtual void Visit(ast::Block *) override;
+  virtual void Visit(ast::ExprStatement *) override;
+  virtual void Visit(ast::Return *) override;
+  virtual void Visit(ast::If *) override;
+  virtual void Visit(ast::While *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override {}
+  virtual void Visit(ast::Raise *) override;
+
+  virtual void Visit(ast::Name *) override;
+  virtual void Visit(ast::UnaryOpExpr *) override;
+  virtual void Visit(ast::BinaryOpExpr *) override;
+  virtual void Visit(ast::LogicExpr *) override;
+  virtual void Visit(ast::IfElseExpr *) override;
+  virtual void Visit(ast::CallExpr *) override;
+  virtual void Visit(ast::SubscriptExpr *) override;
+  virtual void Visit(ast::CallOperator *) override;
+  virtual void Visit(ast::SubscriptOperator *) override;
+};
+
+}  // namespace pass
+
+#endif  // _XULANG_SRC_PASS_FOLD_HPP
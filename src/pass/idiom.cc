@@ -0,0 +1,546 @@
+#include "./idiom.hpp"
+
+#include "../ast/clone.hpp"
+#include "../ast/printer.hpp"
+#include "../builtin/names.hpp"
+#include "./fold.hpp"
+
+namespace pass {
+
+// The slot of a local of the frame, or -1
+static int SlotOf(const ast::Expression *expr) {
+  auto name = dynamic_cast<const ast::Name *>(expr);
+  if (name == nullptr || name->parent != nullptr ||
+      name->binding.kind != ast::Binding::kLocal || name->binding.depth != 0) {
+    return -1;
+  }
+  return name->binding.slot;
+}
+
+static bool IsOne(const ast::Expression *expr) {
+  auto constant = Constant();
+  return ToConstant(expr, &constant) && !constant.is_float && constant.i == 1;
+}
+
+// i += 1
+static const ast::Name *StepOf(const ast::Expression *expr) {
+  auto step = dynamic_cast<const ast::BinaryOpExpr *>(expr);
+  if (step == nullptr || std::string(step->op->GetName()) != "__self_plus__" ||
+      SlotOf(step->left.get()) < 0 || !IsOne(step->right.get())) {
+    return nullptr;
+  }
+  return static_cast<const ast::Name *>(step->left.get());
+}
+
+// a of a[i], with a a Name and i the local at index
+static const ast::Name *ElementOf(const ast::Expression *expr, int index) {
+  auto subscript = dynamic_cast<const ast::SubscriptExpr *>(expr);
+  if (subscript == nullptr || subscript->op->dims.size() != 1) return nullptr;
+  const auto &dim = *subscript->op->dims.front();
+  auto array = dynamic_cast<const ast::Name *>(subscript->obj.get());
+  if (array == nullptr || array->parent != nullptr ||
+      array->binding.kind == ast::Binding::kBuiltin ||
+      SlotOf(array) == index || SlotOf(std::get<0>(dim).get()) != index ||
+      std::get<1>(dim) != nullptr || std::get<2>(dim) != nullptr) {
+    return nullptr;
+  }
+  return array;
+}
+
+// The same value every iteration of a loop which only sets the slots. No
+// element is read, and nothing which may raise, e.g. a division, is
+// evaluated since the loop may not run at all.
+static bool IsInvariant(const ast::Expression *expr,
+                        const std::set<int> &slots) {
+  if (dynamic_cast<const ast::Literal *>(expr) != nullptr) return true;
+  if (auto name = dynamic_cast<const ast::Name *>(expr)) {
+    if (name->parent != nullptr) return false;
+    auto slot = SlotOf(name);
+    return slot < 0 || !slots.count(slot);
+  }
+  if (auto unary = dynamic_cast<const ast::UnaryOpExpr *>(expr)) {
+    return std::string(unary->op->GetName()) != "__deref__" &&
+           IsInvariant(unary->right.get(), slots);
+  }
+  if (auto binary = dynamic_cast<const ast::BinaryOpExpr *>(expr)) {
+    auto op = std::string(binary->op->GetName());
+    return op != "__div__" && op != "__mod__" && op != "__assign__" &&
+           op.rfind("__self_", 0) != 0 &&
+           IsInvariant(binary->left.get(), slots) &&
+           IsInvariant(binary->right.get(), slots);
+  }
+  if (auto logic = dynamic_cast<const ast::LogicExpr *>(expr)) {
+    return IsInvariant(logic->left.get(), slots) &&
+           IsInvariant(logic->right.get(), slots);
+  }
+  if (auto if_else = dynamic_cast<const ast::IfElseExpr *>(expr)) {
+    return IsInvariant(if_else->left.get(), slots) &&
+           IsInvariant(if_else->test.get(), slots) &&
+           IsInvariant(if_else->right.get(), slots);
+  }
+  if (auto call = dynamic_cast<const ast::CallExpr *>(expr)) {
+    auto callee = dynamic_cast<const ast::Name *>(call->obj.get());
+    if (callee == nullptr) return false;
+    if (callee->parent != nullptr) {
+      // e.g. a.length(), the elements are changed but not their number
+      if (!builtin::IsPureMethod(*callee->id) ||
+          !IsInvariant(callee->parent.get(), slots)) {
+        return false;
+      }
+    } else if (callee->binding.kind != ast::Binding::kBuiltin ||
+               !builtin::kBuiltins[callee->binding.slot].is_pure ||
+               builtin::kBuiltins[callee->binding.slot].is_alloc) {
+      return false;
+    }
+    for (const auto &x : call->op->unameds) {
+      if (!IsInvariant(x.get(), slots)) return false;
+    }
+    for (const auto &x : call->op->keywords) {
+      if (!IsInvariant(std::get<1>(x).get(), slots)) return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+static utils::Uptr<ast::Name> MakeBuiltin(const std::string &id) {
+  auto name = std::make_unique<ast::Name>(std::make_unique<ast::TextType>(id));
+  name->binding = {ast::Binding::kBuiltin, 0, builtin::FindBuiltin(id)};
+  return name;
+}
+
+static utils::Uptr<ast::Expression> PlusOne(utils::Uptr<ast::Expression> &&x) {
+  auto one = Constant();
+  one.i = 1;
+  return std::make_unique<ast::BinaryOpExpr>(
+      std::move(x), std::make_unique<ast::OpPlus>(), ToLiteral(one));
+}
+
+// The ids created anywhere in the module, which hide the builtins
+class Ids final : public ast::Walker {
+ public:
+  std::set<std::string> ids;
+
+  virtual void Visit(ast::ObjCreate *create) override {
+    ids.insert(*create->id);
+    ast::Walker::Visit(create);
+  }
+  virtual void Visit(ast::Function *func) override {
+    ids.insert(*func->id);
+    ast::Walker::Visit(func);
+  }
+  virtual void Visit(ast::Assemble *assemble) override {
+    ids.insert(*assemble->id);
+    ast::Walker::Visit(assemble);
+  }
+  virtual void Visit(ast::Struct *struct_create) override {
+    ids.insert(*struct_create->id);
+    ast::Walker::Visit(struct_create);
+  }
+  virtual void Visit(ast::Class *class_create) override {
+    ids.insert(*class_create->id);
+    ast::Walker::Visit(class_create);
+  }
+  virtual void Visit(ast::Import *import) override {
+    ids.insert(*import->id);
+  }
+  virtual void Visit(ast::Try *try_stmt) override {
+    for (const auto &x : try_stmt->excepts) ids.insert(*std::get<0>(x));
+    ast::Walker::Visit(try_stmt);
+  }
+};
+
+// The builtin type of a local, e.g. Int, Array or Memory Int8
+using Types = std::unordered_map<int, std::string>;
+
+// Whether the value of expr is an Int, or it raises
+static bool IsInt(const ast::Expression *expr, const Types &types) {
+  auto constant = Constant();
+  if (ToConstant(expr, &constant)) return !constant.is_float;
+  auto type = [&](const ast::Expression *x) {
+    auto found = types.find(SlotOf(x));
+    return found == types.end() ? "" : found->second;
+  };
+  if (dynamic_cast<const ast::Name *>(expr) != nullptr) {
+    return type(expr) == "Int";
+  }
+  if (auto subscript = dynamic_cast<const ast::SubscriptExpr *>(expr)) {
+    auto array = type(subscript->obj.get());
+    return array == "Memory Int" || array == "Memory Int8";
+  }
+  if (auto unary = dynamic_cast<const ast::UnaryOpExpr *>(expr)) {
+    auto op = std::string(unary->op->GetName());
+    return op != "__deref__" && op != "__ref__" && op != "__not__" &&
+           IsInt(unary->right.get(), types);
+  }
+  if (auto binary = dynamic_cast<const ast::BinaryOpExpr *>(expr)) {
+    auto op = std::string(binary->op->GetName());
+    return op != "__assign__" && op.rfind("__self_", 0) != 0 &&
+           IsInt(binary->left.get(), types) &&
+           IsInt(binary->right.get(), types);
+  }
+  if (auto call = dynamic_cast<const ast::CallExpr *>(expr)) {
+    auto callee = dynamic_cast<const ast::Name *>(call->obj.get());
+    if (callee == nullptr) return false;
+    if (callee->parent != nullptr) return *callee->id == "length";
+    return callee->binding.kind == ast::Binding::kBuiltin &&
+           (*callee->id == "Int" || *callee->id == "Int8");
+  }
+  return false;
+}
+
+// The locals of a frame whose builtin type holds throughout: the Int ones
+// which are only ever set to Ints, and the Array and Memory ones which are
+// never set again. None is taken by &.
+class LocalTypes final : public ast::Walker {
+ public:
+  Types types;
+  std::set<int> changed;  // set or taken by &, of any type
+
+  // Drop the Int locals set to anything else, until none is
+  void Finish() {
+    for (auto changed = true; changed;) {
+      changed = false;
+      for (const auto &[slot, value] : _sets) {
+        auto found = types.find(slot);
+        if (found == types.end() ||
+            (found->second == "Int" && value != nullptr &&
+             IsInt(value, types))) {
+          continue;
+        }
+        types.erase(found);
+        changed = true;
+      }
+    }
+  }
+
+  virtual void Visit(ast::ObjCreate *create) override {
+    auto type = dynamic_cast<ast::Name *>(create->call_expr->obj.get());
+    if (type != nullptr && type->parent == nullptr &&
+        type->binding.kind == ast::Binding::kBuiltin &&
+        create->binding.kind == ast::Binding::kLocal) {
+      const auto &args = create->call_expr->op->unameds;
+      auto elem = args.empty()
+                      ? nullptr
+                      : dynamic_cast<ast::Name *>(args.front().get());
+      if (*type->id == "Int" || *type->id == "Array") {
+        types[create->binding.slot] = *type->id;
+      } else if (*type->id == "Memory" && elem != nullptr &&
+                 elem->binding.kind == ast::Binding::kBuiltin) {
+        types[create->binding.slot] = "Memory " + *elem->id;
+      }
+    }
+    ast::Walker::Visit(create);
+  }
+  virtual void Visit(ast::BinaryOpExpr *expr) override {
+    auto slot = SlotOf(expr->left.get());
+    auto op = std::string(expr->op->GetName());
+    if (slot >= 0 && (op == "__assign__" || op.rfind("__self_", 0) == 0)) {
+      // Only an Int set to an Int stays one
+      _sets.push_back({slot, expr->right.get()});
+      changed.insert(slot);
+    }
+    ast::Walker::Visit(expr);
+  }
+  virtual void Visit(ast::UnaryOpExpr *expr) override {
+    if (std::string(expr->op->GetName()) == "__ref__" &&
+        SlotOf(expr->right.get()) >= 0) {
+      _sets.push_back({SlotOf(expr->right.get()), nullptr});
+      changed.insert(SlotOf(expr->right.get()));
+    }
+    ast::Walker::Visit(expr);
+  }
+  virtual void Visit(ast::Function *) override {}
+  virtual void Visit(ast::Assemble *) override {}
+  virtual void Visit(ast::Struct *) override {}
+  virtual void Visit(ast::Class *) override {}
+  virtual void Visit(ast::Import *) override {}
+
+ private:
+  std::vector<std::pair<int, const ast::Expression *>> _sets;
+};
+
+Idioms IdiomRecognizer::operator()(ast::Module *module) {
+  auto res = Idioms();
+  _res = &res;
+  _where = module->filename;
+  _path.clear();
+  auto ids = Ids();
+  ids.Walk(module);
+  _ids = std::move(ids.ids);
+  _frames.clear();
+  Walk(module);
+  return res;
+}
+
+utils::Uptr<ast::Block> IdiomRecognizer::Recognize(ast::While *while_stmt) {
+  auto test = dynamic_cast<ast::LogicExpr *>(while_stmt->test.get());
+  // In a try, an except may read i where the loop raised
+  if (_frames.empty() || _frames.back().tries != 0 ||
+      while_stmt->orelse != nullptr || test == nullptr) {
+    return nullptr;
+  }
+  auto cmp = std::string(test->op->GetName());
+  if (cmp != "__lt__" && cmp != "__le__") return nullptr;
+
+  // while ((i += 1) < n) { stmt } or while (i < n) { stmt; i += 1 }
+  const auto &stmts = while_stmt->body->statements;
+  auto index_name = StepOf(test->left.get());
+  auto in_test = index_name != nullptr;
+  if (in_test) {
+    if (stmts.size() != 1) return nullptr;
+  } else {
+    if (stmts.size() != 2) return nullptr;
+    auto last = dynamic_cast<ast::ExprStatement *>(stmts.back().get());
+    index_name = last ? StepOf(last->expr.get()) : nullptr;
+    if (index_name == nullptr ||
+        SlotOf(test->left.get()) != index_name->binding.slot) {
+      return nullptr;
+    }
+  }
+  // The bounds are Ints as the builtins take them
+  const auto &frame = _frames.back();
+  auto type = [&](const ast::Expression *x) {
+    auto found = frame.types.find(SlotOf(x));
+    return found == frame.types.end() ? "" : found->second;
+  };
+  auto index = index_name->binding.slot;
+  if (type(index_name) != "Int" || !IsInt(test->right.get(), frame.types)) {
+    return nullptr;
+  }
+
+  const char *bulk = nullptr;
+  const ast::Name *array = nullptr;
+  const ast::Expression *value = nullptr;  // the value or the source array
+  const ast::Expression *acc = nullptr;    // the sum or the count
+  auto stmt = stmts.front().get();
+  if (auto expr_stmt = dynamic_cast<ast::ExprStatement *>(stmt)) {
+    auto binary = dynamic_cast<ast::BinaryOpExpr *>(expr_stmt->expr.get());
+    auto op = binary ? std::string(binary->op->GetName()) : "";
+    if (op == "__assign__") {
+      array = ElementOf(binary->left.get(), index);
+      value = ElementOf(binary->right.get(), index);
+      if (value != nullptr) {
+        bulk = "Copy";
+        if (array && *static_cast<const ast::Name *>(value)->id == *array->id) {
+          return nullptr;
+        }
+      } else {
+        bulk = "Fill";
+        value = binary->right.get();
+      }
+    } else if (op == "__self_plus__") {
+      bulk = "Sum";
+      array = ElementOf(binary->right.get(), index);
+      acc = binary->left.get();
+    }
+  } else if (auto if_stmt = dynamic_cast<ast::If *>(stmt)) {
+    // if (a[i] == v) { c += 1 }
+    auto eq = dynamic_cast<ast::LogicExpr *>(if_stmt->test.get());
+    const auto &body = if_stmt->body->statements;
+    auto inc = body.size() == 1 ? dynamic_cast<ast::ExprStatement *>(
+                                      body.front().get())
+                                : nullptr;
+    if (if_stmt->orelse == nullptr && eq != nullptr &&
+        std::string(eq->op->GetName()) == "__eq__" && inc != nullptr &&
+        StepOf(inc->expr.get()) != nullptr) {
+      bulk = "Count";
+      acc = StepOf(inc->expr.get());
+      array = ElementOf(eq->left.get(), index);
+      value = eq->right.get();
+      if (array == nullptr) {
+        array = ElementOf(eq->right.get(), index);
+        value = eq->left.get();
+      }
+    }
+  }
+  if (bulk == nullptr || array == nullptr || _ids.count(bulk)) return nullptr;
+
+  // Array and Memory locals of the frame only, e.g. a String has elements
+  // too but no builtin takes it
+  auto is_sequence = [&](const ast::Expression *x) {
+    auto t = type(x);
+    return t == "Array" || t.rfind("Memory ", 0) == 0;
+  };
+  if (!is_sequence(array) || (std::string(bulk) == "Copy" &&
+                              !is_sequence(value))) {
+    return nullptr;
+  }
+  // An Int local which is no param adds the same Ints in any order, e.g. a
+  // Float would round each partial sum
+  if (std::string(bulk) == "Sum" && type(array) != "Memory Int" &&
+      type(array) != "Memory Int8") {
+    return nullptr;
+  }
+
+  // The elements of the array change, but not which array it is
+  auto slots = std::set<int>{index};
+  if (acc != nullptr) {
+    if (type(acc) != "Int" || SlotOf(acc) == index) return nullptr;
+    slots.insert(SlotOf(acc));
+  }
+  if ((value != nullptr && !IsInvariant(value, slots)) ||
+      !IsInvariant(test->right.get(), slots)) {
+    return nullptr;
+  }
+
+  // [lo, hi) are the indices the loop visits
+  auto lo = [&]() -> utils::Uptr<ast::Expression> {
+    auto i = ast::Cloner()(index_name);
+    return in_test ? PlusOne(std::move(i)) : std::move(i);
+  };
+  auto hi = [&]() -> utils::Uptr<ast::Expression> {
+    auto n = ast::Cloner()(test->right.get());
+    return cmp == "__le__" ? PlusOne(std::move(n)) : std::move(n);
+  };
+
+  // lo < n, the test of the first iteration
+  auto first = [&]() -> utils::Uptr<ast::Expression> {
+    return std::make_unique<ast::LogicExpr>(
+        lo(), ast::Cloner()(test->op.get()), ast::Cloner()(test->right.get()));
+  };
+
+  auto args = std::make_unique<ast::CallOperator>();
+  args->AddUnamed(ast::Cloner()(array));
+  if (value != nullptr) args->AddUnamed(ast::Cloner()(value));
+  args->AddUnamed(lo());
+  args->AddUnamed(hi());
+  utils::Uptr<ast::Expression> call =
+      std::make_unique<ast::CallExpr>(MakeBuiltin(bulk), std::move(args));
+  Remark("while loop on " + *array->id + " replaced by " +
+         ast::Printer()(call.get()));
+  if (acc != nullptr) {
+    call = std::make_unique<ast::BinaryOpExpr>(
+        ast::Cloner()(acc), std::make_unique<ast::OpSelfPlus>(),
+        std::move(call));
+  }
+
+  // if (lo < n) { call; i = hi } else { i = lo }, the loop may not run and
+  // then evaluates nothing but its test
+  auto assign = [&](utils::Uptr<ast::Expression> &&x) {
+    return std::make_unique<ast::ExprStatement>(
+        std::make_unique<ast::BinaryOpExpr>(ast::Cloner()(index_name),
+                                            std::make_unique<ast::OpAssign>(),
+                                            std::move(x)));
+  };
+  auto body = std::make_unique<ast::Block>();
+  body->AddStatement(std::make_unique<ast::ExprStatement>(std::move(call)));
+  body->AddStatement(assign(hi()));
+  auto orelse = utils::Uptr<ast::Block>();
+  if (in_test) {
+    orelse = std::make_unique<ast::Block>();
+    orelse->AddStatement(assign(lo()));
+  }
+  auto res = std::make_unique<ast::Block>();
+  res->AddStatement(std::make_unique<ast::If>(first(), std::move(body),
+                                              std::move(orelse)));
+
+  auto &count = std::string(bulk) == "Fill"   ? _res->fills
+                : std::string(bulk) == "Copy" ? _res->copies
+                : std::string(bulk) == "Sum"  ? _res->sums
+                                              : _res->counts;
+  ++count;
+  return res;
+}
+
+void IdiomRecognizer::Remark(const std::string &message) {
+  auto where = _where;
+  for (size_t i = 0; i < _path.size(); ++i) {
+    where += (i == 0 ? ": " : ".") + _path[i];
+  }
+  _res->remarks.push_back({"idiom", where, message});
+}
+
+void IdiomRecognizer::Visit(ast::Block *block) {
+  auto &stmts = block->statements;
+  for (auto it = stmts.begin(); it != stmts.end();) {
+    Walk(it->get());
+    auto while_stmt = dynamic_cast<ast::While *>(it->get());
+    auto bulk = while_stmt ? Recognize(while_stmt) : nullptr;
+    if (bulk == nullptr) {
+      Sized(block, it->get());
+      ++it;
+      continue;
+    }
+    stmts.splice(it, bulk->statements);
+    it = stmts.erase(it);
+  }
+}
+
+void IdiomRecognizer::Visit(ast::Try *try_stmt) {
+  if (!_frames.empty()) ++_frames.back().tries;
+  Walk(try_stmt->body.get());
+  if (!_frames.empty()) --_frames.back().tries;
+  for (const auto &x : try_stmt->excepts) Walk(std::get<2>(x).get());
+  Walk(try_stmt->orelse.get());
+}
+
+// Memory(T, n) and Array(T, n) raise unless n is an Int, so a param never
+// set is one after such a statement of the body, e.g. range of primes()
+void IdiomRecognizer::Sized(const ast::Block *block,
+                            const ast::Statement *stmt) {
+  auto create = dynamic_cast<const ast::ObjCreate *>(stmt);
+  if (_frames.empty() || block != _frames.back().body || create == nullptr) {
+    return;
+  }
+  auto type = dynamic_cast<const ast::Name *>(create->call_expr->obj.get());
+  const auto &args = create->call_expr->op->unameds;
+  if (type == nullptr || type->parent != nullptr ||
+      type->binding.kind != ast::Binding::kBuiltin ||
+      (*type->id != "Memory" && *type->id != "Array") || args.size() != 2 ||
+      !create->call_expr->op->keywords.empty()) {
+    return;
+  }
+  auto &frame = _frames.back();
+  auto slot = SlotOf(args.back().get());
+  if (frame.params.count(slot)) frame.types[slot] = "Int";
+}
+
+void IdiomRecognizer::VisitFrame(ast::Create *create, ast::CallOperator *args,
+                                 ast::Block *body) {
+  auto locals = LocalTypes();
+  locals.Walk(body);
+  locals.Finish();
+  auto frame = Frame{std::move(locals.types), body};
+
+  // The params come first, e.g. n:=Int() of Function(Int, a, n:=Int()). The
+  // args are bound as they are, so n may as well be a Float.
+  auto params = args->unameds.empty() ? 0 : args->unameds.size() - 1;
+  params += args->keywords.size();
+  for (auto slot = 0; slot < static_cast<int>(params); ++slot) {
+    if (!locals.changed.count(slot)) frame.params.insert(slot);
+  }
+  _frames.push_back(std::move(frame));
+  _path.push_back(*create->GetId());
+  Walk(body);
+  _path.pop_back();
+  _frames.pop_back();
+}
+
+void IdiomRecognizer::Visit(ast::Function *func) {
+  VisitFrame(func, func->args.get(), func->body.get());
+}
+
+void IdiomRecognizer::Visit(ast::Assemble *assemble) {
+  VisitFrame(assemble, assemble->args.get(), assemble->body.get());
+}
+
+void IdiomRecognizer::Visit(ast::Struct *struct_create) {
+  _frames.push_back({});
+  _path.push_back(*struct_create->id);
+  Walk(struct_create->body.get());
+  _path.pop_back();
+  _frames.pop_back();
+}
+
+void IdiomRecognizer::Visit(ast::Class *class_create) {
+  _frames.push_back({});
+  _path.push_back(*class_create->id);
+  Walk(class_create->body.get());
+  _path.pop_back();
+  _frames.pop_back();
+}
+
+void IdiomRecognizer::Visit(ast::Import *) {}
+
+}  // namespace pass
@@ -0,0 +1,71 @@
+#ifndef _XULANG_SRC_PASS_IDIOM_HPP
+#define _XULANG_SRC_PASS_IDIOM_HPP
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/walker.hpp"
+#include "./pass.hpp"
+
+namespace pass {
+
+struct Idioms {
+  int fills = 0;   // a[i] = v
+  int copies = 0;  // a[i] = b[i]
+  int sums = 0;    // s += a[i]
+  int counts = 0;  // if (a[i] == v) { c += 1 }
+  Remarks remarks;
+};
+
+// Replace the While loops of the functions which fill, copy, sum or count
+// the elements of a Memory or Array local by one call of the bulk builtin
+// doing it, after pass::Resolver. The builtins raise at the first index out
+// of range as the loop does. The index is an Int local i stepped by 1, in
+// the test as in while ((i += 1) < n) or as the last statement of the body
+// of while (i < n), n is an Int which may not change in the loop and the
+// body is a single statement. A sum or count goes to an Int local, and only
+// Ints of a Memory are summed. Loops in a try are left. The call runs if
+// the loop would, and i is set to its value after the loop, e.g.
+//   while ((i += 1) < n) { a[i] = 0 }
+// becomes
+//   if (i + 1 < n) { Fill(a, 0, i + 1, n); i = n } else { i = i + 1 }
+// Run pass::Resolver again afterwards.
+class IdiomRecognizer final : private ast::Walker {
+ private:
+  std::string _where;
+  std::vector<std::string> _path;
+  Idioms *_res;
+  struct Frame {
+    std::unordered_map<int, std::string> types;  // by slot, e.g. Memory Int
+    const ast::Block *body = nullptr;
+    std::set<int> params;  // never set, not typed until proven, see Sized
+    int tries = 0;         // around the statement
+  };
+
+  std::set<std::string> _ids;  // created in the module, hide builtins
+  std::vector<Frame> _frames;
+
+  utils::Uptr<ast::Block> Recognize(ast::While *while_stmt);
+  void Remark(const std::string &message);
+  void Sized(const ast::Block *block, const ast::Statement *stmt);
+  void VisitFrame(ast::Create *create, ast::CallOperator *args,
+                  ast::Block *body);
+
+ public:
+  Idioms operator()(ast::Module *module);
+
+ private:
+  virtual void Visit(ast::Block *) override;
+  virtual void Visit(ast::Try *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override;
+};
+
+}  // namespace pass
+
+#endif  // _XULANG_SRC_PASS_IDIOM_HPP
@@ -0,0 +1,584 @@
+#include "./inline.hpp"
+
+#include <functional>
+
+#include "../ast/clone.hpp"
+#include "../builtin/names.hpp"
+#include "./dse.hpp"
+
+namespace pass {
+
+static utils::Uptr<ast::Name> MakeName(const std::string &id,
+                                       const ast::Binding &binding = {}) {
+  auto name = std::make_unique<ast::Name>(std::make_unique<ast::TextType>(id));
+  name->binding = binding;
+  return name;
+}
+
+// e.g. Auto(val), Int()
+static utils::Uptr<ast::CallExpr> MakeCall(
+    const std::string &type, utils::Uptr<ast::Expression> &&val = nullptr) {
+  auto args = std::make_unique<ast::CallOperator>();
+  if (val != nullptr) args->AddUnamed(std::move(val));
+  return std::make_unique<ast::CallExpr>(
+      MakeName(type, {ast::Binding::kBuiltin, 0, builtin::FindBuiltin(type)}),
+      std::move(args));
+}
+
+// A default which is the same wherever it is evaluated, e.g. Int() but not
+// Array()
+static bool IsValueDefault(const ast::Expression *expr) {
+  if (dynamic_cast<const ast::Literal *>(expr) != nullptr) return true;
+  auto call = dynamic_cast<const ast::CallExpr *>(expr);
+  if (call == nullptr || !IsPure(call, SlotTypes())) return false;
+  auto callee = static_cast<const ast::Name *>(call->obj.get());
+  return callee->binding.kind == ast::Binding::kBuiltin &&
+         !builtin::kBuiltins[callee->binding.slot].is_alloc;
+}
+
+// Every Return is the last statement of a block which is at the end of the
+// body, e.g. in both branches of the last If
+static bool ReturnsAtEnd(const ast::Block *block, bool at_end) {
+  const auto &stmts = block->statements;
+  for (auto it = stmts.begin(); it != stmts.end(); ++it) {
+    auto last = at_end && std::next(it) == stmts.end();
+    auto stmt = it->get();
+    if (dynamic_cast<const ast::Return *>(stmt) != nullptr) {
+      if (!last) return false;
+    } else if (auto if_stmt = dynamic_cast<const ast::If *>(stmt)) {
+      if (!ReturnsAtEnd(if_stmt->body.get(), last)) return false;
+      if (if_stmt->orelse && !ReturnsAtEnd(if_stmt->orelse.get(), last)) {
+        return false;
+      }
+    } else if (auto while_stmt = dynamic_cast<const ast::While *>(stmt)) {
+      if (!ReturnsAtEnd(while_stmt->body.get(), false)) return false;
+      if (while_stmt->orelse &&
+          !ReturnsAtEnd(while_stmt->orelse.get(), false)) {
+        return false;
+      }
+    } else if (auto try_stmt = dynamic_cast<const ast::Try *>(stmt)) {
+      if (!ReturnsAtEnd(try_stmt->body.get(), false)) return false;
+      for (const auto &x : try_stmt->excepts) {
+        if (!ReturnsAtEnd(std::get<2>(x).get(), false)) return false;
+      }
+      if (try_stmt->orelse && !ReturnsAtEnd(try_stmt->orelse.get(), false)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Every path through the block ends with a Return
+static bool AlwaysReturns(const ast::Block *block) {
+  if (block->statements.empty()) return false;
+  auto last = block->statements.back().get();
+  if (dynamic_cast<const ast::Return *>(last) != nullptr) return true;
+  auto if_stmt = dynamic_cast<const ast::If *>(last);
+  return if_stmt != nullptr && if_stmt->orelse != nullptr &&
+         AlwaysReturns(if_stmt->body.get()) &&
+         AlwaysReturns(if_stmt->orelse.get());
+}
+
+// Replace the Returns of ReturnsAtEnd, nullptr removes them
+static void ReplaceReturns(
+    ast::Block *block,
+    const std::function<utils::Uptr<ast::Statement>(ast::Return *)> &func) {
+  if (block == nullptr || block->statements.empty()) return;
+  auto &last = block->statements.back();
+  if (auto ret = dynamic_cast<ast::Return *>(last.get())) {
+    last = func(ret);
+    if (last == nullptr) block->statements.pop_back();
+  } else if (auto if_stmt = dynamic_cast<ast::If *>(last.get())) {
+    ReplaceReturns(if_stmt->body.get(), func);
+    ReplaceReturns(if_stmt->orelse.get(), func);
+  }
+}
+
+// The Module objs an obj refers to, the edges of the call graph
+class References final : public ast::Walker {
+ public:
+  std::set<int> objs;
+
+  virtual void Visit(ast::Name *name) override {
+    if (name->parent == nullptr &&
+        name->binding.kind == ast::Binding::kGlobal &&
+        name->binding.slot >= 0) {
+      objs.insert(name->binding.slot);
+    }
+    ast::Walker::Visit(name);
+  }
+};
+
+// The module objs and builtins a body refers to, which a local of the
+// caller with the same id would hide once it is inlined
+class FreeIds final : public ast::Walker {
+ public:
+  std::set<std::string> ids;
+
+  virtual void Visit(ast::Name *name) override {
+    if (name->parent == nullptr &&
+        (name->binding.kind == ast::Binding::kGlobal ||
+         name->binding.kind == ast::Binding::kBuiltin)) {
+      ids.insert(*name->id);
+    }
+    ast::Walker::Visit(name);
+  }
+};
+
+// The ids a frame binds, its params aside
+class BoundIds final : public ast::Walker {
+ public:
+  std::set<std::string> ids;
+
+  virtual void Visit(ast::ObjCreate *create) override {
+    ids.insert(*create->id);
+    ast::Walker::Visit(create);
+  }
+  virtual void Visit(ast::Try *try_stmt) override {
+    for (const auto &x : try_stmt->excepts) {
+      if (std::get<0>(x) != nullptr) ids.insert(*std::get<0>(x));
+    }
+    ast::Walker::Visit(try_stmt);
+  }
+  virtual void Visit(ast::Function *func) override { ids.insert(*func->id); }
+  virtual void Visit(ast::Assemble *assemble) override {
+    ids.insert(*assemble->id);
+  }
+  virtual void Visit(ast::Struct *struct_create) override {
+    ids.insert(*struct_create->id);
+  }
+  virtual void Visit(ast::Class *class_create) override {
+    ids.insert(*class_create->id);
+  }
+  virtual void Visit(ast::Import *import) override { ids.insert(*import->id); }
+};
+
+// The locals of a frame which are assigned or taken by &, and whether it
+// creates anything but objects
+class Changes final : public ast::Walker {
+ public:
+  std::set<int> slots;
+  bool creates = false;
+
+ private:
+  void Change(const ast::Expression *expr) {
+    auto name = dynamic_cast<const ast::Name *>(expr);
+    if (name != nullptr && name->parent == nullptr &&
+        name->binding.kind == ast::Binding::kLocal &&
+        name->binding.depth == 0) {
+      slots.insert(name->binding.slot);
+    }
+  }
+
+ public:
+  virtual void Visit(ast::BinaryOpExpr *expr) override {
+    auto op = std::string(expr->op->GetName());
+    if (op == "__assign__" || op.rfind("__self_", 0) == 0) {
+      Change(expr->left.get());
+    }
+    ast::Walker::Visit(expr);
+  }
+  virtual void Visit(ast::UnaryOpExpr *expr) override {
+    if (std::string(expr->op->GetName()) == "__ref__") {
+      Change(expr->right.get());
+    }
+    ast::Walker::Visit(expr);
+  }
+  virtual void Visit(ast::Function *) override { creates = true; }
+  virtual void Visit(ast::Assemble *) override { creates = true; }
+  virtual void Visit(ast::Struct *) override { creates = true; }
+  virtual void Visit(ast::Class *) override { creates = true; }
+  virtual void Visit(ast::Import *) override { creates = true; }
+};
+
+// Give the locals of an inlined body their ids in the caller. A parameter
+// may be replaced by a local of the caller.
+class Renamer final : public ast::Walker {
+ public:
+  std::string prefix;
+  std::unordered_map<int, std::pair<std::string, ast::Binding>> args;
+
+  virtual void Visit(ast::Name *name) override {
+    const auto &binding = name->binding;
+    if (name->parent == nullptr && binding.kind == ast::Binding::kLocal &&
+        binding.depth == 0) {
+      auto arg = args.find(binding.slot);
+      if (arg == args.end()) {
+        *name->id = prefix + *name->id;
+      } else {
+        *name->id = arg->second.first;
+        name->binding = arg->second.second;
+      }
+    }
+    ast::Walker::Visit(name);
+  }
+  virtual void Visit(ast::ObjCreate *create) override {
+    *create->id = prefix + *create->id;
+    ast::Walker::Visit(create);
+  }
+  virtual void Visit(ast::Try *try_stmt) override {
+    for (auto &x : try_stmt->excepts) {
+      *std::get<0>(x) = prefix + *std::get<0>(x);
+    }
+    ast::Walker::Visit(try_stmt);
+  }
+};
+
+Inlining Inliner::operator()(ast::Module *module) {
+  auto res = Inlining();
+  _res = &res;
+  _module = module;
+  _where = module->filename;
+  _path.clear();
+  _objs.clear();
+  for (const auto &obj : module->objs) _objs.push_back(obj.get());
+  _callees.clear();
+  _captured = FindCaptured(module);
+  _frames.clear();
+
+  // Callees first, so their size is the one after inlining into them
+  auto order = std::vector<int>();
+  FindRecursive(&order);
+  res.recursive = static_cast<int>(_recursive.size());
+  for (auto idx : order) Walk(_objs[idx]);
+  return res;
+}
+
+// Tarjan's strongly connected components of the call graph, which come out
+// callees first
+void Inliner::FindRecursive(std::vector<int> *order) {
+  auto edges = std::vector<std::set<int>>();
+  for (auto obj : _objs) {
+    auto refs = References();
+    refs.Walk(obj);
+    edges.push_back(std::move(refs.objs));
+  }
+
+  auto n = static_cast<int>(_objs.size());
+  auto index = std::vector<int>(n, -1), low = std::vector<int>(n, 0);
+  auto on_stack = std::vector<bool>(n, false);
+  auto stack = std::vector<int>();
+  auto count = 0;
+  _recursive.clear();
+
+  std::function<void(int)> connect = [&](int v) {
+    index[v] = low[v] = count++;
+    stack.push_back(v);
+    on_stack[v] = true;
+    for (auto w : edges[v]) {
+      if (w >= n) continue;
+      if (index[w] < 0) {
+        connect(w);
+        low[v] = std::min(low[v], low[w]);
+      } else if (on_stack[w]) {
+        low[v] = std::min(low[v], index[w]);
+      }
+    }
+    if (low[v] != index[v]) return;
+
+    auto component = std::vector<int>();
+    int w;
+    do {
+      w = stack.back();
+      stack.pop_back();
+      on_stack[w] = false;
+      component.push_back(w);
+    } while (w != v);
+    for (auto x : component) {
+      if (component.size() > 1 || edges[x].count(x)) _recursive.insert(x);
+      order->push_back(x);
+    }
+  };
+  for (auto v = 0; v < n; ++v) {
+    if (index[v] < 0) connect(v);
+  }
+}
+
+const Inliner::Callee *Inliner::FindCallee(const ast::CallExpr *call) {
+  auto name = dynamic_cast<const ast::Name *>(call->obj.get());
+  if (name == nullptr || name->parent != nullptr ||
+      name->binding.kind != ast::Binding::kGlobal || name->binding.slot < 0 ||
+      name->binding.slot >= static_cast<int>(_objs.size())) {
+    return nullptr;
+  }
+  auto slot = name->binding.slot;
+  auto func = dynamic_cast<ast::Function *>(_objs[slot]);
+  if (func == nullptr) return nullptr;
+
+  auto found = _callees.find(slot);
+  if (found != _callees.end()) {
+    return found->second.why == nullptr ? &found->second : nullptr;
+  }
+
+  auto &callee = _callees[slot];
+  callee.func = func;
+  auto changes = Changes();
+  changes.Walk(func->body.get());
+  auto size = ast::CountNodes(func->body.get());
+  const auto &stmts = func->body->statements;
+
+  auto unamed = func->args->unameds.begin();
+  if (unamed != func->args->unameds.end()) ++unamed;  // the return type
+  for (; unamed != func->args->unameds.end(); ++unamed) {
+    auto param = dynamic_cast<ast::Name *>(unamed->get());
+    if (param == nullptr) {
+      callee.why = "a parameter is not an id";
+      break;
+    }
+    callee.params.push_back(*param->id);
+    callee.defaults.push_back(nullptr);
+  }
+  for (const auto &x : func->args->keywords) {
+    callee.params.push_back(*std::get<0>(x));
+    callee.defaults.push_back(std::get<1>(x).get());
+  }
+  for (auto slot : changes.slots) {
+    if (slot < static_cast<int>(callee.params.size())) {
+      callee.set_params.insert(slot);
+    }
+  }
+  callee.single_return =
+      !stmts.empty() && dynamic_cast<ast::Return *>(stmts.back().get());
+
+  if (callee.why != nullptr) {
+  } else if (_recursive.count(slot)) {
+    callee.why = "it may call itself";
+  } else if (size > _max_size) {
+    callee.why = "it is too large";
+  } else if (changes.creates) {
+    callee.why = "it creates nested objects";
+  } else if (!ReturnsAtEnd(func->body.get(), true)) {
+    callee.why = "it returns before its end";
+  }
+  if (callee.why == nullptr) return &callee;
+  Remark(*func->id + " is not inlined, " + callee.why + " (" +
+         std::to_string(size) + " nodes)");
+  return nullptr;
+}
+
+utils::Uptr<ast::Block> Inliner::Inline(ast::Statement *stmt) {
+  if (_frames.empty()) return nullptr;
+  auto site = Site::kUnused;
+  ast::CallExpr *call = nullptr;
+  ast::BinaryOpExpr *assign = nullptr;
+  auto create = dynamic_cast<ast::ObjCreate *>(stmt);
+  if (auto expr_stmt = dynamic_cast<ast::ExprStatement *>(stmt)) {
+    call = dynamic_cast<ast::CallExpr *>(expr_stmt->expr.get());
+    assign = dynamic_cast<ast::BinaryOpExpr *>(expr_stmt->expr.get());
+    if (call == nullptr && assign != nullptr &&
+        std::string(assign->op->GetName()) == "__assign__" &&
+        dynamic_cast<ast::Name *>(assign->left.get()) != nullptr) {
+      site = Site::kAssign;
+      call = dynamic_cast<ast::CallExpr *>(assign->right.get());
+    }
+  } else if (create != nullptr) {
+    site = Site::kCreate;
+    call = create->call_expr.get();
+  } else if (auto ret = dynamic_cast<ast::Return *>(stmt)) {
+    site = Site::kReturn;
+    call = dynamic_cast<ast::CallExpr *>(ret->expr.get());
+  }
+  if (call == nullptr) return nullptr;
+  auto callee = FindCallee(call);
+  if (callee == nullptr) return nullptr;
+
+  // The value needs a single return, or a local every path sets
+  auto uses_value = site == Site::kAssign || site == Site::kCreate;
+  auto ret_var = uses_value && !callee->single_return;
+  const auto &body_stmts = callee->func->body->statements;
+  if (uses_value && callee->single_return &&
+      static_cast<ast::Return *>(body_stmts.back().get())->expr == nullptr) {
+    return nullptr;
+  }
+  if (ret_var && !AlwaysReturns(callee->func->body.get())) return nullptr;
+
+  // A module obj or builtin the callee uses must not become a local of the
+  // caller with the same id
+  auto free_ids = FreeIds();
+  free_ids.Walk(callee->func->body.get());
+  for (const auto &id : free_ids.ids) {
+    if (_bound.back().count(id)) return nullptr;
+  }
+
+  // Positional args first, then the keywords by id. The params are bound
+  // in the order the args are evaluated, then the defaults.
+  auto nparams = callee->params.size();
+  auto args = std::vector<utils::Uptr<ast::Expression> *>(nparams, nullptr);
+  auto order = std::vector<size_t>();
+  auto all_pure = true;
+  for (auto &x : call->op->unameds) {
+    auto k = order.size();
+    if (k >= nparams) return nullptr;
+    all_pure = all_pure && IsPure(x.get(), SlotTypes());
+    args[k] = &x;
+    order.push_back(k);
+  }
+  for (auto &x : call->op->keywords) {
+    auto param = std::find(callee->params.begin(), callee->params.end(),
+                           *std::get<0>(x));
+    if (param == callee->params.end()) return nullptr;
+    auto k = static_cast<size_t>(param - callee->params.begin());
+    if (args[k] != nullptr) return nullptr;
+    all_pure = all_pure && IsPure(std::get<1>(x).get(), SlotTypes());
+    args[k] = &std::get<1>(x);
+    order.push_back(k);
+  }
+  for (size_t k = 0; k < nparams; ++k) {
+    if (args[k] != nullptr) continue;
+    if (callee->defaults[k] == nullptr ||
+        !IsValueDefault(callee->defaults[k])) {
+      return nullptr;
+    }
+    order.push_back(k);
+  }
+
+  const auto &id = *callee->func->id;
+  auto res = std::make_unique<ast::Block>();
+  auto renamer = Renamer();
+  auto ret_id = "_" + id + std::to_string(_count++);
+  renamer.prefix = ret_id + "_";
+
+  // e.g. _access0_idx := Int(i), or i itself
+  const auto &captured = _captured[_frames.back()];
+  for (auto k : order) {
+    auto arg = args[k] ? dynamic_cast<ast::Name *>(args[k]->get()) : nullptr;
+    if (arg != nullptr && arg->parent == nullptr && all_pure &&
+        !callee->set_params.count(k) &&
+        ((arg->binding.kind == ast::Binding::kLocal &&
+          arg->binding.depth == 0 && !captured.count(arg->binding.slot)) ||
+         arg->binding.kind == ast::Binding::kBuiltin)) {
+      renamer.args[static_cast<int>(k)] = {*arg->id, arg->binding};
+      continue;
+    }
+
+    // Args are bound as they are, Array(arg) would make a new one
+    utils::Uptr<ast::CallExpr> init;
+    if (args[k] != nullptr) {
+      init = MakeCall("Auto", std::move(*args[k]));
+    } else if (auto call_default =
+                   dynamic_cast<ast::CallExpr *>(callee->defaults[k])) {
+      init = ast::Cloner()(call_default);
+    } else {
+      init = MakeCall("Auto", ast::Cloner()(callee->defaults[k]));
+    }
+    res->AddStatement(std::make_unique<ast::ObjCreate>(
+        std::make_unique<ast::TextType>(renamer.prefix + callee->params[k]),
+        std::move(init)));
+  }
+
+  auto body = ast::Cloner()(callee->func->body.get());
+  renamer.Walk(body.get());
+
+  // Return turns into the value of the site
+  utils::Uptr<ast::Expression> value;
+  if (site == Site::kUnused) {
+    ReplaceReturns(body.get(), [](ast::Return *ret) {
+      return ret->expr == nullptr ? nullptr
+                                  : std::make_unique<ast::ExprStatement>(
+                                        std::move(ret->expr));
+    });
+  } else if (site == Site::kReturn) {
+    if (!AlwaysReturns(body.get())) {
+      body->AddStatement(std::make_unique<ast::Return>());
+    }
+  } else if (!ret_var) {
+    auto ret = static_cast<ast::Return *>(body->statements.back().get());
+    value = std::move(ret->expr);
+    body->statements.pop_back();
+  } else {
+    res->AddStatement(std::make_unique<ast::ObjCreate>(
+        std::make_unique<ast::TextType>(ret_id), MakeCall("Auto")));
+    ReplaceReturns(body.get(), [&](ast::Return *ret) {
+      return ret->expr == nullptr
+                 ? nullptr
+                 : std::make_unique<ast::ExprStatement>(
+                       std::make_unique<ast::BinaryOpExpr>(
+                           MakeName(ret_id), std::make_unique<ast::OpAssign>(),
+                           std::move(ret->expr)));
+    });
+    value = MakeName(ret_id);
+  }
+  res->statements.splice(res->statements.end(), body->statements);
+
+  if (site == Site::kAssign) {
+    res->AddStatement(
+        std::make_unique<ast::ExprStatement>(std::make_unique<ast::BinaryOpExpr>(
+            std::move(assign->left), std::make_unique<ast::OpAssign>(),
+            std::move(value))));
+  } else if (site == Site::kCreate) {
+    auto new_create = std::make_unique<ast::ObjCreate>(
+        std::move(create->id), MakeCall("Auto", std::move(value)));
+    new_create->binding = create->binding;
+    res->AddStatement(std::move(new_create));
+  }
+
+  ++_res->inlined;
+  Remark("inlined " + id + " as " + ret_id);
+  return res;
+}
+
+void Inliner::Remark(const std::string &message) {
+  auto where = _where;
+  for (size_t i = 0; i < _path.size(); ++i) {
+    where += (i == 0 ? ": " : ".") + _path[i];
+  }
+  _res->remarks.push_back({"inline", where, message});
+}
+
+void Inliner::Visit(ast::Block *block) {
+  auto &stmts = block->statements;
+  for (auto it = stmts.begin(); it != stmts.end();) {
+    auto inlined = Inline(it->get());
+    if (inlined == nullptr) {
+      Walk((it++)->get());
+      continue;
+    }
+    // The callee is done already, its body needs no more inlining
+    stmts.splice(it, inlined->statements);
+    it = stmts.erase(it);
+  }
+}
+
+void Inliner::VisitFrame(ast::Create *create, ast::CallOperator *args,
+                         ast::Block *body) {
+  auto bound = BoundIds();
+  for (auto &stmt : body->statements) bound.Walk(stmt.get());
+  if (args != nullptr) {
+    for (const auto &x : args->unameds) {
+      auto param = dynamic_cast<ast::Name *>(x.get());
+      if (param != nullptr && param->parent == nullptr) {
+        bound.ids.insert(*param->id);
+      }
+    }
+    for (const auto &x : args->keywords) bound.ids.insert(*std::get<0>(x));
+  }
+
+  _frames.push_back(create);
+  _bound.push_back(std::move(bound.ids));
+  _path.push_back(*create->GetId());
+  Walk(body);
+  _path.pop_back();
+  _bound.pop_back();
+  _frames.pop_back();
+}
+
+void Inliner::Visit(ast::Function *func) {
+  VisitFrame(func, func->args.get(), func->body.get());
+}
+
+void Inliner::Visit(ast::Assemble *assemble) {
+  VisitFrame(assemble, assemble->args.get(), assemble->body.get());
+}
+
+void Inliner::Visit(ast::Struct *struct_create) {
+  VisitFrame(struct_create, nullptr, struct_create->body.get());
+}
+
+void Inliner::Visit(ast::Class *class_create) {
+  VisitFrame(class_create, nullptr, class_create->body.get());
+}
+
+void Inliner::Visit(ast::Import *) {}
+
+}  // namespace pass
@@ -0,0 +1,82 @@
+#ifndef _XULANG_SRC_PASS_INLINE_HPP
+#define _XULANG_SRC_PASS_INLINE_HPP
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/walker.hpp"
+#include "./pass.hpp"
+
+namespace pass {
+
+struct Inlining {
+  int inlined = 0;  // calls replaced by the body of their callee
+  int recursive = 0;  // module Functions which may call themselves
+  Remarks remarks;
+};
+
+// Replace the calls of small module level Functions by their bodies, after
+// pass::Resolver. Callees are done before their callers, and Functions in a
+// cycle of the call graph are never inlined. A call is inlined when it is a
+// whole statement, f(...), x = f(...), x := f(...) or return f(...), and
+// every Return of the callee ends it, e.g. the last statement of the body or
+// of both branches of a last If. Each parameter becomes a new local
+// initialized by Auto(arg), as a call binds it, or by its default, or is the
+// arg itself if it is a local the callee never sets. The locals of the
+// callee get new ids so they cannot hide the ones of the caller, and a
+// callee using a module obj or builtin whose id the caller binds is not
+// inlined. Run pass::Resolver again afterwards.
+class Inliner final : private ast::Walker {
+ public:
+  static constexpr size_t kDefaultMaxSize = 40;  // ast::CountNodes of a body
+
+ private:
+  struct Callee {
+    ast::Function *func = nullptr;
+    const char *why = nullptr;  // not inlinable
+    std::vector<std::string> params;
+    std::vector<ast::Expression *> defaults;  // nullptr for unamed params
+    std::set<int> set_params;                 // assigned or taken by &
+    bool single_return = false;  // the only Return is the last statement
+  };
+
+  // The kinds of statement a call can be inlined into
+  enum class Site { kUnused, kAssign, kCreate, kReturn };
+
+  size_t _max_size;
+  std::string _where;
+  std::vector<std::string> _path;
+  Inlining *_res;
+  ast::Module *_module;
+  std::vector<ast::Create *> _objs;  // of the module, by index
+  std::set<int> _recursive;          // Module objs indices
+  std::unordered_map<int, Callee> _callees;
+  std::unordered_map<const ast::Create *, std::set<int>> _captured;
+  std::vector<ast::Create *> _frames;
+  std::vector<std::set<std::string>> _bound;  // ids of each frame
+  int _count = 0;
+
+  void FindRecursive(std::vector<int> *order);
+  const Callee *FindCallee(const ast::CallExpr *call);
+  utils::Uptr<ast::Block> Inline(ast::Statement *stmt);
+  void Remark(const std::string &message);
+  void VisitFrame(ast::Create *create, ast::CallOperator *args,
+                  ast::Block *body);
+
+ public:
+  explicit Inliner(size_t max_size = kDefaultMaxSize) : _max_size(max_size) {}
+  Inlining operator()(ast::Module *module);
+
+ private:
+  virtual void Visit(ast::Block *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override;
+};
+
+}  // namespace pass
+
+#endif  // _XULANG_SRC_PASS_INLINE_HPP
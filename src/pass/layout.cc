@@ -0,0 +1,298 @@
+#include "./layout.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+namespace pass {
+
+static inline size_t AlignUp(size_t at, size_t align) {
+  return (at + align - 1) / align * align;
+}
+
+// e.g. ast.Ast of Class(ast.Ast)
+static std::string NameOf(const ast::Expression *expr) {
+  auto name = dynamic_cast<const ast::Name *>(expr);
+  if (name == nullptr) return "";
+  if (name->parent == nullptr) return *name->id;
+  auto parent = NameOf(name->parent.get());
+  return parent.empty() ? "" : parent + (name->deref ? "->" : ".") + *name->id;
+}
+
+static ast::Block *BodyOf(ast::Create *decl) {
+  if (auto s = dynamic_cast<ast::Struct *>(decl)) return s->body.get();
+  return static_cast<ast::Class *>(decl)->body.get();
+}
+
+const Layout::Field *Layout::Find(const std::string &id) const {
+  // A field of the class hides the one of a base
+  for (auto it = fields.rbegin(); it != fields.rend(); ++it) {
+    if (it->id == id) return &*it;
+  }
+  return nullptr;
+}
+
+const Layout *Layouts::Find(const std::string &name) const {
+  for (const auto &type : types) {
+    if (type.name == name) return &type;
+  }
+  return nullptr;
+}
+
+std::string Layouts::Dump() const {
+  auto out = std::ostringstream();
+  for (const auto &type : types) {
+    out << type.name << ": " << (type.is_class ? "Class" : "Struct") << ", "
+        << type.size << " bytes, align " << type.align;
+    if (type.source_size > type.size) {
+      out << ", " << type.source_size - type.size << " saved";
+    }
+    out << "\n";
+    auto base = type.bases.begin();
+    size_t end = 0;
+    for (const auto &field : type.fields) {
+      if (field.offset > end) {
+        out << "  " << end << ": " << field.offset - end << " bytes padding\n";
+      }
+      for (; base != type.bases.end() && base->offset <= field.offset; ++base) {
+        out << "  " << base->offset << ": base " << base->name << "\n";
+      }
+      out << "  " << field.offset << ": " << field.owner << "." << field.id
+          << " " << field.type << ", size " << field.size;
+      if (field.uses != 0) out << ", " << field.uses << " uses";
+      out << "\n";
+      end = field.offset + field.size;
+    }
+    for (; base != type.bases.end(); ++base) {
+      out << "  " << base->offset << ": base " << base->name << "\n";
+    }
+    if (type.size > end) {
+      out << "  " << end << ": " << type.size - end << " bytes padding\n";
+    }
+  }
+  return out.str();
+}
+
+Layouts LayoutEngine::operator()(ast::Module *module) {
+  auto res = Layouts();
+  _res = &res;
+  _where = module->filename;
+  _types.clear();
+  for (const auto &obj : module->objs) {
+    if (dynamic_cast<ast::Struct *>(obj.get()) == nullptr &&
+        dynamic_cast<ast::Class *>(obj.get()) == nullptr) {
+      continue;
+    }
+    auto name = *obj->GetId();
+    if (_types.count(name)) continue;  // resolve remarks it
+    _types[name] = {obj.get(), 0, res.types.size()};
+    res.types.emplace_back().name = name;
+  }
+
+  _bases.clear();
+  for (const auto &obj : module->objs) {
+    if (dynamic_cast<ast::Class *>(obj.get()) != nullptr) {
+      _bases[*obj->GetId()] = Bases(*obj->GetId());
+    }
+  }
+
+  // A member is used through its own type and every one deriving from it
+  _uses.clear();
+  if (_profile != nullptr) {
+    for (const auto &[key, uses] : *_profile) {
+      auto dot = key.rfind('.');
+      if (dot == std::string::npos) continue;
+      auto type = key.substr(0, dot);
+      auto id = key.substr(dot);
+      _uses[type + id] += uses;
+      for (const auto &base : _bases[type]) _uses[base + id] += uses;
+    }
+  }
+
+  for (const auto &obj : module->objs) {
+    auto found = _types.find(*obj->GetId());
+    if (found != _types.end() && found->second.decl == obj.get()) {
+      LayOut(found->first);
+    }
+  }
+  return res;
+}
+
+// The bases of a Class, those of each base before it, each once
+std::vector<std::string> LayoutEngine::Bases(const std::string &name) {
+  auto res = std::vector<std::string>();
+  auto seen = std::unordered_map<std::string, bool>();  // false while open
+  auto visit = [&](const std::string &type, auto &&visit) -> void {
+    auto found = _types.find(type);
+    auto cls = found == _types.end()
+                   ? nullptr
+                   : dynamic_cast<ast::Class *>(found->second.decl);
+    if (cls == nullptr || cls->parents == nullptr) return;
+    seen[type] = false;
+    for (const auto &parent : cls->parents->unameds) {
+      auto base = NameOf(parent.get());
+      auto was = seen.find(base);
+      if (was != seen.end()) {
+        if (!was->second) Remark(name + " derives from itself through " + base);
+        continue;
+      }
+      visit(base, visit);
+      seen[base] = true;
+      res.push_back(base);
+    }
+    seen[type] = true;
+  };
+  visit(name, visit);
+  return res;
+}
+
+const Layout *LayoutEngine::LayOut(const std::string &name) {
+  auto found = _types.find(name);
+  if (found == _types.end()) return nullptr;
+  auto &type = found->second;
+  auto layout = &_res->types[type.index];
+  if (type.state == 2) return layout;
+  if (type.state == 1) return nullptr;
+  type.state = 1;
+
+  auto cls = dynamic_cast<ast::Class *>(type.decl);
+  // The fields each type declares, the bases first
+  auto groups =
+      std::vector<std::pair<std::string, std::vector<Layout::Field>>>();
+  if (cls != nullptr) {
+    for (const auto &base : _bases[name]) {
+      if (base == "Error" || _types.count(base)) {
+        groups.emplace_back(base, Declared(base));
+      } else {
+        Remark(name + " derives from " + base +
+               " outside the module, its fields are left out");
+      }
+    }
+  }
+  groups.emplace_back(name, Declared(name));
+
+  auto header = Layout::Field{"__class__", "Ptr", name, 0, 8, 8};
+  layout->is_class = cls != nullptr;
+  layout->align = 1;
+  size_t end = 0;
+  auto source = Layout();
+  size_t source_end = 0;
+  if (layout->is_class) {
+    Place({header}, false, layout, &end);
+    Place({header}, false, &source, &source_end);
+  }
+  // Only the fields the type declares count as reordered, those of the
+  // bases are reported with the bases
+  auto reordered = false;
+  for (const auto &[owner, fields] : groups) {
+    auto first = layout->fields.size();
+    auto moved = Place(fields, true, layout, &end);
+    if (owner == name) reordered = moved;
+    if (owner != name) {
+      auto at = first < layout->fields.size() ? layout->fields[first].offset
+                                              : end;
+      layout->bases.push_back({owner, at});
+    }
+    Place(fields, false, &source, &source_end);
+  }
+  layout->size = AlignUp(end, layout->align);
+  layout->source_size = AlignUp(source_end, source.align);
+
+  if (reordered) {
+    ++_res->reordered;
+    // Hot fields first may take more
+    if (layout->source_size > layout->size) {
+      _res->saved += layout->source_size - layout->size;
+    }
+    Remark(name + " reordered, " + std::to_string(layout->size) +
+           " bytes, " + std::to_string(layout->source_size) +
+           " in source order");
+  }
+  type.state = 2;
+  return layout;
+}
+
+// The fields a Struct or Class declares itself, in source order
+std::vector<Layout::Field> LayoutEngine::Declared(const std::string &name) {
+  auto res = std::vector<Layout::Field>();
+  auto uses = [&](const std::string &id) -> uint64_t {
+    auto found = _uses.find(name + "." + id);
+    return found == _uses.end() ? 0 : found->second;
+  };
+  if (!_types.count(name)) {
+    // Error is the only builtin a Class derives from
+    res.push_back({"message", "String", name, 0, 8, 8, uses("message")});
+    return res;
+  }
+
+  for (const auto &stmt : BodyOf(_types[name].decl)->statements) {
+    auto member = dynamic_cast<ast::ObjCreate *>(stmt.get());
+    if (member == nullptr) continue;  // methods and nested types
+    auto type = NameOf(member->call_expr->obj.get());
+    auto field =
+        Layout::Field{*member->id, type, name, 0, 8, 8, uses(*member->id)};
+    if (field.type == "Int8") {
+      field.size = field.align = 1;
+    } else if (auto found = _types.find(field.type);
+               found != _types.end() &&
+               dynamic_cast<ast::Struct *>(found->second.decl) != nullptr) {
+      auto held = LayOut(field.type);
+      if (held == nullptr) {
+        Remark(name + "." + field.id + " holds " + field.type +
+               " within itself, it is taken as a reference");
+      } else {
+        field.size = held->size;
+        field.align = held->align;
+      }
+    }
+    // Int, Float and Ptr take 8 bytes, anything else is a reference
+    res.push_back(field);
+  }
+  return res;
+}
+
+// Set the offsets of fields from *end on, in source order or else by
+// decreasing alignment with the hot ones first, true if they moved
+bool LayoutEngine::Place(std::vector<Layout::Field> fields, bool reorder,
+                         Layout *layout, size_t *end) {
+  auto source = fields;
+  if (reorder) {
+    uint64_t most = 0;
+    for (const auto &field : fields) most = std::max(most, field.uses);
+    auto hot = [&](const Layout::Field &field) {
+      return most != 0 && field.uses * kHotRatio >= most;
+    };
+    std::stable_sort(fields.begin(), fields.end(),
+                     [&](const Layout::Field &a, const Layout::Field &b) {
+                       if (hot(a) != hot(b)) return hot(a);
+                       if (a.align != b.align) return a.align > b.align;
+                       return a.size > b.size;
+                     });
+  }
+  for (size_t i = 0; i < fields.size(); ++i) {
+    // Fill the hole before it, left by a base or a hot field
+    for (auto j = i + 1; reorder && j < fields.size(); ++j) {
+      auto at = AlignUp(*end, fields[j].align);
+      if (at + fields[j].size <= AlignUp(*end, fields[i].align) &&
+          fields[j].size != 0) {
+        std::rotate(fields.begin() + i, fields.begin() + j,
+                    fields.begin() + j + 1);
+        break;
+      }
+    }
+    auto &field = fields[i];
+    field.offset = AlignUp(*end, field.align);
+    *end = field.offset + field.size;
+    layout->align = std::max(layout->align, field.align);
+    layout->fields.push_back(field);
+  }
+  for (size_t i = 0; i < fields.size(); ++i) {
+    if (fields[i].id != source[i].id) return true;
+  }
+  return false;
+}
+
+void LayoutEngine::Remark(const std::string &message) {
+  _res->remarks.push_back({"layout", _where, message});
+}
+
+}  // namespace pass
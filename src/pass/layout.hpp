@@ -0,0 +1,98 @@
+#ifndef _XULANG_SRC_PASS_LAYOUT_HPP
+#define _XULANG_SRC_PASS_LAYOUT_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/statement.hpp"
+#include "./pass.hpp"
+
+namespace pass {
+
+// Where each member of a Struct or Class goes in a native object
+struct Layout {
+  struct Field {
+    std::string id;
+    std::string type;   // e.g. Int, or a Struct held in place
+    std::string owner;  // the Struct or Class declaring it
+    size_t offset = 0;
+    size_t size = 0;
+    size_t align = 1;
+    uint64_t uses = 0;  // in the profile
+  };
+  // The fields of a base, or the header, start at offset
+  struct Base {
+    std::string name;
+    size_t offset;
+  };
+
+  std::string name;
+  bool is_class = false;
+  size_t size = 0;
+  size_t align = 1;
+  size_t source_size = 0;  // with every field in source order
+  std::vector<Base> bases;
+  std::vector<Field> fields;  // by offset, those of the bases included
+
+  const Field *Find(const std::string &id) const;
+};
+
+struct Layouts {
+  std::vector<Layout> types;  // in the order the module declares them
+  int reordered = 0;          // types whose fields moved
+  size_t saved = 0;           // bytes, over source order
+  Remarks remarks;
+
+  const Layout *Find(const std::string &name) const;
+  std::string Dump() const;
+};
+
+// Member accesses by "Type.member", e.g. from xlrun --profile
+using Profile = std::unordered_map<std::string, uint64_t>;
+
+// Lay out the Structs and Classes of a module for native code, where Int,
+// Float and Ptr take 8 bytes, Int8 one, a Struct of the module is held in
+// place and anything else is a reference of 8 bytes. A Class starts with a
+// reference to its class, then come its bases as Class(A, B) lists them,
+// each with its own bases first. A base reached twice, e.g. through both A
+// and B, is laid out once where it is first reached. The fields a type
+// declares stay together after its bases, ordered by decreasing alignment
+// so that padding is only needed at the end. With a profile the fields used
+// at least 1/kHotRatio as much as the most used one come first, to share
+// the first cache lines. A field small enough for the hole the one before
+// leaves, e.g. at the end of a base, goes in it.
+class LayoutEngine final {
+ public:
+  static constexpr uint64_t kHotRatio = 16;
+
+  explicit LayoutEngine(const Profile *profile = nullptr)
+      : _profile(profile) {}
+  Layouts operator()(ast::Module *module);
+
+ private:
+  struct Type {
+    ast::Create *decl;
+    int state;  // 1 while being laid out, 2 once done
+    size_t index;  // in Layouts::types
+  };
+
+  const Profile *_profile;
+  std::string _where;
+  Layouts *_res;
+  std::unordered_map<std::string, Type> _types;
+  std::unordered_map<std::string, std::vector<std::string>> _bases;
+  std::unordered_map<std::string, uint64_t> _uses;  // by "Owner.member"
+
+  std::vector<std::string> Bases(const std::string &name);
+  const Layout *LayOut(const std::string &name);
+  std::vector<Layout::Field> Declared(const std::string &name);
+  bool Place(std::vector<Layout::Field> fields, bool reorder, Layout *layout,
+             size_t *end);
+  void Remark(const std::string &message);
+};
+
+}  // namespace pass
+
+#endif  // _XULANG_SRC_PASS_LAYOUT_HPP
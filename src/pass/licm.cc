@@ -0,0 +1,642 @@
+#include "./licm.hpp"
+
+#include <functional>
+
+#include "../ast/printer.hpp"
+#include "../builtin/names.hpp"
+#include "./dse.hpp"
+#include "./fold.hpp"
+
+namespace pass {
+
+static bool IsLocal(const ast::Name *name) {
+  return name->parent == nullptr &&
+         name->binding.kind == ast::Binding::kLocal && name->binding.depth == 0;
+}
+
+static utils::Uptr<ast::Name> MakeName(const std::string &id,
+                                       const ast::Binding &binding) {
+  auto name = std::make_unique<ast::Name>(std::make_unique<ast::TextType>(id));
+  name->binding = binding;
+  return name;
+}
+
+static utils::Uptr<ast::Name> MakeBuiltin(const std::string &id) {
+  return MakeName(id, {ast::Binding::kBuiltin, 0, builtin::FindBuiltin(id)});
+}
+
+// Only Literals and Names are copied, the operands of the steps
+static utils::Uptr<ast::Expression> Copy(const ast::Expression *expr) {
+  if (auto name = dynamic_cast<const ast::Name *>(expr)) {
+    return MakeName(*name->id, name->binding);
+  }
+  auto literal = static_cast<const ast::Literal *>(expr);
+  auto constant = Constant();
+  ToConstant(literal, &constant);
+  return ToLiteral(constant);
+}
+
+static bool HasName(const ast::Expression *expr) {
+  if (dynamic_cast<const ast::Name *>(expr) != nullptr) return true;
+  if (auto unary = dynamic_cast<const ast::UnaryOpExpr *>(expr)) {
+    return HasName(unary->right.get());
+  }
+  if (auto binary = dynamic_cast<const ast::BinaryOpExpr *>(expr)) {
+    return HasName(binary->left.get()) || HasName(binary->right.get());
+  }
+  if (auto logic = dynamic_cast<const ast::LogicExpr *>(expr)) {
+    return HasName(logic->left.get()) || HasName(logic->right.get());
+  }
+  if (auto if_else = dynamic_cast<const ast::IfElseExpr *>(expr)) {
+    return HasName(if_else->left.get()) || HasName(if_else->test.get()) ||
+           HasName(if_else->right.get());
+  }
+  // e.g. Int(3) does not, but the callee of a call is a Name anyway
+  return dynamic_cast<const ast::CallExpr *>(expr) != nullptr;
+}
+
+// What the test and the body of a While change, see LoopOptimizer::Loop.
+// Nested Creates are other frames and only define their own id.
+class LoopScan final : public ast::Walker {
+ public:
+  LoopOptimizer::Loop loop;
+  bool in_test = false;
+
+ private:
+  ast::Block *_block = nullptr;
+  ast::ExprStatement *_stmt = nullptr;
+  int _conditional = 0;  // in a branch the test may skip, e.g. a && (i += 1)
+
+  void Define(const ast::Binding &binding) {
+    if (binding.kind == ast::Binding::kLocal && binding.depth == 0) {
+      loop.others.insert(binding.slot);
+    }
+  }
+
+ public:
+  virtual void Visit(ast::Block *block) override {
+    auto outer = _block;
+    _block = block;
+    ast::Walker::Visit(block);
+    _block = outer;
+  }
+
+  virtual void Visit(ast::ExprStatement *stmt) override {
+    _stmt = stmt;
+    Walk(stmt->expr.get());
+    _stmt = nullptr;
+  }
+
+  virtual void Visit(ast::BinaryOpExpr *expr) override {
+    auto op = std::string(expr->op->GetName());
+    auto target = dynamic_cast<ast::Name *>(expr->left.get());
+    if (op != "__assign__" && op.rfind("__self_", 0) != 0) {
+      return ast::Walker::Visit(expr);
+    }
+    if (target == nullptr || target->parent != nullptr ||
+        target->binding.kind != ast::Binding::kLocal ||
+        target->binding.depth != 0) {
+      // e.g. a[i] = 0, obj.x = 1 or a store to an outer frame
+      loop.writes = true;
+    } else if (op == "__self_plus__" || op == "__self_minus__") {
+      auto is_stmt = _stmt != nullptr && _stmt->expr.get() == expr;
+      if ((is_stmt && !in_test) || (in_test && _conditional == 0)) {
+        loop.steps[target->binding.slot].push_back(
+            {expr, is_stmt ? _block : nullptr, is_stmt ? _stmt : nullptr,
+             in_test});
+      } else {
+        Define(target->binding);
+      }
+    } else {
+      Define(target->binding);
+    }
+    ast::Walker::Visit(expr);
+  }
+
+  virtual void Visit(ast::LogicExpr *expr) override {
+    auto op = std::string(expr->op->GetName());
+    if (op != "__and__" && op != "__or__") return ast::Walker::Visit(expr);
+    Walk(expr->left.get());
+    ++_conditional;
+    Walk(expr->right.get());
+    --_conditional;
+  }
+
+  virtual void Visit(ast::IfElseExpr *expr) override {
+    Walk(expr->test.get());
+    ++_conditional;
+    Walk(expr->left.get());
+    Walk(expr->right.get());
+    --_conditional;
+  }
+
+  // Only pure callees and builtins which never change their args, e.g. Print
+  virtual void Visit(ast::CallExpr *expr) override {
+    auto callee = dynamic_cast<ast::Name *>(expr->obj.get());
+    if (callee == nullptr) {
+      loop.writes = true;
+    } else if (callee->parent != nullptr) {
+      if (!builtin::IsPureMethod(*callee->id)) loop.writes = true;
+    } else if (callee->binding.kind != ast::Binding::kBuiltin ||
+               !builtin::kBuiltins[callee->binding.slot].is_readonly) {
+      loop.writes = true;
+    }
+    ast::Walker::Visit(expr);
+  }
+
+  virtual void Visit(ast::ObjCreate *create) override {
+    Define(create->binding);
+    ast::Walker::Visit(create);
+  }
+  virtual void Visit(ast::Function *func) override { Define(func->binding); }
+  virtual void Visit(ast::Assemble *assemble) override {
+    Define(assemble->binding);
+  }
+  virtual void Visit(ast::Struct *struct_create) override {
+    Define(struct_create->binding);
+  }
+  virtual void Visit(ast::Class *class_create) override {
+    Define(class_create->binding);
+  }
+  virtual void Visit(ast::Import *import) override {
+    Define(import->binding);
+  }
+
+  virtual void Visit(ast::Try *try_stmt) override {
+    for (auto slot : try_stmt->alias_slots) loop.others.insert(slot);
+    ast::Walker::Visit(try_stmt);
+  }
+};
+
+// Call a function on every expression a statement evaluates in its frame,
+// outermost first, it returns true to not go inside. The targets of
+// assignments are only gone inside, e.g. i of a[i] = 0.
+class Rewriter final : public ast::Walker {
+ public:
+  std::function<bool(utils::Uptr<ast::Expression> &)> func;
+
+  void Rewrite(utils::Uptr<ast::Expression> &expr) {
+    if (expr == nullptr || func(expr)) return;
+    Walk(expr.get());
+  }
+
+  virtual void Visit(ast::ExprStatement *stmt) override {
+    // The value of the statement is not used
+    Walk(stmt->expr.get());
+  }
+  virtual void Visit(ast::Return *ret) override { Rewrite(ret->expr); }
+  virtual void Visit(ast::Raise *raise) override { Rewrite(raise->error); }
+  virtual void Visit(ast::If *if_stmt) override {
+    Rewrite(if_stmt->test);
+    Walk(if_stmt->body.get());
+    Walk(if_stmt->orelse.get());
+  }
+  virtual void Visit(ast::While *while_stmt) override {
+    Rewrite(while_stmt->test);
+    Walk(while_stmt->body.get());
+    Walk(while_stmt->orelse.get());
+  }
+  virtual void Visit(ast::Try *try_stmt) override {
+    Walk(try_stmt->body.get());
+    for (const auto &x : try_stmt->excepts) Walk(std::get<2>(x).get());
+    Walk(try_stmt->orelse.get());
+  }
+  virtual void Visit(ast::Function *) override {}
+  virtual void Visit(ast::Assemble *) override {}
+  virtual void Visit(ast::Struct *) override {}
+  virtual void Visit(ast::Class *) override {}
+  virtual void Visit(ast::Import *) override {}
+
+  virtual void Visit(ast::Name *name) override { Rewrite(name->parent); }
+  virtual void Visit(ast::UnaryOpExpr *expr) override { Rewrite(expr->right); }
+  virtual void Visit(ast::BinaryOpExpr *expr) override {
+    auto op = std::string(expr->op->GetName());
+    if (op == "__assign__" || op.rfind("__self_", 0) == 0) {
+      Walk(expr->left.get());
+    } else {
+      Rewrite(expr->left);
+    }
+    Rewrite(expr->right);
+  }
+  virtual void Visit(ast::LogicExpr *expr) override {
+    Rewrite(expr->left);
+    Rewrite(expr->right);
+  }
+  virtual void Visit(ast::IfElseExpr *expr) override {
+    Rewrite(expr->left);
+    Rewrite(expr->test);
+    Rewrite(expr->right);
+  }
+  virtual void Visit(ast::CallExpr *expr) override {
+    Rewrite(expr->obj);
+    Walk(expr->op.get());
+  }
+  virtual void Visit(ast::SubscriptExpr *expr) override {
+    Rewrite(expr->obj);
+    Walk(expr->op.get());
+  }
+  virtual void Visit(ast::CallOperator *cop) override {
+    for (auto &x : cop->unameds) Rewrite(x);
+    for (auto &x : cop->keywords) Rewrite(std::get<1>(x));
+  }
+  virtual void Visit(ast::SubscriptOperator *sop) override {
+    for (auto &x : sop->dims) {
+      Rewrite(std::get<0>(*x));
+      Rewrite(std::get<1>(*x));
+      Rewrite(std::get<2>(*x));
+    }
+  }
+};
+
+// The largest slot a frame uses
+class Locals final : public ast::Walker {
+ public:
+  int slots = 0;
+
+ private:
+  void Use(const ast::Binding &binding) {
+    if (binding.kind == ast::Binding::kLocal && binding.depth == 0) {
+      slots = std::max(slots, binding.slot + 1);
+    }
+  }
+
+ public:
+  virtual void Visit(ast::Name *name) override {
+    Use(name->binding);
+    ast::Walker::Visit(name);
+  }
+  virtual void Visit(ast::ObjCreate *create) override {
+    Use(create->binding);
+    ast::Walker::Visit(create);
+  }
+  virtual void Visit(ast::Function *func) override { Use(func->binding); }
+  virtual void Visit(ast::Assemble *assemble) override {
+    Use(assemble->binding);
+  }
+  virtual void Visit(ast::Struct *struct_create) override {
+    Use(struct_create->binding);
+  }
+  virtual void Visit(ast::Class *class_create) override {
+    Use(class_create->binding);
+  }
+  virtual void Visit(ast::Import *import) override { Use(import->binding); }
+  virtual void Visit(ast::Try *try_stmt) override {
+    for (auto slot : try_stmt->alias_slots) slots = std::max(slots, slot + 1);
+    ast::Walker::Visit(try_stmt);
+  }
+};
+
+LoopOpts LoopOptimizer::operator()(ast::Module *module) {
+  auto res = LoopOpts();
+  _res = &res;
+  _where = module->filename;
+  _path.clear();
+  _captured = FindCaptured(module);
+  _frames.clear();
+  _temps.clear();
+  module->Accept(this);
+  return res;
+}
+
+void LoopOptimizer::Remark(const std::string &message) {
+  auto where = _where;
+  for (size_t i = 0; i < _path.size(); ++i) {
+    where += (i == 0 ? ": " : ".") + _path[i];
+  }
+  _res->remarks.push_back({"licm", where, message});
+}
+
+void LoopOptimizer::VisitCallable(ast::Create *callable,
+                                  ast::CallOperator *args, ast::Block *body) {
+  auto locals = Locals();
+  locals.Walk(body);
+  const auto &captured = _captured[callable];
+  auto frame = Frame{captured, FindTypes(body, captured), locals.slots};
+
+  // The parameters take the first slots, see pass::Resolver
+  auto params = 0;
+  for (auto it = args->unameds.begin(); it != args->unameds.end(); ++it) {
+    if (it != args->unameds.begin()) ++params;
+  }
+  params += args->keywords.size();
+  frame.slots = std::max(frame.slots, params);
+
+  _frames.push_back(std::move(frame));
+  _path.push_back(*callable->GetId());
+  Walk(body);
+  _path.pop_back();
+  _frames.pop_back();
+}
+
+void LoopOptimizer::Visit(ast::Function *func) {
+  VisitCallable(func, func->args.get(), func->body.get());
+}
+
+void LoopOptimizer::Visit(ast::Assemble *assemble) {
+  VisitCallable(assemble, assemble->args.get(), assemble->body.get());
+}
+
+void LoopOptimizer::Visit(ast::Struct *struct_create) {
+  _path.push_back(*struct_create->id);
+  ast::Walker::Visit(struct_create);
+  _path.pop_back();
+}
+
+void LoopOptimizer::Visit(ast::Class *class_create) {
+  _path.push_back(*class_create->id);
+  ast::Walker::Visit(class_create);
+  _path.pop_back();
+}
+
+void LoopOptimizer::Visit(ast::Import *) {}
+
+void LoopOptimizer::Visit(ast::Block *block) {
+  auto &stmts = block->statements;
+  for (auto it = stmts.begin(); it != stmts.end(); ++it) {
+    Walk(it->get());
+    for (auto &stmt : _before) stmts.insert(it, std::move(stmt));
+    _before.clear();
+  }
+}
+
+void LoopOptimizer::Visit(ast::While *while_stmt) {
+  // Loops inside first, what they hoist may go further out from here
+  Walk(while_stmt->body.get());
+  Walk(while_stmt->orelse.get());
+  if (_frames.empty()) return;
+
+  auto loop = Scan(while_stmt);
+  _loop = &loop;
+  HoistTemps(while_stmt, &loop);
+  Reduce(while_stmt, loop);
+  loop = Scan(while_stmt);
+  Hoist(while_stmt);
+  _loop = nullptr;
+}
+
+LoopOptimizer::Loop LoopOptimizer::Scan(ast::While *while_stmt) const {
+  auto scan = LoopScan();
+  scan.in_test = true;
+  scan.Walk(while_stmt->test.get());
+  scan.in_test = false;
+  scan.Walk(while_stmt->body.get());
+  return std::move(scan.loop);
+}
+
+bool LoopOptimizer::IsInvariant(const ast::Expression *expr) const {
+  if (expr == nullptr || dynamic_cast<const ast::Literal *>(expr) != nullptr) {
+    return true;
+  }
+  if (auto name = dynamic_cast<const ast::Name *>(expr)) {
+    if (name->parent != nullptr) {
+      return !_loop->writes && IsInvariant(name->parent.get());
+    }
+    const auto &binding = name->binding;
+    switch (binding.kind) {
+      case ast::Binding::kBuiltin: return true;
+      case ast::Binding::kGlobal: return !_loop->writes;
+      case ast::Binding::kLocal:
+        if (binding.depth != 0) return !_loop->writes;
+        if (_loop->steps.count(binding.slot) ||
+            _loop->others.count(binding.slot)) {
+          return false;
+        }
+        return !_loop->writes ||
+               !_frames.back().captured.count(binding.slot);
+      default: return false;
+    }
+  }
+  if (auto unary = dynamic_cast<const ast::UnaryOpExpr *>(expr)) {
+    // *p may raise
+    return std::string(unary->op->GetName()) != "__deref__" &&
+           IsInvariant(unary->right.get());
+  }
+  if (auto binary = dynamic_cast<const ast::BinaryOpExpr *>(expr)) {
+    // Division by zero may raise
+    auto op = std::string(binary->op->GetName());
+    return op != "__div__" && op != "__mod__" && op != "__assign__" &&
+           op.rfind("__self_", 0) != 0 && IsInvariant(binary->left.get()) &&
+           IsInvariant(binary->right.get());
+  }
+  if (auto logic = dynamic_cast<const ast::LogicExpr *>(expr)) {
+    return IsInvariant(logic->left.get()) && IsInvariant(logic->right.get());
+  }
+  if (auto if_else = dynamic_cast<const ast::IfElseExpr *>(expr)) {
+    return IsInvariant(if_else->left.get()) &&
+           IsInvariant(if_else->test.get()) &&
+           IsInvariant(if_else->right.get());
+  }
+  if (auto call = dynamic_cast<const ast::CallExpr *>(expr)) {
+    auto callee = dynamic_cast<const ast::Name *>(call->obj.get());
+    if (callee == nullptr) return false;
+    if (callee->parent == nullptr) {
+      // A new object each call cannot be shared, e.g. Array()
+      if (callee->binding.kind != ast::Binding::kBuiltin) return false;
+      const auto &info = builtin::kBuiltins[callee->binding.slot];
+      if (!info.is_pure || info.is_alloc) return false;
+    } else if (!builtin::IsPureMethod(*callee->id) ||
+               !IsInvariant(callee)) {
+      return false;
+    }
+    for (const auto &x : call->op->unameds) {
+      if (!IsInvariant(x.get())) return false;
+    }
+    for (const auto &x : call->op->keywords) {
+      if (!IsInvariant(std::get<1>(x).get())) return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+// An Int literal or a local known to be an Int the loop does not change
+bool LoopOptimizer::IsInvariantInt(const ast::Expression *expr) const {
+  if (dynamic_cast<const ast::Literal *>(expr) != nullptr) {
+    return SafeType(expr) == "Int";
+  }
+  auto name = dynamic_cast<const ast::Name *>(expr);
+  return name != nullptr && IsLocal(name) && IsInvariant(name) &&
+         SafeType(name) == "Int";
+}
+
+// The type of what expr gives, "" if it may raise, see pass::SafeType
+std::string LoopOptimizer::SafeType(const ast::Expression *expr) const {
+  return pass::SafeType(expr, _frames.back().types);
+}
+
+// Computed before the loop whether or not the loop runs, or an if or && of
+// it would, so only what cannot raise
+bool LoopOptimizer::IsHoistable(const ast::Expression *expr) const {
+  return dynamic_cast<const ast::Literal *>(expr) == nullptr &&
+         dynamic_cast<const ast::Name *>(expr) == nullptr && HasName(expr) &&
+         IsInvariant(expr) && !SafeType(expr).empty();
+}
+
+// e.g. _inv0 := Auto(n - 1), put before the loop by its Block
+utils::Uptr<ast::Name> LoopOptimizer::NewTemp(
+    const std::string &prefix, utils::Uptr<ast::Expression> &&init,
+    const char *type) {
+  auto id = prefix + std::to_string(_temps_count++);
+  auto binding = ast::Binding{ast::Binding::kLocal, 0, _frames.back().slots++};
+  if (std::string(type) != "Auto") _frames.back().types[binding.slot] = type;
+
+  auto args = std::make_unique<ast::CallOperator>();
+  args->AddUnamed(std::move(init));
+  auto create = std::make_unique<ast::ObjCreate>(
+      std::make_unique<ast::TextType>(id),
+      std::make_unique<ast::CallExpr>(MakeBuiltin(type), std::move(args)));
+  create->binding = binding;
+  _temps.insert(create.get());
+  _before.push_back(std::move(create));
+  return MakeName(id, binding);
+}
+
+// The temps hoisted from the loops inside, if they are invariant here too
+void LoopOptimizer::HoistTemps(ast::While *while_stmt, Loop *loop) {
+  auto &stmts = while_stmt->body->statements;
+  for (auto it = stmts.begin(); it != stmts.end();) {
+    auto create = dynamic_cast<ast::ObjCreate *>(it->get());
+    if (create == nullptr || !_temps.count(create) ||
+        !IsInvariant(create->call_expr.get())) {
+      ++it;
+      continue;
+    }
+    loop->others.erase(create->binding.slot);
+    ++_res->hoisted;
+    Remark("hoisted " + *create->id + " out of an outer loop");
+    _before.push_back(std::move(*it));
+    it = stmts.erase(it);
+  }
+}
+
+// i * c -> _srN, with _srN := Int(i * c) before the loop and _srN += d * c
+// after every i += d
+void LoopOptimizer::Reduce(ast::While *while_stmt, const Loop &loop) {
+  auto &frame = _frames.back();
+  for (const auto &[slot, steps] : loop.steps) {
+    // Not a param nor set by =, which may hold anything
+    if (loop.others.count(slot) || frame.captured.count(slot) ||
+        SafeType(steps[0].expr->left.get()) != "Int") {
+      continue;
+    }
+    auto in_test = false, ok = true;
+    for (const auto &step : steps) {
+      in_test = in_test || step.in_test;
+      ok = ok && IsInvariantInt(step.expr->right.get());
+    }
+    if (!ok) continue;
+
+    auto id = *static_cast<ast::Name *>(steps[0].expr->left.get())->id;
+    ++_res->inductions;
+    Remark(id + " is an induction variable");
+
+    // The same c shares a temp, e.g. i * 4 and 4 * i
+    struct Reduced {
+      std::string id;
+      ast::Binding binding;
+      const ast::Expression *factor;  // c, in the init of the temp
+    };
+    auto temps = std::unordered_map<std::string, Reduced>();
+    auto rewriter = Rewriter();
+    rewriter.func = [&](utils::Uptr<ast::Expression> &expr) {
+      auto mul = dynamic_cast<ast::BinaryOpExpr *>(expr.get());
+      if (mul == nullptr || std::string(mul->op->GetName()) != "__mul__") {
+        return false;
+      }
+      auto factor = mul->right.get();
+      auto name = dynamic_cast<ast::Name *>(mul->left.get());
+      if (name == nullptr || !IsLocal(name) || name->binding.slot != slot) {
+        factor = mul->left.get();
+        name = dynamic_cast<ast::Name *>(mul->right.get());
+      }
+      if (name == nullptr || !IsLocal(name) || name->binding.slot != slot ||
+          !IsInvariantInt(factor)) {
+        return false;
+      }
+
+      auto key = ast::Printer()(factor);
+      auto found = temps.find(key);
+      if (found != temps.end()) {
+        expr = MakeName(found->second.id, found->second.binding);
+        return true;
+      }
+      ++_res->reduced;
+      auto text = ast::Printer()(mul);
+      auto temp = NewTemp("_sr", std::move(expr), "Int");
+      Remark(text + " reduced to additions to " + *temp->id);
+      temps[key] = {*temp->id, temp->binding, factor};
+      expr = std::move(temp);
+      return true;
+    };
+    // The steps in the test run before the body, but not before the uses
+    // later in the test
+    if (!in_test) rewriter.Rewrite(while_stmt->test);
+    rewriter.Walk(while_stmt->body.get());
+
+    for (const auto &[key, temp] : temps) {
+      for (const auto &step : steps) {
+        // d * c, folded if both are literals
+        auto d = Constant(), c = Constant();
+        utils::Uptr<ast::Expression> delta;
+        if (ToConstant(step.expr->right.get(), &d) &&
+            ToConstant(temp.factor, &c)) {
+          delta = ToLiteral({false, d.i * c.i, 0});
+        } else if (ToConstant(step.expr->right.get(), &d) && d.i == 1) {
+          delta = Copy(temp.factor);
+        } else {
+          delta = std::make_unique<ast::BinaryOpExpr>(
+              Copy(step.expr->right.get()), std::make_unique<ast::OpMul>(),
+              Copy(temp.factor));
+        }
+        utils::Uptr<ast::BinaryOperator> op;
+        if (std::string(step.expr->op->GetName()) == "__self_plus__") {
+          op = std::make_unique<ast::OpSelfPlus>();
+        } else {
+          op = std::make_unique<ast::OpSelfMinus>();
+        }
+        auto update = std::make_unique<ast::ExprStatement>(
+            std::make_unique<ast::BinaryOpExpr>(
+                MakeName(temp.id, temp.binding), std::move(op),
+                std::move(delta)));
+
+        if (step.in_test) {
+          auto &body = while_stmt->body->statements;
+          body.insert(body.begin(), std::move(update));
+          continue;
+        }
+        auto &stmts = step.block->statements;
+        for (auto it = stmts.begin(); it != stmts.end(); ++it) {
+          if (it->get() != step.stmt) continue;
+          stmts.insert(std::next(it), std::move(update));
+          break;
+        }
+      }
+    }
+  }
+}
+
+// Every invariant expression becomes a temp, the same text shares one
+void LoopOptimizer::Hoist(ast::While *while_stmt) {
+  auto temps =
+      std::unordered_map<std::string, std::pair<std::string, ast::Binding>>();
+  auto rewriter = Rewriter();
+  rewriter.func = [&](utils::Uptr<ast::Expression> &expr) {
+    if (!IsHoistable(expr.get())) return false;
+    auto text = ast::Printer()(expr.get());
+    auto found = temps.find(text);
+    if (found != temps.end()) {
+      expr = MakeName(found->second.first, found->second.second);
+      return true;
+    }
+    ++_res->hoisted;
+    auto temp = NewTemp("_inv", std::move(expr), "Auto");
+    Remark("hoisted " + text + " out of the loop into " + *temp->id);
+    temps[text] = {*temp->id, temp->binding};
+    expr = std::move(temp);
+    return true;
+  };
+  rewriter.Rewrite(while_stmt->test);
+  rewriter.Walk(while_stmt->body.get());
+}
+
+}  // namespace pass
@@ -0,0 +1,98 @@
+#ifndef _XULANG_SRC_PASS_LICM_HPP
+#define _XULANG_SRC_PASS_LICM_HPP
+
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../ast/walker.hpp"
+#include "./dse.hpp"
+#include "./pass.hpp"
+
+namespace pass {
+
+struct LoopOpts {
+  int hoisted = 0;     // invariant expressions computed once before the loop
+  int inductions = 0;  // induction variables found
+  int reduced = 0;     // multiplications replaced by additions
+  Remarks remarks;
+};
+
+// Optimize every While of the functions after pass::Resolver, innermost
+// loops first. A pure expression whose operands the loop never changes is
+// computed once before it in a new _invN := Auto(expr). An Int local changed
+// only by += and -= of invariant Ints is an induction variable i, and i * c
+// with c an invariant Int becomes a new _srN := Int(i * c) which steps along
+// with i. The temps are computed even when the loop or the branch holding
+// the expression never runs, so only what cannot raise is hoisted: numbers
+// and Strings of known types under +, - and *, comparisons, length() and
+// the like. Run pass::Resolver again afterwards.
+class LoopOptimizer final : private ast::Walker {
+ public:
+  // A += or -= of an induction variable
+  struct Step {
+    ast::BinaryOpExpr *expr;
+    ast::Block *block;     // of the ExprStatement of a step in the body
+    ast::Statement *stmt;  // or nullptr if it is not a whole statement
+    bool in_test;          // always run by the test
+  };
+
+  // What the test and the body of a While change
+  struct Loop {
+    std::map<int, std::vector<Step>> steps;  // by slot
+    std::set<int> others;  // slots set in any other way
+    bool writes = false;   // may change memory, e.g. a[i] = 0 or f()
+  };
+
+ private:
+  struct Frame {
+    std::set<int> captured;
+    SlotTypes types;  // see FindTypes
+    int slots = 0;    // new locals take the next ones
+  };
+
+  std::string _where;
+  std::vector<std::string> _path;
+  LoopOpts *_res;
+  std::unordered_map<const ast::Create *, std::set<int>> _captured;
+  std::vector<Frame> _frames;
+  const Loop *_loop = nullptr;
+  int _temps_count = 0;
+  std::unordered_set<ast::ObjCreate *> _temps;  // the ObjCreates made here
+
+  // Set by the Visit() of a While, consumed by its Block
+  std::vector<utils::Uptr<ast::Statement>> _before;
+
+  Loop Scan(ast::While *while_stmt) const;
+  bool IsInvariant(const ast::Expression *expr) const;
+  bool IsInvariantInt(const ast::Expression *expr) const;
+  std::string SafeType(const ast::Expression *expr) const;
+  bool IsHoistable(const ast::Expression *expr) const;
+  utils::Uptr<ast::Name> NewTemp(const std::string &prefix,
+                                 utils::Uptr<ast::Expression> &&init,
+                                 const char *type);
+  void HoistTemps(ast::While *while_stmt, Loop *loop);
+  void Reduce(ast::While *while_stmt, const Loop &loop);
+  void Hoist(ast::While *while_stmt);
+  void VisitCallable(ast::Create *callable, ast::CallOperator *args,
+                     ast::Block *body);
+  void Remark(const std::string &message);
+
+ public:
+  LoopOpts operator()(ast::Module *module);
+
+ private:
+  virtual void Visit(ast::Block *) override;
+  virtual void Visit(ast::While *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override;
+};
+
+}  // namespace pass
+
+#endif  // _XULANG_SRC_PASS_LICM_HPP
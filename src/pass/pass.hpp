@@ -0,0 +1,24 @@
+#ifndef _XULANG_SRC_PASS_PASS_HPP
+#define _XULANG_SRC_PASS_PASS_HPP
+
+#include <list>
+#include <string>
+
+namespace pass {
+
+// Something a pass found or changed, for the user to read
+struct Remark {
+  std::string pass;
+  std::string where;  // e.g. "primes.xl: main"
+  std::string message;
+
+  operator std::string() const {
+    return "[" + pass + "] " + where + ": " + message;
+  }
+};
+
+using Remarks = std::list<Remark>;
+
+}  // namespace pass
+
+#endif  // _XULANG_SRC_PASS_PASS_HPP
@@ -0,0 +1,942 @@
+#include "./range.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include "../ast/printer.hpp"
+#include "../builtin/names.hpp"
+#include "./dse.hpp"
+#include "./fold.hpp"
+
+namespace pass {
+
+using Range = RangeAnalyzer::Range;
+using Length = RangeAnalyzer::Length;
+using State = RangeAnalyzer::State;
+
+// Loops not settled after this many iterations know nothing at their head
+static constexpr int kMaxIterations = 32;
+
+// The slot of a local of the frame, or -1
+static int SlotOf(const ast::Expression *expr) {
+  auto name = dynamic_cast<const ast::Name *>(expr);
+  if (name == nullptr || name->parent != nullptr ||
+      name->binding.kind != ast::Binding::kLocal || name->binding.depth != 0) {
+    return -1;
+  }
+  return name->binding.slot;
+}
+
+static bool IsAssign(const std::string &op) {
+  return op == "__assign__" || op.rfind("__self_", 0) == 0;
+}
+
+static Range Exactly(int64_t val) {
+  auto res = Range();
+  res.lo = res.hi = val;
+  return res;
+}
+
+static Range Bool() {
+  auto res = Range();
+  res.lo = 0;
+  res.hi = 1;
+  return res;
+}
+
+static bool IsAny(const Range &range) {
+  return !range.lo && !range.hi && range.below.empty();
+}
+
+static std::optional<int64_t> Add(std::optional<int64_t> a,
+                                  std::optional<int64_t> b) {
+  int64_t res;
+  if (!a || !b || __builtin_add_overflow(*a, *b, &res)) return std::nullopt;
+  return res;
+}
+
+static std::optional<int64_t> Neg(std::optional<int64_t> a) {
+  if (!a || *a == INT64_MIN) return std::nullopt;
+  return -*a;
+}
+
+// The tighter of two bounds
+static std::optional<int64_t> Max(std::optional<int64_t> a,
+                                  std::optional<int64_t> b) {
+  if (!a) return b;
+  if (!b) return a;
+  return std::max(*a, *b);
+}
+
+static std::optional<int64_t> Min(std::optional<int64_t> a,
+                                  std::optional<int64_t> b) {
+  if (!a) return b;
+  if (!b) return a;
+  return std::min(*a, *b);
+}
+
+// Whether a + b never goes past INT64_MAX and wraps, or below INT64_MIN
+static bool CannotWrapUp(const Range &a, const Range &b) {
+  if (a.hi && b.hi) return Add(a.hi, b.hi).has_value() || *a.hi < 0;
+  return (a.hi && *a.hi <= 0) || (b.hi && *b.hi <= 0);
+}
+
+static bool CannotWrapDown(const Range &a, const Range &b) {
+  if (a.lo && b.lo) return Add(a.lo, b.lo).has_value() || *a.lo > 0;
+  return (a.lo && *a.lo >= 0) || (b.lo && *b.lo >= 0);
+}
+
+// Ints wrap, so a bound only holds if no sum can cross the other end
+static Range Plus(const Range &a, const Range &b) {
+  auto res = Range();
+  auto up = CannotWrapUp(a, b), down = CannotWrapDown(a, b);
+  if (up) res.lo = Add(a.lo, b.lo);
+  if (down) res.hi = Add(a.hi, b.hi);
+  if (!down) return res;
+  if (b.hi && *b.hi <= 0) res.below = a.below;
+  if (a.hi && *a.hi <= 0) res.below.insert(b.below.begin(), b.below.end());
+  return res;
+}
+
+// -x, where -INT64_MIN is INT64_MIN
+static Range Negate(const Range &x) {
+  auto res = Range();
+  if (!x.lo || *x.lo == INT64_MIN) return res;
+  res.lo = Neg(x.hi);
+  res.hi = -*x.lo;
+  return res;
+}
+
+static Range Minus(const Range &a, const Range &b) {
+  return Plus(a, Negate(b));
+}
+
+static Range Join(const Range &a, const Range &b) {
+  auto res = Range();
+  if (a.lo && b.lo) res.lo = std::min(*a.lo, *b.lo);
+  if (a.hi && b.hi) res.hi = std::max(*a.hi, *b.hi);
+  std::set_intersection(a.below.begin(), a.below.end(), b.below.begin(),
+                        b.below.end(),
+                        std::inserter(res.below, res.below.end()));
+  return res;
+}
+
+static State Unreachable() {
+  auto res = State();
+  res.reachable = false;
+  return res;
+}
+
+static State Join(const State &a, const State &b) {
+  if (!a.reachable) return b;
+  if (!b.reachable) return a;
+  auto res = State();
+  for (const auto &[slot, range] : a.ranges) {
+    auto other = b.ranges.find(slot);
+    if (other == b.ranges.end()) continue;
+    auto joined = Join(range, other->second);
+    if (!IsAny(joined)) res.ranges[slot] = std::move(joined);
+  }
+  for (const auto &[slot, key] : a.equals) {
+    auto other = b.equals.find(slot);
+    if (other != b.equals.end() && other->second == key) res.equals[slot] = key;
+  }
+  for (const auto &[slot, length] : a.lengths) {
+    auto other = b.lengths.find(slot);
+    if (other == b.lengths.end()) continue;
+    auto joined = Length();
+    std::set_intersection(length.keys.begin(), length.keys.end(),
+                          other->second.keys.begin(),
+                          other->second.keys.end(),
+                          std::inserter(joined.keys, joined.keys.end()));
+    if (length.size == other->second.size) joined.size = length.size;
+    if (!joined.keys.empty() || joined.size) res.lengths[slot] = joined;
+  }
+  return res;
+}
+
+// The bounds which moved since the last iteration go one short of the
+// ends of Int, then to infinity, e.g. i of while ((i += 1) < n) stays
+// below INT64_MAX where i += 1 cannot wrap
+static State Widen(const State &last, const State &next) {
+  auto res = next;
+  for (auto it = res.ranges.begin(); it != res.ranges.end();) {
+    auto old = last.ranges.find(it->first);
+    if (old == last.ranges.end()) {
+      it = res.ranges.erase(it);
+      continue;
+    }
+    auto &range = it->second;
+    const auto &was = old->second;
+    if (!was.lo || !range.lo) {
+      range.lo.reset();
+    } else if (*range.lo < *was.lo) {
+      range.lo = *was.lo > INT64_MIN + 1 && *range.lo >= INT64_MIN + 1
+                     ? std::optional<int64_t>(INT64_MIN + 1)
+                     : std::nullopt;
+    }
+    if (!was.hi || !range.hi) {
+      range.hi.reset();
+    } else if (*range.hi > *was.hi) {
+      range.hi = *was.hi < INT64_MAX - 1 && *range.hi <= INT64_MAX - 1
+                     ? std::optional<int64_t>(INT64_MAX - 1)
+                     : std::nullopt;
+    }
+    it = IsAny(range) ? res.ranges.erase(it) : std::next(it);
+  }
+  return res;
+}
+
+// The Int locals of a frame, the Memory and Array ones only made by
+// Memory() or Array(), and the locals used in any other way than a[i] or
+// a.length()
+class FrameScan final : public ast::Walker {
+ public:
+  std::set<int> ints;
+  std::set<int> escapes;
+  std::map<int, std::string> types;  // Memory, Array, or ? for the others
+  std::set<int> assigned;
+
+  virtual void Visit(ast::ObjCreate *create) override {
+    auto type = dynamic_cast<ast::Name *>(create->call_expr->obj.get());
+    auto builtin = type != nullptr && type->parent == nullptr &&
+                   type->binding.kind == ast::Binding::kBuiltin;
+    if (builtin && *type->id == "Int" &&
+        create->binding.kind == ast::Binding::kLocal) {
+      ints.insert(create->binding.slot);
+    }
+    if (create->binding.kind == ast::Binding::kLocal) {
+      auto made = builtin && (*type->id == "Memory" || *type->id == "Array")
+                      ? *type->id
+                      : "?";
+      auto [it, added] = types.emplace(create->binding.slot, made);
+      if (!added && it->second != made) it->second = "?";
+    }
+    ast::Walker::Visit(create);
+  }
+  virtual void Visit(ast::BinaryOpExpr *expr) override {
+    auto slot = SlotOf(expr->left.get());
+    if (slot >= 0 && IsAssign(expr->op->GetName())) assigned.insert(slot);
+    ast::Walker::Visit(expr);
+  }
+  virtual void Visit(ast::Name *name) override {
+    auto slot = SlotOf(name);
+    if (slot >= 0) escapes.insert(slot);
+    ast::Walker::Visit(name);
+  }
+  virtual void Visit(ast::SubscriptExpr *expr) override {
+    if (SlotOf(expr->obj.get()) < 0) Walk(expr->obj.get());
+    Walk(expr->op.get());
+  }
+  virtual void Visit(ast::CallExpr *expr) override {
+    auto callee = dynamic_cast<ast::Name *>(expr->obj.get());
+    if (callee == nullptr || SlotOf(callee->parent.get()) < 0 ||
+        !builtin::IsPureMethod(*callee->id)) {
+      Walk(expr->obj.get());
+    }
+    Walk(expr->op.get());
+  }
+  virtual void Visit(ast::Function *) override {}
+  virtual void Visit(ast::Assemble *) override {}
+  virtual void Visit(ast::Struct *) override {}
+  virtual void Visit(ast::Class *) override {}
+  virtual void Visit(ast::Import *) override {}
+};
+
+// The locals a statement may set
+class Written final : public ast::Walker {
+ public:
+  std::set<int> slots;
+
+  virtual void Visit(ast::BinaryOpExpr *expr) override {
+    auto slot = SlotOf(expr->left.get());
+    if (slot >= 0 && IsAssign(expr->op->GetName())) slots.insert(slot);
+    ast::Walker::Visit(expr);
+  }
+  virtual void Visit(ast::ObjCreate *create) override {
+    slots.insert(create->binding.slot);
+    ast::Walker::Visit(create);
+  }
+  virtual void Visit(ast::Try *try_stmt) override {
+    slots.insert(try_stmt->alias_slots.begin(), try_stmt->alias_slots.end());
+    ast::Walker::Visit(try_stmt);
+  }
+  virtual void Visit(ast::Function *) override {}
+  virtual void Visit(ast::Assemble *) override {}
+  virtual void Visit(ast::Struct *) override {}
+  virtual void Visit(ast::Class *) override {}
+  virtual void Visit(ast::Import *) override {}
+};
+
+Ranges RangeAnalyzer::operator()(ast::Module *module) {
+  auto res = Ranges();
+  _res = &res;
+  _where = module->filename;
+  _path.clear();
+  _captured = FindCaptured(module);
+  _frames.clear();
+  _state = State();
+  _marking = true;
+  for (const auto &obj : module->objs) Walk(obj.get());
+  return res;
+}
+
+Range RangeAnalyzer::Eval(ast::Expression *expr) {
+  _value = Range();
+  if (expr != nullptr) Walk(expr);
+  return std::move(_value);
+}
+
+// The slot of the Int local a comparison operand is the value of, e.g.
+// i or (i += 1), or -1
+int RangeAnalyzer::Operand(const ast::Expression *expr) const {
+  auto assign = dynamic_cast<const ast::BinaryOpExpr *>(expr);
+  if (assign != nullptr && IsAssign(assign->op->GetName())) {
+    expr = assign->left.get();
+  }
+  auto slot = SlotOf(expr);
+  return slot >= 0 && _frames.back().ints.count(slot) ? slot : -1;
+}
+
+// e.g. $3 for the Int n or $5.length() for a.length(), or empty
+std::string RangeAnalyzer::Key(const ast::Expression *expr) const {
+  const auto &frame = _frames.back();
+  auto slot = SlotOf(expr);
+  if (slot >= 0) {
+    return frame.ints.count(slot) ? "$" + std::to_string(slot) : "";
+  }
+
+  auto call = dynamic_cast<const ast::CallExpr *>(expr);
+  auto callee = call ? dynamic_cast<const ast::Name *>(call->obj.get()) : nullptr;
+  if (callee == nullptr || *callee->id != "length" ||
+      !call->op->unameds.empty() || !call->op->keywords.empty()) {
+    return "";
+  }
+  return LengthKey(callee->parent.get());
+}
+
+// Key() and the key the value of a local was set to, e.g. $5.length() for
+// n after n := Int(a.length())
+std::set<std::string> RangeAnalyzer::Keys(const ast::Expression *expr,
+                                          const State &state) const {
+  auto res = std::set<std::string>();
+  auto key = Key(expr);
+  if (!key.empty()) res.insert(key);
+  auto equal = state.equals.find(SlotOf(expr));
+  if (equal != state.equals.end()) res.insert(equal->second);
+  return res;
+}
+
+// $5.length() for a Memory or Array at slot 5 whose length only changes
+// when it is created again, or empty. A Memory never changes its length,
+// an Array made in the frame does while it is only subscripted or asked
+// its length, and nothing else may reach it.
+std::string RangeAnalyzer::LengthKey(const ast::Expression *array) const {
+  const auto &frame = _frames.back();
+  auto slot = SlotOf(array);
+  if (!frame.memories.count(slot) && !frame.arrays.count(slot)) return "";
+  return "$" + std::to_string(slot) + ".length()";
+}
+
+// The range of an operand of a comparison, evaluated already
+Range RangeAnalyzer::Peek(const ast::Expression *expr,
+                          const State &state) const {
+  auto slot = Operand(expr);
+  if (slot >= 0) {
+    auto range = state.ranges.find(slot);
+    return range == state.ranges.end() ? Range() : range->second;
+  }
+  auto constant = Constant();
+  if (ToConstant(expr, &constant)) {
+    return constant.is_float ? Range() : Exactly(constant.i);
+  }
+  if (auto unary = dynamic_cast<const ast::UnaryOpExpr *>(expr)) {
+    if (std::string(unary->op->GetName()) != "__negative__") return {};
+    return Minus(Exactly(0), Peek(unary->right.get(), state));
+  }
+  if (auto binary = dynamic_cast<const ast::BinaryOpExpr *>(expr)) {
+    auto op = std::string(binary->op->GetName());
+    if (op == "__plus__") {
+      return Plus(Peek(binary->left.get(), state),
+                  Peek(binary->right.get(), state));
+    }
+    if (op == "__minus__") {
+      return Minus(Peek(binary->left.get(), state),
+                   Peek(binary->right.get(), state));
+    }
+    return {};
+  }
+  auto res = Range();
+  if (dynamic_cast<const ast::CallExpr *>(expr) != nullptr &&
+      !Key(expr).empty()) {
+    res.lo = 0;  // a length
+  }
+  return res;
+}
+
+// The state where test is truth, or Unreachable()
+State RangeAnalyzer::Refine(const State &state, const ast::Expression *test,
+                            bool truth) const {
+  if (!state.reachable) return state;
+  if (auto unary = dynamic_cast<const ast::UnaryOpExpr *>(test)) {
+    if (std::string(unary->op->GetName()) != "__not__") return state;
+    return Refine(state, unary->right.get(), !truth);
+  }
+  auto logic = dynamic_cast<const ast::LogicExpr *>(test);
+  if (logic == nullptr) return state;
+  auto op = std::string(logic->op->GetName());
+  auto left = logic->left.get(), right = logic->right.get();
+  if (op == "__and__" || op == "__or__") {
+    // a && b is true, or a || b is false, when both are
+    if ((op == "__and__") == truth) {
+      return Refine(Refine(state, left, truth), right, truth);
+    }
+    return Join(Refine(state, left, truth),
+                Refine(Refine(state, left, !truth), right, truth));
+  }
+
+  static const std::map<std::string, std::string> kFlip = {
+      {"__lt__", "__gt__"}, {"__le__", "__ge__"}, {"__gt__", "__lt__"},
+      {"__ge__", "__le__"}, {"__eq__", "__eq__"}, {"__ne__", "__ne__"}};
+  static const std::map<std::string, std::string> kNegate = {
+      {"__lt__", "__ge__"}, {"__le__", "__gt__"}, {"__gt__", "__le__"},
+      {"__ge__", "__lt__"}, {"__eq__", "__ne__"}, {"__ne__", "__eq__"}};
+  if (!kFlip.count(op)) return state;
+  if (!truth) op = kNegate.at(op);
+  auto res = state;
+  if (Operand(left) >= 0) res = Compare(res, left, op, right);
+  if (Operand(right) >= 0) res = Compare(res, right, kFlip.at(op), left);
+  return res;
+}
+
+// The state where x op y holds, x is an Operand()
+State RangeAnalyzer::Compare(const State &state, const ast::Expression *x,
+                             const std::string &op,
+                             const ast::Expression *y) const {
+  if (!state.reachable) return state;
+  auto slot = Operand(x);
+
+  // x op key - minus
+  auto keys = Keys(y, state);
+  int64_t minus = 0;
+  auto binary = dynamic_cast<const ast::BinaryOpExpr *>(y);
+  if (keys.empty() && binary != nullptr) {
+    auto binary_op = std::string(binary->op->GetName());
+    auto offset = Peek(binary->right.get(), state);
+    // key - minus is only below key while it does not wrap
+    if ((binary_op == "__minus__" || binary_op == "__plus__") && offset.lo &&
+        offset.lo == offset.hi && Peek(y, state).lo) {
+      keys = Keys(binary->left.get(), state);
+      minus = binary_op == "__minus__" ? *offset.lo : -*offset.lo;
+    }
+  }
+
+  auto res = state;
+  auto &range = res.ranges[slot];
+  auto val = Peek(y, state);
+  auto is_below = [&] {
+    for (const auto &key : keys) {
+      if (range.below.count(key)) return true;
+    }
+    return false;
+  };
+  auto contradicts = false;  // x >= key while x < key
+  if (op == "__lt__") {
+    range.hi = Min(range.hi, Add(val.hi, -1));
+    range.below.insert(val.below.begin(), val.below.end());
+    if (minus >= 0) range.below.insert(keys.begin(), keys.end());
+  } else if (op == "__le__") {
+    range.hi = Min(range.hi, val.hi);
+    range.below.insert(val.below.begin(), val.below.end());
+    if (minus >= 1) range.below.insert(keys.begin(), keys.end());
+  } else if (op == "__gt__") {
+    range.lo = Max(range.lo, Add(val.lo, 1));
+    contradicts = minus <= 1 && is_below();
+  } else if (op == "__ge__") {
+    range.lo = Max(range.lo, val.lo);
+    contradicts = minus <= 0 && is_below();
+  } else if (op == "__eq__") {
+    range.lo = Max(range.lo, val.lo);
+    range.hi = Min(range.hi, val.hi);
+    range.below.insert(val.below.begin(), val.below.end());
+    contradicts = minus <= 0 && is_below();
+  } else {
+    contradicts = range.lo && range.lo == range.hi && val.lo &&
+                  val.lo == val.hi && *range.lo == *val.lo;
+  }
+  range.below.erase("$" + std::to_string(slot));
+  // Below an Int, so x + 1 cannot wrap
+  if (!range.below.empty()) range.hi = Min(range.hi, INT64_MAX - 1);
+  if (contradicts || (range.lo && range.hi && *range.lo > *range.hi)) {
+    return Unreachable();
+  }
+  if (IsAny(range)) res.ranges.erase(slot);
+  return res;
+}
+
+void RangeAnalyzer::Assign(int slot, const Range &range) {
+  if (!_frames.back().ints.count(slot) || IsAny(range)) {
+    _state.ranges.erase(slot);
+    return;
+  }
+  auto &res = _state.ranges[slot] = range;
+  res.below.erase("$" + std::to_string(slot));
+  if (IsAny(res)) _state.ranges.erase(slot);
+}
+
+// The local at slot changes, so do the keys naming it
+void RangeAnalyzer::Invalidate(int slot) {
+  auto key = "$" + std::to_string(slot);
+  auto names = [&](const std::string &x) {
+    return x == key || x.rfind(key + ".", 0) == 0;
+  };
+  for (auto it = _state.ranges.begin(); it != _state.ranges.end();) {
+    std::erase_if(it->second.below, names);
+    it = IsAny(it->second) ? _state.ranges.erase(it) : std::next(it);
+  }
+  _state.equals.erase(slot);
+  std::erase_if(_state.equals, [&](const auto &x) { return names(x.second); });
+  _state.lengths.erase(slot);
+  for (auto it = _state.lengths.begin(); it != _state.lengths.end();) {
+    std::erase_if(it->second.keys, names);
+    auto empty = it->second.keys.empty() && !it->second.size;
+    it = empty ? _state.lengths.erase(it) : std::next(it);
+  }
+}
+
+// The local at slot was just set to expr, e.g. n := Int(a.length())
+void RangeAnalyzer::SetEqual(int slot, const ast::Expression *expr) {
+  auto key = Key(expr);
+  auto self = "$" + std::to_string(slot);
+  if (key.empty() || key == self || key.rfind(self + ".", 0) == 0) return;
+  _state.equals[slot] = key;
+}
+
+bool RangeAnalyzer::IsInBounds(const ast::Name *array,
+                               const Range &index) const {
+  auto slot = SlotOf(array);
+  if (slot < 0 || !index.lo || *index.lo < 0) return false;
+  auto key = LengthKey(array);
+  if (!key.empty() && index.below.count(key)) return true;
+  auto length = _state.lengths.find(slot);
+  if (length == _state.lengths.end()) return false;
+  for (const auto &key : length->second.keys) {
+    if (index.below.count(key)) return true;
+  }
+  return length->second.size && index.hi && *index.hi < *length->second.size;
+}
+
+void RangeAnalyzer::Remark(const std::string &message) {
+  auto where = _where;
+  for (size_t i = 0; i < _path.size(); ++i) {
+    where += (i == 0 ? ": " : ".") + _path[i];
+  }
+  _res->remarks.push_back({"range", where, message});
+}
+
+void RangeAnalyzer::VisitFrame(ast::Create *owner, ast::CallOperator *args,
+                               ast::Block *body) {
+  // Analyzed once, when the code around it is settled
+  if (!_marking) return;
+
+  auto scan = FrameScan();
+  scan.Walk(body);
+  if (args != nullptr) {
+    // The params come first, e.g. n:=Int() of Function(Int, a, n:=Int())
+    auto slot = args->unameds.empty() ? 0 : args->unameds.size() - 1;
+    for (const auto &x : args->keywords) {
+      auto call = dynamic_cast<ast::CallExpr *>(std::get<1>(x).get());
+      auto type = call ? dynamic_cast<ast::Name *>(call->obj.get()) : nullptr;
+      if (type != nullptr && type->parent == nullptr &&
+          type->binding.kind == ast::Binding::kBuiltin && *type->id == "Int") {
+        scan.ints.insert(static_cast<int>(slot));
+      }
+      ++slot;
+    }
+  }
+  auto frame = Frame{owner};
+  const auto &captured = _captured[owner];
+  frame.types = FindTypes(body, captured);
+  for (auto slot : scan.ints) {
+    if (!captured.count(slot)) frame.ints.insert(slot);
+  }
+  for (const auto &[slot, type] : scan.types) {
+    if (captured.count(slot) || scan.assigned.count(slot)) continue;
+    if (type == "Memory") frame.memories.insert(slot);
+    if (type == "Array" && !scan.escapes.count(slot)) {
+      frame.arrays.insert(slot);
+    }
+  }
+
+  auto state = std::move(_state);
+  _state = State();
+  _frames.push_back(std::move(frame));
+  _path.push_back(*owner->GetId());
+  Walk(body);
+
+  const auto &done = _frames.back();
+  if (args != nullptr && done.subscripts > 0) {
+    Remark(std::to_string(done.in_bounds) + " of " +
+           std::to_string(done.subscripts) + " subscripts in bounds (" +
+           std::to_string(done.in_bounds * 100 / done.subscripts) + "%)");
+  }
+  _res->subscripts += done.subscripts;
+  _res->in_bounds += done.in_bounds;
+  _path.pop_back();
+  _frames.pop_back();
+  _state = std::move(state);
+}
+
+void RangeAnalyzer::Visit(ast::Block *block) {
+  auto &stmts = block->statements;
+  for (auto it = stmts.begin(); it != stmts.end();) {
+    Walk(it->get());
+    if (_replace == nullptr) {
+      ++it;
+      continue;
+    }
+    stmts.splice(it, _replace->statements);
+    _replace = nullptr;
+    it = stmts.erase(it);
+  }
+}
+
+void RangeAnalyzer::Visit(ast::ExprStatement *stmt) { Eval(stmt->expr.get()); }
+
+void RangeAnalyzer::Visit(ast::Break *) {
+  if (!_frames.back().loops.empty()) {
+    auto &loop = _frames.back().loops.back();
+    loop.breaks = Join(loop.breaks, _state);
+  }
+  _state = Unreachable();
+}
+
+void RangeAnalyzer::Visit(ast::Continue *) {
+  if (!_frames.back().loops.empty()) {
+    auto &loop = _frames.back().loops.back();
+    loop.continues = Join(loop.continues, _state);
+  }
+  _state = Unreachable();
+}
+
+void RangeAnalyzer::Visit(ast::Return *ret) {
+  Eval(ret->expr.get());
+  _state = Unreachable();
+}
+
+void RangeAnalyzer::Visit(ast::Raise *raise) {
+  Eval(raise->error.get());
+  _state = Unreachable();
+}
+
+void RangeAnalyzer::Visit(ast::If *if_stmt) {
+  Eval(if_stmt->test.get());
+  auto taken = Refine(_state, if_stmt->test.get(), true);
+  auto skipped = Refine(_state, if_stmt->test.get(), false);
+
+  // A guard the values before it already decide, e.g. if (i < 0) after
+  // i := Int(0)
+  const auto &types = _frames.back().types;
+  if (_marking && _state.reachable && IsPure(if_stmt->test.get(), types) &&
+      taken.reachable != skipped.reachable) {
+    auto always = taken.reachable;
+    Remark("if (" + ast::Printer()(if_stmt->test.get()) + ") is " +
+           (always ? "always" : "never") + " true, removed");
+    ++_res->guards;
+    _state = always ? std::move(taken) : std::move(skipped);
+    auto &branch = always ? if_stmt->body : if_stmt->orelse;
+    if (branch != nullptr) Walk(branch.get());
+    _replace = branch ? std::move(branch) : std::make_unique<ast::Block>();
+    return;
+  }
+
+  _state = std::move(taken);
+  Walk(if_stmt->body.get());
+  auto body = std::move(_state);
+  _state = std::move(skipped);
+  if (if_stmt->orelse != nullptr) Walk(if_stmt->orelse.get());
+  _state = Join(body, _state);
+}
+
+void RangeAnalyzer::Visit(ast::While *while_stmt) {
+  auto &loops = _frames.back().loops;
+  auto test = while_stmt->test.get();
+  auto entry = _state;
+  auto marking = _marking;
+
+  // The state at the test, nothing is marked until it settles
+  _marking = false;
+  auto head = entry;
+  for (int i = 0;; ++i) {
+    if (i >= kMaxIterations) {
+      head = State();
+      break;
+    }
+    _state = head;
+    Eval(test);
+    _state = Refine(_state, test, true);
+    loops.push_back({Unreachable(), Unreachable()});
+    Walk(while_stmt->body.get());
+    auto next = Join(entry, Join(_state, loops.back().continues));
+    loops.pop_back();
+    if (i >= 2) next = Widen(head, next);
+    if (next == head) break;
+    head = std::move(next);
+  }
+  _marking = marking;
+
+  _state = std::move(head);
+  Eval(test);
+  auto exit = Refine(_state, test, false);
+  _state = Refine(_state, test, true);
+  loops.push_back({Unreachable(), Unreachable()});
+  Walk(while_stmt->body.get());
+  auto breaks = std::move(loops.back().breaks);
+  loops.pop_back();
+  _state = std::move(exit);
+  if (while_stmt->orelse != nullptr) Walk(while_stmt->orelse.get());
+  _state = Join(_state, breaks);
+}
+
+void RangeAnalyzer::Visit(ast::Try *try_stmt) {
+  auto entry = _state;
+  Walk(try_stmt->body.get());
+  auto body = std::move(_state);
+
+  // Any statement of the body may raise, the handlers only know what it
+  // never changes
+  auto written = Written();
+  written.Walk(try_stmt->body.get());
+  _state = std::move(entry);
+  for (auto slot : written.slots) Invalidate(slot);
+  for (auto slot : written.slots) _state.ranges.erase(slot);
+  for (auto slot : try_stmt->alias_slots) Invalidate(slot);
+  auto handler = std::move(_state);
+
+  _state = std::move(body);
+  if (try_stmt->orelse != nullptr) Walk(try_stmt->orelse.get());
+  auto res = std::move(_state);
+  for (const auto &x : try_stmt->excepts) {
+    _state = handler;
+    Walk(std::get<2>(x).get());
+    res = Join(res, _state);
+  }
+  _state = std::move(res);
+}
+
+void RangeAnalyzer::Visit(ast::ObjCreate *create) {
+  if (_frames.empty()) return;
+  auto val = Eval(create->call_expr.get());
+  auto slot = create->binding.slot;
+  Invalidate(slot);
+  Assign(slot, val);
+  const auto &call = create->call_expr;
+  auto cast = dynamic_cast<ast::Name *>(call->obj.get());
+  if (cast != nullptr && cast->binding.kind == ast::Binding::kBuiltin &&
+      (*cast->id == "Int" || *cast->id == "Auto") &&
+      call->op->unameds.size() == 1 && call->op->keywords.empty()) {
+    SetEqual(slot, call->op->unameds.front().get());
+  }
+
+  // a := Memory(Int8, n) has n elements for good
+  auto type = dynamic_cast<ast::Name *>(create->call_expr->obj.get());
+  const auto &args = create->call_expr->op->unameds;
+  if (type == nullptr || type->parent != nullptr ||
+      type->binding.kind != ast::Binding::kBuiltin || *type->id != "Memory" ||
+      args.size() != 2) {
+    return;
+  }
+  auto length = Length();
+  auto size = Peek(args.back().get(), _state);
+  if (size.lo && size.lo == size.hi) length.size = size.lo;
+  auto key = Key(args.back().get());
+  if (!key.empty()) length.keys.insert(key);
+  if (!length.keys.empty() || length.size) _state.lengths[slot] = length;
+}
+
+void RangeAnalyzer::Visit(ast::Function *func) {
+  VisitFrame(func, func->args.get(), func->body.get());
+}
+
+void RangeAnalyzer::Visit(ast::Assemble *assemble) {
+  VisitFrame(assemble, assemble->args.get(), assemble->body.get());
+}
+
+void RangeAnalyzer::Visit(ast::Struct *struct_create) {
+  VisitFrame(struct_create, nullptr, struct_create->body.get());
+}
+
+void RangeAnalyzer::Visit(ast::Class *class_create) {
+  VisitFrame(class_create, nullptr, class_create->body.get());
+}
+
+void RangeAnalyzer::Visit(ast::Import *) {}
+
+void RangeAnalyzer::Visit(ast::Literal *literal) {
+  auto constant = Constant();
+  _value = ToConstant(literal, &constant) && !constant.is_float
+               ? Exactly(constant.i)
+               : Range();
+}
+
+void RangeAnalyzer::Visit(ast::Name *name) {
+  if (name->parent != nullptr) Eval(name->parent.get());
+  auto slot = SlotOf(name);
+  auto range = _state.ranges.find(slot);
+  _value = range == _state.ranges.end() ? Range() : range->second;
+}
+
+void RangeAnalyzer::Visit(ast::UnaryOpExpr *expr) {
+  auto val = Eval(expr->right.get());
+  auto op = std::string(expr->op->GetName());
+  if (op == "__negative__") {
+    _value = Minus(Exactly(0), val);
+  } else if (op == "__positive__") {
+    _value = std::move(val);
+  } else if (op == "__not__") {
+    _value = Bool();
+  } else {
+    _value = Range();
+  }
+}
+
+void RangeAnalyzer::Visit(ast::BinaryOpExpr *expr) {
+  auto op = std::string(expr->op->GetName());
+  auto slot = SlotOf(expr->left.get());
+  if (IsAssign(op) && slot >= 0) {
+    auto val = Eval(expr->right.get());
+    auto old = _state.ranges.find(slot);
+    auto last = old == _state.ranges.end() ? Range() : old->second;
+    auto res = op == "__assign__"       ? val
+               : op == "__self_plus__"  ? Plus(last, val)
+               : op == "__self_minus__" ? Minus(last, val)
+                                        : Range();
+    Invalidate(slot);
+    Assign(slot, res);
+    if (op == "__assign__") SetEqual(slot, expr->right.get());
+    _value = std::move(res);
+    return;
+  }
+
+  // e.g. a[i] = 0 is checked as a[i]
+  auto left = Eval(expr->left.get());
+  auto right = Eval(expr->right.get());
+  _value = Range();
+  if (op == "__plus__") {
+    _value = Plus(left, right);
+  } else if (op == "__minus__") {
+    // n - 1 < n
+    _value = Minus(left, right);
+    auto key = Key(expr->left.get());
+    if (!key.empty() && right.lo && *right.lo > 0 && _value.lo) {
+      _value.below.insert(key);
+    }
+  } else if (op == "__mul__" && left.lo && *left.lo >= 0 && right.lo &&
+             *right.lo >= 0 && left.hi && right.hi) {
+    // Only products of non-negative values which cannot wrap, e.g. i * i
+    // with 2 <= i < 1000
+    int64_t product;
+    if (!__builtin_mul_overflow(*left.hi, *right.hi, &product)) {
+      _value.lo = *left.lo * *right.lo;
+      _value.hi = product;
+    }
+  } else if (op == "__mod__" && left.lo && *left.lo >= 0 && right.lo &&
+             *right.lo > 0) {
+    // x % n is in [0, n) for x >= 0 and n > 0
+    _value.lo = 0;
+    if (right.hi) _value.hi = *right.hi - 1;
+    auto key = Key(expr->right.get());
+    if (!key.empty()) _value.below.insert(key);
+    _value.below.insert(right.below.begin(), right.below.end());
+  }
+}
+
+void RangeAnalyzer::Visit(ast::LogicExpr *expr) {
+  auto op = std::string(expr->op->GetName());
+  Eval(expr->left.get());
+  if (op == "__and__" || op == "__or__") {
+    // The right side is only evaluated when the left does not decide
+    auto decided = Refine(_state, expr->left.get(), op == "__or__");
+    _state = Refine(_state, expr->left.get(), op == "__and__");
+    Eval(expr->right.get());
+    _state = Join(decided, _state);
+  } else {
+    Eval(expr->right.get());
+  }
+  _value = Bool();
+}
+
+void RangeAnalyzer::Visit(ast::IfElseExpr *expr) {
+  Eval(expr->test.get());
+  auto skipped = Refine(_state, expr->test.get(), false);
+  _state = Refine(_state, expr->test.get(), true);
+  auto left = Eval(expr->left.get());
+  auto taken = std::move(_state);
+  _state = std::move(skipped);
+  auto right = Eval(expr->right.get());
+  _value = !taken.reachable   ? right
+           : !_state.reachable ? left
+                               : Join(left, right);
+  _state = Join(taken, _state);
+}
+
+void RangeAnalyzer::Visit(ast::CallExpr *expr) {
+  auto callee = dynamic_cast<ast::Name *>(expr->obj.get());
+  Eval(expr->obj.get());
+  auto args = std::vector<Range>();
+  for (const auto &x : expr->op->unameds) args.push_back(Eval(x.get()));
+  for (const auto &x : expr->op->keywords) Eval(std::get<1>(x).get());
+
+  // Only the length of a Memory holds across a call which changes things,
+  // its args are calls of their own
+  auto pure = callee != nullptr &&
+              (callee->parent != nullptr
+                   ? builtin::IsPureMethod(*callee->id)
+                   : callee->binding.kind == ast::Binding::kBuiltin &&
+                         builtin::kBuiltins[callee->binding.slot].is_pure);
+  if (!pure) {
+    for (auto slot : _frames.back().arrays) Invalidate(slot);
+  }
+
+  _value = Range();
+  if (callee == nullptr || !expr->op->keywords.empty()) return;
+  if (callee->parent != nullptr) {
+    if (*callee->id == "length" && args.empty()) _value.lo = 0;
+    return;
+  }
+  if (callee->binding.kind != ast::Binding::kBuiltin) return;
+  // Int(x) and Auto(x) are x, Int() is 0
+  if ((*callee->id == "Int" || *callee->id == "Auto") && args.size() == 1) {
+    _value = std::move(args.front());
+  } else if (*callee->id == "Int" && args.empty()) {
+    _value = Exactly(0);
+  }
+}
+
+void RangeAnalyzer::Visit(ast::SubscriptExpr *expr) {
+  auto array = dynamic_cast<ast::Name *>(expr->obj.get());
+  Eval(expr->obj.get());
+  auto &sop = *expr->op;
+  if (_marking) sop.in_bounds.assign(sop.dims.size(), false);
+  size_t dim = 0;
+  for (const auto &x : sop.dims) {
+    auto &[beg, end, step] = *x;
+    auto index = Eval(beg.get());
+    Eval(end.get());
+    Eval(step.get());
+    if (_marking && beg != nullptr && end == nullptr && step == nullptr) {
+      auto &frame = _frames.back();
+      ++frame.subscripts;
+      // Only the first dim of a Memory or Array has a known length
+      if (sop.dims.size() == 1 && array != nullptr &&
+          IsInBounds(array, index)) {
+        sop.in_bounds[dim] = true;
+        ++frame.in_bounds;
+      }
+    }
+    ++dim;
+  }
+  _value = Range();
+}
+
+}  // namespace pass
@@ -0,0 +1,144 @@
+#ifndef _XULANG_SRC_PASS_RANGE_HPP
+#define _XULANG_SRC_PASS_RANGE_HPP
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/walker.hpp"
+#include "./dse.hpp"
+#include "./pass.hpp"
+
+namespace pass {
+
+struct Ranges {
+  int subscripts = 0;  // dims indexed by a single value
+  int in_bounds = 0;   // of them, proven to be in bounds
+  int guards = 0;      // Ifs whose test is always or never true, removed
+  Remarks remarks;
+};
+
+// Find the values the Int locals of each function may have, after
+// pass::Resolver, and mark the subscripts a[i] whose index is in bounds in
+// ast::SubscriptOperator::in_bounds. A value is bounded by constants and by
+// keys it is less than, $3 for the Int local at slot 3 and $3.length() for
+// the length of the Memory at slot 3, or of the Array made there while it
+// is only subscripted or asked its length. Ints wrap, so a bound is dropped
+// once an operation may cross INT64_MIN or INT64_MAX. a[i] is in bounds
+// when 0 <= i and i is less than a key of the length of a, e.g. i of
+//   a := Memory(Int8, n)
+//   while ((i += 1) < n) { a[i] = 0 }
+// with i := Int(-1). While loops are iterated to a fixed point, widening
+// the constant bounds which keep changing. An If whose test has no side
+// effect and is always or never true is replaced by the branch taken.
+class RangeAnalyzer final : private ast::Walker {
+ public:
+  // lo <= x <= hi and x < every key of below
+  struct Range {
+    std::optional<int64_t> lo;
+    std::optional<int64_t> hi;
+    std::set<std::string> below;
+
+    bool operator==(const Range &) const = default;
+  };
+
+  // What the length of a Memory is, from a := Memory(type, size)
+  struct Length {
+    std::set<std::string> keys;
+    std::optional<int64_t> size;
+
+    bool operator==(const Length &) const = default;
+  };
+
+  struct State {
+    bool reachable = true;
+    std::map<int, Range> ranges;    // by slot, missing means any value
+    std::map<int, Length> lengths;  // by slot
+    std::map<int, std::string> equals;  // by slot, a key of the same value
+
+    bool operator==(const State &) const = default;
+  };
+
+ private:
+  struct Loop {
+    State breaks;
+    State continues;
+  };
+
+  struct Frame {
+    ast::Create *owner;
+    std::set<int> ints;      // Int locals nothing else can change
+    std::set<int> memories;  // Memory locals, see LengthKey
+    std::set<int> arrays;    // Array locals nothing else can reach
+    SlotTypes types;         // see FindTypes
+    std::vector<Loop> loops;
+    int subscripts = 0;
+    int in_bounds = 0;
+  };
+
+  std::string _where;
+  std::vector<std::string> _path;
+  Ranges *_res;
+  std::unordered_map<const ast::Create *, std::set<int>> _captured;
+  std::vector<Frame> _frames;
+  State _state;
+  Range _value;           // of the expression just visited
+  bool _marking = false;  // false while a loop is iterated to its fixed point
+  utils::Uptr<ast::Block> _replace;  // for the If just visited, see Block
+
+  Range Eval(ast::Expression *expr);
+  int Operand(const ast::Expression *expr) const;
+  std::string Key(const ast::Expression *expr) const;
+  std::string LengthKey(const ast::Expression *array) const;
+  std::set<std::string> Keys(const ast::Expression *expr,
+                             const State &state) const;
+  void SetEqual(int slot, const ast::Expression *expr);
+  Range Peek(const ast::Expression *expr, const State &state) const;
+  State Refine(const State &state, const ast::Expression *test,
+               bool truth) const;
+  State Compare(const State &state, const ast::Expression *x,
+                const std::string &op, const ast::Expression *y) const;
+  void Assign(int slot, const Range &range);
+  void Invalidate(int slot);
+  bool IsInBounds(const ast::Name *array, const Range &index) const;
+  void VisitFrame(ast::Create *owner, ast::CallOperator *args,
+                  ast::Block *body);
+  void Remark(const std::string &message);
+
+ public:
+  Ranges operator()(ast::Module *module);
+
+ private:
+  virtual void Visit(ast::Block *) override;
+  virtual void Visit(ast::ExprStatement *) override;
+  virtual void Visit(ast::Break *) override;
+  virtual void Visit(ast::Continue *) override;
+  virtual void Visit(ast::Return *) override;
+  virtual void Visit(ast::If *) override;
+  virtual void Visit(ast::While *) override;
+  virtual void Visit(ast::ObjCreate *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override;
+  virtual void Visit(ast::Raise *) override;
+  virtual void Visit(ast::Try *) override;
+
+  virtual void Visit(ast::Literal *) override;
+  virtual void Visit(ast::Name *) override;
+  virtual void Visit(ast::UnaryOpExpr *) override;
+  virtual void Visit(ast::BinaryOpExpr *) override;
+  virtual void Visit(ast::LogicExpr *) override;
+  virtual void Visit(ast::IfElseExpr *) override;
+  virtual void Visit(ast::CallExpr *) override;
+  virtual void Visit(ast::SubscriptExpr *) override;
+};
+
+}  // namespace pass
+
+#endif  // _XULANG_SRC_PASS_RANGE_HPP
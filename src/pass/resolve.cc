@@ -0,0 +1,180 @@
+#include "./resolve.hpp"
+
+#include "../builtin/names.hpp"
+
+namespace pass {
+
+std::string Resolver::Where() const {
+  auto res = _where;
+  for (size_t i = 0; i < _path.size(); ++i) {
+    res += (i == 0 ? ": " : ".") + _path[i];
+  }
+  return res;
+}
+
+ast::Binding Resolver::Declare(const std::string &id) {
+  if (_frames.empty()) {
+    auto it = _globals.find(id);
+    return {ast::Binding::kGlobal, 0, it == _globals.end() ? -1 : it->second};
+  }
+  auto &top = _frames.back();
+  auto slot = static_cast<int>(top.frame->slots.size());
+  top.frame->slots.push_back(id);
+  top.scopes.back()[id] = slot;
+  return {ast::Binding::kLocal, 0, slot};
+}
+
+ast::Binding Resolver::Lookup(const std::string &id) const {
+  for (auto depth = 0; depth < static_cast<int>(_frames.size()); ++depth) {
+    const auto &scopes = _frames[_frames.size() - 1 - depth].scopes;
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+      auto found = it->find(id);
+      if (found != it->end()) {
+        return {ast::Binding::kLocal, depth, found->second};
+      }
+    }
+  }
+
+  auto global = _globals.find(id);
+  if (global != _globals.end()) {
+    return {ast::Binding::kGlobal, 0, global->second};
+  }
+  auto idx = builtin::FindBuiltin(id);
+  if (idx >= 0) return {ast::Binding::kBuiltin, 0, idx};
+  return {};
+}
+
+void Resolver::PushFrame(ast::Create *owner) {
+  auto &frame = _res->frames.emplace_back(Frame{owner});
+  _res->frame_of[owner] = &frame;
+  _frames.push_back({&frame, {{}}});
+  _path.push_back(*owner->GetId());
+}
+
+void Resolver::PopFrame() {
+  _frames.pop_back();
+  _path.pop_back();
+}
+
+Resolution Resolver::operator()(ast::Module *module) {
+  auto res = Resolution();
+  _res = &res;
+  _where = module->filename;
+  _globals.clear();
+  _frames.clear();
+  _path.clear();
+  module->Accept(this);
+  return res;
+}
+
+void Resolver::Visit(ast::Module *module) {
+  // Every module level Create can be used anywhere in the module
+  auto idx = 0;
+  for (const auto &obj : module->objs) _globals[*obj->GetId()] = idx++;
+  ast::Walker::Visit(module);
+}
+
+void Resolver::Visit(ast::Block *block) {
+  if (_frames.empty()) return ast::Walker::Visit(block);
+  _frames.back().scopes.emplace_back();
+  ast::Walker::Visit(block);
+  _frames.back().scopes.pop_back();
+}
+
+void Resolver::Visit(ast::ObjCreate *create) {
+  // The new id is not visible in its own initializer, e.g. x := Int(x)
+  Walk(create->call_expr.get());
+  create->binding = Declare(*create->id);
+}
+
+void Resolver::VisitCallable(ast::Create *callable, ast::CallOperator *args,
+                             ast::Block *body) {
+  // Types and defaults are evaluated where the callable is created, and the
+  // callable can call itself
+  auto unamed = args->unameds.begin();
+  if (unamed != args->unameds.end()) Walk((unamed++)->get());
+  for (const auto &x : args->keywords) Walk(std::get<1>(x).get());
+  callable->binding = Declare(*callable->GetId());
+
+  PushFrame(callable);
+  for (; unamed != args->unameds.end(); ++unamed) {
+    auto param = dynamic_cast<ast::Name *>(unamed->get());
+    if (param == nullptr || param->parent != nullptr) {
+      _res->remarks.push_back({"resolve", Where(), "parameter is not an id"});
+      continue;
+    }
+    param->binding = Declare(*param->id);
+    ++_frames.back().frame->params;
+  }
+  for (const auto &x : args->keywords) {
+    Declare(*std::get<0>(x));
+    ++_frames.back().frame->params;
+  }
+  Walk(body);
+  PopFrame();
+}
+
+void Resolver::Visit(ast::Function *func) {
+  VisitCallable(func, func->args.get(), func->body.get());
+}
+
+void Resolver::Visit(ast::Assemble *assemble) {
+  VisitCallable(assemble, assemble->args.get(), assemble->body.get());
+}
+
+void Resolver::Visit(ast::Struct *struct_create) {
+  struct_create->binding = Declare(*struct_create->id);
+  PushFrame(struct_create);
+  Walk(struct_create->body.get());
+  PopFrame();
+}
+
+void Resolver::Visit(ast::Class *class_create) {
+  Walk(class_create->parents.get());
+  class_create->binding = Declare(*class_create->id);
+  PushFrame(class_create);
+  Walk(class_create->body.get());
+  PopFrame();
+}
+
+// The files of an Import are not names, e.g. ast := String('ast.xl')
+void Resolver::Visit(ast::Import *import) {
+  import->binding = Declare(*import->id);
+}
+
+void Resolver::Visit(ast::Try *try_stmt) {
+  Walk(try_stmt->body.get());
+  try_stmt->alias_slots.clear();
+  for (const auto &x : try_stmt->excepts) {
+    Walk(std::get<1>(x).get());
+    if (_frames.empty()) {
+      Walk(std::get<2>(x).get());
+      continue;
+    }
+    _frames.back().scopes.emplace_back();
+    try_stmt->alias_slots.push_back(Declare(*std::get<0>(x)).slot);
+    Walk(std::get<2>(x).get());
+    _frames.back().scopes.pop_back();
+  }
+  Walk(try_stmt->orelse.get());
+}
+
+void Resolver::Visit(ast::Name *name) {
+  if (name->parent != nullptr) {
+    // Members are found through the object at run time
+    Walk(name->parent.get());
+    name->binding = {ast::Binding::kMember};
+    return;
+  }
+
+  name->binding = Lookup(*name->id);
+  if (name->binding.kind != ast::Binding::kUnresolved) {
+    ++_res->resolved;
+    return;
+  }
+  ++_res->unresolved;
+  _res->remarks.push_back(
+      {"resolve", Where(), "unresolved name \"" + *name->id + "\""});
+}
+
+}  // namespace pass
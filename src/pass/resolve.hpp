@@ -0,0 +1,71 @@
+#ifndef _XULANG_SRC_PASS_RESOLVE_HPP
+#define _XULANG_SRC_PASS_RESOLVE_HPP
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/walker.hpp"
+#include "./pass.hpp"
+
+namespace pass {
+
+// The slots of a Function, Assemble, Class or Struct. Every ObjCreate,
+// nested Create and except alias inside gets its own slot, parameters take
+// the first ones in the order they are declared.
+struct Frame {
+  const ast::Create *owner;
+  std::vector<std::string> slots;
+  int params = 0;
+};
+
+struct Resolution {
+  std::list<Frame> frames;  // in the order of their owners in the source
+  std::unordered_map<const ast::Create *, Frame *> frame_of;
+  int resolved = 0;
+  int unresolved = 0;
+  Remarks remarks;
+};
+
+// Bind every Name to a frame slot, a Module obj or a builtin, and every
+// Create to the slot it defines. Run it again after changing the tree.
+class Resolver final : private ast::Walker {
+ private:
+  struct FrameScopes {
+    Frame *frame;
+    std::vector<std::unordered_map<std::string, int>> scopes;
+  };
+
+  std::string _where;
+  std::unordered_map<std::string, int> _globals;
+  std::vector<FrameScopes> _frames;
+  std::vector<std::string> _path;
+  Resolution *_res;
+
+  ast::Binding Declare(const std::string &id);
+  ast::Binding Lookup(const std::string &id) const;
+  void PushFrame(ast::Create *owner);
+  void PopFrame();
+  void VisitCallable(ast::Create *callable, ast::CallOperator *args,
+                     ast::Block *body);
+  std::string Where() const;
+
+ public:
+  Resolution operator()(ast::Module *module);
+
+ private:
+  virtual void Visit(ast::Module *) override;
+  virtual void Visit(ast::Block *) override;
+  virtual void Visit(ast::ObjCreate *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override;
+  virtual void Visit(ast::Try *) override;
+  virtual void Visit(ast::Name *) override;
+};
+
+}  // namespace pass
+
+#endif  // _XULANG_SRC_PASS_RESOLVE_HPP
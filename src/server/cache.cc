@@ -0,0 +1,70 @@
+#include "./cache.hpp"
+
+#include <sys/stat.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "../ast/json.hpp"
+#include "../parser/parse.hpp"
+
+namespace server {
+
+auto ModuleCache::GetSlot(const std::string &path) -> Sptr<Slot> {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto &slot = _slots[path];
+  if (slot == nullptr) slot = std::make_shared<Slot>();
+  return slot;
+}
+
+Sptr<const CacheEntry> ModuleCache::Get(const std::string &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) return nullptr;
+  auto mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                  st.st_mtim.tv_nsec;
+
+  auto slot = GetSlot(path);
+  std::lock_guard<std::mutex> lock(slot->mutex);
+  auto old = slot->entry;
+  if (old != nullptr && old->mtime_ns == mtime_ns && old->size == st.st_size) {
+    ++hits;
+    return old;
+  }
+
+  auto in = std::ifstream(path, std::ios::binary);
+  if (!in) return nullptr;
+  auto buf = std::stringstream();
+  buf << in.rdbuf();
+  auto source = buf.str();
+
+  auto entry = std::make_shared<CacheEntry>();
+  entry->mtime_ns = mtime_ns;
+  entry->size = static_cast<int64_t>(source.size());
+  entry->hash = utils::Fnv1a(source);
+  if (old != nullptr && old->hash == entry->hash) {
+    // Touched but not changed
+    ++rehashes;
+    entry->module = old->module;
+    entry->json = old->json;
+  } else {
+    ++parses;
+    entry->module = parser::ParseString(source, path);
+    if (entry->module != nullptr) {
+      entry->json = ast::ToJson()(entry->module.get());
+    }
+  }
+  slot->entry = entry;
+  return entry;
+}
+
+void ModuleCache::Drop(const std::string &path) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _slots.erase(path);
+}
+
+size_t ModuleCache::Size() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _slots.size();
+}
+
+}  // namespace server
@@ -0,0 +1,51 @@
+#ifndef _XULANG_SRC_SERVER_CACHE_HPP
+#define _XULANG_SRC_SERVER_CACHE_HPP
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "../ast/statement.hpp"
+
+namespace server {
+
+using utils::Sptr;
+
+// A parsed file, immutable once published so readers need no lock
+struct CacheEntry {
+  int64_t mtime_ns;
+  int64_t size;
+  uint64_t hash;
+  Sptr<const ast::Module> module;  // nullptr if the file has syntax errors
+  std::string json;                // compact ToJson output of module
+};
+
+// Parsed modules keyed by absolute path. A file is re-read only when its
+// mtime or size changed, and re-parsed only when its content hash did.
+class ModuleCache final {
+ private:
+  // Requests for the same file wait for each other, others run in parallel
+  struct Slot {
+    std::mutex mutex;
+    Sptr<const CacheEntry> entry;
+  };
+
+  std::mutex _mutex;
+  std::unordered_map<std::string, Sptr<Slot>> _slots;
+
+  Sptr<Slot> GetSlot(const std::string &path);
+
+ public:
+  std::atomic<uint64_t> hits = 0;
+  std::atomic<uint64_t> rehashes = 0;
+  std::atomic<uint64_t> parses = 0;
+
+  // Return nullptr if the file cannot be read
+  Sptr<const CacheEntry> Get(const std::string &path);
+  void Drop(const std::string &path);
+  size_t Size();
+};
+
+}  // namespace server
+
+#endif  // _XULANG_SRC_SERVER_CACHE_HPP
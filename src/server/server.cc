@@ -0,0 +1,196 @@
+#include "./server.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <thread>
+
+#include "../utils/log.hpp"
+
+namespace server {
+
+static auto kLog = utils::Logger::NewLogger("server");
+
+static bool MakeAddress(const std::string &path, sockaddr_un *addr) {
+  if (path.size() >= sizeof(addr->sun_path)) return false;
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  strcpy(addr->sun_path, path.c_str());
+  return true;
+}
+
+static bool SendAll(int fd, const std::string &data) {
+  for (size_t sent = 0; sent < data.size();) {
+    auto n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+// Read up to the next '\n', buf keeps what was read past it
+static bool RecvLine(int fd, std::string *buf, std::string *line) {
+  for (;;) {
+    auto pos = buf->find('\n');
+    if (pos != std::string::npos) {
+      *line = buf->substr(0, pos);
+      buf->erase(0, pos + 1);
+      return true;
+    }
+    char chunk[4096];
+    auto n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) return false;
+    buf->append(chunk, n);
+  }
+}
+
+static bool RecvSize(int fd, std::string *buf, size_t size) {
+  while (buf->size() < size) {
+    char chunk[4096];
+    auto n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) return false;
+    buf->append(chunk, n);
+  }
+  return true;
+}
+
+static std::string Ok(const std::string &payload = "") {
+  return "ok " + std::to_string(payload.size()) + "\n" + payload;
+}
+
+static std::string Err(const std::string &reason) {
+  return "error " + reason + "\n";
+}
+
+Server::~Server() {
+  if (_listen_fd < 0) return;
+  close(_listen_fd);
+  unlink(_socket_path.c_str());
+}
+
+std::string Server::DefaultSocketPath() {
+  return "/tmp/xlserver-" + std::to_string(getuid()) + ".sock";
+}
+
+bool Server::Listen() {
+  sockaddr_un addr;
+  if (!MakeAddress(_socket_path, &addr)) {
+    kLog->Error({"socket path too long:", _socket_path});
+    return false;
+  }
+
+  // A socket nobody accepts on is left over by a dead server
+  auto probe = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) {
+    close(probe);
+    kLog->Error({"a server is already listening on", _socket_path});
+    return false;
+  }
+  close(probe);
+  unlink(_socket_path.c_str());
+
+  _listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (_listen_fd < 0 ||
+      bind(_listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(_listen_fd, SOMAXCONN) != 0) {
+    kLog->Error({"cannot listen on", _socket_path + ":", strerror(errno)});
+    return false;
+  }
+  kLog->Info({"listening on", _socket_path});
+  return true;
+}
+
+void Server::Run() {
+  for (;;) {
+    auto fd = accept(_listen_fd, nullptr, nullptr);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stop) {
+      if (fd >= 0) close(fd);
+      break;
+    }
+    if (fd < 0) continue;
+    _client_fds.insert(fd);
+    std::thread([this, fd] { Serve(fd); }).detach();
+  }
+
+  // Wake up the clients blocked in recv() and wait for their threads
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (auto fd : _client_fds) shutdown(fd, SHUT_RDWR);
+  _closed_cv.wait(lock, [this] { return _client_fds.empty(); });
+}
+
+void Server::Stop() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _stop = true;
+  shutdown(_listen_fd, SHUT_RDWR);
+}
+
+void Server::Serve(int fd) {
+  auto buf = std::string(), line = std::string();
+  while (RecvLine(fd, &buf, &line)) {
+    if (!SendAll(fd, Handle(line))) break;
+    // Stop only after answering, Run() shuts down all client sockets
+    if (line == "stop") Stop();
+  }
+
+  close(fd);
+  std::lock_guard<std::mutex> lock(_mutex);
+  _client_fds.erase(fd);
+  _closed_cv.notify_all();
+}
+
+std::string Server::Handle(const std::string &line) {
+  auto space = line.find(' ');
+  auto cmd = line.substr(0, space);
+  auto path = space == std::string::npos ? "" : line.substr(space + 1);
+
+  if (cmd == "stats") {
+    return Ok("files " + std::to_string(_cache.Size()) + "\nhits " +
+              std::to_string(_cache.hits) + "\nrehashes " +
+              std::to_string(_cache.rehashes) + "\nparses " +
+              std::to_string(_cache.parses) + "\n");
+  }
+  if (cmd == "stop") return Ok();
+  if (cmd != "parse" && cmd != "json" && cmd != "drop") {
+    return Err("unknown request \"" + cmd + "\"");
+  }
+  if (path.empty() || path[0] != '/') return Err("path must be absolute");
+  if (cmd == "drop") {
+    _cache.Drop(path);
+    return Ok();
+  }
+
+  auto entry = _cache.Get(path);
+  if (entry == nullptr) return Err("cannot read " + path);
+  if (entry->module == nullptr) return Err("syntax error in " + path);
+  return cmd == "json" ? Ok(entry->json) : Ok();
+}
+
+bool Server::Request(const std::string &socket_path, const std::string &line,
+                     std::string *response) {
+  sockaddr_un addr;
+  if (!MakeAddress(socket_path, &addr)) return false;
+  auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      !SendAll(fd, line + "\n")) {
+    close(fd);
+    return false;
+  }
+
+  auto buf = std::string(), head = std::string();
+  auto ok = RecvLine(fd, &buf, &head);
+  if (ok && head.rfind("ok ", 0) == 0) {
+    auto size = std::stoul(head.substr(3));
+    ok = RecvSize(fd, &buf, size);
+    *response = head + "\n" + buf.substr(0, size);
+  } else if (ok) {
+    *response = head;
+  }
+  close(fd);
+  return ok;
+}
+
+}  // namespace server
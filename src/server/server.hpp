@@ -0,0 +1,52 @@
+#ifndef _XULANG_SRC_SERVER_SERVER_HPP
+#define _XULANG_SRC_SERVER_SERVER_HPP
+
+#include <condition_variable>
+#include <unordered_set>
+
+#include "./cache.hpp"
+
+namespace server {
+
+// A long running front end on a Unix stream socket, so that tools pay for
+// process startup and cold parsing once. Requests are single lines and
+// every connection may send many of them:
+//   parse <abs path>  ->  "ok 0\n", or "error <reason>\n"
+//   json <abs path>   ->  "ok <n>\n" followed by n bytes of compact JSON
+//   drop <abs path>   ->  "ok 0\n", forget the cached module
+//   stats             ->  "ok <n>\n" followed by n bytes of counters
+//   stop              ->  "ok 0\n", then the server shuts down
+class Server final {
+ private:
+  std::string _socket_path;
+  int _listen_fd = -1;
+  ModuleCache _cache;
+
+  std::mutex _mutex;
+  std::condition_variable _closed_cv;
+  std::unordered_set<int> _client_fds;
+  bool _stop = false;
+
+  void Serve(int fd);
+  std::string Handle(const std::string &line);
+
+ public:
+  Server(const std::string &socket_path) : _socket_path(socket_path) {}
+  Server(const Server &) = delete;
+  ~Server();
+
+  // Bind the socket, replacing a stale one left by a dead server
+  bool Listen();
+  // Accept connections until a stop request, each one gets its own thread
+  void Run();
+  void Stop();
+
+  static std::string DefaultSocketPath();
+  // Send one request and wait for its response, for clients
+  static bool Request(const std::string &socket_path, const std::string &line,
+                      std::string *response);
+};
+
+}  // namespace server
+
+#endif  // _XULANG_SRC_SERVER_SERVER_HPP
@@ -0,0 +1,54 @@
+#include "./thread_pool.hpp"
+
+namespace utils {
+
+ThreadPool::ThreadPool(size_t threads) {
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < threads; ++i) {
+    _workers.emplace_back([this] { Work(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _task_cv.notify_all();
+  for (auto &worker : _workers) worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> &&task) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tasks.push(std::move(task));
+  }
+  _task_cv.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _idle_cv.wait(lock, [this] { return _tasks.empty() && _busy == 0; });
+}
+
+void ThreadPool::Work() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _task_cv.wait(lock, [this] { return _stop || !_tasks.empty(); });
+      if (_tasks.empty()) return;
+      task = std::move(_tasks.front());
+      _tasks.pop();
+      ++_busy;
+    }
+    task();
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      --_busy;
+      if (_tasks.empty() && _busy == 0) _idle_cv.notify_all();
+    }
+  }
+}
+
+}  // namespace utils
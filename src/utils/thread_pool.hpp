@@ -0,0 +1,40 @@
+#ifndef _SRC_UTILS_THREAD_POOL_HPP
+#define _SRC_UTILS_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+// A fixed set of workers consuming a FIFO task queue. Tasks may submit more
+// tasks, Wait() returns only when the queue is drained and all workers idle.
+class ThreadPool final {
+ private:
+  std::vector<std::thread> _workers;
+  std::queue<std::function<void()>> _tasks;
+  std::mutex _mutex;
+  std::condition_variable _task_cv;
+  std::condition_variable _idle_cv;
+  size_t _busy = 0;
+  bool _stop = false;
+
+  void Work();
+
+ public:
+  // threads == 0 means one worker per hardware thread
+  ThreadPool(size_t threads = 0);
+  ThreadPool(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  void Submit(std::function<void()> &&task);
+  void Wait();
+  inline size_t Size() const { return _workers.size(); }
+};
+
+}  // namespace utils
+
+#endif  // _SRC_UTILS_THREAD_POOL_HPP
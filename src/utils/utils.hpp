@@ -1,7 +1,9 @@
 #ifndef _SRC_UTILS_UTILS_HPP
 #define _SRC_UTILS_UTILS_HPP
 
+#include <cstdint>
 #include <memory>
+#include <string>
 
 namespace utils {
 
@@ -29,6 +31,15 @@ inline Sptr<DstT> CastS(const Sptr<SrcT> &sptr) {
   return std::dynamic_pointer_cast<DstT>(sptr);
 }
 
+// FNV-1a, unlike std::hash it is stable across runs, builds and platforms
+inline uint64_t Fnv1a(const std::string &data,
+                      uint64_t hash = 14695981039346656037ull) {
+  for (const auto &c : data) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
 }  // namespace utils
 
 #endif  // _SRC_UTILS_UTILS_HPP
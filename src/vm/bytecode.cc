@@ -0,0 +1,169 @@
+#include "./bytecode.hpp"
+
+#include <sstream>
+
+#include "../builtin/names.hpp"
+
+namespace vm {
+
+const char *OpName(Op op) {
+  static const char *const kNames[] = {
+#define _XULANG_VM_OP_NAME(op) #op,
+      _XULANG_VM_OPS(_XULANG_VM_OP_NAME)
+#undef _XULANG_VM_OP_NAME
+  };
+  return kNames[static_cast<int>(op)] + 1;  // without the k
+}
+
+Op OpOf(const std::string &name) {
+  static const std::unordered_map<std::string, Op> kOps = {
+      {"__plus__", Op::kAdd},          {"__self_plus__", Op::kAdd},
+      {"__minus__", Op::kSub},         {"__self_minus__", Op::kSub},
+      {"__mul__", Op::kMul},           {"__self_mul__", Op::kMul},
+      {"__div__", Op::kDiv},           {"__self_div__", Op::kDiv},
+      {"__mod__", Op::kMod},           {"__self_mod__", Op::kMod},
+      {"__bit_xor__", Op::kXor},       {"__self_bit_xor__", Op::kXor},
+      {"__bit_or__", Op::kOr},         {"__self_bit_or__", Op::kOr},
+      {"__bit_and__", Op::kAnd},       {"__self_bit_and__", Op::kAnd},
+      {"__shift_left__", Op::kShl},    {"__self_shift_left__", Op::kShl},
+      {"__shift_right__", Op::kShr},   {"__self_shift_right__", Op::kShr},
+      {"__eq__", Op::kEq},             {"__ne__", Op::kNe},
+      {"__le__", Op::kLe},             {"__ge__", Op::kGe},
+      {"__lt__", Op::kLt},             {"__gt__", Op::kGt},
+      {"__positive__", Op::kPos},      {"__negative__", Op::kNeg},
+      {"__not__", Op::kNot},           {"__bit_not__", Op::kBitNot},
+      {"__ref__", Op::kRef},           {"__deref__", Op::kMove},
+  };
+  auto found = kOps.find(name);
+  return found == kOps.end() ? Op::kNop : found->second;
+}
+
+static std::string ConstText(const Program &program, const Value &val) {
+  switch (val.tag) {
+    case Tag::kInt: return std::to_string(val.i);
+    case Tag::kFloat: {
+      auto out = std::ostringstream();
+      out << val.f;
+      return out.str();
+    }
+    case Tag::kString:
+      return "'" + static_cast<const String *>(val.obj)->text + "'";
+    case Tag::kBuiltin: return builtin::kBuiltins[val.i].name;
+    case Tag::kFunction: return program.funcs[val.i].name;
+    case Tag::kClass: return program.classes[val.i].name;
+    default: return "Void";
+  }
+}
+
+// e.g.
+//   3  JumpIfNotLt  r1, r2 -> 9
+static void DumpCode(const Program &program, const std::string &name,
+                     const Code &code, std::ostringstream &out) {
+  out << name << ": " << code.nregs << " regs\n";
+  for (size_t pc = 0; pc < code.instrs.size(); ++pc) {
+    const auto &instr = code.instrs[pc];
+    auto op = instr.op;
+    auto r = [](int x) { return "r" + std::to_string(x); };
+    auto k = [&](int x) { return ConstText(program, code.consts[x]); };
+    auto args = std::string();
+    switch (op) {
+      case Op::kNop:
+      case Op::kReturnVoid: break;
+      case Op::kConst: args = r(instr.a) + ", " + k(instr.b); break;
+      case Op::kInt:
+        args = r(instr.a) + ", " + std::to_string(int16_t(instr.b));
+        break;
+      case Op::kGlobal:
+      case Op::kSetGlobal:
+        args = r(instr.a) + ", " + program.globals[instr.b];
+        break;
+      case Op::kDefault:
+        args = r(instr.a) + " -> " + std::to_string(instr.t);
+        break;
+      case Op::kAddImm:
+        args = r(instr.a) + ", " + r(instr.b) + ", " +
+               std::to_string(int16_t(instr.c));
+        break;
+      case Op::kJump: args = "-> " + std::to_string(instr.t); break;
+      case Op::kJumpIf:
+      case Op::kJumpIfNot:
+        args = r(instr.a) + " -> " + std::to_string(instr.t);
+        break;
+      case Op::kJumpIfNotEq:
+      case Op::kJumpIfNotNe:
+      case Op::kJumpIfNotLt:
+      case Op::kJumpIfNotLe:
+      case Op::kJumpIfNotGt:
+      case Op::kJumpIfNotGe:
+        args = r(instr.a) + ", " + r(instr.b) + " -> " +
+               std::to_string(instr.t);
+        break;
+      case Op::kGetMember:
+        args = r(instr.a) + ", " + r(instr.b) + "." + k(instr.c);
+        break;
+      case Op::kSetMember:
+        args = r(instr.a) + "." + k(instr.b) + ", " + r(instr.c);
+        break;
+      case Op::kCall:
+      case Op::kCallFunc:
+      case Op::kCallMethod: {
+        args = r(instr.a) + ", ";
+        if (op == Op::kCall) args += r(instr.b);
+        if (op == Op::kCallFunc) args += program.funcs[instr.t].name;
+        if (op == Op::kCallMethod) args += r(instr.b) + "." + k(instr.t);
+        args += "(";
+        for (int i = 1; i <= instr.c; ++i) {
+          args += (i == 1 ? "" : ", ") + r(instr.b + i);
+        }
+        args += ")";
+        break;
+      }
+      case Op::kNew:
+        args = r(instr.a) + ", " + program.classes[instr.b].name;
+        break;
+      case Op::kSlice:
+        args = r(instr.a) + ", " + r(instr.b) + "[" + r(instr.b + 1) + ":" +
+               r(instr.b + 2) + ":" + r(instr.b + 3) + "]";
+        break;
+      case Op::kReturn:
+      case Op::kRaise: args = r(instr.a); break;
+      case Op::kMove:
+      case Op::kNeg:
+      case Op::kPos:
+      case Op::kNot:
+      case Op::kBitNot:
+      case Op::kBool:
+      case Op::kRef:
+      case Op::kToInt:
+      case Op::kToFloat:
+      case Op::kLength: args = r(instr.a) + ", " + r(instr.b); break;
+      default:
+        args = r(instr.a) + ", " + r(instr.b) + ", " + r(instr.c);
+        break;
+    }
+    auto num = std::to_string(pc);
+    out << std::string(5 - std::min<size_t>(num.size(), 4), ' ') << num << "  "
+        << OpName(op) << std::string(13 - std::min<size_t>(
+                                              std::strlen(OpName(op)), 12),
+                                     ' ')
+        << args << "\n";
+  }
+  for (const auto &handler : code.handlers) {
+    out << "  try " << handler.beg << ".." << handler.end << " -> "
+        << handler.target << " with r" << handler.reg << "\n";
+  }
+}
+
+std::string Disassemble(const Program &program) {
+  auto out = std::ostringstream();
+  DumpCode(program, "__init__", program.init, out);
+  for (const auto &cls : program.classes) {
+    if (cls.ast != nullptr) DumpCode(program, cls.name, cls.init, out);
+  }
+  for (const auto &func : program.funcs) {
+    DumpCode(program, func.name, func.code, out);
+  }
+  return out.str();
+}
+
+}  // namespace vm
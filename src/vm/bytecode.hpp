@@ -0,0 +1,160 @@
+#ifndef _XULANG_SRC_VM_BYTECODE_HPP
+#define _XULANG_SRC_VM_BYTECODE_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/statement.hpp"
+#include "./value.hpp"
+
+namespace vm {
+
+// r[x] is register x of the frame, the locals take the slots pass::Resolver
+// gave them and the temporaries come after. t is a code index to jump to.
+#define _XULANG_VM_OPS(X)                                                    \
+  X(kNop)                                                                    \
+  X(kMove)      /* r[a] = r[b] */                                            \
+  X(kConst)     /* r[a] = consts[b] */                                       \
+  X(kInt)       /* r[a] = b, as int16 */                                     \
+  X(kGlobal)    /* r[a] = globals[b] */                                      \
+  X(kSetGlobal) /* globals[b] = r[a] */                                      \
+  X(kDefault)   /* if the arg of param a was given, goto t */                \
+  X(kAdd)       /* r[a] = r[b] + r[c], and so on */                          \
+  X(kSub)                                                                    \
+  X(kMul)                                                                    \
+  X(kDiv)                                                                    \
+  X(kMod)                                                                    \
+  X(kXor)                                                                    \
+  X(kOr)                                                                     \
+  X(kAnd)                                                                    \
+  X(kShl)                                                                    \
+  X(kShr)                                                                    \
+  X(kEq)                                                                     \
+  X(kNe)                                                                     \
+  X(kLt)                                                                     \
+  X(kLe)                                                                     \
+  X(kGt)                                                                     \
+  X(kGe)                                                                     \
+  X(kAddImm)    /* r[a] = r[b] + c, as int16 */                              \
+  X(kNeg)       /* r[a] = -r[b] */                                           \
+  X(kPos)                                                                    \
+  X(kNot)                                                                    \
+  X(kBitNot)                                                                 \
+  X(kBool)      /* r[a] = 1 if r[b] is true else 0 */                        \
+  X(kRef)       /* r[a] = &r[b], the object itself */                        \
+  X(kToInt)     /* r[a] = Int(r[b]) */                                       \
+  X(kToFloat)   /* r[a] = Float(r[b]) */                                     \
+  X(kJump)      /* goto t */                                                 \
+  X(kJumpIf)    /* if r[a], goto t */                                        \
+  X(kJumpIfNot) /* if not r[a], goto t */                                    \
+  X(kJumpIfNotEq) /* if not r[a] == r[b], goto t, and so on */               \
+  X(kJumpIfNotNe)                                                            \
+  X(kJumpIfNotLt)                                                            \
+  X(kJumpIfNotLe)                                                            \
+  X(kJumpIfNotGt)                                                            \
+  X(kJumpIfNotGe)                                                            \
+  X(kGetIndex)  /* r[a] = r[b][r[c]] */                                      \
+  X(kGetIndexIn) /* as kGetIndex, the index is known to be in bounds */      \
+  X(kSetIndex)  /* r[a][r[b]] = r[c] */                                      \
+  X(kSetIndexIn)                                                             \
+  X(kSlice)     /* r[a] = r[b][r[b + 1]:r[b + 2]:r[b + 3]] */               \
+  X(kGetMember) /* r[a] = r[b].consts[c] */                                  \
+  X(kSetMember) /* r[a].consts[b] = r[c] */                                  \
+  X(kLength)    /* r[a] = r[b].length() */                                   \
+  X(kCall)      /* r[a] = r[b](r[b + 1], ..., r[b + c]) */                   \
+  X(kCallFunc)  /* as kCall, r[b] is funcs[t] */                             \
+  X(kCallMethod) /* r[a] = r[b].consts[t](r[b + 1], ..., r[b + c]) */        \
+  X(kMatch)     /* r[a] = 1 if the error r[b] is of the class r[c] else 0 */ \
+  X(kNew)       /* r[a] = an instance of classes[b], members r[0] ... */     \
+  X(kReturn)    /* return r[a] */                                            \
+  X(kReturnVoid)                                                             \
+  X(kRaise)     /* raise r[a] */
+
+enum class Op : uint8_t {
+#define _XULANG_VM_OP_ENUM(op) op,
+  _XULANG_VM_OPS(_XULANG_VM_OP_ENUM)
+#undef _XULANG_VM_OP_ENUM
+};
+
+const char *OpName(Op op);
+// Of an ast operator, e.g. kAdd for __plus__ and __self_plus__ and kMove
+// for __deref__, kNop for __assign__, __and__ and __or__
+Op OpOf(const std::string &name);
+
+// t is the target of jumps and the extra operand of calls
+struct Instr {
+  Op op;
+  uint16_t a = 0;
+  uint16_t b = 0;
+  uint16_t c = 0;
+  uint16_t t = 0;
+};
+
+// A raise between beg and end goes to target with the error in r[reg],
+// the innermost try comes first
+struct Handler {
+  uint16_t beg;
+  uint16_t end;
+  uint16_t target;
+  uint16_t reg;
+};
+
+struct Code {
+  int nregs = 0;
+  std::vector<Instr> instrs;
+  std::vector<Value> consts;
+  std::vector<Handler> handlers;
+};
+
+// Machine code of a Function without side effects, from jit::Jit. It takes
+// the args as int64_t, Floats by their bits, and returns false where the
+// bytecode would do what it does not, e.g. raise, for the bytecode to run
+// the call again from the start.
+struct Native {
+  static constexpr int kMaxParams = 8;
+
+  bool (*entry)(const int64_t *args, int64_t *res, int depth) = nullptr;
+  std::vector<Tag> params;  // kInt or kFloat, the args must be the same
+  Tag res = Tag::kVoid;
+};
+
+struct Func {
+  std::string name;  // e.g. main or OutOfRange.__Create__
+  const ast::Function *ast;
+  int nparams = 0;
+  int nrequired = 0;  // the unnamed params, before the keyword ones
+  std::vector<std::string> params;
+  int nslots = 0;  // locals, from pass::Resolver
+  Code code;
+  Native native;  // entry is nullptr unless compiled
+};
+
+struct Class {
+  std::string name;
+  const ast::Create *ast;  // Class or Struct, nullptr for Error
+  int base = -1;           // Class(Base), Program::classes index
+  bool is_error = false;   // Error or a class derived from it
+  std::unordered_map<std::string, int> members;  // slot by id
+  int nslots = 0;
+  int create = -1;  // slot of __Create__
+  Code init;        // creates the members and ends with kNew
+};
+
+// What a module compiles to. Error is always classes[0], its message is its
+// only member.
+struct Program {
+  std::string filename;
+  std::vector<Func> funcs;
+  std::vector<Class> classes;
+  std::vector<std::string> globals;  // ids of the Module objs
+  std::vector<Value> statics;  // by globals index, Functions and Classes
+  Code init;  // creates the other Module objs
+  int main = -1;  // globals index of main or Main
+};
+
+std::string Disassemble(const Program &program);
+
+}  // namespace vm
+
+#endif  // _XULANG_SRC_VM_BYTECODE_HPP
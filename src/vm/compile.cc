@@ -0,0 +1,901 @@
+#include "./compile.hpp"
+
+#include <algorithm>
+
+#include "../builtin/names.hpp"
+#include "../pass/fold.hpp"
+
+namespace vm {
+
+// The jump taken when the comparison is false
+static const std::unordered_map<std::string, Op> kJumpIfNots = {
+    {"__eq__", Op::kJumpIfNotEq}, {"__ne__", Op::kJumpIfNotNe},
+    {"__lt__", Op::kJumpIfNotLt}, {"__le__", Op::kJumpIfNotLe},
+    {"__gt__", Op::kJumpIfNotGt}, {"__ge__", Op::kJumpIfNotGe},
+};
+
+static constexpr int kMaxOperand = 0xffff;
+
+// e.g. 'a\'b\n' gives a'b and a new line
+static std::string Unquote(const std::string &text) {
+  auto res = std::string();
+  for (size_t i = 1; i + 1 < text.size(); ++i) {
+    if (text[i] != '\\' || i + 2 >= text.size()) {
+      res += text[i];
+      continue;
+    }
+    switch (text[++i]) {
+      case 'n': res += '\n'; break;
+      case 't': res += '\t'; break;
+      case 'r': res += '\r'; break;
+      case '0': res += '\0'; break;
+      case '\\':
+      case '\'':
+      case '"': res += text[i]; break;
+      default: res += std::string("\\") + text[i]; break;
+    }
+  }
+  return res;
+}
+
+Value LiteralValue(const ast::Literal *literal) {
+  if (std::string(literal->type->GetName()) == "String") {
+    return NewString(Unquote(*literal->val));
+  }
+  auto constant = pass::Constant();
+  if (!pass::ToConstant(literal, &constant)) return Value();
+  return constant.is_float ? Value::Float(constant.f)
+                           : Value::Int(static_cast<int64_t>(constant.i));
+}
+
+// Small Int literals go in the instr itself
+static bool SmallInt(const ast::Expression *expr, int *val) {
+  auto constant = pass::Constant();
+  if (!pass::ToConstant(expr, &constant) || constant.is_float) return false;
+  auto i = static_cast<int64_t>(constant.i);
+  if (i < INT16_MIN || i > INT16_MAX) return false;
+  *val = static_cast<int>(i);
+  return true;
+}
+
+// Every Function, Struct and Class with the path of Creates leading to it
+class Creates final : public ast::Walker {
+ public:
+  struct Found {
+    std::string name;  // e.g. Name.__Create__
+    ast::Create *create;
+  };
+  std::vector<Found> funcs;
+  std::vector<Found> classes;
+
+ private:
+  std::vector<std::string> _path;
+
+  std::string Enter(ast::Create *create) {
+    _path.push_back(*create->GetId());
+    auto name = std::string();
+    for (const auto &id : _path) name += (name.empty() ? "" : ".") + id;
+    return name;
+  }
+
+ public:
+  virtual void Visit(ast::Function *func) override {
+    funcs.push_back({Enter(func), func});
+    ast::Walker::Visit(func);
+    _path.pop_back();
+  }
+  virtual void Visit(ast::Struct *struct_create) override {
+    classes.push_back({Enter(struct_create), struct_create});
+    ast::Walker::Visit(struct_create);
+    _path.pop_back();
+  }
+  virtual void Visit(ast::Class *class_create) override {
+    classes.push_back({Enter(class_create), class_create});
+    ast::Walker::Visit(class_create);
+    _path.pop_back();
+  }
+  virtual void Visit(ast::Assemble *) override {}
+  virtual void Visit(ast::Import *) override {}
+};
+
+Compilation Compiler::operator()(ast::Module *module,
+                                 const pass::Resolution &resolution) {
+  auto res = Compilation();
+  res.program = std::make_unique<Program>();
+  _res = &res;
+  _program = res.program.get();
+  _resolution = &resolution;
+  _funcs.clear();
+  _classes.clear();
+  _creates.clear();
+  _module = false;
+  _in_func = false;
+  _defaults = false;
+  _program->filename = module->filename;
+
+  auto &error = _program->classes.emplace_back();
+  error.name = "Error";
+  error.ast = nullptr;
+  error.is_error = true;
+  error.members["message"] = 0;
+  error.nslots = 1;
+
+  // Give everything its index first, calls may come before the callee
+  auto creates = Creates();
+  creates.Walk(module);
+  for (const auto &[name, create] : creates.funcs) {
+    _funcs[create] = static_cast<int>(_program->funcs.size());
+    auto &func = _program->funcs.emplace_back();
+    func.name = name;
+    func.ast = static_cast<const ast::Function *>(create);
+  }
+  for (const auto &[name, create] : creates.classes) {
+    _classes[create] = static_cast<int>(_program->classes.size());
+    auto &cls = _program->classes.emplace_back();
+    cls.name = name;
+    cls.ast = create;
+  }
+  for (const auto &obj : module->objs) {
+    auto tag = Tag::kVoid;
+    auto idx = 0;
+    if (auto func = _funcs.find(obj.get()); func != _funcs.end()) {
+      tag = Tag::kFunction;
+      idx = func->second;
+    } else if (auto cls = _classes.find(obj.get()); cls != _classes.end()) {
+      tag = Tag::kClass;
+      idx = cls->second;
+    }
+    _program->globals.push_back(*obj->GetId());
+    _program->statics.push_back(Value::Of(tag, idx));
+    if (tag == Tag::kFunction &&
+        (*obj->GetId() == "main" || *obj->GetId() == "Main")) {
+      _program->main = static_cast<int>(_program->globals.size()) - 1;
+    }
+  }
+
+  // The members of a class are the slots of its frame, and of errors also
+  // the message. Bases are Error or classes of the module.
+  for (const auto &[_, create] : creates.classes) {
+    auto &cls = _program->classes[_classes[create]];
+    _where = module->filename + ": " + cls.name;
+    const auto &slots = _resolution->frame_of.at(create)->slots;
+    for (size_t i = 0; i < slots.size(); ++i) {
+      cls.members.emplace(slots[i], static_cast<int>(i));
+    }
+    cls.nslots = static_cast<int>(slots.size());
+    auto found = cls.members.find("__Create__");
+    if (found != cls.members.end()) cls.create = found->second;
+
+    auto class_create = dynamic_cast<const ast::Class *>(create);
+    if (class_create == nullptr || class_create->parents == nullptr) continue;
+    const auto &parents = *class_create->parents;
+    if (parents.unameds.empty()) continue;
+    if (parents.unameds.size() > 1 || !parents.keywords.empty()) {
+      Remark("only one base class is supported");
+      continue;
+    }
+    auto base = parents.unameds.front().get();
+    auto name = dynamic_cast<const ast::Name *>(base);
+    if (name != nullptr && name->binding.kind == ast::Binding::kBuiltin &&
+        *name->id == "Error") {
+      cls.base = 0;
+    } else if ((cls.base = Static(base, Tag::kClass)) < 0) {
+      Remark("the base class must be Error or a class of the module");
+    }
+  }
+  for (auto &cls : _program->classes) {
+    auto depth = 0;
+    for (auto at = cls.base; at >= 0 && depth < 64; ++depth) {
+      const auto &base = _program->classes[at];
+      if (base.members.size() > base.members.count("message")) {
+        _where = module->filename + ": " + cls.name;
+        Remark("members of base classes are not inherited");
+      }
+      if (base.is_error || at == 0) cls.is_error = true;
+      at = base.base;
+    }
+    if (cls.is_error && !cls.members.count("message")) {
+      cls.members["message"] = cls.nslots++;
+    }
+  }
+
+  for (const auto &[_, create] : creates.classes) {
+    auto idx = _classes[create];
+    auto body = dynamic_cast<const ast::Class *>(create) != nullptr
+                    ? static_cast<ast::Class *>(create)->body.get()
+                    : static_cast<ast::Struct *>(create)->body.get();
+    CompileClass(&_program->classes[idx], create, body);
+    auto found = _program->classes[idx].members.find("__Create__");
+    if (found == _program->classes[idx].members.end()) continue;
+    for (const auto &stmt : body->statements) {
+      auto func = dynamic_cast<ast::Function *>(stmt.get());
+      if (func != nullptr && *func->id == "__Create__") {
+        _creates[idx] = _funcs[func];
+      }
+    }
+  }
+  for (const auto &[_, create] : creates.funcs) {
+    auto func = static_cast<ast::Function *>(create);
+    CompileFunc(&_program->funcs[_funcs[func]], func->args.get(),
+                func->body.get());
+  }
+
+  // The Module objs which are not Functions or Classes are created in order
+  Begin(&_program->init, 0, module->filename);
+  _module = true;
+  for (const auto &obj : module->objs) {
+    _top = 0;
+    obj->Accept(this);
+  }
+  Emit(Op::kReturnVoid);
+  End();
+  _module = false;
+
+  if (!res.remarks.empty()) res.program = nullptr;
+  return res;
+}
+
+void Compiler::Remark(const std::string &message) {
+  _res->remarks.push_back({"vm", _where, message});
+}
+
+int Compiler::Temp() {
+  auto reg = _top++;
+  _code->nregs = std::max(_code->nregs, _top);
+  return reg;
+}
+
+size_t Compiler::Emit(Op op, int a, int b, int c, int t) {
+  if (std::max({a, b, c, t}) > kMaxOperand) {
+    Remark("too many registers, constants or instrs");
+  }
+  _code->instrs.push_back({op, static_cast<uint16_t>(a),
+                           static_cast<uint16_t>(b), static_cast<uint16_t>(c),
+                           static_cast<uint16_t>(t)});
+  return _code->instrs.size() - 1;
+}
+
+int Compiler::Const(Value &&val) {
+  _code->consts.push_back(std::move(val));
+  return static_cast<int>(_code->consts.size()) - 1;
+}
+
+void Compiler::Patch(const std::vector<size_t> &jumps, size_t target) {
+  if (target > kMaxOperand) Remark("too many instrs");
+  for (auto jump : jumps) {
+    _code->instrs[jump].t = static_cast<uint16_t>(target);
+  }
+}
+
+void Compiler::Begin(Code *code, int nslots, const std::string &where) {
+  _code = code;
+  _code->nregs = nslots;
+  _nslots = nslots;
+  _top = nslots;
+  _where = where;
+  _loops.clear();
+}
+
+void Compiler::End() {
+  if (_code->nregs > kMaxOperand) Remark("too many registers");
+}
+
+// r[0] ... are the params, the args given and kMissing for the others.
+// The default of a keyword param replaces kMissing.
+void Compiler::CompileFunc(Func *func, ast::CallOperator *args,
+                           ast::Block *body) {
+  const auto &frame = *_resolution->frame_of.at(func->ast);
+  func->nparams = frame.params;
+  func->params.assign(frame.slots.begin(), frame.slots.begin() + frame.params);
+  func->nrequired = func->nparams - static_cast<int>(args->keywords.size());
+  func->nslots = static_cast<int>(frame.slots.size());
+  Begin(&func->code, func->nslots, _program->filename + ": " + func->name);
+
+  auto param = func->nrequired;
+  _defaults = true;
+  for (const auto &[_, val] : args->keywords) {
+    auto skip = Emit(Op::kDefault, param);
+    Into(val.get(), param);
+    _top = _nslots;
+    Patch({skip}, Here());
+    ++param;
+  }
+  _defaults = false;
+
+  _in_func = true;
+  Walk(body);
+  _in_func = false;
+  Emit(Op::kReturnVoid);
+  End();
+}
+
+// The members are the registers, kNew gathers them in the instance
+void Compiler::CompileClass(Class *cls, ast::Create *create, ast::Block *body) {
+  auto nslots =
+      static_cast<int>(_resolution->frame_of.at(create)->slots.size());
+  Begin(&cls->init, std::max(nslots, cls->nslots),
+        _program->filename + ": " + cls->name);
+  for (auto slot = nslots; slot < cls->nslots; ++slot) {
+    Emit(Op::kConst, slot, Const(Value()));
+  }
+  Walk(body);
+  auto instance = Temp();
+  Emit(Op::kNew, instance, _classes[create]);
+  Emit(Op::kReturn, instance);
+  End();
+}
+
+int Compiler::Reg(ast::Expression *expr) {
+  _dst = -1;
+  _reg = -1;
+  Walk(expr);
+  return _reg;
+}
+
+void Compiler::Into(ast::Expression *expr, int dst) {
+  _dst = dst;
+  _reg = -1;
+  Walk(expr);
+  if (_reg >= 0 && _reg != dst) Emit(Op::kMove, dst, _reg);
+}
+
+// Jump to the targets patched into jumps when the truth of expr is when,
+// fall through otherwise. && and || never evaluate more than they need.
+void Compiler::Branch(ast::Expression *expr, bool when,
+                      std::vector<size_t> *jumps) {
+  auto mark = _top;
+  auto constant = pass::Constant();
+  if (pass::ToConstant(expr, &constant)) {
+    if (constant.IsTrue() == when) jumps->push_back(Emit(Op::kJump));
+    return;
+  }
+
+  if (auto logic = dynamic_cast<ast::LogicExpr *>(expr); logic != nullptr) {
+    auto name = std::string(logic->op->GetName());
+    if (name == "__and__" || name == "__or__") {
+      // when is what decides both, e.g. a && b is false once a is
+      if ((name == "__and__") != when) {
+        Branch(logic->left.get(), when, jumps);
+        Branch(logic->right.get(), when, jumps);
+      } else {
+        auto decided = std::vector<size_t>();
+        Branch(logic->left.get(), !when, &decided);
+        Branch(logic->right.get(), when, jumps);
+        Patch(decided, Here());
+      }
+      return;
+    }
+    auto left = Reg(logic->left.get());
+    auto right = Reg(logic->right.get());
+    _top = mark;
+    auto jump = Emit(kJumpIfNots.at(name), left, right);
+    if (!when) {
+      jumps->push_back(jump);
+    } else {
+      jumps->push_back(Emit(Op::kJump));
+      Patch({jump}, Here());
+    }
+    return;
+  }
+
+  auto unary = dynamic_cast<ast::UnaryOpExpr *>(expr);
+  if (unary != nullptr && std::string(unary->op->GetName()) == "__not__") {
+    return Branch(unary->right.get(), !when, jumps);
+  }
+  auto test = Reg(expr);
+  _top = mark;
+  jumps->push_back(Emit(when ? Op::kJumpIf : Op::kJumpIfNot, test));
+}
+
+// Evaluate the target before the value, e.g. a[i] += f() reads a[i] first
+int Compiler::Assign(ast::Expression *target, const std::string &op,
+                     ast::Expression *val) {
+  auto is_assign = op == "__assign__";
+  auto compute = [&](int old) {
+    auto imm = 0;
+    auto bin = OpOf(op);
+    if ((bin == Op::kAdd || bin == Op::kSub) && SmallInt(val, &imm) &&
+        imm != INT16_MIN) {
+      Emit(Op::kAddImm, old, old, bin == Op::kAdd ? imm : -imm);
+    } else {
+      Emit(bin, old, old, Reg(val));
+    }
+  };
+
+  if (auto name = dynamic_cast<ast::Name *>(target); name != nullptr) {
+    const auto &binding = name->binding;
+    if (name->parent != nullptr) {
+      auto obj = Reg(name->parent.get());
+      auto id = Const(NewString(*name->id));
+      if (is_assign) {
+        auto res = Reg(val);
+        Emit(Op::kSetMember, obj, id, res);
+        return res;
+      }
+      auto res = Temp();
+      Emit(Op::kGetMember, res, obj, id);
+      compute(res);
+      Emit(Op::kSetMember, obj, id, res);
+      return res;
+    }
+    if (binding.kind == ast::Binding::kLocal && binding.depth == 0 &&
+        !_module) {
+      if (is_assign) {
+        Into(val, binding.slot);
+      } else {
+        compute(binding.slot);
+      }
+      return binding.slot;
+    }
+    if (binding.kind == ast::Binding::kGlobal && binding.slot >= 0) {
+      if (is_assign) {
+        auto res = Reg(val);
+        Emit(Op::kSetGlobal, res, binding.slot);
+        return res;
+      }
+      auto res = Temp();
+      Emit(Op::kGlobal, res, binding.slot);
+      compute(res);
+      Emit(Op::kSetGlobal, res, binding.slot);
+      return res;
+    }
+    Remark("cannot assign to \"" + *name->id + "\"");
+    return Reg(val);
+  }
+
+  if (auto sub = dynamic_cast<ast::SubscriptExpr *>(target); sub != nullptr) {
+    const auto &dims = sub->op->dims;
+    if (dims.size() != 1) {
+      Remark("only subscripts of one index are supported");
+      return Reg(val);
+    }
+    if (ast::SubscriptOperator::IsSlice(*dims.front())) {
+      Remark("cannot assign to a slice, Copy into it instead");
+      return Reg(val);
+    }
+    auto in_bounds = !sub->op->in_bounds.empty() && sub->op->in_bounds[0];
+    auto obj = Reg(sub->obj.get());
+    auto idx = Reg(std::get<0>(*dims.front()).get());
+    auto set = in_bounds ? Op::kSetIndexIn : Op::kSetIndex;
+    if (is_assign) {
+      auto res = Reg(val);
+      Emit(set, obj, idx, res);
+      return res;
+    }
+    auto res = Temp();
+    Emit(in_bounds ? Op::kGetIndexIn : Op::kGetIndex, res, obj, idx);
+    compute(res);
+    Emit(set, obj, idx, res);
+    return res;
+  }
+
+  Remark("cannot assign to this expression");
+  return Reg(val);
+}
+
+// Put the callee, if any, in a new register b and the args after it,
+// keyword args in the place of their param and kMissing in the gaps
+int Compiler::Call(ast::CallOperator *cop, const Func *func, int skip,
+                   ast::Expression *callee, int *argc) {
+  auto args = std::vector<std::pair<ast::Expression *, int>>();
+  auto count = 0;
+  for (const auto &x : cop->unameds) args.push_back({x.get(), count++});
+  for (const auto &[id, val] : cop->keywords) {
+    auto pos = -1;
+    if (func != nullptr) {
+      for (int i = skip; i < func->nparams; ++i) {
+        if (func->params[i] == *id) pos = i - skip;
+      }
+    }
+    if (pos < 0 || pos < static_cast<int>(cop->unameds.size())) {
+      Remark(func == nullptr
+                 ? "keyword args need a callee known when compiling"
+                 : func->name + " has no param " + *id + " left for the arg");
+      continue;
+    }
+    args.push_back({val.get(), pos});
+    count = std::max(count, pos + 1);
+  }
+
+  auto base = Temp();
+  for (int i = 0; i < count; ++i) Temp();
+  auto top = _top;
+  if (callee != nullptr) Into(callee, base);
+  auto given = std::vector<bool>(count);
+  for (const auto &[expr, pos] : args) {
+    if (given[pos]) Remark("more than one arg for the same param");
+    given[pos] = true;
+    _top = top;
+    Into(expr, base + 1 + pos);
+  }
+  _top = top;
+  for (int i = 0; i < count; ++i) {
+    if (!given[i]) {
+      Emit(Op::kConst, base + 1 + i, Const(Value::Of(Tag::kMissing, 0)));
+    }
+  }
+  *argc = count;
+  return base;
+}
+
+// A Create inside a Function, Struct or Class is stored in its slot each
+// time the code runs, it is the same static Function or Class every time
+void Compiler::Nested(ast::Create *create) {
+  if (_module) return;
+  auto val = Value();
+  if (auto func = _funcs.find(create); func != _funcs.end()) {
+    val = Value::Of(Tag::kFunction, func->second);
+  } else {
+    val = Value::Of(Tag::kClass, _classes.at(create));
+  }
+  Emit(Op::kConst, create->binding.slot, Const(std::move(val)));
+}
+
+// The Program::funcs or classes index of a Module obj, -1 if expr is not one
+int Compiler::Static(ast::Expression *expr, Tag tag) const {
+  auto name = dynamic_cast<const ast::Name *>(expr);
+  if (name == nullptr || name->parent != nullptr ||
+      name->binding.kind != ast::Binding::kGlobal || name->binding.slot < 0) {
+    return -1;
+  }
+  const auto &val = _program->statics[name->binding.slot];
+  return val.tag == tag ? static_cast<int>(val.i) : -1;
+}
+
+void Compiler::Visit(ast::Block *block) {
+  for (const auto &stmt : block->statements) {
+    auto mark = _top;
+    Walk(stmt.get());
+    _top = mark;
+  }
+}
+
+void Compiler::Visit(ast::ExprStatement *stmt) { Reg(stmt->expr.get()); }
+
+void Compiler::Visit(ast::Break *) {
+  if (_loops.empty()) return Remark("break outside a loop");
+  _loops.back().breaks.push_back(Emit(Op::kJump));
+}
+
+void Compiler::Visit(ast::Continue *) {
+  if (_loops.empty()) return Remark("continue outside a loop");
+  _loops.back().continues.push_back(Emit(Op::kJump));
+}
+
+void Compiler::Visit(ast::Return *ret) {
+  if (!_in_func) return Remark("return outside a function");
+  if (ret->expr == nullptr) {
+    Emit(Op::kReturnVoid);
+    return;
+  }
+  Emit(Op::kReturn, Reg(ret->expr.get()));
+}
+
+void Compiler::Visit(ast::If *if_stmt) {
+  auto orelse = std::vector<size_t>();
+  Branch(if_stmt->test.get(), false, &orelse);
+  Walk(if_stmt->body.get());
+  if (if_stmt->orelse == nullptr) {
+    Patch(orelse, Here());
+    return;
+  }
+  auto end = Emit(Op::kJump);
+  Patch(orelse, Here());
+  Walk(if_stmt->orelse.get());
+  Patch({end}, Here());
+}
+
+// Break skips the else
+void Compiler::Visit(ast::While *while_stmt) {
+  auto top = Here();
+  auto exits = std::vector<size_t>();
+  Branch(while_stmt->test.get(), false, &exits);
+  _loops.emplace_back();
+  Walk(while_stmt->body.get());
+  Emit(Op::kJump, 0, 0, 0, static_cast<int>(top));
+  auto loop = std::move(_loops.back());
+  _loops.pop_back();
+  Patch(loop.continues, top);
+  Patch(exits, Here());
+  Walk(while_stmt->orelse.get());
+  Patch(loop.breaks, Here());
+}
+
+void Compiler::Visit(ast::ObjCreate *create) {
+  const auto &binding = create->binding;
+  if (binding.kind == ast::Binding::kLocal) {
+    Into(create->call_expr.get(), binding.slot);
+  } else {
+    Emit(Op::kSetGlobal, Reg(create->call_expr.get()), binding.slot);
+  }
+}
+
+void Compiler::Visit(ast::Function *func) { Nested(func); }
+void Compiler::Visit(ast::Assemble *) { Remark("Assemble is not supported"); }
+void Compiler::Visit(ast::Struct *struct_create) { Nested(struct_create); }
+void Compiler::Visit(ast::Class *class_create) { Nested(class_create); }
+void Compiler::Visit(ast::Import *) { Remark("Import is not supported"); }
+
+void Compiler::Visit(ast::Raise *raise) {
+  Emit(Op::kRaise, Reg(raise->error.get()));
+}
+
+// try { body } except (e := T) { handler } else { orelse } becomes
+//   body; orelse; jump after
+// target, the handler of body:
+//   match m, r, T; jump if not m to next; e = r; handler; jump after
+// next:
+//   raise r, to the handler of an enclosing try if any
+void Compiler::Visit(ast::Try *try_stmt) {
+  auto beg = Here();
+  Walk(try_stmt->body.get());
+  auto end = Here();
+  Walk(try_stmt->orelse.get());
+  auto after = std::vector<size_t>{Emit(Op::kJump)};
+
+  auto error = Temp();
+  if (Here() > kMaxOperand) Remark("too many instrs");
+  _code->handlers.push_back(
+      {static_cast<uint16_t>(beg), static_cast<uint16_t>(end),
+       static_cast<uint16_t>(Here()), static_cast<uint16_t>(error)});
+  size_t idx = 0;
+  for (const auto &[alias, type, handler] : try_stmt->excepts) {
+    auto mark = _top;
+    auto match = Temp();
+    Emit(Op::kMatch, match, error, Reg(type.get()));
+    _top = mark;
+    auto next = Emit(Op::kJumpIfNot, match);
+    if (idx < try_stmt->alias_slots.size()) {
+      Emit(Op::kMove, try_stmt->alias_slots[idx], error);
+    } else {
+      Remark("except outside a function");
+    }
+    ++idx;
+    Walk(handler.get());
+    after.push_back(Emit(Op::kJump));
+    Patch({next}, Here());
+  }
+  Emit(Op::kRaise, error);
+  Patch(after, Here());
+}
+
+void Compiler::Visit(ast::Literal *literal) {
+  auto dst = _dst;
+  auto small = 0;
+  if (SmallInt(literal, &small)) {
+    _reg = Target(dst);
+    Emit(Op::kInt, _reg, static_cast<uint16_t>(small));
+    return;
+  }
+  auto val = LiteralValue(literal);
+  if (val.tag == Tag::kVoid) Remark("invalid literal " + *literal->val);
+  _reg = Target(dst);
+  Emit(Op::kConst, _reg, Const(std::move(val)));
+}
+
+void Compiler::Visit(ast::Name *name) {
+  auto dst = _dst;
+  auto mark = _top;
+  const auto &binding = name->binding;
+  if (name->parent != nullptr) {
+    auto obj = Reg(name->parent.get());
+    _top = mark;
+    _reg = Target(dst);
+    Emit(Op::kGetMember, _reg, obj, Const(NewString(*name->id)));
+    return;
+  }
+
+  switch (binding.kind) {
+    case ast::Binding::kLocal:
+      if (_defaults) {
+        Remark("defaults may only use Module objs and builtins, not \"" +
+               *name->id + "\"");
+      } else if (binding.depth > 0) {
+        Remark("locals of outer frames are not supported, \"" + *name->id +
+               "\"");
+      }
+      _reg = binding.slot;
+      return;
+    case ast::Binding::kGlobal:
+      if (binding.slot < 0) break;
+      _reg = Target(dst);
+      Emit(Op::kGlobal, _reg, binding.slot);
+      return;
+    case ast::Binding::kBuiltin:
+      _reg = Target(dst);
+      Emit(Op::kConst, _reg, Const(Value::Of(Tag::kBuiltin, binding.slot)));
+      return;
+    default: break;
+  }
+  Remark("unresolved name \"" + *name->id + "\"");
+  _reg = Target(dst);
+}
+
+void Compiler::Visit(ast::UnaryOpExpr *expr) {
+  auto dst = _dst;
+  auto mark = _top;
+  auto right = Reg(expr->right.get());
+  _top = mark;
+  _reg = Target(dst);
+  Emit(OpOf(expr->op->GetName()), _reg, right);
+}
+
+void Compiler::Visit(ast::BinaryOpExpr *expr) {
+  auto dst = _dst;
+  auto mark = _top;
+  auto name = std::string(expr->op->GetName());
+  if (name == "__assign__" || name.rfind("__self_", 0) == 0) {
+    _reg = Assign(expr->left.get(), name, expr->right.get());
+    return;
+  }
+
+  auto op = OpOf(name);
+  auto left = Reg(expr->left.get());
+  auto imm = 0;
+  if ((op == Op::kAdd || op == Op::kSub) &&
+      SmallInt(expr->right.get(), &imm) && imm != INT16_MIN) {
+    _top = mark;
+    _reg = Target(dst);
+    Emit(Op::kAddImm, _reg, left, op == Op::kAdd ? imm : -imm);
+    return;
+  }
+  auto right = Reg(expr->right.get());
+  _top = mark;
+  _reg = Target(dst);
+  Emit(op, _reg, left, right);
+}
+
+void Compiler::Visit(ast::LogicExpr *expr) {
+  auto dst = _dst;
+  auto mark = _top;
+  auto name = std::string(expr->op->GetName());
+  if (name != "__and__" && name != "__or__") {
+    auto left = Reg(expr->left.get());
+    auto right = Reg(expr->right.get());
+    _top = mark;
+    _reg = Target(dst);
+    Emit(OpOf(name), _reg, left, right);
+    return;
+  }
+
+  // 0 or 1, written once both sides are known not to read a local it is
+  // going to
+  auto res = dst >= _nslots ? dst : Temp();
+  auto falses = std::vector<size_t>();
+  Branch(expr, false, &falses);
+  Emit(Op::kInt, res, 1);
+  auto end = Emit(Op::kJump);
+  Patch(falses, Here());
+  Emit(Op::kInt, res, 0);
+  Patch({end}, Here());
+  _reg = res;
+}
+
+void Compiler::Visit(ast::IfElseExpr *expr) {
+  auto dst = _dst;
+  auto res = dst >= _nslots ? dst : Temp();
+  auto mark = _top;
+  auto not_taken = std::vector<size_t>();
+  Branch(expr->test.get(), false, &not_taken);
+  Into(expr->left.get(), res);
+  _top = mark;
+  auto end = Emit(Op::kJump);
+  Patch(not_taken, Here());
+  Into(expr->right.get(), res);
+  _top = mark;
+  Patch({end}, Here());
+  _reg = res;
+}
+
+void Compiler::Visit(ast::CallExpr *expr) {
+  auto dst = _dst;
+  auto mark = _top;
+  auto cop = expr->op.get();
+  auto name = dynamic_cast<ast::Name *>(expr->obj.get());
+  auto plain = cop->keywords.empty() && cop->unameds.size() <= 1;
+
+  // Int(x), Float(x) and x.length() need no call
+  if (name != nullptr && name->parent == nullptr &&
+      name->binding.kind == ast::Binding::kBuiltin && plain &&
+      (*name->id == "Int" || *name->id == "Float")) {
+    auto is_int = *name->id == "Int";
+    if (cop->unameds.empty()) {
+      _reg = Target(dst);
+      if (is_int) {
+        Emit(Op::kInt, _reg, 0);
+      } else {
+        Emit(Op::kConst, _reg, Const(Value::Float(0)));
+      }
+      return;
+    }
+    // Int(0) is the literal itself
+    auto arg = cop->unameds.front().get();
+    auto constant = pass::Constant();
+    if (pass::ToConstant(arg, &constant) && constant.is_float != is_int) {
+      _dst = dst;
+      return Walk(arg);
+    }
+    auto reg = Reg(arg);
+    _top = mark;
+    _reg = Target(dst);
+    Emit(is_int ? Op::kToInt : Op::kToFloat, _reg, reg);
+    return;
+  }
+  if (name != nullptr && name->parent != nullptr && *name->id == "length" &&
+      cop->unameds.empty() && cop->keywords.empty()) {
+    auto obj = Reg(name->parent.get());
+    _top = mark;
+    _reg = Target(dst);
+    Emit(Op::kLength, _reg, obj);
+    return;
+  }
+
+  // The method of an instance gets the instance as its first arg
+  auto argc = 0;
+  if (name != nullptr && name->parent != nullptr) {
+    auto id = Const(NewString(*name->id));
+    auto base = Call(cop, nullptr, 0, name->parent.get(), &argc);
+    _top = mark;
+    _reg = Target(dst);
+    Emit(Op::kCallMethod, _reg, base, argc, id);
+    return;
+  }
+  auto func = Static(expr->obj.get(), Tag::kFunction);
+  if (func >= 0) {
+    auto base = Call(cop, &_program->funcs[func], 0, nullptr, &argc);
+    _top = mark;
+    _reg = Target(dst);
+    Emit(Op::kCallFunc, _reg, base, argc, func);
+    return;
+  }
+  auto cls = Static(expr->obj.get(), Tag::kClass);
+  auto create = _creates.find(cls);
+  auto base = Call(cop, create == _creates.end()
+                            ? nullptr
+                            : &_program->funcs[create->second],
+                   1, expr->obj.get(), &argc);
+  _top = mark;
+  _reg = Target(dst);
+  Emit(Op::kCall, _reg, base, argc);
+}
+
+void Compiler::Visit(ast::SubscriptExpr *expr) {
+  auto dst = _dst;
+  auto mark = _top;
+  const auto &dims = expr->op->dims;
+  if (dims.size() != 1) {
+    Remark("only subscripts of one index are supported");
+    _reg = Target(dst);
+    return;
+  }
+  if (ast::SubscriptOperator::IsSlice(*dims.front())) {
+    // The object and the bounds, Void if not given, in a row as kSlice
+    // takes them
+    auto base = Temp();
+    for (int i = 0; i < 3; ++i) Temp();
+    auto top = _top;
+    Into(expr->obj.get(), base);
+    const auto &[beg, end, step] = *dims.front();
+    ast::Expression *bounds[] = {beg.get(), end.get(), step.get()};
+    for (int i = 0; i < 3; ++i) {
+      _top = top;
+      if (bounds[i] != nullptr) {
+        Into(bounds[i], base + 1 + i);
+      } else {
+        Emit(Op::kConst, base + 1 + i, Const(Value()));
+      }
+    }
+    _top = mark;
+    _reg = Target(dst);
+    Emit(Op::kSlice, _reg, base);
+    return;
+  }
+  auto in_bounds = !expr->op->in_bounds.empty() && expr->op->in_bounds[0];
+  auto obj = Reg(expr->obj.get());
+  auto idx = Reg(std::get<0>(*dims.front()).get());
+  _top = mark;
+  _reg = Target(dst);
+  Emit(in_bounds ? Op::kGetIndexIn : Op::kGetIndex, _reg, obj, idx);
+}
+
+}  // namespace vm
@@ -0,0 +1,110 @@
+#ifndef _XULANG_SRC_VM_COMPILE_HPP
+#define _XULANG_SRC_VM_COMPILE_HPP
+
+#include "../ast/walker.hpp"
+#include "../pass/resolve.hpp"
+#include "./bytecode.hpp"
+
+namespace vm {
+
+// The value of an Int, Float or String Literal, Void if it is invalid
+Value LiteralValue(const ast::Literal *literal);
+
+struct Compilation {
+  // nullptr if something is not supported, the remarks say what
+  utils::Uptr<Program> program;
+  pass::Remarks remarks;
+};
+
+// Compile a module to register bytecode, after pass::Resolver has bound its
+// names. The locals of a frame are its registers and the temporaries of an
+// expression are stacked above them, so the args of a call are always the
+// top registers and the frame of the callee starts at them. Tests compile to
+// fused compare and jump, Int(x) and x.length() to single instrs, and the
+// subscripts pass::RangeAnalyzer proved in bounds skip the check. Locals of
+// outer frames, Import, Assemble, multi dim subscripts and assigning to a
+// slice are not supported.
+class Compiler final : private ast::Walker {
+ private:
+  struct Loop {
+    std::vector<size_t> breaks;
+    std::vector<size_t> continues;
+  };
+
+  std::string _where;
+  Compilation *_res;
+  Program *_program;
+  const pass::Resolution *_resolution;
+  std::unordered_map<const ast::Create *, int> _funcs;    // Program::funcs
+  std::unordered_map<const ast::Create *, int> _classes;  // Program::classes
+  std::unordered_map<int, int> _creates;  // __Create__ func by class
+  Code *_code;
+  int _nslots;  // the locals, temporaries are allocated from here
+  int _top;     // the next free temporary
+  bool _module;    // compiling Program::init, no locals
+  bool _in_func;   // compiling the body of a Function
+  bool _defaults;  // compiling the defaults of keyword params
+  std::vector<Loop> _loops;
+
+  // Of the expression being walked: where to put its value, -1 for any
+  // register, and where it was put
+  int _dst;
+  int _reg;
+
+  void Remark(const std::string &message);
+  int Temp();
+  size_t Emit(Op op, int a = 0, int b = 0, int c = 0, int t = 0);
+  int Const(Value &&val);
+  void Patch(const std::vector<size_t> &jumps, size_t target);
+  size_t Here() const { return _code->instrs.size(); }
+
+  void Begin(Code *code, int nslots, const std::string &where);
+  void End();
+  void CompileFunc(Func *func, ast::CallOperator *args, ast::Block *body);
+  void CompileClass(Class *cls, ast::Create *create, ast::Block *body);
+
+  int Reg(ast::Expression *expr);
+  void Into(ast::Expression *expr, int dst);
+  int Target(int dst) { return dst >= 0 ? dst : Temp(); }
+  void Branch(ast::Expression *expr, bool when, std::vector<size_t> *jumps);
+  int Assign(ast::Expression *target, const std::string &op,
+             ast::Expression *val);
+  int Call(ast::CallOperator *cop, const Func *func, int skip,
+           ast::Expression *callee, int *argc);
+  void Nested(ast::Create *create);
+  int Static(ast::Expression *callee, Tag tag) const;
+
+ public:
+  Compilation operator()(ast::Module *module,
+                         const pass::Resolution &resolution);
+
+ private:
+  virtual void Visit(ast::Block *) override;
+  virtual void Visit(ast::ExprStatement *) override;
+  virtual void Visit(ast::Break *) override;
+  virtual void Visit(ast::Continue *) override;
+  virtual void Visit(ast::Return *) override;
+  virtual void Visit(ast::If *) override;
+  virtual void Visit(ast::While *) override;
+  virtual void Visit(ast::ObjCreate *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Assemble *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Import *) override;
+  virtual void Visit(ast::Raise *) override;
+  virtual void Visit(ast::Try *) override;
+
+  virtual void Visit(ast::Literal *) override;
+  virtual void Visit(ast::Name *) override;
+  virtual void Visit(ast::UnaryOpExpr *) override;
+  virtual void Visit(ast::BinaryOpExpr *) override;
+  virtual void Visit(ast::LogicExpr *) override;
+  virtual void Visit(ast::IfElseExpr *) override;
+  virtual void Visit(ast::CallExpr *) override;
+  virtual void Visit(ast::SubscriptExpr *) override;
+};
+
+}  // namespace vm
+
+#endif  // _XULANG_SRC_VM_COMPILE_HPP
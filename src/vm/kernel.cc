@@ -0,0 +1,256 @@
+#include "./kernel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vm {
+
+// 16 bytes of lanes, as every x86-64 and AArch64 has
+typedef int8_t I8x16 __attribute__((vector_size(16)));
+typedef int64_t I64x2 __attribute__((vector_size(16)));
+typedef uint64_t U64x2 __attribute__((vector_size(16)));
+typedef double F64x2 __attribute__((vector_size(16)));
+typedef int16_t I16x16 __attribute__((vector_size(32)));
+
+static constexpr size_t kBlock = 16;
+
+template <typename V>
+static inline V Load(const uint8_t *at) {
+  V v;
+  __builtin_memcpy(&v, at, sizeof(V));
+  return v;
+}
+
+template <typename V>
+static inline void Store(uint8_t *at, V v) {
+  __builtin_memcpy(at, &v, sizeof(V));
+}
+
+template <typename V>
+static inline bool Any(V mask) {
+  for (size_t i = 0; i < sizeof(V) / sizeof(mask[0]); ++i) {
+    if (mask[i] != 0) return true;
+  }
+  return false;
+}
+
+// As Runtime::Binary compares numbers
+static inline bool Same(const Value &a, const Value &b) {
+  if (a.tag == Tag::kInt && b.tag == Tag::kInt) return a.i == b.i;
+  auto x = a.tag == Tag::kInt ? static_cast<double>(a.i) : a.f;
+  auto y = b.tag == Tag::kInt ? static_cast<double>(b.i) : b.f;
+  return x == y;
+}
+
+static inline Value Get(const Span &span, size_t idx) {
+  return Memory::Load(span.elem,
+                      span.data + static_cast<ptrdiff_t>(idx) * span.stride);
+}
+
+// The byte an Int8 element equal to val has, false if none is
+static bool AsInt8(const Value &val, int8_t *byte) {
+  auto f = val.tag == Tag::kInt ? static_cast<double>(val.i) : val.f;
+  if (val.tag == Tag::kInt ? val.i < -128 || val.i > 127
+                           : !(f >= -128 && f <= 127) || std::trunc(f) != f) {
+    return false;
+  }
+  *byte = static_cast<int8_t>(val.tag == Tag::kInt ? val.i : f);
+  return true;
+}
+
+void Fill(const Span &dst, const Value &val, bool simd) {
+  uint64_t pattern = 0;
+  Memory::Store(dst.elem, reinterpret_cast<uint8_t *>(&pattern), val);
+  if (dst.size == 0) return;
+  if (!simd || !dst.Packed()) {
+    for (size_t i = 0; i < dst.size; ++i) {
+      std::memcpy(dst.data + static_cast<ptrdiff_t>(i) * dst.stride, &pattern,
+                  Memory::Width(dst.elem));
+    }
+    return;
+  }
+  if (dst.elem == Memory::kInt8) {
+    std::memset(dst.data, static_cast<int>(pattern & 0xff), dst.size);
+    return;
+  }
+  auto bytes = dst.size * 8;
+  auto lanes = U64x2{} + pattern;
+  size_t at = 0;
+  for (; at + kBlock <= bytes; at += kBlock) Store(dst.data + at, lanes);
+  for (; at < bytes; at += 8) std::memcpy(dst.data + at, &pattern, 8);
+}
+
+void Copy(const Span &dst, const Span &src, bool simd) {
+  auto size = std::min(dst.size, src.size);
+  if (size == 0) return;
+  // Going forward, a destination at or below its source reads every
+  // element before writing over it, as memmove does
+  if (simd && dst.elem == src.elem && dst.Packed() && src.Packed() &&
+      (dst.data <= src.data || dst.data >= src.data + size * src.stride)) {
+    std::memmove(dst.data, src.data, size * src.stride);
+    return;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    Memory::Store(dst.elem, dst.data + static_cast<ptrdiff_t>(i) * dst.stride,
+                  Get(src, i));
+  }
+}
+
+Value Sum(const Span &span, bool simd) {
+  if (!simd || !span.Packed() || span.elem == Memory::kFloat) {
+    // Floats add in order, as a different order rounds differently
+    auto sum = Value::Int(0);
+    for (size_t i = 0; i < span.size; ++i) {
+      auto x = Get(span, i);
+      if (x.tag == Tag::kFloat) {
+        sum.SetFloat((sum.tag == Tag::kInt ? static_cast<double>(sum.i)
+                                           : sum.f) +
+                     x.f);
+      } else if (sum.tag == Tag::kFloat) {
+        sum.SetFloat(sum.f + static_cast<double>(x.i));
+      } else {
+        sum.SetInt(static_cast<int64_t>(static_cast<uint64_t>(sum.i) +
+                                        static_cast<uint64_t>(x.i)));
+      }
+    }
+    return sum;
+  }
+
+  // Ints wrap, so lanes of uint64_t add up to the same in any order
+  auto bytes = span.size * Memory::Width(span.elem);
+  size_t at = 0;
+  uint64_t sum = 0;
+  if (span.elem == Memory::kInt8) {
+    // Lanes of int16_t hold the sum of 255 blocks at most
+    while (at + kBlock <= bytes) {
+      auto acc = I16x16{};
+      for (int n = 0; n < 255 && at + kBlock <= bytes; ++n, at += kBlock) {
+        acc += __builtin_convertvector(Load<I8x16>(span.data + at), I16x16);
+      }
+      for (size_t i = 0; i < kBlock; ++i) {
+        sum += static_cast<uint64_t>(static_cast<int64_t>(acc[i]));
+      }
+    }
+    for (; at < bytes; ++at) {
+      sum += static_cast<uint64_t>(static_cast<int8_t>(span.data[at]));
+    }
+  } else {
+    auto acc0 = U64x2{};
+    auto acc1 = U64x2{};
+    for (; at + 2 * kBlock <= bytes; at += 2 * kBlock) {
+      acc0 += Load<U64x2>(span.data + at);
+      acc1 += Load<U64x2>(span.data + at + kBlock);
+    }
+    acc0 += acc1;
+    sum += acc0[0] + acc0[1];
+    for (; at < bytes; at += 8) {
+      uint64_t x;
+      std::memcpy(&x, span.data + at, 8);
+      sum += x;
+    }
+  }
+  return Value::Int(static_cast<int64_t>(sum));
+}
+
+int64_t Count(const Span &span, const Value &val, bool simd) {
+  if (!val.IsNumber()) return 0;
+  auto scalar = !simd || !span.Packed() ||
+                (span.elem == Memory::kInt && val.tag == Tag::kFloat);
+  if (scalar) {
+    int64_t count = 0;
+    for (size_t i = 0; i < span.size; ++i) count += Same(Get(span, i), val);
+    return count;
+  }
+
+  int64_t count = 0;
+  size_t at = 0;
+  auto bytes = span.size * Memory::Width(span.elem);
+  if (span.elem == Memory::kInt8) {
+    int8_t byte;
+    if (!AsInt8(val, &byte)) return 0;
+    // Lanes count to 255 at most before they are added up
+    while (at + kBlock <= bytes) {
+      auto acc = I8x16{};
+      for (int n = 0; n < 255 && at + kBlock <= bytes; ++n, at += kBlock) {
+        acc -= Load<I8x16>(span.data + at) == byte;
+      }
+      for (size_t i = 0; i < kBlock; ++i) {
+        count += static_cast<uint8_t>(acc[i]);
+      }
+    }
+    for (; at < bytes; ++at) {
+      count += static_cast<int8_t>(span.data[at]) == byte;
+    }
+    return count;
+  }
+  auto acc = I64x2{};
+  if (span.elem == Memory::kInt) {
+    for (; at + kBlock <= bytes; at += kBlock) {
+      acc -= Load<I64x2>(span.data + at) == val.i;
+    }
+  } else {
+    auto y = val.tag == Tag::kInt ? static_cast<double>(val.i) : val.f;
+    for (; at + kBlock <= bytes; at += kBlock) {
+      acc -= Load<F64x2>(span.data + at) == y;
+    }
+  }
+  count += acc[0] + acc[1];
+  for (auto i = at / 8; i < span.size; ++i) count += Same(Get(span, i), val);
+  return count;
+}
+
+int64_t Find(const Span &span, const Value &val, bool simd) {
+  if (!val.IsNumber()) return -1;
+  auto scalar = !simd || !span.Packed() ||
+                (span.elem == Memory::kInt && val.tag == Tag::kFloat);
+  size_t at = 0;
+  if (!scalar && span.elem == Memory::kInt8) {
+    int8_t byte;
+    if (!AsInt8(val, &byte) || span.size == 0) return -1;
+    auto found = std::memchr(span.data, static_cast<uint8_t>(byte), span.size);
+    return found == nullptr ? -1 : static_cast<uint8_t *>(found) - span.data;
+  }
+  if (!scalar) {
+    // Skip the blocks without it, the element loop finds it in the next
+    auto bytes = span.size * 8;
+    auto y = val.tag == Tag::kInt ? static_cast<double>(val.i) : val.f;
+    for (; at + kBlock <= bytes; at += kBlock) {
+      auto hit = span.elem == Memory::kInt
+                     ? Any(Load<I64x2>(span.data + at) == val.i)
+                     : Any(Load<F64x2>(span.data + at) == y);
+      if (hit) break;
+    }
+    at /= 8;
+  }
+  for (auto i = at; i < span.size; ++i) {
+    if (Same(Get(span, i), val)) return i;
+  }
+  return -1;
+}
+
+bool Equal(const Span &a, const Span &b, bool simd) {
+  if (a.size != b.size) return false;
+  if (simd && a.elem == b.elem && a.Packed() && b.Packed()) {
+    auto bytes = a.size * Memory::Width(a.elem);
+    // Ints are equal by their bits, Floats are not for 0.0, -0.0 and NaN
+    if (a.elem != Memory::kFloat) {
+      return bytes == 0 || std::memcmp(a.data, b.data, bytes) == 0;
+    }
+    size_t at = 0;
+    for (; at + kBlock <= bytes; at += kBlock) {
+      if (Any(Load<F64x2>(a.data + at) != Load<F64x2>(b.data + at))) {
+        return false;
+      }
+    }
+    for (auto i = at / 8; i < a.size; ++i) {
+      if (!Same(Get(a, i), Get(b, i))) return false;
+    }
+    return true;
+  }
+  for (size_t i = 0; i < a.size; ++i) {
+    if (!Same(Get(a, i), Get(b, i))) return false;
+  }
+  return true;
+}
+
+}  // namespace vm
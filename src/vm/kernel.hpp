@@ -0,0 +1,42 @@
+#ifndef _XULANG_SRC_VM_KERNEL_HPP
+#define _XULANG_SRC_VM_KERNEL_HPP
+
+#include "./value.hpp"
+
+namespace vm {
+
+// The elements [beg, end) of a Memory, as the kernels below take them
+struct Span {
+  Memory::Elem elem;
+  uint8_t *data;
+  ptrdiff_t stride;
+  size_t size;
+
+  Span(const Memory *memory, size_t beg, size_t end)
+      : elem(memory->elem),
+        data(memory->At(beg)),
+        stride(memory->stride),
+        size(end - beg) {}
+
+  inline bool Packed() const {
+    return stride == static_cast<ptrdiff_t>(Memory::Width(elem));
+  }
+};
+
+// The bulk builtins on Memory. Each gives what the element loop of
+// Runtime would, e.g. Sum adds in order and wraps, NaN is not equal to
+// itself, and Copy goes forward. Packed Spans go through blocks of vector
+// lanes, or memset, memchr and memcmp where those give the same, strided
+// ones and those with simd false, e.g. to compare, go one element at a
+// time.
+void Fill(const Span &dst, const Value &val, bool simd = true);  // a number
+void Copy(const Span &dst, const Span &src, bool simd = true);
+Value Sum(const Span &span, bool simd = true);
+int64_t Count(const Span &span, const Value &val, bool simd = true);
+// The first index of val, or -1
+int64_t Find(const Span &span, const Value &val, bool simd = true);
+bool Equal(const Span &a, const Span &b, bool simd = true);
+
+}  // namespace vm
+
+#endif  // _XULANG_SRC_VM_KERNEL_HPP
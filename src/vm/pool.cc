@@ -0,0 +1,193 @@
+#include "./pool.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace vm {
+
+// 16 to 256 bytes by 16, then 512 to kMaxBlock by doubling
+static constexpr size_t kSmallClasses = 16;
+static constexpr size_t kClasses = kSmallClasses + 5;
+// Of a slab before its blocks
+static constexpr size_t kHeader = 64;
+
+static inline size_t ClassOf(size_t size) {
+  if (size <= 256) return size == 0 ? 0 : (size - 1) / 16;
+  auto cls = kSmallClasses;
+  for (size_t block = 512; block < size; block *= 2) ++cls;
+  return cls;
+}
+
+static inline size_t SizeOf(size_t cls) {
+  return cls < kSmallClasses ? (cls + 1) * 16
+                             : size_t(512) << (cls - kSmallClasses);
+}
+
+namespace {
+
+struct Block {
+  Block *next;
+};
+
+// The free lists of the thread holding it, it outlives the thread for
+// another to take over
+struct Cache {
+  Block *lists[kClasses] = {};
+  std::atomic<Block *> remote[kClasses] = {};
+  std::atomic<bool> taken{true};
+  // Written by the holder alone but for remote_frees, read by stats()
+  std::atomic<uint64_t> allocs[kClasses] = {};
+  std::atomic<uint64_t> frees[kClasses] = {};
+  std::atomic<uint64_t> remote_frees[kClasses] = {};
+  std::atomic<uint64_t> slabs{0};
+};
+
+struct Slab {
+  Cache *owner;  // nullptr for a block of its own
+  size_t cls;    // or its bytes
+};
+
+// Of the holder alone, a plain add rather than a locked one
+inline void Add(std::atomic<uint64_t> &counter, uint64_t n) {
+  counter.store(counter.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+}
+
+std::mutex mutex;
+std::vector<Cache *> *caches = new std::vector<Cache *>();  // never freed
+std::atomic<uint64_t> large_allocs{0};
+std::atomic<uint64_t> large_frees{0};
+std::atomic<size_t> large_bytes{0};
+
+thread_local Cache *local = nullptr;
+
+// Gives the Cache up for another thread when this one ends
+struct Release {
+  ~Release() {
+    if (local == nullptr) return;
+    local->taken.store(false, std::memory_order_release);
+    local = nullptr;
+  }
+};
+thread_local Release release;
+
+Cache *Local() {
+  if (local != nullptr) return local;
+  (void)&release;
+  auto lock = std::lock_guard<std::mutex>(mutex);
+  for (auto cache : *caches) {
+    auto taken = false;
+    if (cache->taken.compare_exchange_strong(taken, true,
+                                             std::memory_order_acquire)) {
+      return local = cache;
+    }
+  }
+  return local = caches->emplace_back(new Cache());
+}
+
+inline Slab *SlabOf(void *block) {
+  return reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(block) &
+                                  ~(Pool::kSlabSize - 1));
+}
+
+// The blocks freed on other threads, or a new slab of them
+Block *Refill(Cache *cache, size_t cls) {
+  auto freed = cache->remote[cls].exchange(nullptr, std::memory_order_acquire);
+  if (freed != nullptr) return freed;
+
+  auto memory = static_cast<uint8_t *>(
+      std::aligned_alloc(Pool::kSlabSize, Pool::kSlabSize));
+  if (memory == nullptr) return nullptr;
+  new (memory) Slab{cache, cls};
+  Add(cache->slabs, 1);
+  auto size = SizeOf(cls);
+  Block *head = nullptr;
+  for (auto at = kHeader + (Pool::kSlabSize - kHeader) / size * size;
+       at > kHeader;) {
+    at -= size;
+    auto block = reinterpret_cast<Block *>(memory + at);
+    block->next = head;
+    head = block;
+  }
+  return head;
+}
+
+}  // namespace
+
+void *Pool::Allocate(size_t size) {
+  if (size > kMaxBlock) {
+    auto bytes = (kHeader + size + kSlabSize - 1) / kSlabSize * kSlabSize;
+    auto memory = static_cast<uint8_t *>(std::aligned_alloc(kSlabSize, bytes));
+    if (memory == nullptr) return nullptr;
+    new (memory) Slab{nullptr, bytes};
+    large_allocs.fetch_add(1, std::memory_order_relaxed);
+    large_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    return memory + kHeader;
+  }
+  auto cls = ClassOf(size);
+  auto cache = Local();
+  auto block = cache->lists[cls];
+  if (block == nullptr && (block = Refill(cache, cls)) == nullptr) {
+    return nullptr;
+  }
+  cache->lists[cls] = block->next;
+  Add(cache->allocs[cls], 1);
+  return block;
+}
+
+void Pool::Free(void *memory) {
+  if (memory == nullptr) return;
+  auto slab = SlabOf(memory);
+  auto block = static_cast<Block *>(memory);
+  auto owner = slab->owner;
+  if (owner == nullptr) {
+    large_frees.fetch_add(1, std::memory_order_relaxed);
+    large_bytes.fetch_sub(slab->cls, std::memory_order_relaxed);
+    std::free(slab);
+  } else if (owner == local) {
+    block->next = owner->lists[slab->cls];
+    owner->lists[slab->cls] = block;
+    Add(owner->frees[slab->cls], 1);
+  } else {
+    auto &remote = owner->remote[slab->cls];
+    block->next = remote.load(std::memory_order_relaxed);
+    while (!remote.compare_exchange_weak(block->next, block,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+    }
+    owner->remote_frees[slab->cls].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+Pool::Stats Pool::stats() {
+  auto res = Stats();
+  auto lock = std::lock_guard<std::mutex>(mutex);
+  for (auto cache : *caches) {
+    for (size_t cls = 0; cls < kClasses; ++cls) {
+      auto allocs = cache->allocs[cls].load(std::memory_order_relaxed);
+      auto frees = cache->frees[cls].load(std::memory_order_relaxed);
+      auto remote = cache->remote_frees[cls].load(std::memory_order_relaxed);
+      res.allocs += allocs;
+      res.frees += frees + remote;
+      res.remote_frees += remote;
+      res.used += (allocs - frees - remote) * SizeOf(cls);
+    }
+    res.slabs += cache->slabs.load(std::memory_order_relaxed);
+  }
+  auto allocs = large_allocs.load(std::memory_order_relaxed);
+  auto frees = large_frees.load(std::memory_order_relaxed);
+  res.allocs += allocs;
+  res.frees += frees;
+  res.large = allocs - frees;
+  res.large_bytes = large_bytes.load(std::memory_order_relaxed);
+  return res;
+}
+
+size_t Pool::BlockSize(size_t size) {
+  return size > kMaxBlock ? size : SizeOf(ClassOf(size));
+}
+
+}  // namespace vm
@@ -0,0 +1,48 @@
+#ifndef _XULANG_SRC_VM_POOL_HPP
+#define _XULANG_SRC_VM_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vm {
+
+// Blocks for the objects made and freed the most, e.g. the Instance of an
+// error class raised and caught in a loop. Each thread takes blocks from
+// free lists of its own by size class, which refill a whole slab of
+// kSlabSize bytes at a time. A block freed on another thread goes back to
+// the lists it came from through a lock-free list their thread drains when
+// it refills. Slabs are never given back, a block larger than the largest
+// class takes slabs of its own which are.
+class Pool final {
+ public:
+  static constexpr size_t kSlabSize = size_t(64) << 10;
+  static constexpr size_t kMaxBlock = 8192;  // of the largest class
+
+  struct Stats {
+    uint64_t allocs = 0;
+    uint64_t frees = 0;         // including the remote ones
+    uint64_t remote_frees = 0;  // on another thread than it came from
+    uint64_t slabs = 0;         // of the size classes
+    size_t used = 0;            // bytes of their blocks not freed
+    uint64_t large = 0;         // blocks of their own slabs not freed
+    size_t large_bytes = 0;
+
+    inline size_t reserved() const { return slabs * kSlabSize; }
+    // The part of the slabs of the size classes not in use, by rounding up
+    // to a class and the free blocks
+    inline double Fragmentation() const {
+      return slabs == 0 ? 0 : 1 - static_cast<double>(used) / reserved();
+    }
+  };
+
+  static void *Allocate(size_t size);  // nullptr if out of memory
+  static void Free(void *block);
+  // Summed over every thread, exact once they are done
+  static Stats stats();
+  // The size class of a block of size bytes, e.g. 48 for 40
+  static size_t BlockSize(size_t size);
+};
+
+}  // namespace vm
+
+#endif  // _XULANG_SRC_VM_POOL_HPP
@@ -0,0 +1,761 @@
+#include "./runtime.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <sstream>
+
+#include "../builtin/names.hpp"
+#include "./kernel.hpp"
+
+namespace vm {
+
+static const int kError = builtin::FindBuiltin("Error");
+
+static const char *TypeName(Tag tag) {
+  switch (tag) {
+    case Tag::kVoid: return "Void";
+    case Tag::kMissing: return "Missing";
+    case Tag::kInt: return "Int";
+    case Tag::kFloat: return "Float";
+    case Tag::kBuiltin: return "Builtin";
+    case Tag::kFunction: return "Function";
+    case Tag::kClass: return "Class";
+    case Tag::kString: return "String";
+    case Tag::kArray: return "Array";
+    case Tag::kMemory: return "Memory";
+    case Tag::kInstance: return "Instance";
+  }
+  return "?";
+}
+
+static inline double ToDouble(const Value &val) {
+  return val.tag == Tag::kFloat ? val.f : static_cast<double>(val.i);
+}
+
+// e.g. 10, -3, 0b1010, 0o12, 0xa, as Int literals are written
+static bool ParseInt(const std::string &text, int64_t *res) {
+  auto negative = !text.empty() && text[0] == '-';
+  auto beg = text.c_str() + (negative ? 1 : 0);
+  auto base = 10;
+  if (beg[0] == '0' && beg[1] != '\0') {
+    base = beg[1] == 'b' ? 2 : beg[1] == 'o' ? 8 : beg[1] == 'x' ? 16 : 10;
+    if (base != 10) beg += 2;
+  }
+  char *end = nullptr;
+  errno = 0;
+  auto i = static_cast<uint64_t>(std::strtoull(beg, &end, base));
+  if (errno != 0 || end == beg || *end != '\0') return false;
+  *res = static_cast<int64_t>(negative ? 0 - i : i);
+  return true;
+}
+
+static bool ParseFloat(const std::string &text, double *res) {
+  char *end = nullptr;
+  errno = 0;
+  *res = std::strtod(text.c_str(), &end);
+  return errno == 0 && end != text.c_str() && *end == '\0';
+}
+
+Runtime::Runtime(const Program *program, std::istream *in, std::ostream *out)
+    : program(program), in(in), out(out), globals(program->statics) {}
+
+bool Runtime::Raise(const std::string &message) {
+  auto instance = Instance::New(0, 1);
+  instance->members[0] = NewString(message);
+  error = Value::Take(Tag::kInstance, instance);
+  return false;
+}
+
+bool Runtime::Binary(Op op, const Value &a, const Value &b, Value *res) {
+  if (a.tag == Tag::kInt && b.tag == Tag::kInt) {
+    // 64 bit two's complement which wraps around, as pass::Folder folds it
+    auto x = static_cast<uint64_t>(a.i), y = static_cast<uint64_t>(b.i);
+    switch (op) {
+      case Op::kAdd: res->SetInt(static_cast<int64_t>(x + y)); return true;
+      case Op::kSub: res->SetInt(static_cast<int64_t>(x - y)); return true;
+      case Op::kMul: res->SetInt(static_cast<int64_t>(x * y)); return true;
+      case Op::kDiv:
+      case Op::kMod:
+        if (b.i == 0) return Raise("division by zero");
+        if (b.i == -1) {
+          res->SetInt(op == Op::kDiv ? static_cast<int64_t>(0 - x) : 0);
+        } else {
+          res->SetInt(op == Op::kDiv ? a.i / b.i : a.i % b.i);
+        }
+        return true;
+      case Op::kXor: res->SetInt(a.i ^ b.i); return true;
+      case Op::kOr: res->SetInt(a.i | b.i); return true;
+      case Op::kAnd: res->SetInt(a.i & b.i); return true;
+      case Op::kShl:
+      case Op::kShr:
+        if (b.i < 0 || b.i > 63) return Raise("shift count out of range");
+        res->SetInt(op == Op::kShl ? static_cast<int64_t>(x << b.i)
+                                   : a.i >> b.i);
+        return true;
+      case Op::kEq: res->SetInt(a.i == b.i); return true;
+      case Op::kNe: res->SetInt(a.i != b.i); return true;
+      case Op::kLt: res->SetInt(a.i < b.i); return true;
+      case Op::kLe: res->SetInt(a.i <= b.i); return true;
+      case Op::kGt: res->SetInt(a.i > b.i); return true;
+      case Op::kGe: res->SetInt(a.i >= b.i); return true;
+      default: break;
+    }
+  } else if (a.IsNumber() && b.IsNumber()) {
+    auto x = ToDouble(a), y = ToDouble(b);
+    switch (op) {
+      case Op::kAdd: res->SetFloat(x + y); return true;
+      case Op::kSub: res->SetFloat(x - y); return true;
+      case Op::kMul: res->SetFloat(x * y); return true;
+      case Op::kDiv: res->SetFloat(x / y); return true;
+      case Op::kMod: res->SetFloat(std::fmod(x, y)); return true;
+      case Op::kEq: res->SetInt(x == y); return true;
+      case Op::kNe: res->SetInt(x != y); return true;
+      case Op::kLt: res->SetInt(x < y); return true;
+      case Op::kLe: res->SetInt(x <= y); return true;
+      case Op::kGt: res->SetInt(x > y); return true;
+      case Op::kGe: res->SetInt(x >= y); return true;
+      default: break;
+    }
+  } else if (a.tag == Tag::kString && b.tag == Tag::kString) {
+    const auto &x = static_cast<const String *>(a.obj)->text;
+    const auto &y = static_cast<const String *>(b.obj)->text;
+    switch (op) {
+      case Op::kAdd: *res = NewString(x + y); return true;
+      case Op::kEq: res->SetInt(x == y); return true;
+      case Op::kNe: res->SetInt(x != y); return true;
+      case Op::kLt: res->SetInt(x < y); return true;
+      case Op::kLe: res->SetInt(x <= y); return true;
+      case Op::kGt: res->SetInt(x > y); return true;
+      case Op::kGe: res->SetInt(x >= y); return true;
+      default: break;
+    }
+  } else if (op == Op::kEq || op == Op::kNe) {
+    // Anything else is only equal to itself
+    auto same = a.tag == b.tag && a.i == b.i;
+    res->SetInt(op == Op::kEq ? same : !same);
+    return true;
+  }
+  return Raise(std::string("unsupported operands ") + TypeName(a.tag) + " " +
+               OpName(op) + " " + TypeName(b.tag));
+}
+
+bool Runtime::Unary(Op op, const Value &a, Value *res) {
+  switch (op) {
+    case Op::kNeg:
+      if (a.tag == Tag::kInt) {
+        res->SetInt(static_cast<int64_t>(0 - static_cast<uint64_t>(a.i)));
+        return true;
+      }
+      if (a.tag == Tag::kFloat) {
+        res->SetFloat(-a.f);
+        return true;
+      }
+      break;
+    case Op::kPos:
+      if (a.IsNumber()) {
+        *res = a;
+        return true;
+      }
+      break;
+    case Op::kNot: res->SetInt(!IsTrue(a)); return true;
+    case Op::kBool: res->SetInt(IsTrue(a)); return true;
+    case Op::kBitNot:
+      if (a.tag == Tag::kInt) {
+        res->SetInt(~a.i);
+        return true;
+      }
+      break;
+    case Op::kRef:
+      // Objects are always passed by reference, numbers have no address
+      if (a.IsObject()) {
+        *res = a;
+        return true;
+      }
+      break;
+    case Op::kToInt:
+      if (a.tag == Tag::kInt) {
+        *res = a;
+        return true;
+      }
+      if (a.tag == Tag::kFloat) {
+        if (!(std::fabs(a.f) < 9.2e18)) return Raise("Float out of Int range");
+        res->SetInt(static_cast<int64_t>(a.f));
+        return true;
+      }
+      if (a.tag == Tag::kString) {
+        int64_t i;
+        const auto &text = static_cast<const String *>(a.obj)->text;
+        if (!ParseInt(text, &i)) return Raise("invalid Int '" + text + "'");
+        res->SetInt(i);
+        return true;
+      }
+      break;
+    case Op::kToFloat:
+      if (a.IsNumber()) {
+        res->SetFloat(ToDouble(a));
+        return true;
+      }
+      if (a.tag == Tag::kString) {
+        double f;
+        const auto &text = static_cast<const String *>(a.obj)->text;
+        if (!ParseFloat(text, &f)) return Raise("invalid Float '" + text + "'");
+        res->SetFloat(f);
+        return true;
+      }
+      break;
+    default: break;
+  }
+  return Raise(std::string("unsupported operand ") + OpName(op) + " " +
+               TypeName(a.tag));
+}
+
+bool Runtime::GetIndex(const Value &obj, const Value &idx, Value *res) {
+  if (idx.tag != Tag::kInt) {
+    return Raise(std::string("index is a ") + TypeName(idx.tag));
+  }
+  auto i = static_cast<uint64_t>(idx.i);
+  auto out_of_range = [&] {
+    return Raise("index " + std::to_string(idx.i) + " out of range");
+  };
+  switch (obj.tag) {
+    case Tag::kArray: {
+      const auto &items = static_cast<const Array *>(obj.obj)->items;
+      if (i >= items.size()) return out_of_range();
+      *res = items[i];
+      return true;
+    }
+    case Tag::kMemory: {
+      auto memory = static_cast<const Memory *>(obj.obj);
+      if (i >= memory->size) return out_of_range();
+      *res = memory->Get(i);
+      return true;
+    }
+    case Tag::kString: {
+      const auto &text = static_cast<const String *>(obj.obj)->text;
+      if (i >= text.size()) return out_of_range();
+      *res = NewString(text.substr(i, 1));
+      return true;
+    }
+    default:
+      return Raise(std::string("cannot subscript a ") + TypeName(obj.tag));
+  }
+}
+
+bool Runtime::SetIndex(const Value &obj, const Value &idx, const Value &val) {
+  if (idx.tag != Tag::kInt) {
+    return Raise(std::string("index is a ") + TypeName(idx.tag));
+  }
+  auto i = static_cast<uint64_t>(idx.i);
+  if (obj.tag == Tag::kArray) {
+    auto &items = static_cast<Array *>(obj.obj)->items;
+    if (i >= items.size()) {
+      return Raise("index " + std::to_string(idx.i) + " out of range");
+    }
+    items[i] = val;
+    return true;
+  }
+  if (obj.tag == Tag::kMemory) {
+    auto memory = static_cast<Memory *>(obj.obj);
+    if (i >= memory->size) {
+      return Raise("index " + std::to_string(idx.i) + " out of range");
+    }
+    if (!val.IsNumber()) {
+      return Raise(std::string("cannot store a ") + TypeName(val.tag) +
+                   " in a Memory");
+    }
+    memory->Set(i, val);
+    return true;
+  }
+  return Raise(std::string("cannot set an element of a ") +
+               TypeName(obj.tag));
+}
+
+// Bounds are clamped to the elements, and count from the end only as far
+// as the default of a negative step goes, there are no negative indexes
+bool Runtime::Slice(const Value &obj, const Value &beg, const Value &end,
+                    const Value &step, Value *res) {
+  size_t size;
+  switch (obj.tag) {
+    case Tag::kString:
+      size = static_cast<const String *>(obj.obj)->text.size();
+      break;
+    case Tag::kArray:
+      size = static_cast<const Array *>(obj.obj)->items.size();
+      break;
+    case Tag::kMemory: size = static_cast<const Memory *>(obj.obj)->size; break;
+    default: return Raise(std::string("cannot slice a ") + TypeName(obj.tag));
+  }
+  for (const auto *bound : {&beg, &end, &step}) {
+    if (bound->tag != Tag::kInt && bound->tag != Tag::kVoid) {
+      return Raise(std::string("slice bound is a ") + TypeName(bound->tag));
+    }
+  }
+  auto by = step.tag == Tag::kInt ? step.i : 1;
+  if (by == 0) return Raise("slice step is 0");
+
+  // [lo, hi] of the elements to go from and to, -1 for before the first
+  int64_t n = size;
+  auto lo = by > 0 ? int64_t(0) : int64_t(-1);
+  auto hi = by > 0 ? n : n - 1;
+  auto from = beg.tag == Tag::kInt ? std::clamp(beg.i, lo, hi)
+              : by > 0             ? lo
+                                   : hi;
+  auto to = end.tag == Tag::kInt ? std::clamp(end.i, lo, hi)
+            : by > 0             ? hi
+                                 : lo;
+  // Unsigned, as the step may be as far as INT64_MIN
+  auto span = by > 0 ? to - from : from - to;
+  auto steps = by > 0 ? uint64_t(by) : 0 - uint64_t(by);
+  auto count = span > 0 ? int64_t(1 + (uint64_t(span) - 1) / steps) : 0;
+
+  if (obj.tag == Tag::kMemory) {
+    auto memory = static_cast<const Memory *>(obj.obj);
+    const auto &base = memory->bytes.empty() && memory->base.obj != nullptr
+                           ? memory->base
+                           : obj;
+    // A step only moves within the elements once there are two of them,
+    // so the stride of one cannot overflow
+    *res = Value::Take(
+        Tag::kMemory,
+        new Memory(base, count == 0 ? memory->data : memory->At(from),
+                   count > 1 ? memory->stride * by : memory->stride, count));
+    return true;
+  }
+  // Not views, as push_back and pop_back of the Array would move them
+  if (obj.tag == Tag::kArray) {
+    const auto &items = static_cast<const Array *>(obj.obj)->items;
+    auto array = new Array();
+    array->items.reserve(count);
+    for (int64_t i = 0; i < count; ++i) {
+      array->items.push_back(items[from + i * by]);
+    }
+    *res = Value::Take(Tag::kArray, array);  // res may be obj
+    return true;
+  }
+  const auto &text = static_cast<const String *>(obj.obj)->text;
+  auto part = std::string();
+  part.reserve(count);
+  for (int64_t i = 0; i < count; ++i) part += text[from + i * by];
+  *res = NewString(std::move(part));
+  return true;
+}
+
+void Runtime::Use(const Instance &instance, const std::string &id) {
+  ++(*member_uses)[program->classes[instance.cls].name + "." + id];
+}
+
+bool Runtime::GetMember(const Value &obj, const std::string &id, Value *res) {
+  if (obj.tag == Tag::kInstance) {
+    auto instance = static_cast<const Instance *>(obj.obj);
+    const auto &members = program->classes[instance->cls].members;
+    auto found = members.find(id);
+    if (found != members.end()) {
+      if (member_uses != nullptr) Use(*instance, id);
+      *res = instance->members[found->second];
+      return true;
+    }
+  }
+  return Raise(std::string(TypeName(obj.tag)) + " has no member " + id);
+}
+
+bool Runtime::SetMember(const Value &obj, const std::string &id,
+                        const Value &val) {
+  if (obj.tag == Tag::kInstance) {
+    auto instance = static_cast<Instance *>(obj.obj);
+    const auto &members = program->classes[instance->cls].members;
+    auto found = members.find(id);
+    if (found != members.end()) {
+      if (member_uses != nullptr) Use(*instance, id);
+      instance->members[found->second] = val;
+      return true;
+    }
+  }
+  return Raise(std::string(TypeName(obj.tag)) + " has no member " + id);
+}
+
+bool Runtime::Length(const Value &obj, Value *res) {
+  switch (obj.tag) {
+    case Tag::kString:
+      res->SetInt(static_cast<const String *>(obj.obj)->text.size());
+      return true;
+    case Tag::kArray:
+      res->SetInt(static_cast<const Array *>(obj.obj)->items.size());
+      return true;
+    case Tag::kMemory:
+      res->SetInt(static_cast<const Memory *>(obj.obj)->size);
+      return true;
+    default:
+      return Raise(std::string(TypeName(obj.tag)) + " has no length");
+  }
+}
+
+// [*beg, *end) are the elements of [lo, hi) of a Memory or Array which a
+// loop over them reaches, *stop the index out of range it stops at, or hi
+static bool Bounds(Runtime *rt, const Value &obj, const Value &lo,
+                   const Value &hi, size_t *beg, size_t *end, int64_t *stop) {
+  if (obj.tag != Tag::kArray && obj.tag != Tag::kMemory) {
+    return rt->Raise(std::string("expected a Memory or Array, not a ") +
+                     TypeName(obj.tag));
+  }
+  if (lo.tag != Tag::kInt || hi.tag != Tag::kInt) {
+    return rt->Raise("bounds are not Ints");
+  }
+  int64_t size = obj.tag == Tag::kArray
+                     ? static_cast<const Array *>(obj.obj)->items.size()
+                     : static_cast<const Memory *>(obj.obj)->size;
+  *stop = hi.i;
+  if (lo.i < hi.i && lo.i < 0) {
+    *stop = lo.i;
+  } else if (lo.i < hi.i && hi.i > size) {
+    *stop = std::max(lo.i, size);
+  }
+  auto clamp = [&](int64_t i) {
+    return static_cast<size_t>(std::clamp<int64_t>(i, 0, size));
+  };
+  *beg = clamp(lo.i);
+  *end = std::max(*beg, clamp(*stop));
+  return true;
+}
+
+static inline Value Element(const Value &obj, size_t idx) {
+  if (obj.tag == Tag::kArray) {
+    return static_cast<const Array *>(obj.obj)->items[idx];
+  }
+  return static_cast<const Memory *>(obj.obj)->Get(idx);
+}
+
+static inline void SetElement(const Value &obj, size_t idx, const Value &val) {
+  if (obj.tag == Tag::kArray) {
+    static_cast<Array *>(obj.obj)->items[idx] = val;
+  } else {
+    static_cast<Memory *>(obj.obj)->Set(idx, val);
+  }
+}
+
+bool Runtime::CallBuiltin(int idx, const Value *args, int argc, Value *res) {
+  const std::string name = builtin::kBuiltins[idx].name;
+  auto expect = [&](int lo, int hi) {
+    if (argc >= lo && argc <= hi) return true;
+    return Raise(name + " takes " + std::to_string(lo) +
+                 (lo == hi ? "" : " to " + std::to_string(hi)) + " args, not " +
+                 std::to_string(argc));
+  };
+
+  if (name == "Int" || name == "Int8") {
+    if (!expect(0, 1)) return false;
+    if (argc == 0) {
+      res->SetInt(0);
+      return true;
+    }
+    if (!Unary(Op::kToInt, args[0], res)) return false;
+    if (name == "Int8") res->SetInt(static_cast<int8_t>(res->i));
+    return true;
+  }
+  if (name == "Float") {
+    if (!expect(0, 1)) return false;
+    if (argc == 0) {
+      res->SetFloat(0);
+      return true;
+    }
+    return Unary(Op::kToFloat, args[0], res);
+  }
+  if (name == "String") {
+    if (!expect(0, 1)) return false;
+    *res = NewString(argc == 0 ? "" : ToString(args[0]));
+    return true;
+  }
+  if (name == "Auto") {
+    if (!expect(0, 1)) return false;
+    *res = argc == 0 ? Value() : args[0];
+    return true;
+  }
+  if (name == "Void" || name == "VOID" || name == "Ptr") {
+    *res = Value();
+    return true;
+  }
+  if (name == "Array") {
+    // Array() or Array(T, n) of n default values of the builtin type T
+    if (!expect(0, 2)) return false;
+    auto array = new Array();
+    *res = Value::Take(Tag::kArray, array);
+    if (argc < 2) return true;
+    if (args[1].tag != Tag::kInt || args[1].i < 0) {
+      return Raise("Array size is not an Int >= 0");
+    }
+    auto init = Value();
+    if (args[0].tag == Tag::kBuiltin && args[0].i != idx &&
+        !CallBuiltin(args[0].i, nullptr, 0, &init)) {
+      return false;
+    }
+    array->items.assign(args[1].i, init);
+    return true;
+  }
+  if (name == "Memory") {
+    if (!expect(2, 2)) return false;
+    auto type = args[0].tag == Tag::kBuiltin
+                    ? std::string(builtin::kBuiltins[args[0].i].name)
+                    : "";
+    auto elem = type == "Int8"    ? Memory::kInt8
+                : type == "Int"   ? Memory::kInt
+                : type == "Float" ? Memory::kFloat
+                                  : -1;
+    if (elem < 0) return Raise("Memory of Int8, Int or Float only");
+    if (args[1].tag != Tag::kInt || args[1].i < 0) {
+      return Raise("Memory size is not an Int >= 0");
+    }
+    *res = Value::Take(Tag::kMemory,
+                       new Memory(static_cast<Memory::Elem>(elem), args[1].i));
+    return true;
+  }
+  if (name == "Error") {
+    *res = Value::Take(Tag::kInstance, Instance::New(0, 1));
+    return InitError(*res, args, argc);
+  }
+  if (name == "Print") {
+    for (int i = 0; i < argc; ++i) *out << ToString(args[i]);
+    *res = Value();
+    return true;
+  }
+  if (name == "Input") {
+    // A number if the line reads as one
+    if (!expect(0, 0)) return false;
+    auto line = std::string();
+    std::getline(*in, line);
+    int64_t i;
+    double f;
+    if (ParseInt(line, &i)) {
+      res->SetInt(i);
+    } else if (ParseFloat(line, &f)) {
+      res->SetFloat(f);
+    } else {
+      *res = NewString(line);
+    }
+    return true;
+  }
+
+  // Fill(a, v, lo, hi), Copy(a, b, lo, hi), Sum(a, lo, hi), Count(a, v, lo, hi)
+  // do what the loop over [lo, hi) does, and raise where it would
+  size_t beg, end;
+  int64_t stop;
+  auto out_of_range = [&](int64_t i) {
+    return Raise("index " + std::to_string(i) + " out of range");
+  };
+  if (name == "Fill") {
+    if (!expect(4, 4) ||
+        !Bounds(this, args[0], args[2], args[3], &beg, &end, &stop)) {
+      return false;
+    }
+    if (args[0].tag == Tag::kMemory && beg < end && !args[1].IsNumber()) {
+      return Raise(std::string("cannot store a ") + TypeName(args[1].tag) +
+                   " in a Memory");
+    }
+    if (args[0].tag == Tag::kMemory) {
+      Fill(Span(static_cast<const Memory *>(args[0].obj), beg, end), args[1]);
+    } else {
+      for (auto i = beg; i < end; ++i) SetElement(args[0], i, args[1]);
+    }
+    *res = Value();
+    return stop == args[3].i || out_of_range(stop);
+  }
+  if (name == "Copy") {
+    size_t beg_b, end_b;
+    int64_t stop_b;
+    if (!expect(4, 4) ||
+        !Bounds(this, args[0], args[2], args[3], &beg, &end, &stop) ||
+        !Bounds(this, args[1], args[2], args[3], &beg_b, &end_b, &stop_b)) {
+      return false;
+    }
+    // Both start at lo, the first to run out stops the loop
+    end = beg + std::min(end - beg, end_b - beg_b);
+    stop = std::min(stop, stop_b);
+    if (args[0].tag == Tag::kMemory && args[1].tag == Tag::kMemory) {
+      Copy(Span(static_cast<const Memory *>(args[0].obj), beg, end),
+           Span(static_cast<const Memory *>(args[1].obj), beg_b,
+                beg_b + (end - beg)));
+    } else {
+      for (auto i = beg; i < end; ++i) {
+        auto val = Element(args[1], i);
+        if (args[0].tag == Tag::kMemory && !val.IsNumber()) {
+          return Raise(std::string("cannot store a ") + TypeName(val.tag) +
+                       " in a Memory");
+        }
+        SetElement(args[0], i, val);
+      }
+    }
+    *res = Value();
+    return stop == args[3].i || out_of_range(stop);
+  }
+  if (name == "Sum") {
+    if (!expect(3, 3) ||
+        !Bounds(this, args[0], args[1], args[2], &beg, &end, &stop)) {
+      return false;
+    }
+    if (args[0].tag == Tag::kMemory) {
+      *res = Sum(Span(static_cast<const Memory *>(args[0].obj), beg, end));
+      return stop == args[2].i || out_of_range(stop);
+    }
+    auto sum = Value::Int(0);
+    for (auto i = beg; i < end; ++i) {
+      if (!Binary(Op::kAdd, sum, Element(args[0], i), &sum)) return false;
+    }
+    *res = std::move(sum);
+    return stop == args[2].i || out_of_range(stop);
+  }
+  if (name == "Count") {
+    if (!expect(4, 4) ||
+        !Bounds(this, args[0], args[2], args[3], &beg, &end, &stop)) {
+      return false;
+    }
+    if (args[0].tag == Tag::kMemory) {
+      res->SetInt(Count(
+          Span(static_cast<const Memory *>(args[0].obj), beg, end), args[1]));
+      return stop == args[3].i || out_of_range(stop);
+    }
+    int64_t count = 0;
+    auto equal = Value();
+    for (auto i = beg; i < end; ++i) {
+      if (!Binary(Op::kEq, Element(args[0], i), args[1], &equal)) return false;
+      count += equal.i;
+    }
+    res->SetInt(count);
+    return stop == args[3].i || out_of_range(stop);
+  }
+  return Raise(name + " cannot be called");
+}
+
+bool Runtime::CallMethod(const Value &obj, const std::string &id,
+                         const Value *args, int argc, Value *res) {
+  if (id == "length" && argc == 0) return Length(obj, res);
+  if (obj.tag == Tag::kArray && id == "push_back" && argc == 1) {
+    static_cast<Array *>(obj.obj)->items.push_back(args[0]);
+    *res = Value();
+    return true;
+  }
+  if (obj.tag == Tag::kArray && id == "pop_back" && argc == 0) {
+    auto &items = static_cast<Array *>(obj.obj)->items;
+    if (items.empty()) return Raise("pop_back of an empty Array");
+    *res = std::move(items.back());
+    items.pop_back();
+    return true;
+  }
+  auto sequence = obj.tag == Tag::kArray || obj.tag == Tag::kMemory;
+  if (sequence && id == "find" && argc == 1) {
+    // The first index of the element equal to args[0], or -1
+    auto size = Value();
+    if (!Length(obj, &size)) return false;
+    if (obj.tag == Tag::kMemory) {
+      res->SetInt(Find(Span(static_cast<const Memory *>(obj.obj), 0, size.i),
+                       args[0]));
+      return true;
+    }
+    auto equal = Value();
+    for (int64_t i = 0; i < size.i; ++i) {
+      if (!Binary(Op::kEq, Element(obj, i), args[0], &equal)) return false;
+      if (equal.i != 0) {
+        res->SetInt(i);
+        return true;
+      }
+    }
+    res->SetInt(-1);
+    return true;
+  }
+  if (sequence && id == "equals" && argc == 1) {
+    // 1 if args[0] has as many elements and each is equal, else 0
+    const auto &other = args[0];
+    res->SetInt(0);
+    if (other.tag != Tag::kArray && other.tag != Tag::kMemory) return true;
+    auto size = Value();
+    auto other_size = Value();
+    if (!Length(obj, &size) || !Length(other, &other_size)) return false;
+    if (obj.tag == Tag::kMemory && other.tag == Tag::kMemory) {
+      res->SetInt(
+          Equal(Span(static_cast<const Memory *>(obj.obj), 0, size.i),
+                Span(static_cast<const Memory *>(other.obj), 0, other_size.i)));
+      return true;
+    }
+    if (size.i != other_size.i) return true;
+    auto equal = Value();
+    for (int64_t i = 0; i < size.i; ++i) {
+      if (!Binary(Op::kEq, Element(obj, i), Element(other, i), &equal)) {
+        return false;
+      }
+      if (equal.i == 0) return true;
+    }
+    res->SetInt(1);
+    return true;
+  }
+  return Raise(std::string(TypeName(obj.tag)) + " has no method " + id +
+               " taking " + std::to_string(argc) + " args");
+}
+
+bool Runtime::InitError(const Value &instance, const Value *args, int argc) {
+  auto obj = static_cast<Instance *>(instance.obj);
+  const auto &cls = program->classes[obj->cls];
+  if (argc == 0) return true;
+  if (!cls.is_error || argc > 1) {
+    return Raise(cls.name + " takes no args, it has no __Create__");
+  }
+  obj->members[cls.members.at("message")] = NewString(ToString(args[0]));
+  return true;
+}
+
+bool Runtime::Match(const Value &error, const Value &type, Value *res) {
+  auto cls = type.tag == Tag::kClass                              ? type.i
+             : type.tag == Tag::kBuiltin && type.i == kError ? 0
+                                                                  : -1;
+  if (cls < 0) {
+    return Raise(std::string("except needs a Class, not a ") +
+                 TypeName(type.tag));
+  }
+  res->SetInt(IsA(error, static_cast<int>(cls)));
+  return true;
+}
+
+bool Runtime::IsA(const Value &obj, int cls) const {
+  if (obj.tag != Tag::kInstance) return false;
+  for (auto at = static_cast<const Instance *>(obj.obj)->cls; at >= 0;
+       at = program->classes[at].base) {
+    if (at == cls) return true;
+  }
+  return false;
+}
+
+std::string Runtime::ToString(const Value &val) const {
+  switch (val.tag) {
+    case Tag::kInt: return std::to_string(val.i);
+    case Tag::kFloat: {
+      auto text = std::ostringstream();
+      text << val.f;
+      return text.str();
+    }
+    case Tag::kString: return static_cast<const String *>(val.obj)->text;
+    case Tag::kArray: {
+      auto text = std::string("[");
+      const auto &items = static_cast<const Array *>(val.obj)->items;
+      for (size_t i = 0; i < items.size(); ++i) {
+        text += (i == 0 ? "" : ", ") + ToString(items[i]);
+      }
+      return text + "]";
+    }
+    case Tag::kMemory: {
+      auto memory = static_cast<const Memory *>(val.obj);
+      static const char *const kElems[] = {"Int8", "Int", "Float"};
+      return std::string("Memory(") + kElems[memory->elem] + ", " +
+             std::to_string(memory->size) + ")";
+    }
+    case Tag::kInstance: {
+      auto instance = static_cast<const Instance *>(val.obj);
+      const auto &cls = program->classes[instance->cls];
+      if (!cls.is_error) return cls.name + "()";
+      const auto &message = instance->members[cls.members.at("message")];
+      return cls.name + ": " + ToString(message);
+    }
+    case Tag::kBuiltin: return builtin::kBuiltins[val.i].name;
+    case Tag::kFunction: return program->funcs[val.i].name;
+    case Tag::kClass: return program->classes[val.i].name;
+    default: return "Void";
+  }
+}
+
+}  // namespace vm
@@ -0,0 +1,64 @@
+#ifndef _XULANG_SRC_VM_RUNTIME_HPP
+#define _XULANG_SRC_VM_RUNTIME_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+
+#include "./bytecode.hpp"
+
+namespace vm {
+
+// What the VM and the AST walker share: the globals, the builtins and the
+// operators on every kind of value. The caller has already tried the fast
+// path of Int and Float operands where it has one. An operation which fails
+// raises, it sets error and returns false.
+class Runtime final {
+ public:
+  // Calls deep, the same for both so that they raise at the same point. The
+  // tree walker takes a lot of the C++ stack for each call.
+  static constexpr int kMaxDepth = 2000;
+
+  const Program *program;
+  std::istream *in;
+  std::ostream *out;
+  std::vector<Value> globals;  // by Module objs index
+  Value error;                 // being raised
+  // If set, the member accesses by "Class.member", for xlopt --layout
+  std::unordered_map<std::string, uint64_t> *member_uses = nullptr;
+
+  Runtime(const Program *program, std::istream *in, std::ostream *out);
+
+  bool Raise(const std::string &message);  // an Error with the message
+  // kAdd to kGe
+  bool Binary(Op op, const Value &a, const Value &b, Value *res);
+  // kNeg to kToFloat
+  bool Unary(Op op, const Value &a, Value *res);
+  bool GetIndex(const Value &obj, const Value &idx, Value *res);
+  bool SetIndex(const Value &obj, const Value &idx, const Value &val);
+  // obj[beg:end:step], Void for a bound not given. A Memory gives a view of
+  // its elements, an Array and a String a copy.
+  bool Slice(const Value &obj, const Value &beg, const Value &end,
+             const Value &step, Value *res);
+  bool GetMember(const Value &obj, const std::string &id, Value *res);
+  bool SetMember(const Value &obj, const std::string &id, const Value &val);
+  bool Length(const Value &obj, Value *res);
+  bool CallBuiltin(int idx, const Value *args, int argc, Value *res);
+  // Of String, Array and Memory, the methods of instances are Funcs
+  bool CallMethod(const Value &obj, const std::string &id, const Value *args,
+                  int argc, Value *res);
+  // What the args of a class without __Create__ set, only the message of
+  // an error
+  bool InitError(const Value &instance, const Value *args, int argc);
+  // kMatch, type is a Class or the builtin Error
+  bool Match(const Value &error, const Value &type, Value *res);
+  bool IsA(const Value &obj, int cls) const;
+  std::string ToString(const Value &val) const;
+
+ private:
+  void Use(const Instance &instance, const std::string &id);
+};
+
+}  // namespace vm
+
+#endif  // _XULANG_SRC_VM_RUNTIME_HPP
@@ -0,0 +1,228 @@
+#ifndef _XULANG_SRC_VM_VALUE_HPP
+#define _XULANG_SRC_VM_VALUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "./pool.hpp"
+
+namespace vm {
+
+enum class Tag : uint8_t {
+  kVoid,
+  kMissing,  // a param no arg was given for, its default is used
+  kInt,
+  kFloat,
+  kBuiltin,   // i: builtin::kBuiltins index
+  kFunction,  // i: Program::funcs index
+  kClass,     // i: Program::classes index
+
+  // Counted references to an Object from here on
+  kString,
+  kArray,
+  kMemory,
+  kInstance,
+};
+
+struct Object {
+  int refs = 0;
+  virtual ~Object() = default;
+};
+
+// Int and Float are held unboxed, the rest of the values are references
+// counted by Value, objects are freed as soon as the last one goes
+class Value final {
+ public:
+  Tag tag = Tag::kVoid;
+  union {
+    int64_t i = 0;
+    double f;
+    Object *obj;
+  };
+
+  Value() = default;
+  Value(const Value &other) : tag(other.tag), i(other.i) { Ref(); }
+  Value(Value &&other) noexcept : tag(other.tag), i(other.i) {
+    other.tag = Tag::kVoid;
+  }
+  ~Value() { Unref(); }
+
+  // other may live in the object this releases, e.g. r = r[0]
+  Value &operator=(const Value &other) {
+    auto other_tag = other.tag;
+    auto other_i = other.i;
+    if (other.IsObject()) ++other.obj->refs;
+    Unref();
+    tag = other_tag;
+    i = other_i;
+    return *this;
+  }
+  Value &operator=(Value &&other) noexcept {
+    if (this != &other) {
+      Unref();
+      tag = other.tag;
+      i = other.i;
+      other.tag = Tag::kVoid;
+    }
+    return *this;
+  }
+
+  static inline Value Int(int64_t i) { return Value(Tag::kInt, i); }
+  static inline Value Float(double f) {
+    auto res = Value(Tag::kFloat, 0);
+    res.f = f;
+    return res;
+  }
+  static inline Value Of(Tag tag, int64_t i) { return Value(tag, i); }
+  static Value Take(Tag tag, Object *obj);  // obj was just created
+
+  inline bool IsObject() const { return tag >= Tag::kString; }
+  inline bool IsNumber() const {
+    return tag == Tag::kInt || tag == Tag::kFloat;
+  }
+
+  // In place, so a register holding a number stays one without a branch
+  // on the old object
+  inline void SetInt(int64_t val) {
+    if (IsObject()) Unref();
+    tag = Tag::kInt;
+    i = val;
+  }
+  inline void SetFloat(double val) {
+    if (IsObject()) Unref();
+    tag = Tag::kFloat;
+    f = val;
+  }
+
+ private:
+  Value(Tag tag, int64_t i) : tag(tag), i(i) {}
+
+  inline void Ref() const {
+    if (IsObject()) ++obj->refs;
+  }
+  inline void Unref() {
+    if (IsObject() && --obj->refs == 0) delete obj;
+    tag = Tag::kVoid;
+  }
+};
+
+struct String final : Object {
+  std::string text;
+  explicit String(std::string text) : text(std::move(text)) {}
+};
+
+struct Array final : Object {
+  std::vector<Value> items;
+};
+
+// Elements of a single number type, e.g. Memory(Int8, n). They are packed
+// in the bytes it owns, or it is a view m[beg:end:step] makes without a
+// copy: every step-th element of the Memory it keeps in base.
+struct Memory final : Object {
+  enum Elem { kInt8, kInt, kFloat };
+  Elem elem;
+  size_t size;
+  uint8_t *data;
+  ptrdiff_t stride;            // bytes from an element to the next
+  std::vector<uint8_t> bytes;  // empty for a view
+  Value base;                  // owning the bytes of a view
+
+  Memory(Elem elem, size_t size)
+      : elem(elem), size(size), bytes(size * Width(elem), 0) {
+    data = bytes.data();
+    stride = Width(elem);
+  }
+  Memory(const Value &base, uint8_t *data, ptrdiff_t stride, size_t size)
+      : elem(static_cast<const Memory *>(base.obj)->elem),
+        size(size),
+        data(data),
+        stride(stride),
+        base(base) {}
+
+  static inline size_t Width(Elem elem) { return elem == kInt8 ? 1 : 8; }
+
+  static inline Value Load(Elem elem, const uint8_t *at) {
+    if (elem == kInt8) return Value::Int(static_cast<int8_t>(*at));
+    if (elem == kInt) {
+      int64_t i;
+      std::memcpy(&i, at, 8);
+      return Value::Int(i);
+    }
+    double f;
+    std::memcpy(&f, at, 8);
+    return Value::Float(f);
+  }
+  // val is a number
+  static inline void Store(Elem elem, uint8_t *at, const Value &val) {
+    if (elem == kFloat) {
+      auto f = val.tag == Tag::kFloat ? val.f : static_cast<double>(val.i);
+      std::memcpy(at, &f, 8);
+      return;
+    }
+    auto i = val.tag == Tag::kInt ? val.i : static_cast<int64_t>(val.f);
+    if (elem == kInt8) {
+      *at = static_cast<uint8_t>(i);
+    } else {
+      std::memcpy(at, &i, 8);
+    }
+  }
+
+  inline uint8_t *At(size_t idx) const {
+    return data + static_cast<ptrdiff_t>(idx) * stride;
+  }
+  inline Value Get(size_t idx) const { return Load(elem, At(idx)); }
+  inline void Set(size_t idx, const Value &val) { Store(elem, At(idx), val); }
+};
+
+// An object of a Class or Struct of the program, its members by slot. It
+// takes a single block of Pool with its members right after it.
+struct Instance final : Object {
+  int cls;  // Program::classes index
+  size_t size;
+  Value *members;
+
+  static inline Instance *New(int cls, size_t size) {
+    auto block = Pool::Allocate(sizeof(Instance) + size * sizeof(Value));
+    if (block == nullptr) throw std::bad_alloc();  // as new does
+    return new (block) Instance(cls, size);
+  }
+  ~Instance() override { std::destroy_n(members, size); }
+  static void operator delete(void *block) { Pool::Free(block); }
+
+ private:
+  Instance(int cls, size_t size)
+      : cls(cls), size(size), members(reinterpret_cast<Value *>(this + 1)) {
+    std::uninitialized_default_construct_n(members, size);
+  }
+};
+
+inline Value Value::Take(Tag tag, Object *obj) {
+  auto res = Value(tag, 0);
+  res.obj = obj;
+  ++obj->refs;
+  return res;
+}
+
+inline bool IsTrue(const Value &val) {
+  switch (val.tag) {
+    case Tag::kVoid:
+    case Tag::kMissing: return false;
+    case Tag::kInt: return val.i != 0;
+    case Tag::kFloat: return val.f != 0;
+    case Tag::kString: return !static_cast<String *>(val.obj)->text.empty();
+    default: return true;
+  }
+}
+
+inline Value NewString(std::string text) {
+  return Value::Take(Tag::kString, new String(std::move(text)));
+}
+
+}  // namespace vm
+
+#endif  // _XULANG_SRC_VM_VALUE_HPP
@@ -0,0 +1,562 @@
+#include "./vm.hpp"
+
+#include <bit>
+#include <cassert>
+
+namespace vm {
+
+#if defined(__GNUC__)
+#define _XULANG_VM_THREADED
+#endif
+
+static inline int64_t Wrap(uint64_t i) { return static_cast<int64_t>(i); }
+
+Machine::Machine(const Program *program, std::istream *in, std::ostream *out)
+    : _rt(program, in, out), _stack(kStackSize) {}
+
+bool Machine::Run(Value *res) {
+  // _stack[0] is the free register before the args of main
+  auto regs = _stack.data() + 1;
+  auto ignored = Value();
+  if (!Enter(_rt.program->init.nregs, regs)) return false;
+  auto ok = Execute(_rt.program->init, regs, &ignored);
+  Leave(_rt.program->init.nregs, regs);
+  if (!ok) return false;
+  if (_rt.program->main < 0) return _rt.Raise("there is no main");
+  return Call(_rt.globals[_rt.program->main], regs, 0, res);
+}
+
+bool Machine::Enter(int nregs, const Value *regs) {
+  if (_depth >= Runtime::kMaxDepth ||
+      regs + nregs > _stack.data() + _stack.size()) {
+    return _rt.Raise("stack overflow");
+  }
+  ++_depth;
+  return true;
+}
+
+// Nothing the frame held outlives it
+void Machine::Leave(int nregs, Value *regs) {
+  for (int i = 0; i < nregs; ++i) regs[i] = Value();
+  --_depth;
+}
+
+bool Machine::Call(const Value &callee, Value *args, int argc, Value *res) {
+  switch (callee.tag) {
+    case Tag::kFunction: return CallFunc(callee.i, args, argc, res);
+    case Tag::kClass: return Construct(callee.i, args, argc, res);
+    case Tag::kBuiltin: return _rt.CallBuiltin(callee.i, args, argc, res);
+    default: return _rt.Raise(_rt.ToString(callee) + " is not callable");
+  }
+}
+
+bool Machine::CallFunc(int idx, Value *args, int argc, Value *res) {
+  const auto &func = _rt.program->funcs[idx];
+  if (argc > func.nparams) {
+    return _rt.Raise(func.name + " takes " + std::to_string(func.nparams) +
+                     " args, not " + std::to_string(argc));
+  }
+  if (func.native.entry != nullptr &&
+      CallNative(func.native, args, argc, res)) {
+    return true;
+  }
+  if (!Enter(func.code.nregs, args)) return false;
+  for (auto i = argc; i < func.nparams; ++i) {
+    args[i] = Value::Of(Tag::kMissing, 0);
+  }
+  auto ret = Value();
+  auto ok = argc >= func.nrequired;
+  if (!ok) {
+    _rt.Raise(func.name + " takes at least " +
+              std::to_string(func.nrequired) + " args, not " +
+              std::to_string(argc));
+  } else {
+    ok = Execute(func.code, args, &ret);
+  }
+  Leave(func.code.nregs, args);
+  *res = std::move(ret);
+  return ok;
+}
+
+// False with nothing changed if the args are not what the machine code
+// takes or it gives up, the bytecode runs the call then
+bool Machine::CallNative(const Native &native, const Value *args, int argc,
+                         Value *res) {
+  if (argc != static_cast<int>(native.params.size())) return false;
+  int64_t bits[Native::kMaxParams];
+  for (int i = 0; i < argc; ++i) {
+    if (args[i].tag != native.params[i]) return false;
+    bits[i] = args[i].tag == Tag::kInt ? args[i].i
+                                       : std::bit_cast<int64_t>(args[i].f);
+  }
+  int64_t out;
+  if (!native.entry(bits, &out, _depth)) return false;
+  if (native.res == Tag::kInt) {
+    res->SetInt(out);
+  } else {
+    res->SetFloat(std::bit_cast<double>(out));
+  }
+  return true;
+}
+
+// The init code of the class creates the instance above the args, then
+// __Create__ gets it in args[-1] before the args
+bool Machine::Construct(int idx, Value *args, int argc, Value *res) {
+  const auto &cls = _rt.program->classes[idx];
+  auto instance = Value();
+  if (cls.ast == nullptr) {
+    instance = Value::Take(Tag::kInstance, Instance::New(idx, cls.nslots));
+  } else {
+    auto regs = args + argc;
+    if (!Enter(cls.init.nregs, regs)) return false;
+    auto ok = Execute(cls.init, regs, &instance);
+    Leave(cls.init.nregs, regs);
+    if (!ok) return false;
+  }
+
+  auto create = Value();
+  if (cls.create >= 0) {
+    create = static_cast<Instance *>(instance.obj)->members[cls.create];
+  }
+  if (create.tag == Tag::kFunction) {
+    args[-1] = instance;
+    auto ignored = Value();
+    if (!CallFunc(create.i, args - 1, argc + 1, &ignored)) return false;
+  } else if (!_rt.InitError(instance, args, argc)) {
+    return false;
+  }
+  *res = std::move(instance);
+  return true;
+}
+
+// obj[1] ... are the args, a Function member gets obj itself first
+bool Machine::CallMethod(Value *obj, const std::string &id, int argc,
+                         Value *res) {
+  if (obj->tag != Tag::kInstance) {
+    return _rt.CallMethod(*obj, id, obj + 1, argc, res);
+  }
+  auto member = Value();
+  if (!_rt.GetMember(*obj, id, &member)) return false;
+  if (member.tag == Tag::kFunction) {
+    return CallFunc(member.i, obj, argc + 1, res);
+  }
+  return Call(member, obj + 1, argc, res);
+}
+
+bool Machine::Execute(const Code &code, Value *regs, Value *res) {
+  const auto begin = code.instrs.data();
+  const auto consts = code.consts.data();
+  auto ip = begin;
+  auto test = Value();  // of a compare and jump taking the slow path
+
+  // ip is the instr being run until NEXT, so a raise knows where it is
+#ifdef _XULANG_VM_THREADED
+#define _XULANG_VM_LABEL(op) &&L_##op,
+  static const void *const kLabels[] = {_XULANG_VM_OPS(_XULANG_VM_LABEL)};
+#undef _XULANG_VM_LABEL
+#define CASE(op) L_##op:
+#define DISPATCH() goto *kLabels[static_cast<int>(ip->op)]
+#else
+#define CASE(op) case Op::op:
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT() \
+  ++ip;        \
+  DISPATCH()
+#define A regs[ip->a]
+#define B regs[ip->b]
+#define C regs[ip->c]
+#define JUMP()        \
+  ip = begin + ip->t; \
+  DISPATCH()
+
+  // Both Int or both Float, else the Runtime
+#define ARITH(op, int_expr, float_expr)                       \
+  CASE(op) {                                                  \
+    const auto &x = B;                                        \
+    const auto &y = C;                                        \
+    if (x.tag == Tag::kInt && y.tag == Tag::kInt) {           \
+      A.SetInt(int_expr);                                     \
+    } else if (x.tag == Tag::kFloat && y.tag == Tag::kFloat) { \
+      A.SetFloat(float_expr);                                 \
+    } else if (!_rt.Binary(Op::op, x, y, &A)) {               \
+      goto raise;                                             \
+    }                                                         \
+    NEXT();                                                   \
+  }
+#define BITWISE(op, int_expr)                             \
+  CASE(op) {                                              \
+    const auto &x = B;                                    \
+    const auto &y = C;                                    \
+    if (x.tag == Tag::kInt && y.tag == Tag::kInt) {       \
+      A.SetInt(int_expr);                                 \
+    } else if (!_rt.Binary(Op::op, x, y, &A)) {           \
+      goto raise;                                         \
+    }                                                     \
+    NEXT();                                               \
+  }
+#define COMPARE(op, cmp)                                      \
+  CASE(op) {                                                  \
+    const auto &x = B;                                        \
+    const auto &y = C;                                        \
+    if (x.tag == Tag::kInt && y.tag == Tag::kInt) {           \
+      A.SetInt(x.i cmp y.i);                                  \
+    } else if (x.tag == Tag::kFloat && y.tag == Tag::kFloat) { \
+      A.SetInt(x.f cmp y.f);                                  \
+    } else if (!_rt.Binary(Op::op, x, y, &A)) {               \
+      goto raise;                                             \
+    }                                                         \
+    NEXT();                                                   \
+  }
+#define JUMP_IF_NOT(op, cmp_op, cmp)                                 \
+  CASE(op) {                                                         \
+    const auto &x = A;                                               \
+    const auto &y = B;                                               \
+    bool taken;                                                      \
+    if (x.tag == Tag::kInt && y.tag == Tag::kInt) {                  \
+      taken = !(x.i cmp y.i);                                        \
+    } else if (x.tag == Tag::kFloat && y.tag == Tag::kFloat) {       \
+      taken = !(x.f cmp y.f);                                        \
+    } else if (_rt.Binary(Op::cmp_op, x, y, &test)) {                \
+      taken = !IsTrue(test);                                         \
+    } else {                                                         \
+      goto raise;                                                    \
+    }                                                                \
+    if (taken) {                                                     \
+      JUMP();                                                        \
+    }                                                                \
+    NEXT();                                                          \
+  }
+
+#ifdef _XULANG_VM_THREADED
+  DISPATCH();
+#else
+dispatch:
+  switch (ip->op) {
+#endif
+
+  CASE(kNop) { NEXT(); }
+  CASE(kMove) {
+    A = B;
+    NEXT();
+  }
+  CASE(kConst) {
+    A = consts[ip->b];
+    NEXT();
+  }
+  CASE(kInt) {
+    A.SetInt(static_cast<int16_t>(ip->b));
+    NEXT();
+  }
+  CASE(kGlobal) {
+    A = _rt.globals[ip->b];
+    NEXT();
+  }
+  CASE(kSetGlobal) {
+    _rt.globals[ip->b] = A;
+    NEXT();
+  }
+  CASE(kDefault) {
+    if (A.tag != Tag::kMissing) {
+      JUMP();
+    }
+    NEXT();
+  }
+
+  ARITH(kAdd, Wrap(uint64_t(x.i) + uint64_t(y.i)), x.f + y.f)
+  ARITH(kSub, Wrap(uint64_t(x.i) - uint64_t(y.i)), x.f - y.f)
+  ARITH(kMul, Wrap(uint64_t(x.i) * uint64_t(y.i)), x.f * y.f)
+  CASE(kDiv) {
+    const auto &x = B;
+    const auto &y = C;
+    if (x.tag == Tag::kInt && y.tag == Tag::kInt && y.i > 0) {
+      A.SetInt(x.i / y.i);
+    } else if (x.tag == Tag::kFloat && y.tag == Tag::kFloat) {
+      A.SetFloat(x.f / y.f);
+    } else if (!_rt.Binary(Op::kDiv, x, y, &A)) {
+      goto raise;
+    }
+    NEXT();
+  }
+  CASE(kMod) {
+    const auto &x = B;
+    const auto &y = C;
+    if (x.tag == Tag::kInt && y.tag == Tag::kInt && y.i > 0) {
+      A.SetInt(x.i % y.i);
+    } else if (!_rt.Binary(Op::kMod, x, y, &A)) {
+      goto raise;
+    }
+    NEXT();
+  }
+  BITWISE(kXor, x.i ^ y.i)
+  BITWISE(kOr, x.i | y.i)
+  BITWISE(kAnd, x.i & y.i)
+  CASE(kShl) {
+    const auto &x = B;
+    const auto &y = C;
+    if (x.tag == Tag::kInt && y.tag == Tag::kInt && uint64_t(y.i) < 64) {
+      A.SetInt(Wrap(uint64_t(x.i) << y.i));
+    } else if (!_rt.Binary(Op::kShl, x, y, &A)) {
+      goto raise;
+    }
+    NEXT();
+  }
+  CASE(kShr) {
+    const auto &x = B;
+    const auto &y = C;
+    if (x.tag == Tag::kInt && y.tag == Tag::kInt && uint64_t(y.i) < 64) {
+      A.SetInt(x.i >> y.i);
+    } else if (!_rt.Binary(Op::kShr, x, y, &A)) {
+      goto raise;
+    }
+    NEXT();
+  }
+  COMPARE(kEq, ==)
+  COMPARE(kNe, !=)
+  COMPARE(kLt, <)
+  COMPARE(kLe, <=)
+  COMPARE(kGt, >)
+  COMPARE(kGe, >=)
+  CASE(kAddImm) {
+    const auto &x = B;
+    auto imm = static_cast<int16_t>(ip->c);
+    if (x.tag == Tag::kInt) {
+      A.SetInt(Wrap(uint64_t(x.i) + uint64_t(int64_t(imm))));
+    } else if (x.tag == Tag::kFloat) {
+      A.SetFloat(x.f + imm);
+    } else if (!_rt.Binary(Op::kAdd, x, Value::Int(imm), &A)) {
+      goto raise;
+    }
+    NEXT();
+  }
+
+  CASE(kNeg) {
+    const auto &x = B;
+    if (x.tag == Tag::kInt) {
+      A.SetInt(Wrap(0 - uint64_t(x.i)));
+    } else if (!_rt.Unary(Op::kNeg, x, &A)) {
+      goto raise;
+    }
+    NEXT();
+  }
+  CASE(kPos) {
+    if (!_rt.Unary(Op::kPos, B, &A)) goto raise;
+    NEXT();
+  }
+  CASE(kNot) {
+    A.SetInt(!IsTrue(B));
+    NEXT();
+  }
+  CASE(kBitNot) {
+    if (!_rt.Unary(Op::kBitNot, B, &A)) goto raise;
+    NEXT();
+  }
+  CASE(kBool) {
+    A.SetInt(IsTrue(B));
+    NEXT();
+  }
+  CASE(kRef) {
+    if (!_rt.Unary(Op::kRef, B, &A)) goto raise;
+    NEXT();
+  }
+  CASE(kToInt) {
+    if (B.tag == Tag::kInt) {
+      A.SetInt(B.i);
+    } else if (!_rt.Unary(Op::kToInt, B, &A)) {
+      goto raise;
+    }
+    NEXT();
+  }
+  CASE(kToFloat) {
+    if (B.tag == Tag::kFloat) {
+      A.SetFloat(B.f);
+    } else if (!_rt.Unary(Op::kToFloat, B, &A)) {
+      goto raise;
+    }
+    NEXT();
+  }
+
+  CASE(kJump) { JUMP(); }
+  CASE(kJumpIf) {
+    if (IsTrue(A)) {
+      JUMP();
+    }
+    NEXT();
+  }
+  CASE(kJumpIfNot) {
+    if (!IsTrue(A)) {
+      JUMP();
+    }
+    NEXT();
+  }
+  JUMP_IF_NOT(kJumpIfNotEq, kEq, ==)
+  JUMP_IF_NOT(kJumpIfNotNe, kNe, !=)
+  JUMP_IF_NOT(kJumpIfNotLt, kLt, <)
+  JUMP_IF_NOT(kJumpIfNotLe, kLe, <=)
+  JUMP_IF_NOT(kJumpIfNotGt, kGt, >)
+  JUMP_IF_NOT(kJumpIfNotGe, kGe, >=)
+
+  CASE(kGetIndex) {
+    const auto &obj = B;
+    const auto &idx = C;
+    if (obj.tag == Tag::kMemory && idx.tag == Tag::kInt) {
+      auto memory = static_cast<const Memory *>(obj.obj);
+      if (uint64_t(idx.i) < memory->size) {
+        A = memory->Get(idx.i);
+        NEXT();
+      }
+    } else if (obj.tag == Tag::kArray && idx.tag == Tag::kInt) {
+      const auto &items = static_cast<const Array *>(obj.obj)->items;
+      if (uint64_t(idx.i) < items.size()) {
+        A = items[idx.i];
+        NEXT();
+      }
+    }
+    if (!_rt.GetIndex(obj, idx, &A)) goto raise;
+    NEXT();
+  }
+  CASE(kGetIndexIn) {
+    const auto &obj = B;
+    const auto &idx = C;
+    // Proven in bounds by pass::RangeAnalyzer
+    if (obj.tag == Tag::kMemory && idx.tag == Tag::kInt) {
+      auto memory = static_cast<const Memory *>(obj.obj);
+      assert(uint64_t(idx.i) < memory->size);
+      A = memory->Get(idx.i);
+    } else if (obj.tag == Tag::kArray && idx.tag == Tag::kInt) {
+      const auto &items = static_cast<const Array *>(obj.obj)->items;
+      assert(uint64_t(idx.i) < items.size());
+      A = items[idx.i];
+    } else if (!_rt.GetIndex(obj, idx, &A)) {
+      goto raise;
+    }
+    NEXT();
+  }
+  CASE(kSetIndex) {
+    const auto &obj = A;
+    const auto &idx = B;
+    const auto &val = C;
+    if (obj.tag == Tag::kMemory && idx.tag == Tag::kInt && val.IsNumber()) {
+      auto memory = static_cast<Memory *>(obj.obj);
+      if (uint64_t(idx.i) < memory->size) {
+        memory->Set(idx.i, val);
+        NEXT();
+      }
+    } else if (obj.tag == Tag::kArray && idx.tag == Tag::kInt) {
+      auto &items = static_cast<Array *>(obj.obj)->items;
+      if (uint64_t(idx.i) < items.size()) {
+        items[idx.i] = val;
+        NEXT();
+      }
+    }
+    if (!_rt.SetIndex(obj, idx, val)) goto raise;
+    NEXT();
+  }
+  CASE(kSetIndexIn) {
+    const auto &obj = A;
+    const auto &idx = B;
+    const auto &val = C;
+    if (obj.tag == Tag::kMemory && idx.tag == Tag::kInt && val.IsNumber()) {
+      auto memory = static_cast<Memory *>(obj.obj);
+      assert(uint64_t(idx.i) < memory->size);
+      memory->Set(idx.i, val);
+    } else if (obj.tag == Tag::kArray && idx.tag == Tag::kInt) {
+      auto &items = static_cast<Array *>(obj.obj)->items;
+      assert(uint64_t(idx.i) < items.size());
+      items[idx.i] = val;
+    } else if (!_rt.SetIndex(obj, idx, val)) {
+      goto raise;
+    }
+    NEXT();
+  }
+  CASE(kSlice) {
+    const auto *bounds = &B;
+    if (!_rt.Slice(bounds[0], bounds[1], bounds[2], bounds[3], &A)) {
+      goto raise;
+    }
+    NEXT();
+  }
+  CASE(kGetMember) {
+    const auto &id = static_cast<const String *>(consts[ip->c].obj)->text;
+    if (!_rt.GetMember(B, id, &A)) goto raise;
+    NEXT();
+  }
+  CASE(kSetMember) {
+    const auto &id = static_cast<const String *>(consts[ip->b].obj)->text;
+    if (!_rt.SetMember(A, id, C)) goto raise;
+    NEXT();
+  }
+  CASE(kLength) {
+    if (!_rt.Length(B, &A)) goto raise;
+    NEXT();
+  }
+
+  CASE(kCall) {
+    if (!Call(Value(B), &B + 1, ip->c, &A)) goto raise;
+    NEXT();
+  }
+  CASE(kCallFunc) {
+    if (!CallFunc(ip->t, &B + 1, ip->c, &A)) goto raise;
+    NEXT();
+  }
+  CASE(kCallMethod) {
+    const auto &id = static_cast<const String *>(consts[ip->t].obj)->text;
+    if (!CallMethod(&B, id, ip->c, &A)) goto raise;
+    NEXT();
+  }
+  CASE(kMatch) {
+    if (!_rt.Match(B, C, &A)) goto raise;
+    NEXT();
+  }
+  CASE(kNew) {
+    const auto &cls = _rt.program->classes[ip->b];
+    auto instance = Instance::New(ip->b, cls.nslots);
+    for (int i = 0; i < cls.nslots; ++i) {
+      instance->members[i] = std::move(regs[i]);
+    }
+    A = Value::Take(Tag::kInstance, instance);
+    NEXT();
+  }
+  CASE(kReturn) {
+    *res = std::move(A);
+    return true;
+  }
+  CASE(kReturnVoid) {
+    *res = Value();
+    return true;
+  }
+  CASE(kRaise) {
+    _rt.error = A;
+    goto raise;
+  }
+
+#ifndef _XULANG_VM_THREADED
+  }
+#endif
+
+raise:
+  // The innermost try covering the instr, or the caller
+  for (const auto &handler : code.handlers) {
+    auto pc = ip - begin;
+    if (pc >= handler.beg && pc < handler.end) {
+      regs[handler.reg] = std::move(_rt.error);
+      ip = begin + handler.target;
+      DISPATCH();
+    }
+  }
+  return false;
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef A
+#undef B
+#undef C
+#undef JUMP
+#undef ARITH
+#undef BITWISE
+#undef COMPARE
+#undef JUMP_IF_NOT
+}
+
+}  // namespace vm
@@ -0,0 +1,44 @@
+#ifndef _XULANG_SRC_VM_VM_HPP
+#define _XULANG_SRC_VM_VM_HPP
+
+#include "./runtime.hpp"
+
+namespace vm {
+
+// Run the bytecode of a Program. Dispatch is threaded through a table of
+// label addresses where the compiler has computed goto, Int and Float
+// operands take a fast path without calling the Runtime, and a raise goes
+// to the innermost handler of the table of its Code covering it. The frames
+// of all calls are windows of one register stack: the args of a call are the
+// first registers of the callee.
+class Machine final {
+ public:
+  static constexpr size_t kStackSize = 1 << 18;  // registers
+
+  Machine(const Program *program, std::istream *in, std::ostream *out);
+
+  // Create the Module objs and call main, false if an error is raised and
+  // not caught, it is then in runtime().error
+  bool Run(Value *res);
+  inline Runtime &runtime() { return _rt; }
+
+ private:
+  Runtime _rt;
+  std::vector<Value> _stack;
+  int _depth = 0;
+
+  bool Enter(int nregs, const Value *regs);
+  void Leave(int nregs, Value *regs);
+  bool Execute(const Code &code, Value *regs, Value *res);
+  // args[-1] is free for the callee to use
+  bool Call(const Value &callee, Value *args, int argc, Value *res);
+  bool CallFunc(int func, Value *args, int argc, Value *res);
+  bool CallNative(const Native &native, const Value *args, int argc,
+                  Value *res);
+  bool Construct(int cls, Value *args, int argc, Value *res);
+  bool CallMethod(Value *obj, const std::string &id, int argc, Value *res);
+};
+
+}  // namespace vm
+
+#endif  // _XULANG_SRC_VM_VM_HPP
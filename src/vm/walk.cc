@@ -0,0 +1,421 @@
+#include "./walk.hpp"
+
+#include "./compile.hpp"
+
+namespace vm {
+
+TreeWalker::TreeWalker(const Program *program, ast::Module *module,
+                       std::istream *in, std::ostream *out)
+    : _rt(program, in, out), _module(module) {
+  for (size_t i = 0; i < program->funcs.size(); ++i) {
+    _statics[program->funcs[i].ast] = Value::Of(Tag::kFunction, i);
+  }
+  for (size_t i = 0; i < program->classes.size(); ++i) {
+    _statics[program->classes[i].ast] = Value::Of(Tag::kClass, i);
+  }
+}
+
+bool TreeWalker::Run(Value *res) {
+  auto idx = 0;
+  for (const auto &obj : _module->objs) {
+    auto create = dynamic_cast<ast::ObjCreate *>(obj.get());
+    if (create != nullptr &&
+        !Eval(create->call_expr.get(), &_rt.globals[idx])) {
+      return false;
+    }
+    ++idx;
+  }
+  if (_rt.program->main < 0) return _rt.Raise("there is no main");
+  return Call(_rt.globals[_rt.program->main], {}, res);
+}
+
+bool TreeWalker::Eval(ast::Expression *expr, Value *res) {
+  _value = Value();
+  Walk(expr);
+  if (_flow == kRaise) return false;
+  *res = std::move(_value);
+  return true;
+}
+
+// Evaluate the target before the value, e.g. a[i] += f() reads a[i] first
+void TreeWalker::Assign(ast::Expression *target, const std::string &op,
+                        ast::Expression *val) {
+  auto compute = [&](const Value &old, Value *res) {
+    if (!Eval(val, res)) return false;
+    if (op == "__assign__") return true;
+    if (_rt.Binary(OpOf(op), old, *res, res)) return true;
+    Fail();
+    return false;
+  };
+
+  auto res = Value();
+  auto old = Value();
+  if (auto name = dynamic_cast<ast::Name *>(target); name != nullptr) {
+    if (name->parent != nullptr) {
+      auto obj = Value();
+      if (!Eval(name->parent.get(), &obj)) return;
+      if (op != "__assign__" && !_rt.GetMember(obj, *name->id, &old)) {
+        return Fail();
+      }
+      if (!compute(old, &res)) return;
+      if (!_rt.SetMember(obj, *name->id, res)) return Fail();
+    } else if (name->binding.kind == ast::Binding::kLocal) {
+      auto &slot = _frame[name->binding.slot];
+      if (!compute(slot, &res)) return;
+      slot = res;
+    } else {
+      auto &global = _rt.globals[name->binding.slot];
+      if (!compute(global, &res)) return;
+      global = res;
+    }
+  } else {
+    auto sub = static_cast<ast::SubscriptExpr *>(target);
+    auto obj = Value();
+    auto idx = Value();
+    if (!Eval(sub->obj.get(), &obj) ||
+        !Eval(std::get<0>(*sub->op->dims.front()).get(), &idx)) {
+      return;
+    }
+    if (op != "__assign__" && !_rt.GetIndex(obj, idx, &old)) return Fail();
+    if (!compute(old, &res)) return;
+    if (!_rt.SetIndex(obj, idx, res)) return Fail();
+  }
+  _value = std::move(res);
+}
+
+// Keyword args take the place of their param, kMissing fills the gaps
+bool TreeWalker::Args(ast::CallOperator *cop, const Value &callee,
+                      std::vector<Value> *args) {
+  for (const auto &x : cop->unameds) {
+    if (!Eval(x.get(), &args->emplace_back())) return false;
+  }
+  if (cop->keywords.empty()) return true;
+
+  const Func *func = nullptr;
+  auto skip = 0;
+  if (callee.tag == Tag::kFunction) {
+    func = &_rt.program->funcs[callee.i];
+  } else if (callee.tag == Tag::kClass) {
+    const auto &cls = _rt.program->classes[callee.i];
+    for (const auto &func_ : _rt.program->funcs) {
+      if (func_.name == cls.name + ".__Create__") func = &func_;
+    }
+    skip = 1;
+  }
+  for (const auto &[id, val] : cop->keywords) {
+    auto pos = -1;
+    for (int i = skip; func != nullptr && i < func->nparams; ++i) {
+      if (func->params[i] == *id) pos = i - skip;
+    }
+    if (pos < 0) {
+      _rt.Raise("no param " + *id + " of " + _rt.ToString(callee));
+      Fail();
+      return false;
+    }
+    if (static_cast<int>(args->size()) <= pos) {
+      args->resize(pos + 1, Value::Of(Tag::kMissing, 0));
+    }
+    if (!Eval(val.get(), &(*args)[pos])) return false;
+  }
+  return true;
+}
+
+bool TreeWalker::Call(const Value &callee, std::vector<Value> &&args,
+                      Value *res) {
+  switch (callee.tag) {
+    case Tag::kFunction: return CallFunc(callee.i, std::move(args), res);
+    case Tag::kClass: return Construct(callee.i, std::move(args), res);
+    case Tag::kBuiltin:
+      return _rt.CallBuiltin(callee.i, args.data(), args.size(), res);
+    default: return _rt.Raise(_rt.ToString(callee) + " is not callable");
+  }
+}
+
+bool TreeWalker::CallFunc(int idx, std::vector<Value> &&args, Value *res) {
+  const auto &func = _rt.program->funcs[idx];
+  auto argc = static_cast<int>(args.size());
+  if (argc > func.nparams) {
+    return _rt.Raise(func.name + " takes " + std::to_string(func.nparams) +
+                     " args, not " + std::to_string(argc));
+  }
+  if (argc < func.nrequired) {
+    return _rt.Raise(func.name + " takes at least " +
+                     std::to_string(func.nrequired) + " args, not " +
+                     std::to_string(argc));
+  }
+  if (_depth >= Runtime::kMaxDepth) return _rt.Raise("stack overflow");
+
+  auto frame = std::move(args);
+  frame.resize(func.nslots);
+  auto caller = _frame;
+  _frame = frame.data();
+  ++_depth;
+  auto param = func.nrequired;
+  for (const auto &[_, val] : func.ast->args->keywords) {
+    if (param >= argc || frame[param].tag == Tag::kMissing) {
+      if (!Eval(val.get(), &frame[param])) break;
+    }
+    ++param;
+  }
+  if (_flow == kNormal) Walk(func.ast->body.get());
+  --_depth;
+  _frame = caller;
+
+  auto flow = _flow;
+  _flow = kNormal;
+  if (flow == kRaise) return false;
+  *res = flow == kReturn ? std::move(_ret) : Value();
+  return true;
+}
+
+// Run the body of the class for its members, then __Create__ with the
+// instance before the args
+bool TreeWalker::Construct(int idx, std::vector<Value> &&args, Value *res) {
+  const auto &cls = _rt.program->classes[idx];
+  auto instance = Value::Take(Tag::kInstance, Instance::New(idx, cls.nslots));
+  auto members = static_cast<Instance *>(instance.obj)->members;
+  if (cls.ast != nullptr) {
+    auto body = dynamic_cast<const ast::Class *>(cls.ast) != nullptr
+                    ? static_cast<const ast::Class *>(cls.ast)->body.get()
+                    : static_cast<const ast::Struct *>(cls.ast)->body.get();
+    auto caller = _frame;
+    _frame = members;
+    Walk(body);
+    _frame = caller;
+    if (_flow == kRaise) {
+      _flow = kNormal;
+      return false;
+    }
+  }
+
+  if (cls.create >= 0 && members[cls.create].tag == Tag::kFunction) {
+    auto create = members[cls.create].i;
+    args.insert(args.begin(), instance);
+    auto ignored = Value();
+    if (!CallFunc(create, std::move(args), &ignored)) return false;
+  } else if (!_rt.InitError(instance, args.data(), args.size())) {
+    return false;
+  }
+  *res = std::move(instance);
+  return true;
+}
+
+void TreeWalker::Visit(ast::Block *block) {
+  for (const auto &stmt : block->statements) {
+    Walk(stmt.get());
+    if (_flow != kNormal) return;
+  }
+}
+
+void TreeWalker::Visit(ast::ExprStatement *stmt) {
+  auto ignored = Value();
+  Eval(stmt->expr.get(), &ignored);
+}
+
+void TreeWalker::Visit(ast::Break *) { _flow = kBreak; }
+void TreeWalker::Visit(ast::Continue *) { _flow = kContinue; }
+
+void TreeWalker::Visit(ast::Return *ret) {
+  _ret = Value();
+  if (ret->expr != nullptr && !Eval(ret->expr.get(), &_ret)) return;
+  _flow = kReturn;
+}
+
+void TreeWalker::Visit(ast::If *if_stmt) {
+  auto test = Value();
+  if (!Eval(if_stmt->test.get(), &test)) return;
+  Walk(IsTrue(test) ? if_stmt->body.get() : if_stmt->orelse.get());
+}
+
+// Break skips the else
+void TreeWalker::Visit(ast::While *while_stmt) {
+  auto test = Value();
+  while (true) {
+    if (!Eval(while_stmt->test.get(), &test)) return;
+    if (!IsTrue(test)) break;
+    Walk(while_stmt->body.get());
+    if (_flow == kBreak) {
+      _flow = kNormal;
+      return;
+    }
+    if (_flow == kContinue) _flow = kNormal;
+    if (_flow != kNormal) return;
+  }
+  Walk(while_stmt->orelse.get());
+}
+
+void TreeWalker::Visit(ast::ObjCreate *create) {
+  Eval(create->call_expr.get(), &_frame[create->binding.slot]);
+}
+
+void TreeWalker::Visit(ast::Function *func) {
+  _frame[func->binding.slot] = _statics.at(func);
+}
+
+void TreeWalker::Visit(ast::Struct *struct_create) {
+  _frame[struct_create->binding.slot] = _statics.at(struct_create);
+}
+
+void TreeWalker::Visit(ast::Class *class_create) {
+  _frame[class_create->binding.slot] = _statics.at(class_create);
+}
+
+void TreeWalker::Visit(ast::Raise *raise) {
+  auto error = Value();
+  if (!Eval(raise->error.get(), &error)) return;
+  _rt.error = std::move(error);
+  Fail();
+}
+
+void TreeWalker::Visit(ast::Try *try_stmt) {
+  Walk(try_stmt->body.get());
+  if (_flow == kNormal) return Walk(try_stmt->orelse.get());
+  if (_flow != kRaise) return;
+
+  _flow = kNormal;
+  auto error = std::move(_rt.error);
+  size_t idx = 0;
+  for (const auto &[_, type, handler] : try_stmt->excepts) {
+    auto cls = Value();
+    auto match = Value();
+    if (!Eval(type.get(), &cls)) return;
+    if (!_rt.Match(error, cls, &match)) return Fail();
+    if (match.i) {
+      _frame[try_stmt->alias_slots[idx]] = std::move(error);
+      return Walk(handler.get());
+    }
+    ++idx;
+  }
+  _rt.error = std::move(error);
+  Fail();
+}
+
+void TreeWalker::Visit(ast::Literal *literal) {
+  auto found = _literals.find(literal);
+  if (found == _literals.end()) {
+    found = _literals.emplace(literal, LiteralValue(literal)).first;
+  }
+  _value = found->second;
+}
+
+void TreeWalker::Visit(ast::Name *name) {
+  if (name->parent != nullptr) {
+    auto obj = Value();
+    if (!Eval(name->parent.get(), &obj)) return;
+    if (!_rt.GetMember(obj, *name->id, &_value)) Fail();
+    return;
+  }
+  switch (name->binding.kind) {
+    case ast::Binding::kLocal: _value = _frame[name->binding.slot]; break;
+    case ast::Binding::kGlobal: _value = _rt.globals[name->binding.slot]; break;
+    default: _value = Value::Of(Tag::kBuiltin, name->binding.slot); break;
+  }
+}
+
+void TreeWalker::Visit(ast::UnaryOpExpr *expr) {
+  auto right = Value();
+  if (!Eval(expr->right.get(), &right)) return;
+  auto op = OpOf(expr->op->GetName());
+  if (op == Op::kMove) {
+    _value = std::move(right);
+  } else if (!_rt.Unary(op, right, &_value)) {
+    Fail();
+  }
+}
+
+void TreeWalker::Visit(ast::BinaryOpExpr *expr) {
+  auto name = std::string(expr->op->GetName());
+  if (name == "__assign__" || name.rfind("__self_", 0) == 0) {
+    return Assign(expr->left.get(), name, expr->right.get());
+  }
+  auto left = Value();
+  auto right = Value();
+  if (!Eval(expr->left.get(), &left) || !Eval(expr->right.get(), &right)) {
+    return;
+  }
+  if (!_rt.Binary(OpOf(name), left, right, &_value)) Fail();
+}
+
+// && and || give 0 or 1 and only evaluate the right side if the left one
+// does not decide
+void TreeWalker::Visit(ast::LogicExpr *expr) {
+  auto name = std::string(expr->op->GetName());
+  auto left = Value();
+  if (!Eval(expr->left.get(), &left)) return;
+  if (name == "__and__" || name == "__or__") {
+    if (IsTrue(left) == (name == "__or__")) {
+      _value = Value::Int(name == "__or__");
+      return;
+    }
+    auto right = Value();
+    if (!Eval(expr->right.get(), &right)) return;
+    _value = Value::Int(IsTrue(right));
+    return;
+  }
+  auto right = Value();
+  if (!Eval(expr->right.get(), &right)) return;
+  if (!_rt.Binary(OpOf(name), left, right, &_value)) Fail();
+}
+
+void TreeWalker::Visit(ast::IfElseExpr *expr) {
+  auto test = Value();
+  if (!Eval(expr->test.get(), &test)) return;
+  Eval(IsTrue(test) ? expr->left.get() : expr->right.get(), &_value);
+}
+
+// The method of an instance gets the instance as its first arg
+void TreeWalker::Visit(ast::CallExpr *expr) {
+  auto name = dynamic_cast<ast::Name *>(expr->obj.get());
+  auto args = std::vector<Value>();
+  auto res = Value();
+  if (name != nullptr && name->parent != nullptr) {
+    auto obj = Value();
+    if (!Eval(name->parent.get(), &obj)) return;
+    if (obj.tag != Tag::kInstance) {
+      if (!Args(expr->op.get(), Value(), &args)) return;
+      if (!_rt.CallMethod(obj, *name->id, args.data(), args.size(), &res)) {
+        return Fail();
+      }
+      _value = std::move(res);
+      return;
+    }
+    auto member = Value();
+    if (!_rt.GetMember(obj, *name->id, &member)) return Fail();
+    if (member.tag == Tag::kFunction) args.push_back(obj);
+    if (!Args(expr->op.get(), member, &args)) return;
+    if (!Call(member, std::move(args), &res)) return Fail();
+    _value = std::move(res);
+    return;
+  }
+
+  auto callee = Value();
+  if (!Eval(expr->obj.get(), &callee) || !Args(expr->op.get(), callee, &args)) {
+    return;
+  }
+  if (!Call(callee, std::move(args), &res)) return Fail();
+  _value = std::move(res);
+}
+
+void TreeWalker::Visit(ast::SubscriptExpr *expr) {
+  auto obj = Value();
+  if (!Eval(expr->obj.get(), &obj)) return;
+  const auto &dim = *expr->op->dims.front();
+  if (ast::SubscriptOperator::IsSlice(dim)) {
+    Value bounds[3];
+    if ((std::get<0>(dim) != nullptr &&
+         !Eval(std::get<0>(dim).get(), &bounds[0])) ||
+        (std::get<1>(dim) != nullptr &&
+         !Eval(std::get<1>(dim).get(), &bounds[1])) ||
+        (std::get<2>(dim) != nullptr &&
+         !Eval(std::get<2>(dim).get(), &bounds[2]))) {
+      return;
+    }
+    if (!_rt.Slice(obj, bounds[0], bounds[1], bounds[2], &_value)) Fail();
+    return;
+  }
+  auto idx = Value();
+  if (!Eval(std::get<0>(dim).get(), &idx)) return;
+  if (!_rt.GetIndex(obj, idx, &_value)) Fail();
+}
+
+}  // namespace vm
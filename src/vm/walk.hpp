@@ -0,0 +1,73 @@
+#ifndef _XULANG_SRC_VM_WALK_HPP
+#define _XULANG_SRC_VM_WALK_HPP
+
+#include "../ast/walker.hpp"
+#include "./runtime.hpp"
+
+namespace vm {
+
+// A naive interpreter evaluating the AST of a module node by node, what the
+// bytecode of Machine is measured against. It shares the Runtime with it,
+// so both give the same results, and takes the members of the classes and
+// the Module objs from the Program compiled from the same module.
+class TreeWalker final : private ast::Walker {
+ public:
+  TreeWalker(const Program *program, ast::Module *module, std::istream *in,
+             std::ostream *out);
+
+  // As Machine::Run()
+  bool Run(Value *res);
+  inline Runtime &runtime() { return _rt; }
+
+ private:
+  // How the statement just walked ended, kRaise leaves the error in the
+  // Runtime
+  enum Flow { kNormal, kBreak, kContinue, kReturn, kRaise };
+
+  Runtime _rt;
+  ast::Module *_module;
+  std::unordered_map<const ast::Create *, Value> _statics;
+  std::unordered_map<const ast::Literal *, Value> _literals;
+  Value *_frame = nullptr;  // locals by slot
+  Flow _flow = kNormal;
+  Value _value;  // of the expression just walked
+  Value _ret;    // of the function returning
+  int _depth = 0;
+
+  bool Eval(ast::Expression *expr, Value *res);
+  void Fail() { _flow = kRaise; }
+  void Assign(ast::Expression *target, const std::string &op,
+              ast::Expression *val);
+  bool Args(ast::CallOperator *cop, const Value &callee,
+            std::vector<Value> *args);
+  bool Call(const Value &callee, std::vector<Value> &&args, Value *res);
+  bool CallFunc(int idx, std::vector<Value> &&args, Value *res);
+  bool Construct(int idx, std::vector<Value> &&args, Value *res);
+
+  virtual void Visit(ast::Block *) override;
+  virtual void Visit(ast::ExprStatement *) override;
+  virtual void Visit(ast::Break *) override;
+  virtual void Visit(ast::Continue *) override;
+  virtual void Visit(ast::Return *) override;
+  virtual void Visit(ast::If *) override;
+  virtual void Visit(ast::While *) override;
+  virtual void Visit(ast::ObjCreate *) override;
+  virtual void Visit(ast::Function *) override;
+  virtual void Visit(ast::Struct *) override;
+  virtual void Visit(ast::Class *) override;
+  virtual void Visit(ast::Raise *) override;
+  virtual void Visit(ast::Try *) override;
+
+  virtual void Visit(ast::Literal *) override;
+  virtual void Visit(ast::Name *) override;
+  virtual void Visit(ast::UnaryOpExpr *) override;
+  virtual void Visit(ast::BinaryOpExpr *) override;
+  virtual void Visit(ast::LogicExpr *) override;
+  virtual void Visit(ast::IfElseExpr *) override;
+  virtual void Visit(ast::CallExpr *) override;
+  virtual void Visit(ast::SubscriptExpr *) override;
+};
+
+}  // namespace vm
+
+#endif  // _XULANG_SRC_VM_WALK_HPP
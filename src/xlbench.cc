@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./vm/kernel.hpp"
+#include "./vm/pool.hpp"
+
+// Time each kernel of vm/kernel.hpp on packed Memory of every element type
+// and a few sizes, through its vector lanes and one element at a time, and
+// check both give the same. Then time vm::Pool against malloc on what
+// raising and catching errors does to the heap.
+namespace {
+
+constexpr vm::Memory::Elem kElems[] = {vm::Memory::kInt8, vm::Memory::kInt,
+                                       vm::Memory::kFloat};
+constexpr const char *kElemNames[] = {"Int8", "Int", "Float"};
+constexpr size_t kSizes[] = {64, 4096, 1 << 20};
+// Elements each timing goes over, at least
+constexpr size_t kWork = size_t(1) << 27;
+
+struct Result {
+  double ns;  // by element
+  int64_t check;
+};
+
+// Elements 0 to 99 but the last, which is the only 100
+void Init(vm::Memory *memory) {
+  for (size_t i = 0; i < memory->size; ++i) {
+    memory->Set(i, vm::Value::Int(i * 7 % 100));
+  }
+  memory->Set(memory->size - 1, vm::Value::Int(100));
+}
+
+int64_t Bits(const vm::Memory &memory) {
+  int64_t hash = 0;
+  for (size_t i = 0; i < memory.size; ++i) {
+    auto val = memory.Get(i);
+    hash = hash * 31 +
+           (val.tag == vm::Tag::kInt ? val.i : static_cast<int64_t>(val.f));
+  }
+  return hash;
+}
+
+Result Time(size_t size, const std::function<int64_t()> &run) {
+  auto times = std::max<size_t>(kWork / size, 1);
+  int64_t check = 0;
+  auto beg = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < times; ++i) check += run();
+  auto end = std::chrono::steady_clock::now();
+  auto ns = std::chrono::duration<double, std::nano>(end - beg).count();
+  return {ns / (times * size), check / static_cast<int64_t>(times)};
+}
+
+bool Kernels(const std::string &only) {
+  auto failed = false;
+  std::printf("%-6s %-6s %8s %12s %12s %8s\n", "kernel", "elem", "size",
+              "scalar ns", "simd ns", "speedup");
+  for (int e = 0; e < 3; ++e) {
+    for (auto size : kSizes) {
+      auto a = vm::Memory(kElems[e], size);
+      auto b = vm::Memory(kElems[e], size);
+      Init(&a);
+      Init(&b);
+      auto all_a = vm::Span(&a, 0, size);
+      auto all_b = vm::Span(&b, 0, size);
+      auto seven = vm::Value::Int(7);
+      auto hundred = vm::Value::Int(100);
+
+      // Fill and Copy check what they leave in a
+      const std::pair<const char *, std::function<int64_t(bool)>> kernels[] = {
+          {"Fill",
+           [&](bool simd) {
+             vm::Fill(all_a, seven, simd);
+             return int64_t(0);
+           }},
+          {"Copy",
+           [&](bool simd) {
+             vm::Copy(all_a, all_b, simd);
+             return int64_t(0);
+           }},
+          {"Sum",
+           [&](bool simd) {
+             auto sum = vm::Sum(all_b, simd);
+             return sum.tag == vm::Tag::kInt ? sum.i
+                                             : static_cast<int64_t>(sum.f);
+           }},
+          {"Count", [&](bool simd) { return vm::Count(all_b, seven, simd); }},
+          {"Find", [&](bool simd) { return vm::Find(all_b, hundred, simd); }},
+          {"Equal",
+           [&](bool simd) {
+             return int64_t(vm::Equal(all_a, all_b, simd));
+           }},
+      };
+      for (const auto &[name, kernel] : kernels) {
+        if (!only.empty() && only != name) continue;
+        Init(&a);
+        auto scalar = Time(size, [&] { return kernel(false); });
+        auto scalar_bits = Bits(a);
+        Init(&a);
+        auto simd = Time(size, [&] { return kernel(true); });
+        if (scalar.check != simd.check || scalar_bits != Bits(a)) {
+          std::printf("%s of %s differs with vector lanes\n", name,
+                      kElemNames[e]);
+          failed = true;
+        }
+        std::printf("%-6s %-6s %8zu %12.3f %12.3f %7.1fx\n", name,
+                    kElemNames[e], size, scalar.ns, simd.ns,
+                    scalar.ns / simd.ns);
+      }
+    }
+  }
+  return !failed;
+}
+
+struct Heap {
+  void *(*allocate)(size_t);
+  void (*free)(void *);
+};
+
+constexpr Heap kMalloc = {std::malloc, std::free};
+constexpr Heap kPool = {vm::Pool::Allocate, vm::Pool::Free};
+// Of an Instance of 1, 2, 4 and 8 members
+constexpr size_t kBlocks[] = {48, 64, 96, 160};
+constexpr size_t kOps = size_t(1) << 22;
+
+inline void *Touch(void *block) {
+  static_cast<volatile uint8_t *>(block)[0] = 1;
+  return block;
+}
+
+// An error raised and caught right away
+void Raise(const Heap &heap) {
+  for (size_t i = 0; i < kOps; ++i) heap.free(Touch(heap.allocate(48)));
+}
+
+// Errors made in nested calls and freed as the raise unwinds them
+void Unwind(const Heap &heap) {
+  void *stack[64];
+  for (size_t i = 0; i < kOps; i += 64) {
+    for (int d = 0; d < 64; ++d) {
+      stack[d] = Touch(heap.allocate(kBlocks[d % 4]));
+    }
+    for (int d = 63; d >= 0; --d) heap.free(stack[d]);
+  }
+}
+
+// Errors kept, e.g. in an Array, and replaced in no order
+void Keep(const Heap &heap) {
+  auto live = std::vector<void *>(4096);
+  for (auto &block : live) block = heap.allocate(kBlocks[0]);
+  uint64_t random = 1;
+  for (size_t i = 0; i < kOps; ++i) {
+    random = random * 6364136223846793005 + 1442695040888963407;
+    auto &block = live[(random >> 33) % live.size()];
+    heap.free(block);
+    block = Touch(heap.allocate(kBlocks[(random >> 20) % 4]));
+  }
+  for (auto block : live) heap.free(block);
+}
+
+// Errors made on one thread and freed on another
+void Remote(const Heap &heap) {
+  auto mutex = std::mutex();
+  auto ready = std::condition_variable();
+  auto batches = std::vector<std::vector<void *>>();
+  auto done = false;
+  auto consumer = std::thread([&] {
+    for (;;) {
+      auto batch = std::vector<void *>();
+      {
+        auto lock = std::unique_lock<std::mutex>(mutex);
+        ready.wait(lock, [&] { return done || !batches.empty(); });
+        if (batches.empty()) return;
+        batch = std::move(batches.back());
+        batches.pop_back();
+      }
+      ready.notify_all();
+      for (auto block : batch) heap.free(block);
+    }
+  });
+  for (size_t i = 0; i < kOps; i += 256) {
+    auto batch = std::vector<void *>(256);
+    for (size_t j = 0; j < 256; ++j) {
+      batch[j] = Touch(heap.allocate(kBlocks[j % 4]));
+    }
+    auto lock = std::unique_lock<std::mutex>(mutex);
+    ready.wait(lock, [&] { return batches.size() < 16; });
+    batches.push_back(std::move(batch));
+    ready.notify_all();
+  }
+  {
+    auto lock = std::lock_guard<std::mutex>(mutex);
+    done = true;
+  }
+  ready.notify_all();
+  consumer.join();
+}
+
+void Pools(const std::string &only) {
+  const std::pair<const char *, void (*)(const Heap &)> patterns[] = {
+      {"raise", Raise},
+      {"unwind", Unwind},
+      {"keep", Keep},
+      {"remote", Remote},
+  };
+  std::printf("\n%-8s %12s %12s %8s\n", "pattern", "malloc ns", "pool ns",
+              "speedup");
+  for (const auto &[name, pattern] : patterns) {
+    if (!only.empty() && only != name) continue;
+    double ns[2];
+    for (int i = 0; i < 2; ++i) {
+      auto beg = std::chrono::steady_clock::now();
+      pattern(i == 0 ? kMalloc : kPool);
+      auto end = std::chrono::steady_clock::now();
+      ns[i] = std::chrono::duration<double, std::nano>(end - beg).count() /
+              kOps;
+    }
+    std::printf("%-8s %12.3f %12.3f %7.1fx\n", name, ns[0], ns[1],
+                ns[0] / ns[1]);
+  }
+  auto stats = vm::Pool::stats();
+  std::printf(
+      "pool: %llu allocs, %llu frees (%llu remote), %zu of %zu bytes used "
+      "(%.1f%% fragmentation)\n",
+      static_cast<unsigned long long>(stats.allocs),
+      static_cast<unsigned long long>(stats.frees),
+      static_cast<unsigned long long>(stats.remote_frees), stats.used,
+      stats.reserved(), stats.Fragmentation() * 100);
+}
+
+}  // namespace
+
+// xlbench [name] times only the kernel or pattern of that name
+int main(int argc, char *argv[]) {
+  auto only = argc > 1 ? std::string(argv[1]) : std::string();
+  auto ok = Kernels(only);
+  Pools(only);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,217 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+#include "./ast/printer.hpp"
+#include "./ir/build.hpp"
+#include "./ir/gvn.hpp"
+#include "./ir/verify.hpp"
+#include "./loader/loader.hpp"
+#include "./pass/dse.hpp"
+#include "./pass/escape.hpp"
+#include "./pass/fold.hpp"
+#include "./pass/idiom.hpp"
+#include "./pass/inline.hpp"
+#include "./pass/layout.hpp"
+#include "./pass/licm.hpp"
+#include "./pass/range.hpp"
+#include "./pass/resolve.hpp"
+
+static int Usage() {
+  std::cout << "Usage: xlopt [options] file1.xl file2.xl ...\n"
+               "  --resolve    report unresolved names and frame sizes\n"
+               "  --inline     inline small functions at their call statements\n"
+               "  --inline-size=N\n"
+               "               largest body inlined, in nodes (default 40)\n"
+               "  --fold       fold constants and remove dead branches\n"
+               "  --idiom      replace fill, copy, sum and count loops by bulk\n"
+               "               builtins\n"
+               "  --dse        remove stores and objects which are never read\n"
+               "  --licm       hoist loop invariants, strength reduce induction\n"
+               "               variables\n"
+               "  --range      prove subscripts in bounds, remove decided guards\n"
+               "  --escape     find the objects which never leave their function\n"
+               "  --layout     lay out the fields of every Struct and Class to\n"
+               "               leave the least padding\n"
+               "  --layout-profile=FILE\n"
+               "               put the members FILE shows used the most first,\n"
+               "               as xlrun --profile writes it\n"
+               "  --print      print the modules after all passes\n"
+               "  --gvn        number the values of the SSA form of every function\n"
+               "  --ir         print the SSA form of every function"
+            << std::endl;
+  return 0;
+}
+
+static void PrintRemarks(const pass::Remarks &remarks) {
+  for (const auto &remark : remarks) {
+    std::cout << std::string(remark) << std::endl;
+  }
+}
+
+// The SSA form is lowered from the AST after the passes on it
+static bool RunIr(const std::set<std::string> &options, ast::Module *module) {
+  auto lowering = ir::Builder()(module);
+  PrintRemarks(lowering.remarks);
+
+  auto ok = true;
+  auto verify = [&](const ir::Function &func) {
+    for (const auto &error : ir::Verify(func)) {
+      std::cout << "[verify] " << module->filename << ": " << func.name << ": "
+                << error << std::endl;
+      ok = false;
+    }
+  };
+  for (const auto &func : lowering.funcs) {
+    verify(*func);
+    if (options.count("gvn")) {
+      auto removed = ir::NumberValues(func.get());
+      std::cout << "[gvn] " << module->filename << ": " << func->name << ": "
+                << removed << " instrs removed, " << func->Size() << " left"
+                << std::endl;
+      verify(*func);
+    }
+    if (options.count("ir")) std::cout << ir::Dump(*func);
+  }
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  auto options = std::set<std::string>();
+  auto files = std::vector<std::string>();
+  auto inline_size = pass::Inliner::kDefaultMaxSize;
+  auto profile = std::string();
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string(argv[i]);
+    if (arg.rfind("--inline-size=", 0) == 0) {
+      inline_size = std::strtoul(arg.c_str() + 14, nullptr, 10);
+    } else if (arg.rfind("--layout-profile=", 0) == 0) {
+      profile = arg.substr(17);
+      options.insert("layout");
+    } else if (arg.rfind("--", 0) == 0) {
+      options.insert(arg.substr(2));
+    } else {
+      files.push_back(arg);
+    }
+  }
+  if (files.empty()) return Usage();
+
+  // Lines of "Type.member uses"
+  auto uses = pass::Profile();
+  if (!profile.empty()) {
+    auto file = std::ifstream(profile);
+    if (!file) {
+      std::cout << profile << ": cannot be read" << std::endl;
+      return -1;
+    }
+    auto member = std::string();
+    uint64_t n;
+    while (file >> member >> n) uses[member] += n;
+  }
+
+  auto graph = loader::Loader().Load(files);
+  if (graph == nullptr) return -1;
+
+  auto ret = 0;
+  for (auto idx : graph->TopoOrder()) {
+    auto module = graph->nodes[idx]->module.get();
+
+    // Every other pass relies on the bindings
+    auto resolution = pass::Resolver()(module);
+    if (options.count("resolve")) {
+      PrintRemarks(resolution.remarks);
+      for (const auto &frame : resolution.frames) {
+        std::cout << "[resolve] " << module->filename << ": "
+                  << *frame.owner->GetId() << " has " << frame.slots.size()
+                  << " slots, " << frame.params << " params" << std::endl;
+      }
+      std::cout << "[resolve] " << module->filename << ": "
+                << resolution.resolved << " names resolved, "
+                << resolution.unresolved << " unresolved" << std::endl;
+    }
+
+    if (options.count("inline")) {
+      auto inlining = pass::Inliner(inline_size)(module);
+      PrintRemarks(inlining.remarks);
+      std::cout << "[inline] " << module->filename << ": " << inlining.inlined
+                << " calls inlined, " << inlining.recursive
+                << " recursive functions" << std::endl;
+      resolution = pass::Resolver()(module);
+    }
+
+    if (options.count("fold")) {
+      auto folding = pass::Folder()(module);
+      PrintRemarks(folding.remarks);
+      std::cout << "[fold] " << module->filename << ": " << folding.folded
+                << " expressions folded, " << folding.branches
+                << " branches decided, " << folding.removed << " nodes removed"
+                << std::endl;
+      resolution = pass::Resolver()(module);
+    }
+
+    if (options.count("idiom")) {
+      auto idioms = pass::IdiomRecognizer()(module);
+      PrintRemarks(idioms.remarks);
+      std::cout << "[idiom] " << module->filename << ": " << idioms.fills
+                << " fills, " << idioms.copies << " copies, " << idioms.sums
+                << " sums, " << idioms.counts << " counts" << std::endl;
+      resolution = pass::Resolver()(module);
+    }
+
+    if (options.count("dse")) {
+      auto elimination = pass::DeadStoreEliminator()(module);
+      PrintRemarks(elimination.remarks);
+      std::cout << "[dse] " << module->filename << ": " << elimination.stores
+                << " stores, " << elimination.objects + elimination.calls
+                << " objects removed" << std::endl;
+      resolution = pass::Resolver()(module);
+    }
+
+    if (options.count("licm")) {
+      auto opts = pass::LoopOptimizer()(module);
+      PrintRemarks(opts.remarks);
+      std::cout << "[licm] " << module->filename << ": " << opts.hoisted
+                << " expressions hoisted, " << opts.inductions
+                << " induction variables, " << opts.reduced
+                << " multiplications reduced" << std::endl;
+      resolution = pass::Resolver()(module);
+    }
+
+    if (options.count("range")) {
+      auto ranges = pass::RangeAnalyzer()(module);
+      PrintRemarks(ranges.remarks);
+      std::cout << "[range] " << module->filename << ": " << ranges.in_bounds
+                << " of " << ranges.subscripts << " subscripts in bounds, "
+                << ranges.guards << " guards removed" << std::endl;
+      resolution = pass::Resolver()(module);
+    }
+
+    if (options.count("escape")) {
+      auto escapes = pass::EscapeAnalyzer()(module);
+      PrintRemarks(escapes.remarks);
+      std::cout << "[escape] " << module->filename << ": " << escapes.no_escape
+                << " of " << escapes.objects << " objects do not escape, "
+                << escapes.scalars << " of them scalars, " << escapes.returned
+                << " returned, " << escapes.stored << " kept" << std::endl;
+    }
+
+    if (options.count("layout")) {
+      auto layouts =
+          pass::LayoutEngine(profile.empty() ? nullptr : &uses)(module);
+      PrintRemarks(layouts.remarks);
+      std::cout << layouts.Dump();
+      std::cout << "[layout] " << module->filename << ": "
+                << layouts.types.size() << " types, " << layouts.reordered
+                << " reordered, " << layouts.saved << " bytes saved"
+                << std::endl;
+    }
+
+    if (options.count("print")) std::cout << ast::Printer()(module);
+    if ((options.count("ir") || options.count("gvn")) &&
+        !RunIr(options, module)) {
+      ret = -1;
+    }
+  }
+  return ret;
+}
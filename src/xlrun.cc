@@ -0,0 +1,218 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "./jit/jit.hpp"
+#include "./loader/loader.hpp"
+#include "./pass/fold.hpp"
+#include "./pass/idiom.hpp"
+#include "./pass/inline.hpp"
+#include "./pass/licm.hpp"
+#include "./pass/range.hpp"
+#include "./pass/resolve.hpp"
+#include "./utils/log.hpp"
+#include "./vm/compile.hpp"
+#include "./vm/pool.hpp"
+#include "./vm/vm.hpp"
+#include "./vm/walk.hpp"
+
+static auto kLog = utils::Logger::NewLogger("vm");
+
+static int Usage() {
+  std::cout << "Usage: xlrun [options] file.xl\n"
+               "  -O           inline, fold, replace idioms, hoist invariants\n"
+               "               and prove subscripts in bounds first\n"
+               "  --walk       run the AST with the tree walker, not the VM\n"
+               "  --dump       print the bytecode\n"
+               "  --jit        compile the Functions which only compute on\n"
+               "               Int and Float to machine code with LLVM\n"
+               "  --llvm       print their IR after -O2 and why the others\n"
+               "               are not compiled\n"
+               "  --obj=FILE   write them to an object file\n"
+               "  --pool       print what the objects took of the pool\n"
+               "  --profile=FILE\n"
+               "               write how many times each member of a Class or\n"
+               "               Struct is used, for xlopt --layout-profile\n"
+               "  --bench=N    run N times on both, check they print the same\n"
+               "               and compare their times"
+            << std::endl;
+  return 0;
+}
+
+// The passes of xlopt which make the bytecode faster, each after the names
+// are bound
+static void Optimize(ast::Module *module) {
+  pass::Resolver()(module);
+  pass::Inliner()(module);
+  pass::Resolver()(module);
+  pass::Folder()(module);
+  pass::Resolver()(module);
+  pass::IdiomRecognizer()(module);
+  pass::Resolver()(module);
+  pass::LoopOptimizer()(module);
+  pass::Resolver()(module);
+  pass::RangeAnalyzer()(module);
+}
+
+// Lower what it can to LLVM IR, optimize it, and write it or load it for the
+// VM to call
+static bool Compile(jit::Jit *jit, ast::Module *module, vm::Program *program,
+                    bool load, bool print, const std::string &object) {
+  auto lowering = jit::CodeGen()(module, *program);
+  if (!jit->Optimize(lowering.module.get())) {
+    kLog->Error({"jit", jit->error()});
+    return false;
+  }
+  if (print) {
+    for (const auto &remark : lowering.remarks) {
+      kLog->Info({std::string(remark)});
+    }
+    auto text = std::string();
+    auto out = llvm::raw_string_ostream(text);
+    lowering.module->print(out, nullptr);
+    std::cout << out.str();
+  }
+  if (!object.empty() && !jit->EmitObject(lowering.module.get(), object)) {
+    kLog->Error({"jit", jit->error()});
+    return false;
+  }
+  if (load && !jit->Load(std::move(lowering), program)) {
+    kLog->Error({"jit", jit->error()});
+    return false;
+  }
+  return true;
+}
+
+// The exit code is what main returns if it is an Int
+static int Exit(bool ok, vm::Runtime &runtime, const vm::Value &res) {
+  if (!ok) {
+    kLog->Error({"uncaught", runtime.ToString(runtime.error)});
+    return -1;
+  }
+  return res.tag == vm::Tag::kInt ? static_cast<int>(res.i) : 0;
+}
+
+// Both engines get the same input and print to a string each run
+static int Bench(const vm::Program &program, ast::Module *module, int times) {
+  auto input = std::string(std::istreambuf_iterator<char>(std::cin), {});
+  auto run = [&](bool walk, std::string *output) {
+    auto beg = std::chrono::steady_clock::now();
+    for (int i = 0; i < times; ++i) {
+      auto in = std::istringstream(input);
+      auto out = std::ostringstream();
+      auto res = vm::Value();
+      if (walk) {
+        auto walker = vm::TreeWalker(&program, module, &in, &out);
+        out << (walker.Run(&res) ? "" : walker.runtime().ToString(
+                                            walker.runtime().error));
+      } else {
+        auto machine = vm::Machine(&program, &in, &out);
+        out << (machine.Run(&res) ? "" : machine.runtime().ToString(
+                                              machine.runtime().error));
+      }
+      *output = out.str();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - beg).count();
+  };
+
+  auto walked = std::string();
+  auto ran = std::string();
+  auto walk_ms = run(true, &walked);
+  auto vm_ms = run(false, &ran);
+  if (walked != ran) {
+    kLog->Error(
+        {program.filename, "prints differently on the walker and the VM"});
+    return -1;
+  }
+  std::cout << "[bench] " << program.filename << ": " << times
+            << " runs, walker " << walk_ms << " ms, vm " << vm_ms << " ms, "
+            << walk_ms / vm_ms << "x" << std::endl;
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  auto options = std::set<std::string>();
+  auto files = std::vector<std::string>();
+  auto times = 0;
+  auto object = std::string();
+  auto profile = std::string();
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string(argv[i]);
+    if (arg.rfind("--bench=", 0) == 0) {
+      times = std::atoi(arg.c_str() + 8);
+    } else if (arg.rfind("--obj=", 0) == 0) {
+      object = arg.substr(6);
+    } else if (arg.rfind("--profile=", 0) == 0) {
+      profile = arg.substr(10);
+    } else if (arg.rfind("-", 0) == 0) {
+      options.insert(arg.substr(arg.find_first_not_of('-')));
+    } else {
+      files.push_back(arg);
+    }
+  }
+  if (files.size() != 1) return Usage();
+
+  auto graph = loader::Loader().Load(files);
+  if (graph == nullptr) return -1;
+  auto module = graph->nodes[graph->roots.front()]->module.get();
+  if (options.count("O")) Optimize(module);
+  auto resolution = pass::Resolver()(module);
+  for (const auto &remark : resolution.remarks) {
+    kLog->Error({std::string(remark)});
+  }
+
+  auto compilation = vm::Compiler()(module, resolution);
+  for (const auto &remark : compilation.remarks) {
+    kLog->Error({std::string(remark)});
+  }
+  if (compilation.program == nullptr || !resolution.remarks.empty()) return -1;
+  auto &program = *compilation.program;
+  if (options.count("dump")) std::cout << vm::Disassemble(program);
+  auto jit = jit::Jit();
+  auto load = options.count("jit") > 0, print = options.count("llvm") > 0;
+  if ((load || print || !object.empty()) &&
+      !Compile(&jit, module, &program, load, print, object)) {
+    return -1;
+  }
+  if (times > 0) return Bench(program, module, times);
+
+  auto res = vm::Value();
+  auto code = 0;
+  auto uses = std::unordered_map<std::string, uint64_t>();
+  if (options.count("walk")) {
+    auto walker = vm::TreeWalker(&program, module, &std::cin, &std::cout);
+    if (!profile.empty()) walker.runtime().member_uses = &uses;
+    auto ok = walker.Run(&res);
+    std::cout.flush();
+    code = Exit(ok, walker.runtime(), res);
+  } else {
+    auto machine = vm::Machine(&program, &std::cin, &std::cout);
+    if (!profile.empty()) machine.runtime().member_uses = &uses;
+    auto ok = machine.Run(&res);
+    std::cout.flush();
+    code = Exit(ok, machine.runtime(), res);
+  }
+  if (options.count("pool")) {
+    auto stats = vm::Pool::stats();
+    kLog->Info({"pool", std::to_string(stats.allocs) + " allocs, " +
+                            std::to_string(stats.frees) + " frees, " +
+                            std::to_string(stats.slabs) + " slabs, " +
+                            std::to_string(stats.used) + " bytes used"});
+  }
+  if (!profile.empty()) {
+    auto file = std::ofstream(profile);
+    for (const auto &[member, n] : std::map(uses.begin(), uses.end())) {
+      file << member << " " << n << "\n";
+    }
+    if (!file) {
+      kLog->Error({profile, "cannot be written"});
+      return -1;
+    }
+  }
+  return code;
+}
@@ -0,0 +1,63 @@
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "./ast/json.hpp"
+#include "./server/server.hpp"
+
+static int Usage() {
+  std::cout << "Usage: xlserver [-s socket] serve\n"
+               "       xlserver [-s socket] parse|json|drop file1.xl ...\n"
+               "       xlserver [-s socket] stats|stop"
+            << std::endl;
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  auto socket_path = server::Server::DefaultSocketPath();
+  auto args = std::vector<std::string>(argv + 1, argv + argc);
+  if (args.size() >= 2 && args[0] == "-s") {
+    socket_path = args[1];
+    args.erase(args.begin(), args.begin() + 2);
+  }
+  if (args.empty()) return Usage();
+
+  if (args[0] == "serve") {
+    auto server = server::Server(socket_path);
+    if (!server.Listen()) return -1;
+    server.Run();
+    return 0;
+  }
+
+  auto requests = std::vector<std::string>();
+  if (args[0] == "stats" || args[0] == "stop") {
+    requests.push_back(args[0]);
+  } else if (args[0] == "parse" || args[0] == "json" || args[0] == "drop") {
+    for (size_t i = 1; i < args.size(); ++i) {
+      requests.push_back(args[0] + " " +
+                         std::filesystem::absolute(args[i]).string());
+    }
+  } else {
+    return Usage();
+  }
+
+  auto failed = false;
+  for (const auto &request : requests) {
+    auto response = std::string();
+    if (!server::Server::Request(socket_path, request, &response)) {
+      std::cerr << "cannot reach the server on " << socket_path << std::endl;
+      return -1;
+    }
+    auto newline = response.find('\n');
+    if (response.rfind("ok", 0) != 0) {
+      std::cerr << response << std::endl;
+      failed = true;
+    } else if (args[0] == "json") {
+      ast::PrintJson(response.substr(newline + 1));
+      std::cout << std::endl << std::endl;
+    } else if (newline + 1 < response.size()) {
+      std::cout << response.substr(newline + 1);
+    }
+  }
+  return failed ? -1 : 0;
+}